@@ -0,0 +1,120 @@
+/* @file bestkeyindex.cpp
+ * @brief The best keys of the KeyCache by mail address
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bestkeyindex.h"
+
+unsigned int
+best_key_flags (const GpgME::Key &key, const std::string &mbox,
+                bool secret)
+{
+  unsigned int flags = 0;
+
+  if (key.isNull ())
+    {
+      return 0;
+    }
+  if (secret)
+    {
+      if (key.canSign () && key.hasSecret ())
+        {
+          flags |= BEST_KEY_USABLE;
+        }
+    }
+  else if (key.canEncrypt () && !key.isRevoked () && !key.isExpired ()
+           && !key.isDisabled () && !key.isInvalid ())
+    {
+      flags |= BEST_KEY_USABLE;
+    }
+  if (key.isDeVs ())
+    {
+      flags |= BEST_KEY_DEVS;
+    }
+  if (secret)
+    {
+      return flags;
+    }
+  for (const auto &uid: key.userIDs ())
+    {
+      if (mbox != uid.addrSpec ())
+        {
+          continue;
+        }
+      if (uid.validity () >= GpgME::UserID::Marginal
+          || uid.origin () == GpgME::Key::OriginWKD)
+        {
+          flags |= BEST_KEY_VALID;
+          break;
+        }
+      if (uid.validity () == GpgME::UserID::Unknown)
+        {
+          flags |= BEST_KEY_UNKNOWN;
+        }
+    }
+  return flags;
+}
+
+best_key_check_e
+check_best_key (const best_key_s &best, bool secret, bool de_vs,
+                bool auto_untrusted)
+{
+  if (!(best.flags & BEST_KEY_USABLE))
+    {
+      return BestKeyNotUsable;
+    }
+  if (de_vs && !(best.flags & BEST_KEY_DEVS))
+    {
+      return BestKeyNotDeVs;
+    }
+  if (secret || (best.flags & BEST_KEY_VALID))
+    {
+      return BestKeyOk;
+    }
+  if (auto_untrusted && (best.flags & BEST_KEY_UNKNOWN))
+    {
+      return BestKeyOkUnknown;
+    }
+  return BestKeyNotValid;
+}
+
+void
+BestKeyIndex::set (const std::string &mbox, const GpgME::Key &key,
+                   bool secret)
+{
+  if (key.isNull ())
+    {
+      m_map.erase (mbox);
+      return;
+    }
+  m_map[mbox] = best_key_s {key, best_key_flags (key, mbox, secret)};
+}
+
+bool
+BestKeyIndex::find (const std::string &mbox, best_key_s *r_best) const
+{
+  const auto it = m_map.find (mbox);
+
+  if (it == m_map.end ())
+    {
+      return false;
+    }
+  *r_best = it->second;
+  return true;
+}
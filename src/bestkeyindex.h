@@ -0,0 +1,94 @@
+/* @file bestkeyindex.h
+ * @brief The best keys of the KeyCache by mail address
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BESTKEYINDEX_H
+#define BESTKEYINDEX_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string>
+#include <unordered_map>
+
+#include <gpgme++/key.h>
+
+/* Flags of a key in the index of the best keys.  The checks which
+   depend on options are done on lookup.  */
+#define BEST_KEY_USABLE  1  /* The key can encrypt or sign.  */
+#define BEST_KEY_VALID   2  /* A user id for the mbox is valid enough. */
+#define BEST_KEY_UNKNOWN 4  /* A user id for the mbox has unknown
+                               validity.  */
+#define BEST_KEY_DEVS    8  /* The key is VS-NfD compliant.  */
+
+/* The key for a mail address with the result of the checks which
+   getEncryptionKeys and getSigningKey would do for every lookup.  */
+struct best_key_s
+{
+  GpgME::Key key;
+  unsigned int flags;
+};
+
+/* The results of check_best_key.  */
+enum best_key_check_e
+{
+  BestKeyOk = 0,
+  /* Only usable because keys with unknown validity are allowed.  */
+  BestKeyOkUnknown,
+  BestKeyNotUsable,
+  BestKeyNotDeVs,
+  BestKeyNotValid
+};
+
+/* Return the BEST_KEY flags of KEY for MBOX.  SECRET is true if KEY
+   is used for signing.  */
+unsigned int best_key_flags (const GpgME::Key &key, const std::string &mbox,
+                             bool secret);
+
+/* Check BEST like getEncryptionKeys or, if SECRET is set, like
+   getSigningKey.  DE_VS is set in VS-NfD mode and AUTO_UNTRUSTED if
+   keys with unknown validity may be used.  */
+best_key_check_e check_best_key (const best_key_s &best, bool secret,
+                                 bool de_vs, bool auto_untrusted);
+
+/* The BestKeyIndex maps mail addresses to their key and its flags.
+   The flags are computed when a key is stored so that a lookup only
+   has to test them.  It has no lock of its own; the KeyCache
+   protects it with the lock of its key maps.  */
+class BestKeyIndex
+{
+public:
+  /* Store KEY as the best key for MBOX.  A null KEY removes MBOX.
+     SECRET is true for an index of signing keys.  */
+  void set (const std::string &mbox, const GpgME::Key &key, bool secret);
+
+  void erase (const std::string &mbox) { m_map.erase (mbox); }
+
+  /* Look up MBOX.  Returns false if there is no key for it.  */
+  bool find (const std::string &mbox, best_key_s *r_best) const;
+
+  size_t size () const { return m_map.size (); }
+
+private:
+  std::unordered_map<std::string, best_key_s> m_map;
+};
+
+#endif /* BESTKEYINDEX_H */
@@ -0,0 +1,278 @@
+/* @file cachecrypt.cpp
+ * @brief Protected memory and hashing for the caches of plaintext
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "cachecrypt.h"
+
+#include "common_indep.h"
+
+#ifdef HAVE_W32_SYSTEM
+# include <wincrypt.h>
+# include <bcrypt.h>
+#else
+# include <gcrypt.h>
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gpg-error.h>
+
+GPGRT_LOCK_DEFINE (cachecrypt_lock);
+
+void
+protect_data (std::string &buf)
+{
+#ifdef HAVE_W32_SYSTEM
+  size_t len = buf.size ();
+  len += CRYPTPROTECTMEMORY_BLOCK_SIZE - len % CRYPTPROTECTMEMORY_BLOCK_SIZE;
+  buf.resize (len);
+  if (!CryptProtectMemory (&buf[0], (DWORD) len,
+                           CRYPTPROTECTMEMORY_SAME_PROCESS))
+    {
+      log_error ("%s:%s: CryptProtectMemory failed: %lu",
+                 SRCNAME, __func__, GetLastError ());
+      wipe_string (buf);
+    }
+#else
+  /* Only used by the tests.  */
+  (void) buf;
+#endif
+}
+
+bool
+unprotect_data (std::string &buf, size_t len)
+{
+#ifdef HAVE_W32_SYSTEM
+  if (buf.empty ()
+      || !CryptUnprotectMemory (&buf[0], (DWORD) buf.size (),
+                                CRYPTPROTECTMEMORY_SAME_PROCESS))
+    {
+      log_error ("%s:%s: CryptUnprotectMemory failed: %lu",
+                 SRCNAME, __func__, GetLastError ());
+      return false;
+    }
+#endif
+  if (len > buf.size ())
+    {
+      return false;
+    }
+  buf.resize (len);
+  return true;
+}
+
+void
+wipe_string (std::string &buf)
+{
+  if (buf.size ())
+    {
+      wipememory (&buf[0], buf.size ());
+    }
+  buf.clear ();
+}
+
+void
+delete_wiped (std::string *buf)
+{
+  wipe_string (*buf);
+  delete buf;
+}
+
+#ifdef HAVE_W32_SYSTEM
+static BCRYPT_ALG_HANDLE sha256_alg;
+
+/* Open the algorithm provider on first use.  Its handle may be used
+   by several threads and is never closed.  */
+static BCRYPT_ALG_HANDLE
+get_sha256_alg ()
+{
+  BCRYPT_ALG_HANDLE ret;
+
+  gpgol_lock (&cachecrypt_lock);
+  if (!sha256_alg)
+    {
+      NTSTATUS status = BCryptOpenAlgorithmProvider (&sha256_alg,
+                                                     BCRYPT_SHA256_ALGORITHM,
+                                                     nullptr, 0);
+      if (!BCRYPT_SUCCESS (status))
+        {
+          log_error ("%s:%s: BCryptOpenAlgorithmProvider failed: %#lx",
+                     SRCNAME, __func__, (unsigned long) status);
+          sha256_alg = nullptr;
+        }
+    }
+  ret = sha256_alg;
+  gpgol_unlock (&cachecrypt_lock);
+  return ret;
+}
+#else
+/* Libgcrypt needs to be initialized once.  */
+static void
+init_gcrypt ()
+{
+  gpgol_lock (&cachecrypt_lock);
+  if (!gcry_control (GCRYCTL_INITIALIZATION_FINISHED_P))
+    {
+      gcry_check_version (nullptr);
+      gcry_control (GCRYCTL_INITIALIZATION_FINISHED, 0);
+    }
+  gpgol_unlock (&cachecrypt_lock);
+}
+#endif
+
+class Sha256::Private
+{
+public:
+  Private () :
+    m_hd (nullptr),
+    m_failed (false)
+  {
+  }
+
+  ~Private ()
+  {
+    if (m_hd)
+      {
+#ifdef HAVE_W32_SYSTEM
+        BCryptDestroyHash (m_hd);
+#else
+        gcry_md_close (m_hd);
+#endif
+      }
+  }
+
+#ifdef HAVE_W32_SYSTEM
+  BCRYPT_HASH_HANDLE m_hd;
+#else
+  gcry_md_hd_t m_hd;
+#endif
+  /* Set if a call failed.  Then the digest is empty.  */
+  bool m_failed;
+};
+
+Sha256::Sha256 () :
+  d (new Private)
+{
+#ifdef HAVE_W32_SYSTEM
+  BCRYPT_ALG_HANDLE alg = get_sha256_alg ();
+  if (!alg)
+    {
+      d->m_failed = true;
+      return;
+    }
+  NTSTATUS status = BCryptCreateHash (alg, &d->m_hd, nullptr, 0, nullptr,
+                                      0, 0);
+  if (!BCRYPT_SUCCESS (status))
+    {
+      log_error ("%s:%s: BCryptCreateHash failed: %#lx",
+                 SRCNAME, __func__, (unsigned long) status);
+      d->m_hd = nullptr;
+      d->m_failed = true;
+    }
+#else
+  init_gcrypt ();
+  gpg_error_t err = gcry_md_open (&d->m_hd, GCRY_MD_SHA256, 0);
+  if (err)
+    {
+      log_error ("%s:%s: gcry_md_open failed: %s",
+                 SRCNAME, __func__, gpg_strerror (err));
+      d->m_hd = nullptr;
+      d->m_failed = true;
+    }
+#endif
+}
+
+void
+Sha256::write (const void *buf, size_t len)
+{
+  if (d->m_failed || !len)
+    {
+      return;
+    }
+#ifdef HAVE_W32_SYSTEM
+  const unsigned char *p = static_cast<const unsigned char *> (buf);
+  while (len)
+    {
+      /* BCryptHashData takes a ULONG length.  */
+      ULONG n = len > 0x40000000 ? 0x40000000 : (ULONG) len;
+      NTSTATUS status = BCryptHashData (d->m_hd, (PUCHAR) p, n, 0);
+      if (!BCRYPT_SUCCESS (status))
+        {
+          log_error ("%s:%s: BCryptHashData failed: %#lx",
+                     SRCNAME, __func__, (unsigned long) status);
+          d->m_failed = true;
+          return;
+        }
+      p += n;
+      len -= n;
+    }
+#else
+  gcry_md_write (d->m_hd, buf, len);
+#endif
+}
+
+void
+Sha256::writeString (const std::string &str)
+{
+  unsigned char len[8];
+  uint64_t n = str.size ();
+  int i;
+
+  for (i = 0; i < 8; i++)
+    {
+      len[i] = (unsigned char) (n >> (56 - 8 * i));
+    }
+  write (len, sizeof len);
+  write (str.data (), str.size ());
+}
+
+std::string
+Sha256::final ()
+{
+  unsigned char digest[32];
+  std::string ret;
+  char hex[3];
+
+  if (d->m_failed)
+    {
+      return ret;
+    }
+#ifdef HAVE_W32_SYSTEM
+  NTSTATUS status = BCryptFinishHash (d->m_hd, digest, sizeof digest, 0);
+  if (!BCRYPT_SUCCESS (status))
+    {
+      log_error ("%s:%s: BCryptFinishHash failed: %#lx",
+                 SRCNAME, __func__, (unsigned long) status);
+      d->m_failed = true;
+      return ret;
+    }
+#else
+  memcpy (digest, gcry_md_read (d->m_hd, GCRY_MD_SHA256), sizeof digest);
+#endif
+  /* The handle can't be used after the digest was read.  */
+  d->m_failed = true;
+  for (const auto c: digest)
+    {
+      snprintf (hex, sizeof hex, "%02x", c);
+      ret += hex;
+    }
+  return ret;
+}
@@ -0,0 +1,71 @@
+/* @file cachecrypt.h
+ * @brief Protected memory and hashing for the caches of plaintext
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CACHECRYPT_H
+#define CACHECRYPT_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <memory>
+#include <string>
+
+/* Encrypt BUF in place for the lifetime of the process.  BUF is
+   padded as required.  On error BUF is wiped and cleared.  */
+void protect_data (std::string &buf);
+
+/* Decrypt BUF which was encrypted by protect_data and cut it to
+   LEN.  Returns false on error.  */
+bool unprotect_data (std::string &buf, size_t len);
+
+/* Wipe the plaintext in BUF and clear it.  */
+void wipe_string (std::string &buf);
+
+/* Deleter for a shared_ptr to plaintext which wipes the string when
+   the last reference is gone.  */
+void delete_wiped (std::string *buf);
+
+/* A SHA-256 of the Windows CNG API.  The tests use Libgcrypt.  The
+   caches use it as the key of their entries which are returned
+   without comparing the data, so the key must not collide.  */
+class Sha256
+{
+public:
+  Sha256 ();
+
+  /* Hash LEN bytes at BUF.  */
+  void write (const void *buf, size_t len);
+
+  /* Hash STR prefixed with its length so that consecutive strings
+     can't be shifted into each other.  */
+  void writeString (const std::string &str);
+
+  /* Return the digest as a lower case hex string.  Returns an empty
+     string on error.  No data may be written afterwards.  */
+  std::string final ();
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif /* CACHECRYPT_H */
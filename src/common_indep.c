@@ -27,6 +27,9 @@
 #include <wchar.h>
 #include <stdlib.h>
 #include <ctype.h>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 
 struct opt_s opt;
 
@@ -235,62 +238,117 @@ trim_trailing_spaces (char *string)
   return string;
 }
 
+/* Return a pointer to the first '=' in the LENGTH bytes at S or NULL
+   if there is none.  Most quoted-printable text has long runs of
+   literal characters so this is worth a vectorized scan.  */
+static char *
+find_qp_escape (char *s, size_t length)
+{
+#ifdef __SSE2__
+  const __m128i eq = _mm_set1_epi8 ('=');
+  int mask;
+
+  for (; length >= 16; length -= 16, s += 16)
+    {
+      mask = _mm_movemask_epi8
+        (_mm_cmpeq_epi8 (_mm_loadu_si128 ((const __m128i *)s), eq));
+      if (mask)
+        return s + __builtin_ctz (mask);
+    }
+#endif /*__SSE2__*/
+  return memchr (s, '=', length);
+}
+
+
 /* Do in-place decoding of quoted-printable data of LENGTH in BUFFER.
-   Returns the new length of the buffer and stores true at R_SLBRK if
-   the line ended with a soft line break; false is stored if not.
-   This fucntion asssumes that a complete line is passed in
-   buffer.  */
+   Returns the new length of the buffer.  BUFFER may hold any number
+   of lines.  If R_NOT_TAKEN is not NULL the data is assumed to be
+   continued by the next call: An escape sequence or soft line break
+   which is incomplete at the end of BUFFER is not decoded and its
+   length is stored at R_NOT_TAKEN so that the caller can pass it
+   again in front of the next chunk.  If R_NOT_TAKEN is NULL a '=' at
+   the end is a soft line break.  If R_SLBRK is not NULL true is
+   stored there if the data ended with a soft line break; false if
+   not.  */
 size_t
-qp_decode (char *buffer, size_t length, int *r_slbrk)
+qp_decode_buffer (char *buffer, size_t length, size_t *r_not_taken,
+                  int *r_slbrk)
 {
-  char *d, *s;
+  char *d, *s, *end, *eq;
+  size_t n;
 
   if (r_slbrk)
     *r_slbrk = 0;
+  if (r_not_taken)
+    *r_not_taken = 0;
 
-  /* Fixme:  We should remove trailing white space first.  */
-  for (s=d=buffer; length; length--)
-    if (*s == '=')
-      {
-        if (length > 2 && hexdigitp (s+1) && hexdigitp (s+2))
-          {
-            s++;
-            *(unsigned char*)d++ = xtoi_2 (s);
-            s += 2;
-            length -= 2;
-          }
-        else if (length > 2 && s[1] == '\r' && s[2] == '\n')
-          {
-            /* Soft line break.  */
-            s += 3;
-            length -= 2;
-            if (r_slbrk && length == 1)
-              *r_slbrk = 1;
-          }
-        else if (length > 1 && s[1] == '\n')
-          {
-            /* Soft line break with only a Unix line terminator. */
-            s += 2;
-            length -= 1;
-            if (r_slbrk && length == 1)
-              *r_slbrk = 1;
-          }
-        else if (length == 1)
-          {
-            /* Soft line break at the end of the line. */
-            s += 1;
-            if (r_slbrk)
-              *r_slbrk = 1;
-          }
-        else
-          *d++ = *s++;
-      }
-    else
-      *d++ = *s++;
+  end = buffer + length;
+  for (s = d = buffer; s < end; )
+    {
+      /* Copy the literal characters up to the next '='.  */
+      eq = find_qp_escape (s, end - s);
+      n = (eq ? eq : end) - s;
+      if (d != s)
+        memmove (d, s, n);
+      d += n;
+      s += n;
+      if (!eq)
+        break;
+
+      n = end - s;
+      if (r_not_taken
+          && (n == 1 || (n == 2 && (hexdigitp (s+1) || s[1] == '\r'))))
+        {
+          /* Wait for the rest of the sequence.  */
+          *r_not_taken = n;
+          break;
+        }
+      if (n > 2 && hexdigitp (s+1) && hexdigitp (s+2))
+        {
+          *(unsigned char*)d++ = xtoi_2 (s+1);
+          s += 3;
+        }
+      else if (n > 2 && s[1] == '\r' && s[2] == '\n')
+        {
+          /* Soft line break.  */
+          s += 3;
+          if (r_slbrk && s == end)
+            *r_slbrk = 1;
+        }
+      else if (n > 1 && s[1] == '\n')
+        {
+          /* Soft line break with only a Unix line terminator. */
+          s += 2;
+          if (r_slbrk && s == end)
+            *r_slbrk = 1;
+        }
+      else if (n == 1)
+        {
+          /* Soft line break at the end of the line. */
+          s += 1;
+          if (r_slbrk)
+            *r_slbrk = 1;
+        }
+      else
+        *d++ = *s++;
+    }
 
   return d - buffer;
 }
 
+
+/* Do in-place decoding of quoted-printable data of LENGTH in BUFFER.
+   Returns the new length of the buffer and stores true at R_SLBRK if
+   the line ended with a soft line break; false is stored if not.
+   This fucntion asssumes that a complete line is passed in
+   buffer.  */
+size_t
+qp_decode (char *buffer, size_t length, int *r_slbrk)
+{
+  /* Fixme:  We should remove trailing white space first.  */
+  return qp_decode_buffer (buffer, length, NULL, r_slbrk);
+}
+
 /* Return the a quoted printable encoded version of the
    input string. If outlen is not null the size of the
    quoted printable string is returned. String will be
@@ -348,6 +406,107 @@ void b64_init (b64_state_t *state)
 }
 
 
+#ifdef __SSE2__
+/* Decode the 16 base64 characters at SRC into 12 bytes at DST.
+   Returns false without writing anything if SRC contains anything
+   but base64 characters.  DST may overlap with SRC as long as it
+   does not start behind it.  */
+static int
+b64_decode_sse2 (unsigned char *dst, const unsigned char *src)
+{
+  __m128i in, upper, lower, digit, plus, slash, valid, shift, v;
+  unsigned int tmp[4];
+  int i;
+
+#define IN_RANGE(x,lo,hi) _mm_and_si128                         \
+    (_mm_cmpgt_epi8 ((x), _mm_set1_epi8 ((lo) - 1)),            \
+     _mm_cmplt_epi8 ((x), _mm_set1_epi8 ((hi) + 1)))
+
+  in = _mm_loadu_si128 ((const __m128i *)src);
+
+  /* Characters >= 0x80 are negative and thus never in range.  */
+  upper = IN_RANGE (in, 'A', 'Z');
+  lower = IN_RANGE (in, 'a', 'z');
+  digit = IN_RANGE (in, '0', '9');
+  plus = _mm_cmpeq_epi8 (in, _mm_set1_epi8 ('+'));
+  slash = _mm_cmpeq_epi8 (in, _mm_set1_epi8 ('/'));
+#undef IN_RANGE
+
+  valid = _mm_or_si128 (_mm_or_si128 (upper, lower),
+                        _mm_or_si128 (_mm_or_si128 (digit, plus), slash));
+  if (_mm_movemask_epi8 (valid) != 0xffff)
+    return 0;
+
+  /* Map each character to its 6 bit value by adding the offset of
+     its range.  */
+  shift = _mm_or_si128
+    (_mm_or_si128 (_mm_and_si128 (upper, _mm_set1_epi8 (-'A')),
+                   _mm_and_si128 (lower, _mm_set1_epi8 (26 - 'a'))),
+     _mm_or_si128 (_mm_and_si128 (digit, _mm_set1_epi8 (52 - '0')),
+                   _mm_or_si128 (_mm_and_si128 (plus,
+                                                _mm_set1_epi8 (62 - '+')),
+                                 _mm_and_si128 (slash,
+                                                _mm_set1_epi8 (63 - '/')))));
+  v = _mm_add_epi8 (in, shift);
+
+  /* Merge pairs of 6 bit values into 12 bit values and then pairs of
+     those into the 24 bits of each quad.  */
+  v = _mm_or_si128 (_mm_slli_epi16 (_mm_and_si128 (v, _mm_set1_epi16 (0xff)),
+                                    6),
+                    _mm_srli_epi16 (v, 8));
+  v = _mm_or_si128 (_mm_slli_epi32 (_mm_and_si128 (v,
+                                                   _mm_set1_epi32 (0xffff)),
+                                    12),
+                    _mm_srli_epi32 (v, 16));
+  _mm_storeu_si128 ((__m128i *)tmp, v);
+
+  for (i = 0; i < 4; i++)
+    {
+      *dst++ = tmp[i] >> 16;
+      *dst++ = tmp[i] >> 8;
+      *dst++ = tmp[i];
+    }
+  return 1;
+}
+#endif /*__SSE2__*/
+
+
+/* Decode as many complete groups of four base64 characters from SRC
+   into DST as possible.  This stops at the first group which
+   contains anything but base64 characters (e.g. white space, padding
+   or garbage) so that the caller can handle the rest.  DST may be the
+   same as SRC.  Returns the number of characters consumed; 3/4 of
+   that is the number of bytes written.  */
+static size_t
+b64_decode_quads (unsigned char *dst, const unsigned char *src,
+                  size_t length)
+{
+  const unsigned char *s = src;
+  unsigned int a, b, c, e;
+
+#ifdef __SSE2__
+  for (; length >= 16; length -= 16, s += 16, dst += 12)
+    if (!b64_decode_sse2 (dst, s))
+      break;
+#endif
+
+  for (; length >= 4; length -= 4, s += 4)
+    {
+      a = asctobin[s[0]];
+      b = asctobin[s[1]];
+      c = asctobin[s[2]];
+      e = asctobin[s[3]];
+      if ((a | b | c | e) & 0x80)
+        break;
+      *dst++ = (a << 2) | (b >> 4);
+      *dst++ = (b << 4) | (c >> 2);
+      *dst++ = (c << 6) | e;
+    }
+
+  return s - src;
+}
+
+
 /* Do in-place decoding of base-64 data of LENGTH in BUFFER.  Returns
    the new length of the buffer. STATE is required to return errors and
    to maintain the state of the decoder.  */
@@ -358,11 +517,27 @@ b64_decode (b64_state_t *state, char *buffer, size_t length)
   unsigned char val = state->val;
   int c;
   char *d, *s;
+  size_t n;
 
   if (state->stop_seen)
     return 0;
 
-  for (s=d=buffer; length; length--, s++)
+  s = d = buffer;
+
+  /* Most of the time we get complete lines of valid characters.  Let
+     the block decoder do the bulk of the work and continue byte wise
+     at the first character it can't handle.  */
+  if (!idx)
+    {
+      n = b64_decode_quads ((unsigned char *)d, (unsigned char *)s, length);
+      s += n;
+      d += n / 4 * 3;
+      length -= n;
+      if (n)
+        val = d[-1];
+    }
+
+  for (; length; length--, s++)
     {
       if (*s == '\n' || *s == ' ' || *s == '\r' || *s == '\t')
         continue;
@@ -456,6 +631,64 @@ b64_encode (const char *input, size_t length)
   return ret;
 }
 
+/* Base64 encode LENGTH bytes of INPUT to OUTPUT as used for MIME
+   parts: Lines of 64 characters, each terminated by CR,LF.  The last
+   line is padded and also terminated by CR,LF.  OUTPUT needs to have
+   space for B64_MIME_ENCODED_LEN(LENGTH) bytes.  Returns the number of
+   bytes written.  Data can be encoded in chunks if all but the last
+   one have a length which is a multiple of B64_MIME_LINE_INPUT.  */
+size_t
+b64_encode_mime (char *output, const void *input, size_t length)
+{
+  const unsigned char *s = (const unsigned char *)input;
+  char *d = output;
+  int i;
+
+  /* Complete lines.  */
+  for (; length >= B64_MIME_LINE_INPUT; length -= B64_MIME_LINE_INPUT)
+    {
+      for (i = 0; i < B64_MIME_LINE_INPUT / 3; i++, s += 3)
+        {
+          *d++ = bintoasc[s[0] >> 2];
+          *d++ = bintoasc[((s[0] << 4) & 060) | (s[1] >> 4)];
+          *d++ = bintoasc[((s[1] << 2) & 074) | (s[2] >> 6)];
+          *d++ = bintoasc[s[2] & 077];
+        }
+      *d++ = '\r';
+      *d++ = '\n';
+    }
+
+  if (!length)
+    return d - output;
+
+  /* The last line.  */
+  for (; length > 2; length -= 3, s += 3)
+    {
+      *d++ = bintoasc[s[0] >> 2];
+      *d++ = bintoasc[((s[0] << 4) & 060) | (s[1] >> 4)];
+      *d++ = bintoasc[((s[1] << 2) & 074) | (s[2] >> 6)];
+      *d++ = bintoasc[s[2] & 077];
+    }
+  if (length == 1)
+    {
+      *d++ = bintoasc[s[0] >> 2];
+      *d++ = bintoasc[(s[0] << 4) & 060];
+      *d++ = '=';
+      *d++ = '=';
+    }
+  else if (length == 2)
+    {
+      *d++ = bintoasc[s[0] >> 2];
+      *d++ = bintoasc[((s[0] << 4) & 060) | (s[1] >> 4)];
+      *d++ = bintoasc[(s[1] << 2) & 074];
+      *d++ = '=';
+    }
+  *d++ = '\r';
+  *d++ = '\n';
+
+  return d - output;
+}
+
 /* Create a boundary.  Note that mimemaker.c knows about the structure
    of the boundary (i.e. that it starts with "=-=") so that it can
    protect against accidently used boundaries within the content.  */
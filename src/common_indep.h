@@ -189,6 +189,12 @@ struct opt_s
   int autotrust;             /* TOFU configured for GpgOL */
   int sync_enc;              /* Disabed async encryption */
   int sync_dec;              /* Disabed async decryption */
+  int decrypt_cache;         /* Keep the results of decrypted mails
+                                in memory to show them again
+                                without decryption.  */
+  int part_cache;            /* Keep the encoded parts of large
+                                attachments to send them again
+                                without encoding.  */
   int prefer_smime;          /* S/MIME prefered when autoresolving */
   int smime_html_warn_shown; /* Flag to save if unsigned smime warning
                                 was shown */
@@ -199,6 +205,8 @@ struct opt_s
   int search_smime_servers;  /* Search for S/MIME keys on all
                                 configured S/MIME keyservers for each
                                 new unknown mail */
+  int negative_cache_ttl;    /* Seconds for which a locate which
+                                found no key is not repeated.  */
   int auto_unstrusted;       /* Automatically encrypt even to untrusted keys. */
   int autoimport;            /* Automatically import keys from headers
                                 or attachments. */
@@ -260,10 +268,19 @@ struct b64_state_s
 typedef struct b64_state_s b64_state_t;
 
 size_t qp_decode (char *buffer, size_t length, int *r_slbrk);
+size_t qp_decode_buffer (char *buffer, size_t length, size_t *r_not_taken,
+                         int *r_slbrk);
 char *qp_encode (const char *input, size_t length, size_t* outlen);
 void b64_init (b64_state_t *state);
 size_t b64_decode (b64_state_t *state, char *buffer, size_t length);
 char * b64_encode (const char *input, size_t length);
+/* Number of input bytes for a base64 line of 64 characters.  */
+#define B64_MIME_LINE_INPUT 48
+/* The size of the output of b64_encode_mime for LENGTH bytes.  */
+#define B64_MIME_ENCODED_LEN(length) \
+  (((length) + B64_MIME_LINE_INPUT - 1) / B64_MIME_LINE_INPUT * 2 \
+   + ((length) + 2) / 3 * 4)
+size_t b64_encode_mime (char *output, const void *input, size_t length);
 
 char *latin1_to_utf8 (const char *string);
 
@@ -32,6 +32,7 @@
 #include "mymapitags.h"
 #include "recipient.h"
 #include "recipientmanager.h"
+#include "signeddataprovider.h"
 #include "windowmessages.h"
 
 #include <gpgme++/context.h>
@@ -41,6 +42,7 @@
 #include "common.h"
 
 #include <sstream>
+#include <time.h>
 
 static int
 sink_data_write (sink_t sink, const void *data, size_t datalen)
@@ -56,6 +58,38 @@ create_sign_attach (sink_t sink, protocol_t protocol,
                     GpgME::Data &signedData,
                     const char *micalg);
 
+static int
+write_sign_head (sink_t sink, protocol_t protocol, const char *boundary,
+                 const char *micalg);
+
+static int
+write_sign_tail (sink_t sink, protocol_t protocol, const char *boundary,
+                 GpgME::Data &signature);
+
+/* Create a context for PROTO with the keys of SIGNER_KEYS for PROTO
+   as signers.  */
+static std::unique_ptr<GpgME::Context>
+create_crypto_context (GpgME::Protocol proto,
+                       const std::vector<GpgME::Key> &signer_keys)
+{
+  auto ctx = GpgME::Context::create (proto);
+
+  if (!ctx)
+    {
+      return nullptr;
+    }
+  for (const auto &key: signer_keys)
+    {
+      if (key.protocol () == proto)
+        {
+          ctx->addSigningKey (key);
+        }
+    }
+  ctx->setTextMode (proto == GpgME::OpenPGP);
+  ctx->setArmor (proto == GpgME::OpenPGP);
+  return ctx;
+}
+
 /** We have some C Style cruft in here as this was historically how
   GpgOL worked directly in the MAPI data objects. To reduce the regression
   risk the new object oriented way for crypto reused as much as possible
@@ -68,6 +102,7 @@ CryptController::CryptController (Mail *mail, bool encrypt, bool sign,
     m_sign (sign),
     m_crypto_success (false),
     m_no_smime_shown (false),
+    m_quiet (false),
     m_proto (proto)
 {
   TSTART;
@@ -144,10 +179,16 @@ CryptController::collect_data ()
   memset (sink, 0, sizeof *sink);
   sink->cb_data = &m_input;
   sink->writefnc = sink_data_write;
+  sink_set_buffer (sink, SINK_BUFFER_SIZE);
 
   /* Collect the mime strucutre */
   int err = add_body_and_attachments (sink, m_mail, body);
   xfree (body);
+  if (!err)
+    {
+      err = sink_flush (sink);
+    }
+  sink_release_buffer (sink);
 
   if (err)
     {
@@ -540,7 +581,14 @@ CryptController::is_resolved ()
   if (!m_no_smime_shown && !hasSMIMESignKey && m_sign && opt.sign_default &&
       opt.enable_smime && opt.prefer_smime)
     {
-      if (!KeyCache::instance ()->isPopulated())
+      if (m_quiet)
+        {
+          /* The send reports this.  */
+          log_dbg ("No S/MIME signing key. Not resolvable in quiet mode.");
+          TRETURN false;
+        }
+      if (!KeyCache::instance ()->isPopulated() &&
+          !KeyCache::instance ()->hasSnapshot ())
         {
           log_dbg ("Keycache is not loaded. Showing just the UI resolver.");
         }
@@ -619,8 +667,6 @@ int
 CryptController::resolve_keys_cached()
 {
   TSTART;
-  // Prepare variables
-  const auto recps = m_mail->getCachedRecipientAddresses ();
   bool resolved = false;
   if (opt.enable_smime && opt.prefer_smime)
     {
@@ -689,6 +735,172 @@ CryptController::resolve_keys_cached()
   TRETURN 0;
 }
 
+/* Check that KEY can still be used to encrypt or, if FOR_SIGNING,
+   to sign.  The expiry is compared with the current time because
+   the flags are from the last key listing.  */
+static bool
+key_is_usable (const GpgME::Key &key, bool for_signing)
+{
+  if (key.isNull () || key.isRevoked () || key.isExpired ()
+      || key.isDisabled () || key.isInvalid ())
+    {
+      return false;
+    }
+  const time_t now = time (nullptr);
+  for (const auto &sub: key.subkeys ())
+    {
+      if (sub.isRevoked () || sub.isExpired () || sub.isDisabled ()
+          || sub.isInvalid ()
+          || !(for_signing ? sub.canSign () : sub.canEncrypt ()))
+        {
+          continue;
+        }
+      if (sub.neverExpires () || sub.expirationTime () > now)
+        {
+          return true;
+        }
+    }
+  return false;
+}
+
+static bool
+same_key (const GpgME::Key &a, const GpgME::Key &b)
+{
+  return a.primaryFingerprint () && b.primaryFingerprint ()
+         && !strcmp (a.primaryFingerprint (), b.primaryFingerprint ());
+}
+
+/* Check that the keys of PREPARED are still the ones the KeyCache
+   resolves to and that they are still usable.  A key can be
+   revoked, expire or be replaced between the preparation and the
+   send.  */
+static bool
+prepared_is_current (const prepared_crypto_s &prepared)
+{
+  TSTART;
+  const auto cache = KeyCache::instance ();
+
+  if (prepared.encrypt)
+    {
+      for (const auto &recp: prepared.recipients)
+        {
+          const auto keys = recp.keys ();
+          const auto current = cache->getEncryptionKeys (recp.mbox (),
+                                                         prepared.proto);
+          if (keys.size () != current.size ())
+            {
+              TRETURN false;
+            }
+          for (size_t i = 0; i < keys.size (); i++)
+            {
+              if (!same_key (keys[i], current[i])
+                  || !key_is_usable (current[i], false))
+                {
+                  TRETURN false;
+                }
+            }
+        }
+    }
+  if (prepared.sign)
+    {
+      for (const auto &key: prepared.signer_keys)
+        {
+          if (key.isNull ())
+            {
+              continue;
+            }
+          const auto current = cache->getSigningKey (prepared.sender.c_str (),
+                                                     key.protocol ());
+          if (!same_key (key, current) || !key_is_usable (current, true))
+            {
+              TRETURN false;
+            }
+        }
+    }
+  TRETURN true;
+}
+
+/* Take the keys and the context from CryptController::prewarm if
+   they were prepared for this operation and are still valid.  */
+bool
+CryptController::use_prepared ()
+{
+  TSTART;
+  const auto prepared = m_mail->takePreparedCrypto ();
+  if (!prepared)
+    {
+      TRETURN false;
+    }
+
+  std::vector<std::string> addresses;
+  for (const auto &recp: m_recipients)
+    {
+      addresses.push_back (recp.mbox ());
+    }
+  if (prepared->encrypt != m_encrypt || prepared->sign != m_sign
+      || prepared->sender != m_sender || prepared->addresses != addresses)
+    {
+      log_debug ("%s:%s: Prepared keys are outdated.",
+                 SRCNAME, __func__);
+      TRETURN false;
+    }
+  if (!prepared_is_current (*prepared))
+    {
+      log_debug ("%s:%s: Prepared keys changed in the KeyCache.",
+                 SRCNAME, __func__);
+      TRETURN false;
+    }
+
+  log_debug ("%s:%s: Using the keys prepared with protocol %s.",
+             SRCNAME, __func__, to_cstr (prepared->proto));
+  m_recipients = prepared->recipients;
+  m_signer_keys = prepared->signer_keys;
+  m_proto = prepared->proto;
+  m_prepared_ctx = std::move (prepared->ctx);
+  start_crypto_overlay ();
+  resolving_done ();
+  TRETURN true;
+}
+
+std::shared_ptr<prepared_crypto_s>
+CryptController::prewarm ()
+{
+  TSTART;
+  if ((!m_encrypt && !m_sign) || !opt.autoresolve || opt.alwaysShowApproval)
+    {
+      TRETURN nullptr;
+    }
+
+  if (m_recipients.empty ()
+      || get_resolved_protocol () != GpgME::UnknownProtocol)
+    {
+      /* Nothing to resolve or the keys were set explicitly.  */
+      TRETURN nullptr;
+    }
+  m_quiet = true;
+  if (resolve_keys_cached ())
+    {
+      TRETURN nullptr;
+    }
+
+  auto ret = std::make_shared<prepared_crypto_s> ();
+  for (const auto &recp: m_recipients)
+    {
+      ret->addresses.push_back (recp.mbox ());
+    }
+  ret->sender = m_sender;
+  ret->encrypt = m_encrypt;
+  ret->sign = m_sign;
+  ret->proto = m_proto;
+  ret->recipients = m_recipients;
+  ret->signer_keys = m_signer_keys;
+  ret->ctx = create_crypto_context (ret->proto, ret->signer_keys);
+  log_debug ("%s:%s: Prepared %s for %lu recipients of %p.",
+             SRCNAME, __func__, to_cstr (ret->proto),
+             (unsigned long) ret->addresses.size (), m_mail);
+  TRETURN ret;
+}
+
 void
 CryptController::clear_keys ()
 {
@@ -777,6 +989,11 @@ CryptController::resolve_keys ()
       TRETURN -1;
     }
 
+  if (opt.autoresolve && !opt.alwaysShowApproval && use_prepared ())
+    {
+      TRETURN 0;
+    }
+
   if (opt.autoresolve && !opt.alwaysShowApproval && !resolve_keys_cached ())
     {
       log_debug ("%s:%s: resolved keys through the cache",
@@ -1080,7 +1297,18 @@ CryptController::do_crypto (GpgME::Error &err, std::string &r_diag, bool force)
       m_bodyInput = GpgME::Data(GpgME::Data::null);
     }
 
-  auto ctx = GpgME::Context::create(m_proto);
+  std::unique_ptr<GpgME::Context> ctx;
+  if (m_prepared_ctx && m_prepared_ctx->protocol () == m_proto)
+    {
+      log_debug ("%s:%s: Using the prepared context.",
+                 SRCNAME, __func__);
+      ctx = std::move (m_prepared_ctx);
+    }
+  else
+    {
+      m_prepared_ctx = nullptr;
+      ctx = create_crypto_context (m_proto, m_signer_keys);
+    }
 
   if (!ctx)
     {
@@ -1091,19 +1319,6 @@ CryptController::do_crypto (GpgME::Error &err, std::string &r_diag, bool force)
                          utf8_gettext ("GpgOL"), MB_OK);
       TRETURN -1;
     }
-  if (!m_signer_keys.empty ())
-    {
-      for (const auto &key: m_signer_keys)
-        {
-          if (key.protocol () == m_proto)
-            {
-              ctx->addSigningKey (key);
-            }
-        }
-    }
-
-  ctx->setTextMode (m_proto == GpgME::OpenPGP);
-  ctx->setArmor (m_proto == GpgME::OpenPGP);
 
   /* Prepare to offer a "Forced encryption for S/MIME errors or drafts */
   GpgME::Context::EncryptionFlags flags = GpgME::Context::EncryptionFlags::None;
@@ -1195,27 +1410,39 @@ CryptController::do_crypto (GpgME::Error &err, std::string &r_diag, bool force)
       // We now have plaintext in m_input
       // The detached signature in m_output
 
-      // Set up the sink object to construct the multipart/signed
-      GpgME::Data multipart;
+      // Construct the multipart/signed while it is encrypted.  Only
+      // the header and the signature part are built in memory, the
+      // plaintext is read from m_input by the provider.
+      const protocol_t protocol = m_proto == GpgME::CMS ?
+                                  PROTOCOL_SMIME : PROTOCOL_OPENPGP;
+      char boundary[BOUNDARYSIZE+1];
+      std::string head, tail;
       struct sink_s sinkmem;
       sink_t sink = &sinkmem;
       memset (sink, 0, sizeof *sink);
-      sink->cb_data = &multipart;
-      sink->writefnc = sink_data_write;
+      sink->writefnc = sink_string_append;
 
-      if (create_sign_attach (sink,
-                              m_proto == GpgME::CMS ?
-                                         PROTOCOL_SMIME : PROTOCOL_OPENPGP,
-                              m_output, m_input, m_micalg.c_str ()))
+      generate_boundary (boundary);
+      sink->cb_data = &head;
+      if (write_sign_head (sink, protocol, boundary, m_micalg.c_str ()))
         {
           TRACEPOINT;
           TRETURN -1;
         }
+      sink->cb_data = &tail;
+      if (write_sign_tail (sink, protocol, boundary, m_output))
+        {
+          TRACEPOINT;
+          TRETURN -1;
+        }
+
+      SignedDataProvider provider (head, m_input, tail);
+      GpgME::Data multipart (&provider);
 
-      // Now we have the multipart we do not need the output anymore.
+      // The signature is now in the tail, we do not need the output
+      // anymore.
       m_output = GpgME::Data ();
       m_output.setEncoding(GpgME::Data::MimeEncoding);
-      multipart.seek (0, SEEK_SET);
       const auto encResult = ctx->encrypt (m_enc_keys, multipart,
                                            m_output,
                                            flags);
@@ -1320,28 +1547,30 @@ write_data (sink_t sink, GpgME::Data &data)
 
   char buf[4096];
   size_t nread;
+  int rc;
   data.seek (0, SEEK_SET);
   while ((nread = data.read (buf, 4096)) > 0)
     {
-      sink->writefnc (sink, buf, nread);
+      if ((rc = write_buffer (sink, buf, nread)))
+        {
+          TRETURN rc;
+        }
     }
 
   TRETURN 0;
 }
 
-int
-create_sign_attach (sink_t sink, protocol_t protocol,
-                    GpgME::Data &signature,
-                    GpgME::Data &signedData,
-                    const char *micalg)
+/* Write the top header of a multipart/signed structure and the
+   boundary before the signed data to SINK.  */
+static int
+write_sign_head (sink_t sink, protocol_t protocol, const char *boundary,
+                 const char *micalg)
 {
   TSTART;
-  char boundary[BOUNDARYSIZE+1];
   char top_header[BOUNDARYSIZE+200];
   int rc = 0;
 
   /* Write the top header.  */
-  generate_boundary (boundary);
   create_top_signing_header (top_header, sizeof top_header,
                              protocol, 1, boundary,
                              micalg);
@@ -1359,12 +1588,17 @@ create_sign_attach (sink_t sink, protocol_t protocol,
       TRETURN rc;
     }
 
-  /* Write the signed mime structure */
-  if ((rc = write_data (sink, signedData)))
-    {
-      TRACEPOINT;
-      TRETURN rc;
-    }
+  TRETURN rc;
+}
+
+/* Write the part with the SIGNATURE after the signed data and the
+   final boundary to SINK.  */
+static int
+write_sign_tail (sink_t sink, protocol_t protocol, const char *boundary,
+                 GpgME::Data &signature)
+{
+  TSTART;
+  int rc = 0;
 
   /* Write the signature attachment */
   if ((rc = write_boundary (sink, boundary, 0)))
@@ -1441,6 +1675,39 @@ create_sign_attach (sink_t sink, protocol_t protocol,
   TRETURN rc;
 }
 
+int
+create_sign_attach (sink_t sink, protocol_t protocol,
+                    GpgME::Data &signature,
+                    GpgME::Data &signedData,
+                    const char *micalg)
+{
+  TSTART;
+  char boundary[BOUNDARYSIZE+1];
+  int rc = 0;
+
+  generate_boundary (boundary);
+  if ((rc = write_sign_head (sink, protocol, boundary, micalg)))
+    {
+      TRACEPOINT;
+      TRETURN rc;
+    }
+
+  /* Write the signed mime structure */
+  if ((rc = write_data (sink, signedData)))
+    {
+      TRACEPOINT;
+      TRETURN rc;
+    }
+
+  if ((rc = write_sign_tail (sink, protocol, boundary, signature)))
+    {
+      TRACEPOINT;
+      TRETURN rc;
+    }
+
+  TRETURN rc;
+}
+
 static int
 create_encrypt_attach (sink_t sink, protocol_t protocol,
                        GpgME::Data &encryptedData,
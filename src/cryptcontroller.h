@@ -28,6 +28,10 @@
 #include <gpgme++/data.h>
 #include <string.h>
 
+#include <memory>
+#include <string>
+#include <vector>
+
 class Recipient;
 class Mail;
 class Overlay;
@@ -36,8 +40,25 @@ namespace GpgME
 {
   class SigningResult;
   class Error;
+  class Context;
 } // namespace GpgME
 
+/* Keys resolved through the KeyCache and a context configured for
+   them while the mail is composed.  See CryptController::prewarm.  */
+struct prepared_crypto_s
+{
+  /* What the keys were resolved for.  */
+  std::vector<std::string> addresses;
+  std::string sender;
+  bool encrypt;
+  bool sign;
+  /* The result.  */
+  GpgME::Protocol proto;
+  std::vector<Recipient> recipients;
+  std::vector<GpgME::Key> signer_keys;
+  std::unique_ptr<GpgME::Context> ctx;
+};
+
 class CryptController
 {
 public:
@@ -117,7 +138,22 @@ public:
 
   /** @brief stop the crypto overlay */
   void stop_crypto_overlay ();
+
+  /** @brief Resolve the keys through the KeyCache and create a
+    context for them before the mail is sent.  This is done in the
+    background when the recipients of a mail in the composer changed.
+    prepare_crypto and do_crypto use the result if the recipients,
+    the sender and the operation did not change until the send.
+
+    The controller must be created with the Mail delete lock held
+    but prewarm does not access the mail, so it can run without the
+    lock.  No message is shown.
+
+    @returns nullptr if the keys can't be resolved without the
+    resolver or without a message to the user. */
+  std::shared_ptr<prepared_crypto_s> prewarm ();
 private:
+  bool use_prepared ();
   void clear_keys ();
   void resolving_done ();
   int resolve_keys ();
@@ -134,12 +170,14 @@ private:
   GpgME::Data m_input, m_bodyInput, m_signedData, m_output;
   std::string m_micalg;
   bool m_encrypt, m_sign, m_crypto_success, m_no_smime_shown;
+  bool m_quiet; /* Never show a message.  Used by prewarm.  */
   GpgME::Protocol m_proto;
   std::string m_sender;
   std::vector<GpgME::Key> m_signer_keys;
   std::vector<GpgME::Key> m_enc_keys;
   std::vector<Recipient> m_recipients;
   std::unique_ptr<Overlay> m_overlay;
+  std::unique_ptr<GpgME::Context> m_prepared_ctx;
 };
 
 #endif
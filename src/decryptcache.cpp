@@ -0,0 +1,468 @@
+/* @file decryptcache.cpp
+ * @brief Cache for the results of decrypted mails
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "decryptcache.h"
+
+#include "cachecrypt.h"
+#include "common_indep.h"
+#include "parsecontroller.h"
+#include "mimedataprovider.h"
+#include "attachment.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+#include <unordered_map>
+
+#include <gpg-error.h>
+
+GPGRT_LOCK_DEFINE (decrypt_cache_lock);
+
+static DecryptCache *singleton = nullptr;
+
+namespace
+{
+struct entry_s
+{
+  std::string uid;
+  std::string hash;
+  /* The plaintext parts.  Encrypted with protect_data.  */
+  std::string blob;
+  size_t blob_len;
+  msgtype_t type;
+  bool block_html;
+  GpgME::DecryptionResult decrypt_result;
+  GpgME::VerificationResult verify_result;
+};
+}
+
+static void
+put_string (std::string &buf, const std::string &str)
+{
+  uint64_t len = str.size ();
+
+  buf.append ((const char *) &len, sizeof len);
+  buf.append (str);
+}
+
+static bool
+get_string (const std::string &buf, size_t *pos, std::string &str)
+{
+  uint64_t len;
+
+  if (buf.size () - *pos < sizeof len)
+    {
+      return false;
+    }
+  memcpy (&len, buf.data () + *pos, sizeof len);
+  *pos += sizeof len;
+  if (buf.size () - *pos < len)
+    {
+      return false;
+    }
+  str.assign (buf, *pos, len);
+  *pos += len;
+  return true;
+}
+
+static std::string
+data_to_string (GpgME::Data &data)
+{
+  std::string ret;
+  char buf[8192];
+  ssize_t nread;
+
+  data.seek (0, SEEK_SET);
+  while ((nread = data.read (buf, sizeof buf)) > 0)
+    {
+      ret.append (buf, nread);
+    }
+  data.seek (0, SEEK_SET);
+  return ret;
+}
+
+/* The protected headers which are used by the Mail.  */
+static const char *protected_headers[] = {"Subject", "From", "To", "Cc",
+                                          "Date", "Reply-To", "Followup-To",
+                                          nullptr};
+
+/* Serialize the plaintext results of PARSER into BUF.  */
+static void
+serialize_parser (const ParseController &parser, std::string &buf)
+{
+  const auto atts = parser.get_attachments ();
+
+  put_string (buf, parser.get_formatted_error ());
+  put_string (buf, parser.get_body ());
+  put_string (buf, parser.get_html_body ());
+  put_string (buf, parser.get_body_charset ());
+  put_string (buf, parser.get_html_charset ());
+  put_string (buf, parser.get_content_type ());
+  for (int i = 0; protected_headers[i]; i++)
+    {
+      put_string (buf, parser.get_protected_header (protected_headers[i]));
+    }
+  put_string (buf, std::to_string (atts.size ()));
+  for (const auto &att: atts)
+    {
+      put_string (buf, att->get_display_name ());
+      put_string (buf, att->get_content_id ());
+      put_string (buf, att->get_content_type ());
+      put_string (buf, att->is_mime () ? "1" : "0");
+      std::string data = data_to_string (att->get_data ());
+      put_string (buf, data);
+      wipe_string (data);
+    }
+}
+
+class DecryptCache::Private
+{
+public:
+  Private () :
+    m_max_size (DECRYPT_CACHE_MAX_SIZE),
+    m_size (0)
+  {
+  }
+
+  /* Remove the entry at IT.  Called with the lock held.  */
+  void
+  remove (std::list<entry_s>::iterator it)
+  {
+    m_size -= it->blob.size ();
+    wipe_string (it->blob);
+    m_map.erase (it->uid);
+    m_entries.erase (it);
+  }
+
+  /* Remove the least recently used entries until the cache fits
+     into the size limit.  Called with the lock held.  */
+  void
+  shrink ()
+  {
+    while (m_size > m_max_size && !m_entries.empty ())
+      {
+        log_debug ("%s:%s: Evicting entry of %lu bytes",
+                   SRCNAME, __func__,
+                   (unsigned long) m_entries.back ().blob.size ());
+        remove (std::prev (m_entries.end ()));
+      }
+  }
+
+  /* Most recently used first.  */
+  std::list<entry_s> m_entries;
+  std::unordered_map<std::string, std::list<entry_s>::iterator> m_map;
+  size_t m_max_size;
+  size_t m_size;
+};
+
+DecryptCache::DecryptCache ():
+  d (new Private)
+{
+}
+
+DecryptCache *
+DecryptCache::instance ()
+{
+  if (!singleton)
+    {
+      singleton = new DecryptCache ();
+    }
+  return singleton;
+}
+
+void
+DecryptCache::store (const std::string &uid, const std::string &hash,
+                     const ParseController &parser)
+{
+  TSTART;
+  if (uid.empty () || hash.empty ())
+    {
+      TRETURN;
+    }
+
+  entry_s entry;
+  entry.uid = uid;
+  entry.hash = hash;
+  entry.type = parser.m_type;
+  entry.block_html = parser.m_block_html;
+  entry.decrypt_result = parser.m_decrypt_result;
+  entry.verify_result = parser.m_verify_result;
+  serialize_parser (parser, entry.blob);
+  entry.blob_len = entry.blob.size ();
+
+  gpgol_lock (&decrypt_cache_lock);
+  if (entry.blob_len > d->m_max_size / 4)
+    {
+      log_debug ("%s:%s: Not caching %lu bytes",
+                 SRCNAME, __func__, (unsigned long) entry.blob_len);
+      wipe_string (entry.blob);
+      /* Don't keep an older version.  */
+      const auto it = d->m_map.find (uid);
+      if (it != d->m_map.end ())
+        {
+          d->remove (it->second);
+        }
+      gpgol_unlock (&decrypt_cache_lock);
+      TRETURN;
+    }
+  gpgol_unlock (&decrypt_cache_lock);
+
+  protect_data (entry.blob);
+  if (entry.blob.empty ())
+    {
+      TRETURN;
+    }
+
+  gpgol_lock (&decrypt_cache_lock);
+  const auto it = d->m_map.find (uid);
+  if (it != d->m_map.end ())
+    {
+      d->remove (it->second);
+    }
+  d->m_size += entry.blob.size ();
+  d->m_entries.push_front (std::move (entry));
+  d->m_map[uid] = d->m_entries.begin ();
+  d->shrink ();
+  log_debug ("%s:%s: Cached %s. %lu entries with %lu bytes",
+             SRCNAME, __func__, uid.c_str (),
+             (unsigned long) d->m_entries.size (), (unsigned long) d->m_size);
+  gpgol_unlock (&decrypt_cache_lock);
+  TRETURN;
+}
+
+std::shared_ptr<ParseController>
+DecryptCache::restore (const std::string &uid, const std::string &hash)
+{
+  TSTART;
+  entry_s entry;
+
+  gpgol_lock (&decrypt_cache_lock);
+  const auto it = d->m_map.find (uid);
+  if (it == d->m_map.end ())
+    {
+      gpgol_unlock (&decrypt_cache_lock);
+      TRETURN nullptr;
+    }
+  if (it->second->hash != hash)
+    {
+      log_debug ("%s:%s: Content of %s changed",
+                 SRCNAME, __func__, uid.c_str ());
+      d->remove (it->second);
+      gpgol_unlock (&decrypt_cache_lock);
+      TRETURN nullptr;
+    }
+  /* Move it to the front.  */
+  d->m_entries.splice (d->m_entries.begin (), d->m_entries, it->second);
+  entry = *it->second;
+  gpgol_unlock (&decrypt_cache_lock);
+
+  if (!unprotect_data (entry.blob, entry.blob_len))
+    {
+      invalidate (uid);
+      TRETURN nullptr;
+    }
+
+  auto parser = std::shared_ptr<ParseController> (new ParseController
+                                                  (entry.type));
+  auto provider = parser->m_outputprovider;
+  std::string count;
+  std::string is_mime;
+  std::string data;
+  size_t pos = 0;
+  bool ok;
+
+  parser->m_block_html = entry.block_html;
+  parser->m_decrypt_result = entry.decrypt_result;
+  parser->m_verify_result = entry.verify_result;
+  ok = (get_string (entry.blob, &pos, parser->m_error)
+        && get_string (entry.blob, &pos, provider->m_body)
+        && get_string (entry.blob, &pos, provider->m_html_body)
+        && get_string (entry.blob, &pos, provider->m_body_charset)
+        && get_string (entry.blob, &pos, provider->m_html_charset)
+        && get_string (entry.blob, &pos, provider->m_content_type));
+  for (int i = 0; ok && protected_headers[i]; i++)
+    {
+      std::string value;
+      ok = get_string (entry.blob, &pos, value);
+      if (ok && value.size ())
+        {
+          provider->m_protected_headers.emplace (protected_headers[i],
+                                                 value);
+        }
+    }
+  ok = ok && get_string (entry.blob, &pos, count);
+  for (long n = ok ? atol (count.c_str ()) : 0; ok && n > 0; n--)
+    {
+      std::string name, cid, ctype;
+
+      ok = (get_string (entry.blob, &pos, name)
+            && get_string (entry.blob, &pos, cid)
+            && get_string (entry.blob, &pos, ctype)
+            && get_string (entry.blob, &pos, is_mime)
+            && get_string (entry.blob, &pos, data));
+      if (!ok)
+        {
+          break;
+        }
+      auto att = std::shared_ptr<Attachment> (new Attachment ());
+      att->set_attach_type (ATTACHTYPE_FROMMOSS);
+      att->set_display_name (name.c_str ());
+      att->set_content_id (cid.c_str ());
+      att->set_content_type (ctype.c_str ());
+      att->set_is_mime (is_mime == "1");
+      att->get_data ().write (data.data (), data.size ());
+      att->get_data ().seek (0, SEEK_SET);
+      provider->m_attachments.push_back (att);
+      wipe_string (data);
+    }
+  wipe_string (entry.blob);
+
+  if (!ok)
+    {
+      log_error ("%s:%s: Invalid cache entry for %s",
+                 SRCNAME, __func__, uid.c_str ());
+      invalidate (uid);
+      TRETURN nullptr;
+    }
+  log_debug ("%s:%s: Restored %s", SRCNAME, __func__, uid.c_str ());
+  TRETURN parser;
+}
+
+void
+DecryptCache::invalidate (const std::string &uid)
+{
+  TSTART;
+  gpgol_lock (&decrypt_cache_lock);
+  const auto it = d->m_map.find (uid);
+  if (it != d->m_map.end ())
+    {
+      log_debug ("%s:%s: Removing %s", SRCNAME, __func__, uid.c_str ());
+      d->remove (it->second);
+    }
+  gpgol_unlock (&decrypt_cache_lock);
+  TRETURN;
+}
+
+void
+DecryptCache::clear ()
+{
+  TSTART;
+  gpgol_lock (&decrypt_cache_lock);
+  while (!d->m_entries.empty ())
+    {
+      d->remove (d->m_entries.begin ());
+    }
+  gpgol_unlock (&decrypt_cache_lock);
+  TRETURN;
+}
+
+void
+DecryptCache::setMaxSize (size_t size)
+{
+  gpgol_lock (&decrypt_cache_lock);
+  d->m_max_size = size;
+  d->shrink ();
+  gpgol_unlock (&decrypt_cache_lock);
+}
+
+size_t
+DecryptCache::count () const
+{
+  gpgol_lock (&decrypt_cache_lock);
+  size_t ret = d->m_entries.size ();
+  gpgol_unlock (&decrypt_cache_lock);
+  return ret;
+}
+
+size_t
+DecryptCache::size () const
+{
+  gpgol_lock (&decrypt_cache_lock);
+  size_t ret = d->m_size;
+  gpgol_unlock (&decrypt_cache_lock);
+  return ret;
+}
+
+std::string
+DecryptCache::hashFile (FILE *stream)
+{
+  TSTART;
+  unsigned char buf[8192];
+  Sha256 hash;
+  off_t start = ftello (stream);
+  size_t nread;
+
+  while ((nread = fread (buf, 1, sizeof buf, stream)))
+    {
+      hash.write (buf, nread);
+    }
+  fseeko (stream, start, SEEK_SET);
+  TRETURN hash.final ();
+}
+
+#ifdef HAVE_W32_SYSTEM
+std::string
+DecryptCache::hashStream (LPSTREAM stream)
+{
+  TSTART;
+  unsigned char buf[8192];
+  Sha256 hash;
+  uint64_t total = 0;
+  ULARGE_INTEGER start;
+  LARGE_INTEGER pos;
+  ULONG nread;
+  HRESULT hr;
+
+  pos.QuadPart = 0;
+  if (stream->Seek (pos, STREAM_SEEK_CUR, &start))
+    {
+      log_error ("%s:%s: Failed to get the stream position.",
+                 SRCNAME, __func__);
+      TRETURN std::string ();
+    }
+  for (;;)
+    {
+      hr = stream->Read (buf, sizeof buf, &nread);
+      if (hr != S_OK && hr != S_FALSE)
+        {
+          log_error ("%s:%s: Read failed: hr=%#lx", SRCNAME, __func__, hr);
+          total = 0;
+          break;
+        }
+      if (!nread)
+        {
+          break;
+        }
+      hash.write (buf, nread);
+      total += nread;
+    }
+  pos.QuadPart = start.QuadPart;
+  if (stream->Seek (pos, STREAM_SEEK_SET, nullptr))
+    {
+      log_error ("%s:%s: Failed to restore the stream position.",
+                 SRCNAME, __func__);
+      TRETURN std::string ();
+    }
+  TRETURN total ? hash.final () : std::string ();
+}
+#endif
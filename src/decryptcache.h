@@ -0,0 +1,94 @@
+/* @file decryptcache.h
+ * @brief Cache for the results of decrypted mails
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DECRYPTCACHE_H
+#define DECRYPTCACHE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <memory>
+#include <string>
+
+#ifdef HAVE_W32_SYSTEM
+#include <windows.h>
+#endif
+
+class ParseController;
+
+/* The default size limit of the cache.  */
+#define DECRYPT_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* The DecryptCache keeps the results of parsing decrypted mails so
+   that a mail which is selected again can be shown without another
+   decryption.  Entries are looked up by the GpgOL UID of the mail
+   and the SHA-256 of the encrypted content.  The plaintext parts of an
+   entry are kept encrypted with a key that only lives as long as
+   the process.  If the cache grows beyond its size limit the least
+   recently used entries are removed.  */
+class DecryptCache
+{
+protected:
+  /** Internal ctor */
+  explicit DecryptCache ();
+
+public:
+  /** Get the DecryptCache */
+  static DecryptCache *instance ();
+
+  /* Store the results of PARSER for the mail with UID.  HASH is the
+     hash of the content PARSER parsed.  An older entry for UID is
+     replaced.  */
+  void store (const std::string &uid, const std::string &hash,
+              const ParseController &parser);
+
+  /* Return a ParseController with the results stored for UID or
+     nullptr if there is no entry for UID with HASH.  */
+  std::shared_ptr<ParseController> restore (const std::string &uid,
+                                            const std::string &hash);
+
+  /* Remove the entry for UID.  */
+  void invalidate (const std::string &uid);
+
+  /* Remove all entries.  */
+  void clear ();
+
+  /* Set the maximum size of all entries.  */
+  void setMaxSize (size_t size);
+
+  /* The number and size of the entries.  */
+  size_t count () const;
+  size_t size () const;
+
+  /* Return the SHA-256 of the remaining data in STREAM or an empty
+     string on error.  The position of the stream is not changed.  */
+  static std::string hashFile (FILE *stream);
+#ifdef HAVE_W32_SYSTEM
+  static std::string hashStream (LPSTREAM stream);
+#endif
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif
@@ -34,6 +34,7 @@
 #include "mail.h"
 #include "gpgoladdin.h"
 #include "windowmessages.h"
+#include "parsescheduler.h"
 
 /* Explorer Events */
 BEGIN_EVENT_SINK(ExplorerEvents, IDispatch)
@@ -98,6 +99,25 @@ std::map<LPDISPATCH, int> s_explorerMap;
 
 gpgrt_lock_t explorer_map_lock = GPGRT_LOCK_INITIALIZER;
 
+/* Parse the selected MAILITEM before the other mails.  */
+static void
+selectForParsing (LPDISPATCH mailitem)
+{
+  char *uid = get_unique_id (mailitem, 0, nullptr);
+
+  if (!uid)
+    {
+      /* Not yet loaded.  */
+      return;
+    }
+  Mail *mail = Mail::getMailForUUID (uid);
+  xfree (uid);
+  if (mail)
+    {
+      ParseScheduler::instance ()->setSelected (mail);
+    }
+}
+
 static bool
 hasSelection (LPDISPATCH explorer)
 {
@@ -126,6 +146,10 @@ hasSelection (LPDISPATCH explorer)
             SRCNAME, __func__);
         selected = false;
       }
+      else
+      {
+        selectForParsing (mailitem);
+      }
       gpgol_release (mailitem);
       gpgol_release (selectitem);
     }
@@ -0,0 +1,402 @@
+/* @file fprtable.h
+ * @brief A compact hash table keyed by fingerprints
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FPRTABLE_H
+#define FPRTABLE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+/* A fingerprint in binary form.  OpenPGP v4 and X.509 fingerprints
+   have 20 bytes and v5 fingerprints 32 bytes.  Unlike a std::string
+   of the hex form it needs no allocation.  A string which is not
+   the hex form of at most 32 bytes gives a null fingerprint.  */
+class BinFpr
+{
+public:
+  enum
+    {
+      MaxLength = 32
+    };
+
+  BinFpr () : m_len (0) {}
+
+  explicit BinFpr (const char *hex) : m_len (0)
+  {
+    size_t len = hex ? strlen (hex) : 0;
+    size_t i;
+
+    if (!len || len % 2 || len / 2 > MaxLength)
+      {
+        return;
+      }
+    for (i = 0; i < len / 2; i++)
+      {
+        int hi = hexval (hex[2 * i]);
+        int lo = hexval (hex[2 * i + 1]);
+        if (hi == -1 || lo == -1)
+          {
+            return;
+          }
+        m_data[i] = (unsigned char) (hi << 4 | lo);
+      }
+    m_len = (unsigned char) (len / 2);
+  }
+
+  explicit BinFpr (const std::string &hex) : BinFpr (hex.c_str ()) {}
+
+  bool isNull () const { return !m_len; }
+
+  /* Return the upper case hex form like GnuPG prints it.  */
+  std::string
+  toString () const
+  {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string ret (m_len * 2, '0');
+    size_t i;
+
+    for (i = 0; i < m_len; i++)
+      {
+        ret[2 * i] = digits[m_data[i] >> 4];
+        ret[2 * i + 1] = digits[m_data[i] & 15];
+      }
+    return ret;
+  }
+
+  /* The bytes of a real fingerprint are evenly distributed but the
+     table only uses the low bits, so the first 16 bytes are mixed.  */
+  size_t
+  hash () const
+  {
+    uint64_t a = 0;
+    uint64_t b = 0;
+    uint64_t h;
+
+    memcpy (&a, m_data, m_len < 8 ? m_len : 8);
+    if (m_len > 8)
+      {
+        memcpy (&b, m_data + 8, m_len < 16 ? m_len - 8 : 8);
+      }
+    h = (a ^ (b * 0xff51afd7ed558ccdULL) ^ m_len) * 0x9e3779b97f4a7c15ULL;
+    return (size_t) (h ^ (h >> 32));
+  }
+
+  bool
+  operator== (const BinFpr &other) const
+  {
+    return m_len == other.m_len && !memcmp (m_data, other.m_data, m_len);
+  }
+
+  bool operator!= (const BinFpr &other) const { return !(*this == other); }
+
+private:
+  static int
+  hexval (char c)
+  {
+    if (c >= '0' && c <= '9')
+      {
+        return c - '0';
+      }
+    if (c >= 'A' && c <= 'F')
+      {
+        return c - 'A' + 10;
+      }
+    if (c >= 'a' && c <= 'f')
+      {
+        return c - 'a' + 10;
+      }
+    return -1;
+  }
+
+  unsigned char m_len;
+  unsigned char m_data[MaxLength];
+};
+
+/* A hash table from fingerprints to values of type V with open
+   addressing.  The entries are stored in one array and found by
+   linear probing so a lookup touches no other memory than the
+   slot.  Entries are removed by moving the following entries back
+   so that no tombstones are needed.  A table is not thread-safe; the
+   KeyCache guards it with its locks.  */
+template <class V>
+class FprTable
+{
+public:
+  typedef std::pair<BinFpr, V> value_type;
+
+  /* Iterates over the used slots.  */
+  class const_iterator
+  {
+  public:
+    const_iterator (const value_type *pos, const value_type *end) :
+      m_pos (pos), m_end (end)
+    {
+      skip ();
+    }
+    const value_type &operator* () const { return *m_pos; }
+    const value_type *operator-> () const { return m_pos; }
+    const_iterator &operator++ () { ++m_pos; skip (); return *this; }
+    bool operator!= (const const_iterator &o) const { return m_pos != o.m_pos; }
+    bool operator== (const const_iterator &o) const { return m_pos == o.m_pos; }
+
+  private:
+    void
+    skip ()
+    {
+      while (m_pos != m_end && m_pos->first.isNull ())
+        {
+          ++m_pos;
+        }
+    }
+
+    const value_type *m_pos;
+    const value_type *m_end;
+  };
+
+  FprTable () : m_size (0) {}
+
+  size_t size () const { return m_size; }
+  bool empty () const { return !m_size; }
+
+  const_iterator
+  begin () const
+  {
+    return const_iterator (m_slots.data (), m_slots.data () + m_slots.size ());
+  }
+
+  const_iterator
+  end () const
+  {
+    const value_type *end = m_slots.data () + m_slots.size ();
+    return const_iterator (end, end);
+  }
+
+  /* Make room for N entries without growing.  */
+  void
+  reserve (size_t n)
+  {
+    size_t cap = 16;
+
+    while (cap * MaxLoad / 8 < n)
+      {
+        cap *= 2;
+      }
+    if (cap > m_slots.size ())
+      {
+        rehash (cap);
+      }
+  }
+
+  void
+  clear ()
+  {
+    m_slots.clear ();
+    m_size = 0;
+  }
+
+  void
+  swap (FprTable &other)
+  {
+    m_slots.swap (other.m_slots);
+    std::swap (m_size, other.m_size);
+  }
+
+  /* Return the value for FPR or nullptr.  The pointer is valid until
+     the table is changed.  */
+  const V *
+  find (const BinFpr &fpr) const
+  {
+    if (!m_size || fpr.isNull ())
+      {
+        return nullptr;
+      }
+    const size_t mask = m_slots.size () - 1;
+    for (size_t i = fpr.hash () & mask; ; i = (i + 1) & mask)
+      {
+        const auto &slot = m_slots[i];
+        if (slot.first.isNull ())
+          {
+            return nullptr;
+          }
+        if (slot.first == fpr)
+          {
+            return &slot.second;
+          }
+      }
+  }
+
+  V *
+  find (const BinFpr &fpr)
+  {
+    return const_cast<V *> (static_cast<const FprTable *> (this)->find (fpr));
+  }
+
+  /* Insert VALUE for FPR unless FPR is already in the table.
+     Returns the value in the table and whether it was inserted.  A
+     null FPR is not inserted.  */
+  std::pair<V *, bool>
+  insert (const BinFpr &fpr, const V &value)
+  {
+    if (fpr.isNull ())
+      {
+        return std::make_pair (nullptr, false);
+      }
+    V *found = find (fpr);
+    if (found)
+      {
+        return std::make_pair (found, false);
+      }
+    if ((m_size + 1) * 8 > m_slots.size () * MaxLoad)
+      {
+        rehash (m_slots.empty () ? 16 : m_slots.size () * 2);
+      }
+    const size_t mask = m_slots.size () - 1;
+    size_t i = fpr.hash () & mask;
+    while (!m_slots[i].first.isNull ())
+      {
+        i = (i + 1) & mask;
+      }
+    m_slots[i].first = fpr;
+    m_slots[i].second = value;
+    m_size++;
+    return std::make_pair (&m_slots[i].second, true);
+  }
+
+  /* Set the value for FPR to VALUE.  */
+  void
+  set (const BinFpr &fpr, const V &value)
+  {
+    auto ret = insert (fpr, value);
+    if (ret.first && !ret.second)
+      {
+        *ret.first = value;
+      }
+  }
+
+  /* Remove FPR.  Returns true if it was in the table.  */
+  bool
+  erase (const BinFpr &fpr)
+  {
+    if (!m_size || fpr.isNull ())
+      {
+        return false;
+      }
+    const size_t mask = m_slots.size () - 1;
+    size_t i = fpr.hash () & mask;
+    for (;; i = (i + 1) & mask)
+      {
+        if (m_slots[i].first.isNull ())
+          {
+            return false;
+          }
+        if (m_slots[i].first == fpr)
+          {
+            break;
+          }
+      }
+    /* Move back the following entries which can't be found anymore
+       with a hole at I.  */
+    for (size_t j = (i + 1) & mask; !m_slots[j].first.isNull ();
+         j = (j + 1) & mask)
+      {
+        const size_t home = m_slots[j].first.hash () & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+          {
+            m_slots[i] = std::move (m_slots[j]);
+            i = j;
+          }
+      }
+    m_slots[i] = value_type ();
+    m_size--;
+    return true;
+  }
+
+  /* Remove all entries for which PRED (fpr, value) is true.  */
+  template <class Pred>
+  size_t
+  eraseIf (Pred pred)
+  {
+    std::vector<BinFpr> fprs;
+
+    for (const auto &slot: *this)
+      {
+        if (pred (slot.first, slot.second))
+          {
+            fprs.push_back (slot.first);
+          }
+      }
+    for (const auto &fpr: fprs)
+      {
+        erase (fpr);
+      }
+    return fprs.size ();
+  }
+
+  /* The bytes allocated for the slots.  */
+  size_t
+  memoryUsage () const
+  {
+    return m_slots.capacity () * sizeof (value_type);
+  }
+
+private:
+  /* The maximum load in eighths.  */
+  enum
+    {
+      MaxLoad = 6
+    };
+
+  void
+  rehash (size_t cap)
+  {
+    std::vector<value_type> old (cap);
+
+    old.swap (m_slots);
+    m_size = 0;
+    for (auto &slot: old)
+      {
+        if (slot.first.isNull ())
+          {
+            continue;
+          }
+        const size_t mask = m_slots.size () - 1;
+        size_t i = slot.first.hash () & mask;
+        while (!m_slots[i].first.isNull ())
+          {
+            i = (i + 1) & mask;
+          }
+        m_slots[i] = std::move (slot);
+        m_size++;
+      }
+  }
+
+  std::vector<value_type> m_slots;
+  size_t m_size;
+};
+
+#endif /* FPRTABLE_H */
@@ -0,0 +1,145 @@
+/* @file jobgroup.cpp
+ * @brief Run a group of jobs concurrently and wait for all of them
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jobgroup.h"
+
+#include "common_indep.h"
+#include "workerpool.h"
+
+#include <list>
+
+#include <gpg-error.h>
+
+GPGRT_LOCK_DEFINE (job_group_lock);
+
+namespace
+{
+/* The shared pool of all job groups and its queue.  The queue is
+   protected by the lock of the pool.  */
+struct job_pool_s
+{
+  job_pool_s () :
+    pool ("job group", JOBGROUP_MAX_WORKERS, [this] () { return take (); })
+  {
+  }
+
+  std::function<void ()>
+  take ()
+  {
+    auto func = std::move (queue.front ());
+    queue.pop_front ();
+    return func;
+  }
+
+  std::list<std::function<void ()> > queue;
+  WorkerPool pool;
+};
+}
+
+/* The workers keep a pointer to the pool so it is never
+   destroyed.  */
+static job_pool_s *job_pool;
+
+static job_pool_s *
+get_job_pool ()
+{
+  gpgol_lock (&job_group_lock);
+  if (!job_pool)
+    {
+      job_pool = new job_pool_s;
+    }
+  gpgol_unlock (&job_group_lock);
+  return job_pool;
+}
+
+class JobGroup::Private
+{
+public:
+  Private () :
+    m_pool (get_job_pool ()),
+    m_pending (0),
+    m_added (0)
+  {
+  }
+
+  job_pool_s *m_pool;
+  /* Jobs not yet done.  Protected by the lock of the pool.  */
+  int m_pending;
+  /* Jobs added since the last wait.  */
+  int m_added;
+};
+
+JobGroup::JobGroup () : d (new Private)
+{
+}
+
+JobGroup::~JobGroup ()
+{
+  wait ();
+}
+
+void
+JobGroup::add (const std::function<void ()> &func)
+{
+  Private *p = d.get ();
+  auto &pool = p->m_pool->pool;
+  std::function<void ()> job = func;
+
+  pool.lock ();
+  p->m_pool->queue.push_back ([p, job] () mutable {
+      job ();
+      /* Destroy the job's arguments before it is marked as done.  */
+      job = nullptr;
+      p->m_pool->pool.lock ();
+      p->m_pending--;
+      p->m_pool->pool.unlock ();
+    });
+  p->m_pending++;
+  p->m_added++;
+  pool.queued ();
+  if (!pool.workers ())
+    {
+      auto wrapped = std::move (p->m_pool->queue.back ());
+      p->m_pool->queue.pop_back ();
+      pool.dropped ();
+      pool.unlock ();
+      log_error ("%s:%s: No job worker. Running job directly.",
+                 SRCNAME, __func__);
+      wrapped ();
+      return;
+    }
+  pool.unlock ();
+}
+
+void
+JobGroup::wait ()
+{
+  Private *p = d.get ();
+
+  p->m_pool->pool.wait ([p] () { return !p->m_pending; });
+  p->m_added = 0;
+}
+
+int
+JobGroup::size () const
+{
+  return d->m_added;
+}
@@ -0,0 +1,63 @@
+/* @file jobgroup.h
+ * @brief Run a group of jobs concurrently and wait for all of them
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JOBGROUP_H
+#define JOBGROUP_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <functional>
+#include <memory>
+
+/* The maximum number of threads for the jobs of all groups.  */
+#define JOBGROUP_MAX_WORKERS 4
+
+/* A JobGroup runs the added jobs in the shared WorkerPool of all job
+   groups.  wait returns when all jobs of the group are done.  This
+   is meant for a handful of long running jobs which should not wait
+   for each other, like the crypto of the mails of a split send.
+   Unlike the ParseScheduler there are no priorities.  If no worker
+   can be started the job is run by add itself.  The destructor
+   waits for the jobs.  A JobGroup must only be used from one thread
+   and never from a job of a group.  */
+class JobGroup
+{
+public:
+  JobGroup ();
+  ~JobGroup ();
+
+  /* Queue JOB in the shared pool.  */
+  void add (const std::function<void ()> &job);
+
+  /* Wait until all jobs are done.  */
+  void wait ();
+
+  /* Number of jobs added since the last wait.  */
+  int size () const;
+
+private:
+  class Private;
+  std::unique_ptr<Private> d;
+};
+
+#endif // JOBGROUP_H
@@ -21,9 +21,17 @@
 
 #include "keycache.h"
 
+#include "bestkeyindex.h"
 #include "common.h"
 #include "cpphelp.h"
+#include "fprtable.h"
+#include "keyjobqueue.h"
+#include "keyringwatcher.h"
+#include "keysnapshot.h"
 #include "mail.h"
+#include "negativecache.h"
+#include "pendingset.h"
+#include "rwlock.h"
 
 #include <gpg-error.h>
 #include <gpgme++/context.h>
@@ -33,32 +41,35 @@
 #include <gpgme++/engineinfo.h>
 #include <gpgme++/defaultassuantransaction.h>
 #include <gpgme++/configuration.h>
+#include <gpgme++/global.h>
 
 #include <windows.h>
 
-#include <set>
 #include <unordered_map>
 #include <sstream>
 
-GPGRT_LOCK_DEFINE (keycache_lock);
-GPGRT_LOCK_DEFINE (fpr_map_lock);
-GPGRT_LOCK_DEFINE (update_lock);
-GPGRT_LOCK_DEFINE (import_lock);
+/* The maps are read by the UI thread for every recipient while the
+   keylisting and the locator threads write to them.  Readers share
+   the locks so that they only wait for the single insert which is
+   in progress.  The fpr_map_lock is never taken while holding the
+   keycache_lock.  */
+static RWLock keycache_lock;
+static RWLock fpr_map_lock;
 GPGRT_LOCK_DEFINE (config_lock);
 static KeyCache* singleton = nullptr;
 
-/** At some point we need to set a limit. There
-  seems to be no limit on how many recipients a mail
-  can have in outlook.
+/* The mail addresses for which the last locate found no key.  */
+static NegativeCache s_negative_cache;
 
-  We would run out of resources or block.
+/* How long to wait for a running update or import of a key in
+   milliseconds.  */
+#define UPDATE_WAIT_TIMEOUT 30000
+#define IMPORT_WAIT_TIMEOUT 10000
 
-  50 Threads already seems a bit excessive but
-  it should really cover most legit use cases.
-*/
-
-#define MAX_LOCATOR_THREADS 50
-static int s_thread_cnt;
+/* The number of mail addresses which are located with one gpg.  The
+   lookups for one gpg run one after another so large recipient lists
+   are split to still use the workers of the KeyJobQueue.  */
+#define LOCATE_BATCH_SIZE 20
 
 namespace
 {
@@ -70,7 +81,6 @@ namespace
           m_mail (mail)
         {
           TSTART;
-          s_thread_cnt++;
           Mail::lockDelete ();
           if (Mail::isValidPtr (m_mail))
             {
@@ -83,7 +93,6 @@ namespace
         ~LocateArgs()
         {
           TSTART;
-          s_thread_cnt--;
           Mail::lockDelete ();
           if (Mail::isValidPtr (m_mail))
             {
@@ -98,10 +107,6 @@ namespace
     };
 } // namespace
 
-typedef std::pair<std::string, GpgME::Protocol> update_arg_t;
-
-typedef std::pair<std::unique_ptr<LocateArgs>, std::string> import_arg_t;
-
 static std::vector<GpgME::Key>
 filter_chain (const std::vector<GpgME::Key> &input)
 {
@@ -137,25 +142,23 @@ filter_chain (const std::vector<GpgME::Key> &input)
     return leaves;
 }
 
-static DWORD WINAPI
-do_update (LPVOID arg)
+static void
+do_update (const std::string &fpr, GpgME::Protocol proto)
 {
   TSTART;
-  auto args = std::unique_ptr<update_arg_t> ((update_arg_t*) arg);
-
   log_debug ("%s:%s updating: \"%s\" with protocol %s",
-             SRCNAME, __func__, anonstr (args->first.c_str ()),
-             to_cstr (args->second));
+             SRCNAME, __func__, anonstr (fpr.c_str ()),
+             to_cstr (proto));
 
   auto ctx = std::unique_ptr<GpgME::Context> (GpgME::Context::createForProtocol
-                                              (args->second));
+                                              (proto));
 
   if (!ctx)
     {
       TRACEPOINT;
-      KeyCache::instance ()->onUpdateJobDone (args->first.c_str(),
+      KeyCache::instance ()->onUpdateJobDone (fpr.c_str(),
                                               GpgME::Key ());
-      TRETURN 0;
+      TRETURN;
     }
 
   ctx->setKeyListMode (GpgME::KeyListMode::Local |
@@ -163,42 +166,40 @@ do_update (LPVOID arg)
                        GpgME::KeyListMode::Validate |
                        GpgME::KeyListMode::WithTofu);
   GpgME::Error err;
-  const auto newKey = ctx->key (args->first.c_str (), err, false);
+  const auto newKey = ctx->key (fpr.c_str (), err, false);
   TRACEPOINT;
 
   if (newKey.isNull())
     {
       log_debug ("%s:%s Failed to find key for %s",
-                 SRCNAME, __func__, anonstr (args->first.c_str ()));
+                 SRCNAME, __func__, anonstr (fpr.c_str ()));
     }
   if (err)
     {
       log_debug ("%s:%s Failed to find key for %s err: %s",
-                 SRCNAME, __func__, anonstr (args->first.c_str()),
+                 SRCNAME, __func__, anonstr (fpr.c_str()),
                  err.asStdString().c_str());
     }
-  KeyCache::instance ()->onUpdateJobDone (args->first.c_str(),
+  KeyCache::instance ()->onUpdateJobDone (fpr.c_str(),
                                           newKey);
   log_debug ("%s:%s Update job done - idling",
              SRCNAME, __func__);
-  TRETURN 0;
+  TRETURN;
 }
 
-static DWORD WINAPI
-do_import (LPVOID arg)
+static void
+do_import (const LocateArgs &args, const std::string &keydata)
 {
   TSTART;
-  auto args = std::unique_ptr<import_arg_t> ((import_arg_t*) arg);
-
-  const std::string mbox = args->first->m_mbox;
+  const std::string mbox = args.m_mbox;
 
   log_debug ("%s:%s importing for: \"%s\" with data \n%s",
              SRCNAME, __func__, anonstr (mbox.c_str ()),
-             anonstr (args->second.c_str ()));
+             anonstr (keydata.c_str ()));
 
   // We want to avoid unneccessary copies. The c_str will be valid
-  // until args goes out of scope.
-  const char *keyStr = args->second.c_str ();
+  // until the job is done.
+  const char *keyStr = keydata.c_str ();
   GpgME::Data data (keyStr, strlen (keyStr), /* copy */ false);
 
   GpgME::Protocol proto = GpgME::OpenPGP;
@@ -214,14 +215,16 @@ do_import (LPVOID arg)
   if (!ctx)
     {
       TRACEPOINT;
-      TRETURN 0;
+      KeyCache::instance ()->onAddrBookImportJobDone (mbox, {}, proto);
+      TRETURN;
     }
 
   if (type != GpgME::Data::PGPKey && type != GpgME::Data::X509Cert)
     {
       log_debug ("%s:%s Data for: %s is not a PGP Key or Cert ",
                  SRCNAME, __func__, anonstr (mbox.c_str ()));
-      TRETURN 0;
+      KeyCache::instance ()->onAddrBookImportJobDone (mbox, {}, proto);
+      TRETURN;
     }
   data.rewind ();
 
@@ -243,13 +246,9 @@ do_import (LPVOID arg)
           continue;
         }
 
-      update_arg_t * update_args = new update_arg_t;
-      update_args->first = std::string (fpr);
-      update_args->second = proto;
-
       // We do it blocking to be sure that when all imports
       // are done they are also part of the keycache.
-      do_update ((LPVOID) update_args);
+      do_update (fpr, proto);
 
       if (std::find(fingerprints.begin(), fingerprints.end(), fpr) ==
           fingerprints.end())
@@ -260,17 +259,25 @@ do_import (LPVOID arg)
                  SRCNAME, __func__, anonstr (fpr));
     }
 
+  if (!fingerprints.empty ())
+    {
+      s_negative_cache.expire (mbox, proto);
+    }
   KeyCache::instance ()->onAddrBookImportJobDone (mbox,
                                                   fingerprints,
                                                   proto);
 
   log_debug ("%s:%s Import job done for: %s",
              SRCNAME, __func__, anonstr (mbox.c_str ()));
-  TRETURN 0;
+  TRETURN;
 }
 
-static void
-do_populate_protocol (GpgME::Protocol proto, bool secret)
+/* List the keys of PROTO and add them to KEYS.  EXTRA_MODE is added
+   to the keylist mode.  Returns false if the listing failed.  */
+static bool
+do_populate_protocol (GpgME::Protocol proto, bool secret,
+                      std::vector<GpgME::Key> *keys,
+                      unsigned int extra_mode = 0)
 {
   log_debug ("%s:%s: Starting keylisting for proto %s",
              SRCNAME, __func__, to_cstr (proto));
@@ -280,11 +287,12 @@ do_populate_protocol (GpgME::Protocol proto, bool secret)
       /* Maybe PGP broken and not S/MIME */
       log_error ("%s:%s: broken installation no ctx.",
                  SRCNAME, __func__);
-      TRETURN;
+      TRETURN false;
     }
 
   ctx->setKeyListMode (GpgME::KeyListMode::Local |
-                       GpgME::KeyListMode::Validate);
+                       GpgME::KeyListMode::Validate |
+                       extra_mode);
   ctx->setOffline (true);
   GpgME::Error err;
 
@@ -292,7 +300,7 @@ do_populate_protocol (GpgME::Protocol proto, bool secret)
     {
       log_error ("%s:%s: Failed to start keylisting err: %i: %s",
                  SRCNAME, __func__, err.code (), err.asStdString().c_str());
-      TRETURN;
+      TRETURN false;
     }
 
   while (!err)
@@ -303,11 +311,74 @@ do_populate_protocol (GpgME::Protocol proto, bool secret)
           TRACEPOINT;
           break;
         }
-      KeyCache::instance()->onUpdateJobDone (key.primaryFingerprint(),
-                                             key);
+      keys->push_back (key);
+    }
+  log_debug ("%s:%s: Listed %u %s keys for proto %s",
+             SRCNAME, __func__, (unsigned int) keys->size (),
+             secret ? "secret" : "public", to_cstr (proto));
+  TRETURN !err || err.code () == GPG_ERR_EOF;
+}
 
+/* Return a string of the properties of KEY which matter for the
+   cache.  Two listings of a key which did not change give the same
+   string.  */
+static std::string
+key_digest (const GpgME::Key &key)
+{
+  std::stringstream ss;
+
+  ss << key.primaryFingerprint () << ' ' << key.lastUpdate () << ' '
+     << key.ownerTrust () << ' ' << key.isRevoked () << key.isExpired ()
+     << key.isDisabled () << key.isInvalid () << key.hasSecret ()
+     << key.canEncrypt () << key.canSign () << '\n';
+  for (const auto &sub: key.subkeys ())
+    {
+      ss << sub.fingerprint () << ' ' << sub.expirationTime () << ' '
+         << sub.isRevoked () << sub.isExpired () << sub.isDisabled ()
+         << sub.isInvalid () << sub.canEncrypt () << sub.canSign ()
+         << '\n';
     }
-  TRETURN;
+  for (const auto &uid: key.userIDs ())
+    {
+      ss << (uid.id () ? uid.id () : "") << ' ' << uid.validity () << ' '
+         << uid.isRevoked () << uid.isInvalid () << '\n';
+    }
+  return ss.str ();
+}
+
+namespace
+{
+  struct populate_job_s
+    {
+      GpgME::Protocol proto;
+      bool secret;
+      std::vector<GpgME::Key> keys;
+    };
+} // namespace
+
+static DWORD WINAPI
+do_populate_job (LPVOID arg)
+{
+  auto job = static_cast<populate_job_s *> (arg);
+
+  do_populate_protocol (job->proto, job->secret, &job->keys);
+  return 0;
+}
+
+/* Run JOB in a new thread.  If that fails JOB is run right away and
+   nullptr is returned.  */
+static HANDLE
+start_populate_job (populate_job_s *job)
+{
+  HANDLE thread = CreateThread (nullptr, 0, do_populate_job,
+                                job, 0, nullptr);
+  if (!thread)
+    {
+      log_error ("%s:%s: Failed to create thread.",
+                 SRCNAME, __func__);
+      do_populate_job (job);
+    }
+  return thread;
 }
 
 const std::vector< std::pair<std::string, std::string> >
@@ -473,18 +544,76 @@ do_populate (LPVOID)
   gpgrt_lock_unlock (&config_lock);
   log_debug ("%s:%s: Populating keycache",
              SRCNAME, __func__);
-  do_populate_protocol (GpgME::OpenPGP, false);
+  ULONGLONG start = GetTickCount64 ();
+
+  /* Until the listing is done lookups can use the snapshot from the
+     last run.  The stamp is taken before the listing so that a
+     change during the listing invalidates the new snapshot.  */
+  const char *homedir = GpgME::dirInfo ("homedir");
+  std::string stamp;
+  if (homedir)
+    {
+      stamp = KeySnapshot::keyringStamp (homedir);
+      KeyCache::instance ()->loadSnapshot (homedir, stamp);
+    }
+
+  /* The listings run at the same time.  The secret listings have to
+     wait for the smartcards to be learned.  The keys are inserted in
+     the old order: public before secret and OpenPGP before CMS.  */
+  populate_job_s jobs[] = {
+      { GpgME::OpenPGP, false, {} },
+      { GpgME::OpenPGP, true, {} },
+      { GpgME::CMS, false, {} },
+      { GpgME::CMS, true, {} }
+  };
+  const int n_jobs = opt.enable_smime ? 4 : 2;
+  HANDLE threads[4];
+  int n_threads = 0;
+
+  threads[n_threads] = start_populate_job (&jobs[0]);
+  n_threads += !!threads[n_threads];
+  if (opt.enable_smime)
+    {
+      threads[n_threads] = start_populate_job (&jobs[2]);
+      n_threads += !!threads[n_threads];
+    }
   do_populate_smartcards (GpgME::OpenPGP);
-  do_populate_protocol (GpgME::OpenPGP, true);
   if (opt.enable_smime)
     {
-      do_populate_protocol (GpgME::CMS, false);
       do_populate_smartcards (GpgME::CMS);
-      do_populate_protocol (GpgME::CMS, true);
+      threads[n_threads] = start_populate_job (&jobs[3]);
+      n_threads += !!threads[n_threads];
     }
+  do_populate_job (&jobs[1]);
 
-  log_debug ("%s:%s: Keycache populated",
-             SRCNAME, __func__);
+  if (n_threads)
+    {
+      WaitForMultipleObjects (n_threads, threads, TRUE, INFINITE);
+    }
+  for (int i = 0; i < n_threads; i++)
+    {
+      CloseHandle (threads[i]);
+    }
+
+  std::vector<GpgME::Key> keys;
+  for (int i = 0; i < n_jobs; i++)
+    {
+      keys.insert (keys.end (), jobs[i].keys.begin (), jobs[i].keys.end ());
+      std::vector<GpgME::Key> ().swap (jobs[i].keys);
+    }
+  ULONGLONG listed = GetTickCount64 ();
+  KeyCache::instance ()->onPopulateDone (keys);
+  if (homedir)
+    {
+      KeyCache::instance ()->saveSnapshot (homedir, stamp);
+      KeyCache::instance ()->startKeyringWatcher (homedir);
+    }
+
+  log_debug ("%s:%s: Keycache populated with %u keys in %u ms "
+             "(listing %u ms)",
+             SRCNAME, __func__, (unsigned int) keys.size (),
+             (unsigned int) (GetTickCount64 () - start),
+             (unsigned int) (listed - start));
   KeyCache::instance ()->setIsPopulated(true);
   TRETURN 0;
 }
@@ -500,7 +629,7 @@ public:
   void setPgpKey(const std::string &mbox, const GpgME::Key &key)
   {
     TSTART;
-    gpgol_lock (&keycache_lock);
+    keycache_lock.lock ();
     auto it = m_pgp_key_map.find (mbox);
 
     if (it == m_pgp_key_map.end ())
@@ -511,15 +640,16 @@ public:
       {
         it->second = key;
       }
+    indexKey (m_pgp_key_map, mbox, key);
+    keycache_lock.unlock ();
     insertOrUpdateInFprMap (key);
-    gpgol_unlock (&keycache_lock);
     TRETURN;
   }
 
   void setSmimeKey(const std::string &mbox, const GpgME::Key &key)
   {
     TSTART;
-    gpgol_lock (&keycache_lock);
+    keycache_lock.lock ();
     auto it = m_smime_key_map.find (mbox);
 
     if (it == m_smime_key_map.end ())
@@ -530,8 +660,9 @@ public:
       {
         it->second = key;
       }
+    indexKey (m_smime_key_map, mbox, key);
+    keycache_lock.unlock ();
     insertOrUpdateInFprMap (key);
-    gpgol_unlock (&keycache_lock);
     TRETURN;
   }
 
@@ -612,49 +743,72 @@ public:
     TRETURN newKey;
   }
 
-  void setPgpKeySecret(const std::string &mbox, const GpgME::Key &key,
-                       bool insert = true)
+  /* Use KEY as secret key for MBOX in SKEY_MAP unless the key there
+     is better.  Called with the keycache_lock held.  */
+  void updateSkeyMap (std::unordered_map<std::string, GpgME::Key> &skey_map,
+                      const std::string &mbox, const GpgME::Key &key)
   {
-    TSTART;
-    gpgol_lock (&keycache_lock);
-    auto it = m_pgp_skey_map.find (mbox);
+    auto it = skey_map.find (mbox);
 
-    if (it == m_pgp_skey_map.end ())
+    if (it == skey_map.end ())
       {
-        m_pgp_skey_map.insert (std::pair<std::string, GpgME::Key> (mbox, key));
+        it = skey_map.insert (std::pair<std::string, GpgME::Key> (mbox,
+                                                                   key)).first;
       }
     else
       {
         it->second = compareSkeys (it->second, key);
       }
-    if (insert)
-      {
-        insertOrUpdateInFprMap (key);
-      }
-    gpgol_unlock (&keycache_lock);
-    TRETURN;
+    indexKey (skey_map, mbox, it->second);
   }
 
-  void setSmimeKeySecret(const std::string &mbox, const GpgME::Key &key,
-                         bool insert = true)
+  /* Set the secret keys in SKEYS which are pairs of a mail address
+     and a key.  */
+  void setSecretKeys (const std::vector<std::pair<std::string, GpgME::Key> >
+                      &skeys)
   {
     TSTART;
-    gpgol_lock (&keycache_lock);
-    auto it = m_smime_skey_map.find (mbox);
-
-    if (it == m_smime_skey_map.end ())
-      {
-        m_smime_skey_map.insert (std::pair<std::string, GpgME::Key> (mbox, key));
-      }
-    else
+    if (skeys.empty ())
       {
-        it->second = compareSkeys (it->second, key);
+        TRETURN;
       }
-    if (insert)
+    keycache_lock.lock ();
+    for (const auto &skey: skeys)
       {
-        insertOrUpdateInFprMap (key);
+        if (skey.second.protocol () == GpgME::OpenPGP)
+          {
+            updateSkeyMap (m_pgp_skey_map, skey.first, skey.second);
+          }
+        else if (skey.second.protocol () == GpgME::CMS)
+          {
+            updateSkeyMap (m_smime_skey_map, skey.first, skey.second);
+          }
+        else
+          {
+            STRANGEPOINT;
+          }
       }
-    gpgol_unlock (&keycache_lock);
+    keycache_lock.unlock ();
+    TRETURN;
+  }
+
+  void setPgpKeySecret(const std::string &mbox, const GpgME::Key &key)
+  {
+    TSTART;
+    keycache_lock.lock ();
+    updateSkeyMap (m_pgp_skey_map, mbox, key);
+    keycache_lock.unlock ();
+    insertOrUpdateInFprMap (key);
+    TRETURN;
+  }
+
+  void setSmimeKeySecret(const std::string &mbox, const GpgME::Key &key)
+  {
+    TSTART;
+    keycache_lock.lock ();
+    updateSkeyMap (m_smime_skey_map, mbox, key);
+    keycache_lock.unlock ();
+    insertOrUpdateInFprMap (key);
     TRETURN;
   }
 
@@ -670,41 +824,35 @@ public:
       }
     auto mbox = GpgME::UserID::addrSpecFromString (addr);
 
-    gpgol_lock (&import_lock);
     const auto job_set = (proto == GpgME::OpenPGP ?
                        &m_pgp_import_jobs : &m_cms_import_jobs);
-    int i = 0;
-    while (job_set->find (mbox) != job_set->end ())
+    if (job_set->contains (mbox))
       {
-        i++;
-        if (i % 100 == 0)
-          {
-            log_debug ("%s:%s Waiting on import for \"%s\"",
-                       SRCNAME, __func__, anonstr (addr));
-          }
-        gpgol_unlock (&import_lock);
-        Sleep (10);
-        gpgol_lock (&import_lock);
-        if (i == 1000)
+        log_debug ("%s:%s Waiting on import for \"%s\"",
+                   SRCNAME, __func__, anonstr (addr));
+        if (!job_set->wait (mbox, IMPORT_WAIT_TIMEOUT))
           {
             /* Just to be on the save side */
             log_error ("%s:%s Waiting on import for \"%s\" "
                        "failed! Bug!",
                        SRCNAME, __func__, anonstr (addr));
-            break;
           }
       }
-    gpgol_unlock (&import_lock);
 
     auto override_map = (proto == GpgME::OpenPGP ?
                          &m_pgp_overrides : &m_cms_overrides);
+    std::vector<std::string> fprs;
+    keycache_lock.lockShared ();
     const auto it = override_map->find (mbox);
-    if (it == override_map->end ())
+    if (it != override_map->end ())
       {
-        gpgol_unlock (&keycache_lock);
-        TRETURN ret;
+        fprs = it->second;
       }
-    for (const auto &fpr: it->second)
+    keycache_lock.unlockShared ();
+
+    /* The keys are looked up without the keycache_lock as
+       getByFpr takes the fpr_map_lock.  */
+    for (const auto &fpr: fprs)
       {
         const auto key = getByFpr (fpr.c_str (), false);
         if (key.isNull())
@@ -719,113 +867,89 @@ public:
         /* Remove root and intermediate ca's */
         ret = filter_chain (ret);
     }
-    gpgol_unlock (&keycache_lock);
     TRETURN ret;
   }
 
-  GpgME::Key getKey (const char *addr, GpgME::Protocol proto)
+  /* Return the index of the best keys for the mail address map MAP.  */
+  BestKeyIndex &
+  bestKeysFor (const std::unordered_map<std::string, GpgME::Key> &map)
   {
-    TSTART;
-    if (!addr)
+    if (&map == &m_pgp_key_map)
       {
-        TRETURN GpgME::Key();
+        return m_pgp_best_keys;
       }
-    auto mbox = GpgME::UserID::addrSpecFromString (addr);
-
-    if (proto == GpgME::OpenPGP)
+    if (&map == &m_smime_key_map)
       {
-        gpgol_lock (&keycache_lock);
-        const auto it = m_pgp_key_map.find (mbox);
-
-        if (it == m_pgp_key_map.end ())
-          {
-            gpgol_unlock (&keycache_lock);
-            TRETURN GpgME::Key();
-          }
-        const auto ret = it->second;
-        gpgol_unlock (&keycache_lock);
-
-        TRETURN ret;
+        return m_smime_best_keys;
       }
-    gpgol_lock (&keycache_lock);
-    const auto it = m_smime_key_map.find (mbox);
-
-    if (it == m_smime_key_map.end ())
+    if (&map == &m_pgp_skey_map)
       {
-        gpgol_unlock (&keycache_lock);
-        TRETURN GpgME::Key();
+        return m_pgp_best_skeys;
       }
-    const auto ret = it->second;
-    gpgol_unlock (&keycache_lock);
-
-    TRETURN ret;
+    return m_smime_best_skeys;
   }
 
-  GpgME::Key getSKey (const char *addr, GpgME::Protocol proto)
+  /* Store KEY as the best key for MBOX in the index of MAP.  The
+     flags are computed here so that a lookup only has to test them.
+     Called with the keycache_lock held whenever MAP is changed.  */
+  void indexKey (const std::unordered_map<std::string, GpgME::Key> &map,
+                 const std::string &mbox, const GpgME::Key &key)
   {
-    TSTART;
-    if (!addr)
-      {
-        TRETURN GpgME::Key();
-      }
-    auto mbox = GpgME::UserID::addrSpecFromString (addr);
-
-    if (proto == GpgME::OpenPGP)
-      {
-        gpgol_lock (&keycache_lock);
-        const auto it = m_pgp_skey_map.find (mbox);
-
-        if (it == m_pgp_skey_map.end ())
-          {
-            gpgol_unlock (&keycache_lock);
-            TRETURN GpgME::Key();
-          }
-        const auto ret = it->second;
-        gpgol_unlock (&keycache_lock);
-
-        TRETURN ret;
-      }
-    gpgol_lock (&keycache_lock);
-    const auto it = m_smime_skey_map.find (mbox);
+    const bool secret = &map == &m_pgp_skey_map || &map == &m_smime_skey_map;
 
-    if (it == m_smime_skey_map.end ())
-      {
-        gpgol_unlock (&keycache_lock);
-        TRETURN GpgME::Key();
-      }
-    const auto ret = it->second;
-    gpgol_unlock (&keycache_lock);
+    bestKeysFor (map).set (mbox, key, secret);
+  }
 
-    TRETURN ret;
+  /* Look up the best key for MBOX in PROTO.  Returns false if there
+     is none.  */
+  bool getBestKey (const std::string &mbox, GpgME::Protocol proto,
+                   bool secret, best_key_s *r_best) const
+  {
+    const auto &index = (secret ?
+                         (proto == GpgME::OpenPGP ? m_pgp_best_skeys
+                                                  : m_smime_best_skeys) :
+                         (proto == GpgME::OpenPGP ? m_pgp_best_keys
+                                                  : m_smime_best_keys));
+    keycache_lock.lockShared ();
+    const bool ret = index.find (mbox, r_best);
+    keycache_lock.unlockShared ();
+    return ret;
   }
 
   GpgME::Key getSigningKey (const char *addr, GpgME::Protocol proto)
   {
     TSTART;
-    const auto key = getSKey (addr, proto);
-    if (key.isNull())
+    if (!addr)
       {
-        log_debug ("%s:%s: secret key for %s is null",
-                   SRCNAME, __func__, anonstr (addr));
-        TRETURN key;
+        TRETURN GpgME::Key();
       }
-    if (!key.canSign())
+    const auto mbox = GpgME::UserID::addrSpecFromString (addr);
+    best_key_s best;
+    if (!getBestKey (mbox, proto, true, &best))
       {
-        log_debug ("%s:%s: Discarding key for %s because it can't sign",
-                   SRCNAME, __func__, anonstr (addr));
-        TRETURN GpgME::Key();
+        best.key = getSKeyFromSnapshot (addr, proto);
+        best.flags = best_key_flags (best.key, mbox, true);
       }
-    if (!key.hasSecret())
+    const auto &key = best.key;
+    if (key.isNull())
       {
-        log_debug ("%s:%s: Discarding key for %s because it has no secret",
+        log_debug ("%s:%s: secret key for %s is null",
                    SRCNAME, __func__, anonstr (addr));
-        TRETURN GpgME::Key();
+        TRETURN key;
       }
-    if (in_de_vs_mode () && !key.isDeVs())
+    switch (check_best_key (best, true, in_de_vs_mode (), false))
       {
-        log_debug ("%s:%s: signing key for %s is not deVS",
-                   SRCNAME, __func__, anonstr (addr));
-        TRETURN GpgME::Key();
+        case BestKeyNotUsable:
+          log_debug ("%s:%s: Discarding key for %s because it %s",
+                     SRCNAME, __func__, anonstr (addr),
+                     key.canSign () ? "has no secret" : "can't sign");
+          TRETURN GpgME::Key();
+        case BestKeyNotDeVs:
+          log_debug ("%s:%s: signing key for %s is not deVS",
+                     SRCNAME, __func__, anonstr (addr));
+          TRETURN GpgME::Key();
+        default:
+          break;
       }
     TRETURN key;
   }
@@ -858,62 +982,41 @@ public:
                        SRCNAME, __func__, anonstr (recip.c_str ()));
             continue;
           }
-        const auto key = getKey (recip.c_str (), proto);
-        if (key.isNull())
+        /* The checks of the key were done when it was stored.  */
+        const auto mbox = GpgME::UserID::addrSpecFromString (recip.c_str ());
+        best_key_s best;
+        if (!getBestKey (mbox, proto, false, &best))
           {
             log_debug ("%s:%s: No key for %s in proto %s. no internal encryption",
                        SRCNAME, __func__, anonstr (recip.c_str ()),
                        to_cstr (proto));
             TRETURN std::vector<GpgME::Key>();
           }
+        const auto &key = best.key;
 
-        if (!key.canEncrypt() || key.isRevoked() ||
-            key.isExpired() || key.isDisabled() || key.isInvalid())
-          {
-            log_data ("%s:%s: Invalid [%s%s%s%s%s] key for %s, FPR %s. no internal encryption",
-                       SRCNAME, __func__, key.canEncrypt()?"E":".", key.isRevoked()?"R":".",
-                        key.isExpired()?"X":".", key.isDisabled()?"D":".",
-                        key.isInvalid()?"I":".", anonstr (recip.c_str ()), key.primaryFingerprint());
-            TRETURN std::vector<GpgME::Key>();
-          }
-
-        if (in_de_vs_mode () && !key.isDeVs ())
-          {
-            log_data ("%s:%s: key for %s is not deVS",
-                      SRCNAME, __func__, anonstr (recip.c_str ()));
-            TRETURN std::vector<GpgME::Key>();
-          }
-
-        bool validEnough = false;
-        /* Here we do the check if the key is valid for this recipient */
-        const auto addrSpec = GpgME::UserID::addrSpecFromString (recip.c_str ());
-        for (const auto &uid: key.userIDs ())
+        switch (check_best_key (best, false, in_de_vs_mode (),
+                                opt.auto_unstrusted))
           {
-            if (addrSpec != uid.addrSpec())
-              {
-                // Ignore unmatching addr specs
-                continue;
-              }
-            if (uid.validity() >= GpgME::UserID::Marginal ||
-                uid.origin() == GpgME::Key::OriginWKD)
-              {
-                validEnough = true;
-                break;
-              }
-            if (opt.auto_unstrusted &&
-                uid.validity() == GpgME::UserID::Unknown)
-              {
-                log_debug ("%s:%s: Passing unknown trust key for %s because of option",
-                           SRCNAME, __func__, anonstr (recip.c_str ()));
-                validEnough = true;
-                break;
-              }
-          }
-        if (!validEnough)
-          {
-            log_debug ("%s:%s: UID for %s does not have at least marginal trust",
-                       SRCNAME, __func__, anonstr (recip.c_str ()));
-            TRETURN std::vector<GpgME::Key>();
+            case BestKeyNotUsable:
+              log_data ("%s:%s: Invalid [%s%s%s%s%s] key for %s, FPR %s. no internal encryption",
+                         SRCNAME, __func__, key.canEncrypt()?"E":".", key.isRevoked()?"R":".",
+                          key.isExpired()?"X":".", key.isDisabled()?"D":".",
+                          key.isInvalid()?"I":".", anonstr (recip.c_str ()), key.primaryFingerprint());
+              TRETURN std::vector<GpgME::Key>();
+            case BestKeyNotDeVs:
+              log_data ("%s:%s: key for %s is not deVS",
+                        SRCNAME, __func__, anonstr (recip.c_str ()));
+              TRETURN std::vector<GpgME::Key>();
+            case BestKeyNotValid:
+              log_debug ("%s:%s: UID for %s does not have at least marginal trust",
+                         SRCNAME, __func__, anonstr (recip.c_str ()));
+              TRETURN std::vector<GpgME::Key>();
+            case BestKeyOkUnknown:
+              log_debug ("%s:%s: Passing unknown trust key for %s because of option",
+                         SRCNAME, __func__, anonstr (recip.c_str ()));
+              break;
+            case BestKeyOk:
+              break;
           }
         // Accepting key
         ret.push_back (key);
@@ -921,19 +1024,21 @@ public:
     TRETURN ret;
   }
 
-  void insertOrUpdateInFprMap (const GpgME::Key &key)
+  /* Insert or update KEY in the fingerprint maps.  The pairs of mail
+     address and key which should be used as secret keys are added
+     to SKEYS.  The maps are passed so that the populate thread can
+     fill its own maps without holding the lock.  */
+  static void
+  updateFprMaps (FprTable<GpgME::Key> &fpr_map,
+                 FprTable<BinFpr> &sub_fpr_map,
+                 std::vector<GpgME::Key> &ultimate_keys,
+                 const GpgME::Key &key,
+                 std::vector<std::pair<std::string, GpgME::Key> > *skeys)
     {
       TSTART;
-      if (key.isNull() || !key.primaryFingerprint())
-        {
-          TRACEPOINT;
-          TRETURN;
-        }
-      gpgol_lock (&fpr_map_lock);
-
       /* First ensure that we have the subkeys mapped to the primary
          fpr */
-      const char *primaryFpr = key.primaryFingerprint ();
+      const BinFpr primaryFpr (key.primaryFingerprint ());
 
 #if 0
         {
@@ -944,28 +1049,18 @@ public:
         }
 #endif
 
-      for (const auto &sub: key.subkeys())
+      if (primaryFpr.isNull ())
         {
-          const char *subFpr = sub.fingerprint();
-          auto it = m_sub_fpr_map.find (subFpr);
-          if (it == m_sub_fpr_map.end ())
-            {
-              m_sub_fpr_map.insert (std::make_pair(
-                                     std::string (subFpr),
-                                     std::string (primaryFpr)));
-            }
+          STRANGEPOINT;
+          TRETURN;
         }
-
-      auto it = m_fpr_map.find (primaryFpr);
-
-      if (it == m_fpr_map.end ())
+      for (const auto &sub: key.subkeys())
         {
-          m_fpr_map.insert (std::make_pair (primaryFpr, key));
-
-          gpgol_unlock (&fpr_map_lock);
-          TRETURN;
+          sub_fpr_map.insert (BinFpr (sub.fingerprint ()), primaryFpr);
         }
 
+      auto it = fpr_map.find (primaryFpr);
+
       for (const auto &uid: key.userIDs())
         {
           if (key.isBad() || uid.isBad())
@@ -983,47 +1078,96 @@ public:
                   continue;
                 }
               TRACEPOINT;
-              m_ultimate_keys.erase (std::remove_if (m_ultimate_keys.begin(),
-                                     m_ultimate_keys.end(),
+              ultimate_keys.erase (std::remove_if (ultimate_keys.begin(),
+                                   ultimate_keys.end(),
                                      [fpr] (const GpgME::Key &ult)
                 {
                   return ult.primaryFingerprint() && !strcmp (fpr, ult.primaryFingerprint());
-                }), m_ultimate_keys.end());
+                }), ultimate_keys.end());
               TRACEPOINT;
-              m_ultimate_keys.push_back (key);
+              ultimate_keys.push_back (key);
             }
 
           /* Update skey maps */
           if (key.hasSecret ())
             {
-              if (key.protocol () == GpgME::OpenPGP)
-                {
-                  setPgpKeySecret (uid.addrSpec(), key, false);
-                }
-              else if (key.protocol () == GpgME::CMS)
-                {
-                  setSmimeKeySecret (uid.addrSpec(), key, false);
-                }
-              else
-                {
-                  STRANGEPOINT;
-                }
+              skeys->push_back (std::make_pair (uid.addrSpec(), key));
             }
         }
 
-      if (it->second.hasSecret () && !key.hasSecret())
+      if (!it)
+        {
+          fpr_map.insert (primaryFpr, key);
+        }
+      else if (it->hasSecret () && !key.hasSecret())
         {
           log_debug ("%s:%s Lost secret info on update. Merging.",
                      SRCNAME, __func__);
           auto merged = key;
-          merged.mergeWith (it->second);
-          it->second = merged;
+          merged.mergeWith (*it);
+          *it = merged;
         }
       else
         {
-          it->second = key;
+          *it = key;
+        }
+      TRETURN;
+    }
+
+  void insertOrUpdateInFprMap (const GpgME::Key &key)
+    {
+      TSTART;
+      if (key.isNull() || !key.primaryFingerprint())
+        {
+          TRACEPOINT;
+          TRETURN;
+        }
+      /* The secret key maps are updated after the fpr_map_lock is
+         released.  */
+      std::vector<std::pair<std::string, GpgME::Key> > skeys;
+      fpr_map_lock.lock ();
+      updateFprMaps (m_fpr_map, m_sub_fpr_map, m_ultimate_keys, key, &skeys);
+      fpr_map_lock.unlock ();
+      setSecretKeys (skeys);
+      TRETURN;
+    }
+
+  /* Insert the KEYS of a full keylisting in the order in which they
+     were listed.  The maps are built without a lock and then swapped
+     in at once.  */
+  void insertKeys (const std::vector<GpgME::Key> &keys)
+    {
+      TSTART;
+      FprTable<GpgME::Key> fpr_map;
+      FprTable<BinFpr> sub_fpr_map;
+      std::vector<GpgME::Key> ultimate_keys;
+      std::vector<std::pair<std::string, GpgME::Key> > skeys;
+
+      fpr_map.reserve (keys.size ());
+      sub_fpr_map.reserve (keys.size () * 2);
+      for (const auto &key: keys)
+        {
+          if (key.isNull() || !key.primaryFingerprint())
+            {
+              continue;
+            }
+          updateFprMaps (fpr_map, sub_fpr_map, ultimate_keys, key, &skeys);
+        }
+
+      fpr_map_lock.lock ();
+      /* Keys which were updated during the keylisting are newer than
+         the listed ones.  */
+      for (const auto &pair: m_fpr_map)
+        {
+          updateFprMaps (fpr_map, sub_fpr_map, ultimate_keys, pair.second,
+                         &skeys);
         }
-      gpgol_unlock (&fpr_map_lock);
+      m_fpr_map.swap (fpr_map);
+      m_sub_fpr_map.swap (sub_fpr_map);
+      std::swap (m_ultimate_keys, ultimate_keys);
+      fpr_map_lock.unlock ();
+
+      setSecretKeys (skeys);
       TRETURN;
     }
 
@@ -1036,29 +1180,28 @@ public:
         TRETURN GpgME::Key();
       }
 
-    gpgol_lock (&fpr_map_lock);
-    std::string primaryFpr;
-    const auto it = m_sub_fpr_map.find (fpr);
-    if (it != m_sub_fpr_map.end ())
-      {
-        log_debug ("%s:%s using \"%s\" for \"%s\"",
-                   SRCNAME, __func__, anonstr (it->second.c_str()),
-                   anonstr (fpr));
-        primaryFpr = it->second;
-      }
-    else
+    BinFpr primaryFpr (fpr);
+    fpr_map_lock.lockShared ();
+    const auto sub = m_sub_fpr_map.find (primaryFpr);
+    if (sub)
       {
-        primaryFpr = fpr;
+        if (*sub != primaryFpr)
+          {
+            log_debug ("%s:%s using \"%s\" for \"%s\"",
+                       SRCNAME, __func__, anonstr (sub->toString ().c_str()),
+                       anonstr (fpr));
+          }
+        primaryFpr = *sub;
       }
 
-    const auto keyIt = m_fpr_map.find (primaryFpr);
-    if (keyIt != m_fpr_map.end ())
+    const auto key = m_fpr_map.find (primaryFpr);
+    if (key)
       {
-        const auto ret = keyIt->second;
-        gpgol_unlock (&fpr_map_lock);
+        const auto ret = *key;
+        fpr_map_lock.unlockShared ();
         TRETURN ret;
       }
-    gpgol_unlock (&fpr_map_lock);
+    fpr_map_lock.unlockShared ();
     TRETURN GpgME::Key();
   }
 
@@ -1080,30 +1223,19 @@ public:
           if (block)
             {
               const std::string sFpr (fpr);
-              int i = 0;
 
-              gpgol_lock (&update_lock);
-              while (m_update_jobs.find(sFpr) != m_update_jobs.end ())
+              if (m_update_jobs.contains (sFpr))
                 {
-                  i++;
-                  if (i % 100 == 0)
-                    {
-                      log_debug ("%s:%s Waiting on update for \"%s\"",
-                                 SRCNAME, __func__, anonstr (fpr));
-                    }
-                  gpgol_unlock (&update_lock);
-                  Sleep (10);
-                  gpgol_lock (&update_lock);
-                  if (i == 3000)
+                  log_debug ("%s:%s Waiting on update for \"%s\"",
+                             SRCNAME, __func__, anonstr (fpr));
+                  if (!m_update_jobs.wait (sFpr, UPDATE_WAIT_TIMEOUT))
                     {
                       /* Just to be on the save side */
                       log_error ("%s:%s Waiting on update for \"%s\" "
                                  "failed! Bug!",
                                  SRCNAME, __func__, anonstr (fpr));
-                      break;
                     }
                 }
-              gpgol_unlock (&update_lock);
 
               TRACEPOINT;
               const auto ret2 = getFromMap (fpr);
@@ -1119,6 +1251,11 @@ public:
                   TRETURN ret2;
                 }
             }
+          const auto ret3 = getFromSnapshot (fpr);
+          if (!ret3.isNull ())
+            {
+              TRETURN ret3;
+            }
           log_debug ("%s:%s Cache miss for %s.",
                      SRCNAME, __func__, anonstr (fpr));
           TRETURN GpgME::Key();
@@ -1137,22 +1274,20 @@ public:
            TRETURN;
          }
        const std::string sFpr (fpr);
-       gpgol_lock (&update_lock);
-       if (m_update_jobs.find(sFpr) != m_update_jobs.end ())
+       bool added = m_update_jobs.add (sFpr);
+       if (!added)
          {
            log_debug ("%s:%s Update for \"%s\" already in progress.",
                       SRCNAME, __func__, anonstr (fpr));
-           gpgol_unlock (&update_lock);
          }
-
-       m_update_jobs.insert (sFpr);
-       gpgol_unlock (&update_lock);
-       update_arg_t * args = new update_arg_t;
-       args->first = sFpr;
-       args->second = proto;
-       CloseHandle (CreateThread (NULL, 0, do_update,
-                                  (LPVOID) args, 0,
-                                  NULL));
+       const auto res = KeyJobQueue::instance ()->submit
+         (std::string ("update:") + sFpr,
+          [sFpr, proto] () { do_update (sFpr, proto); });
+       if (res != KeyJobQueue::Submitted && added)
+         {
+           /* Do not let getByFpr wait for a job which never runs.  */
+           m_update_jobs.remove (sFpr);
+         }
        TRETURN;
      }
 
@@ -1165,16 +1300,8 @@ public:
         }
       TRACEPOINT;
       insertOrUpdateInFprMap (key);
-      gpgol_lock (&update_lock);
-      const auto it = m_update_jobs.find(fpr);
-
-      if (it == m_update_jobs.end())
-        {
-          gpgol_unlock (&update_lock);
-          TRETURN;
-        }
-      m_update_jobs.erase (it);
-      gpgol_unlock (&update_lock);
+      /* Wakes up the threads waiting in getByFpr.  */
+      m_update_jobs.remove (fpr);
       TRACEPOINT;
       TRETURN;
     }
@@ -1195,25 +1322,23 @@ public:
         {
           TRETURN;
         }
-      gpgol_lock (&import_lock);
       auto job_set = (proto == GpgME::OpenPGP ?
                        &m_pgp_import_jobs : &m_cms_import_jobs);
-      if (job_set->find (mbox) != job_set->end ())
+      if (!job_set->add (mbox))
         {
           log_debug ("%s:%s import for \"%s\" %s already in progress.",
                      SRCNAME, __func__, anonstr (mbox.c_str ()),
                      to_cstr (proto));
-          gpgol_unlock (&import_lock);
         }
-      job_set->insert (mbox);
-      gpgol_unlock (&import_lock);
 
-      import_arg_t * args = new import_arg_t;
-      args->first = std::unique_ptr<LocateArgs> (new LocateArgs (mbox, mail));
-      args->second = sdata;
-      CloseHandle (CreateThread (NULL, 0, do_import,
-                                 (LPVOID) args, 0,
-                                 NULL));
+      const auto args = std::make_shared<LocateArgs> (mbox, mail);
+      const auto res = KeyJobQueue::instance ()->submit
+        (std::string ("import:") + to_cstr (proto) + ":" + mbox,
+         [args, sdata] () { do_import (*args, sdata); });
+      if (res == KeyJobQueue::Rejected)
+        {
+          job_set->remove (mbox);
+        }
 
       TRETURN;
     }
@@ -1223,7 +1348,7 @@ public:
                                 GpgME::Protocol proto)
     {
       TSTART;
-      gpgol_lock (&keycache_lock);
+      keycache_lock.lock ();
       auto override_map = (proto == GpgME::OpenPGP ?
                            &m_pgp_overrides : &m_cms_overrides);
       auto job_set = (proto == GpgME::OpenPGP ?
@@ -1238,41 +1363,401 @@ public:
         {
           override_map->insert (std::make_pair (mbox, result_fprs));
         }
-      gpgol_unlock (&keycache_lock);
-      gpgol_lock (&import_lock);
-      const auto job_it = job_set->find(mbox);
-
-      if (job_it == job_set->end())
+      keycache_lock.unlock ();
+      /* Wakes up the threads waiting in getOverrides.  */
+      if (!job_set->remove (mbox))
         {
           log_error ("%s:%s import for \"%s\" %s already finished.",
                      SRCNAME, __func__, anonstr (mbox.c_str ()),
                      to_cstr (proto));
-          gpgol_unlock (&import_lock);
-          TRETURN;
         }
-      job_set->erase (job_it);
-      gpgol_unlock (&import_lock);
       TRETURN;
     }
 
 
 
-  void populate ()
+  /* List the key FPR of PROTO.  */
+  static GpgME::Key listKey (const char *fpr, GpgME::Protocol proto,
+                             bool secret)
     {
       TSTART;
-      gpgrt_lock_lock (&keycache_lock);
-      m_ultimate_keys.clear ();
-      gpgrt_lock_unlock (&keycache_lock);
-      CloseHandle (CreateThread (nullptr, 0, do_populate,
-                                 nullptr, 0,
-                                 nullptr));
-      TRETURN;
+      auto ctx = std::unique_ptr<GpgME::Context>
+        (GpgME::Context::createForProtocol (proto));
+      if (!ctx)
+        {
+          TRACEPOINT;
+          TRETURN GpgME::Key();
+        }
+      ctx->setKeyListMode (GpgME::KeyListMode::Local |
+                           GpgME::KeyListMode::Validate);
+      ctx->setOffline (true);
+      GpgME::Error err;
+      const auto key = ctx->key (fpr, err, secret);
+      if (err)
+        {
+          log_debug ("%s:%s Failed to list key %s err: %s",
+                     SRCNAME, __func__, anonstr (fpr),
+                     err.asStdString().c_str());
+          TRETURN GpgME::Key();
+        }
+      TRETURN key;
     }
 
-  const std::vector<GpgME::Configuration::Component> get_cached_config () const
+  /* Until the cache is populated the snapshot is used to find the
+     secret keys for ADDR.  The keys are listed again so that only
+     their current state is used.  */
+  GpgME::Key getSKeyFromSnapshot (const char *addr, GpgME::Protocol proto)
     {
-      /* Quick hack to ensure that the config is loaded. */
-      gpgrt_lock_lock (&config_lock);
+      TSTART;
+      if (!addr || m_is_populated)
+        {
+          TRETURN GpgME::Key();
+        }
+      const auto mbox = GpgME::UserID::addrSpecFromString (addr);
+
+      keycache_lock.lockShared ();
+      const auto fprs = m_snapshot.secretKeys (mbox, proto);
+      keycache_lock.unlockShared ();
+
+      GpgME::Key ret;
+      for (const auto &fpr: fprs)
+        {
+          const auto key = listKey (fpr.c_str (), proto, true);
+          if (!key.isNull ())
+            {
+              ret = compareSkeys (ret, key);
+            }
+        }
+      if (ret.isNull ())
+        {
+          TRETURN ret;
+        }
+      log_debug ("%s:%s: Using secret key %s for %s from the snapshot.",
+                 SRCNAME, __func__, anonstr (ret.primaryFingerprint ()),
+                 anonstr (addr));
+      keycache_lock.lock ();
+      updateSkeyMap (proto == GpgME::OpenPGP ? m_pgp_skey_map
+                                             : m_smime_skey_map,
+                     mbox, ret);
+      keycache_lock.unlock ();
+      insertOrUpdateInFprMap (ret);
+      TRETURN ret;
+    }
+
+  /* Until the cache is populated look up FPR if the snapshot has it.  */
+  GpgME::Key getFromSnapshot (const char *fpr) const
+    {
+      TSTART;
+      if (m_is_populated)
+        {
+          TRETURN GpgME::Key();
+        }
+      keycache_lock.lockShared ();
+      const auto entry = m_snapshot.find (fpr);
+      const auto proto = entry ? (GpgME::Protocol) entry->protocol
+                               : GpgME::UnknownProtocol;
+      keycache_lock.unlockShared ();
+      if (proto == GpgME::UnknownProtocol)
+        {
+          TRETURN GpgME::Key();
+        }
+      const auto key = listKey (fpr, proto, false);
+      if (!key.isNull ())
+        {
+          log_debug ("%s:%s: Listed %s from the snapshot.",
+                     SRCNAME, __func__, anonstr (fpr));
+        }
+      TRETURN key;
+    }
+
+  void loadSnapshot (const std::string &homedir, const std::string &stamp)
+    {
+      TSTART;
+      KeySnapshot snapshot;
+
+      if (!snapshot.load (homedir + "/" KEYSNAPSHOT_NAME, stamp))
+        {
+          log_debug ("%s:%s: No usable snapshot.",
+                     SRCNAME, __func__);
+          TRETURN;
+        }
+      log_debug ("%s:%s: Using snapshot with %u keys.",
+                 SRCNAME, __func__, (unsigned int) snapshot.size ());
+      keycache_lock.lock ();
+      std::swap (m_snapshot, snapshot);
+      m_snapshot_homedir = homedir;
+      m_snapshot_stamp = stamp;
+      keycache_lock.unlock ();
+      TRETURN;
+    }
+
+  /* Write a snapshot of the populated cache.  STAMP is the stamp of
+     the keyring from before the listing.  */
+  void saveSnapshot (const std::string &homedir, const std::string &stamp)
+    {
+      TSTART;
+      KeySnapshot snapshot;
+
+      fpr_map_lock.lockShared ();
+      for (const auto &pair: m_fpr_map)
+        {
+          const auto &key = pair.second;
+          unsigned int flags = 0;
+          int validity = 0;
+          std::vector<std::string> mboxes;
+
+          if (key.hasSecret ())
+            {
+              flags |= KeySnapshot::FlagSecret;
+            }
+          if (key.canEncrypt ())
+            {
+              flags |= KeySnapshot::FlagCanEncrypt;
+            }
+          if (key.canSign ())
+            {
+              flags |= KeySnapshot::FlagCanSign;
+            }
+          if (key.isBad ())
+            {
+              flags |= KeySnapshot::FlagBad;
+            }
+          for (const auto &uid: key.userIDs ())
+            {
+              if (uid.validity () > validity)
+                {
+                  validity = uid.validity ();
+                }
+              /* Only the secret keys are looked up by mail address.  */
+              if (key.hasSecret () && !uid.isBad () && uid.addrSpec ().size ())
+                {
+                  mboxes.push_back (uid.addrSpec ());
+                }
+            }
+          snapshot.add (pair.first, key.protocol (), flags, validity,
+                        mboxes);
+        }
+      fpr_map_lock.unlockShared ();
+
+      if (snapshot.save (homedir + "/" KEYSNAPSHOT_NAME, stamp))
+        {
+          log_debug ("%s:%s: Saved snapshot with %u keys.",
+                     SRCNAME, __func__, (unsigned int) snapshot.size ());
+        }
+
+      /* The populated cache replaces the old snapshot.  */
+      keycache_lock.lock ();
+      m_snapshot.clear ();
+      keycache_lock.unlock ();
+      TRETURN;
+    }
+
+  /* Check if a snapshot is loaded and the keyring has not changed
+     since.  */
+  bool hasSnapshot () const
+    {
+      TSTART;
+      keycache_lock.lockShared ();
+      bool ret = !m_snapshot.empty ();
+      const auto homedir = m_snapshot_homedir;
+      const auto stamp = m_snapshot_stamp;
+      keycache_lock.unlockShared ();
+
+      TRETURN ret && KeySnapshot::keyringStamp (homedir) == stamp;
+    }
+
+  void startKeyringWatcher (const std::string &homedir)
+    {
+      TSTART;
+      if (!m_watcher.isRunning ())
+        {
+          m_watcher.start (homedir, [this] () { refreshChangedKeys (); });
+        }
+      TRETURN;
+    }
+
+  /* Update the key of MAP for MBOX if it is KEY.  A bad key is removed
+     so that the mail address is located again.  Called with the
+     keycache_lock held.  */
+  void
+  patchKeyMap (std::unordered_map<std::string, GpgME::Key> &map,
+               const GpgME::Key &key)
+    {
+      for (auto it = map.begin (); it != map.end ();)
+        {
+          if (it->second.isNull () || !it->second.primaryFingerprint ()
+              || strcmp (it->second.primaryFingerprint (),
+                         key.primaryFingerprint ()))
+            {
+              ++it;
+            }
+          else if (key.isBad () || !key.canEncrypt ())
+            {
+              bestKeysFor (map).erase (it->first);
+              it = map.erase (it);
+            }
+          else
+            {
+              it->second = key;
+              indexKey (map, it->first, key);
+              ++it;
+            }
+        }
+    }
+
+  /* Update the mail address maps for the changed KEY.  */
+  void patchMboxMaps (const GpgME::Key &key)
+    {
+      TSTART;
+      auto &key_map = key.protocol () == GpgME::OpenPGP ? m_pgp_key_map
+                                                        : m_smime_key_map;
+      keycache_lock.lock ();
+      patchKeyMap (key_map, key);
+      /* The addresses for which no key was found are located again.
+         The locate decides whether the new key is the best one.  */
+      for (const auto &uid: key.userIDs ())
+        {
+          const auto it = m_pgp_key_map.find (uid.addrSpec ());
+          if (it != m_pgp_key_map.end () && it->second.isNull ())
+            {
+              m_pgp_key_map.erase (it);
+              s_negative_cache.expire (uid.addrSpec (), key.protocol ());
+            }
+        }
+      keycache_lock.unlock ();
+      TRETURN;
+    }
+
+  /* Remove the key FPR which was deleted from the keyring.  */
+  void removeKey (const std::string &fpr)
+    {
+      TSTART;
+      const auto match = [&fpr] (const GpgME::Key &k)
+        {
+          return k.primaryFingerprint () && fpr == k.primaryFingerprint ();
+        };
+
+      const BinFpr binFpr (fpr);
+      fpr_map_lock.lock ();
+      m_fpr_map.erase (binFpr);
+      m_sub_fpr_map.eraseIf ([&binFpr] (const BinFpr &, const BinFpr &primary)
+        {
+          return primary == binFpr;
+        });
+      m_ultimate_keys.erase (std::remove_if (m_ultimate_keys.begin (),
+                                             m_ultimate_keys.end (), match),
+                             m_ultimate_keys.end ());
+      fpr_map_lock.unlock ();
+
+      keycache_lock.lock ();
+      for (auto map: {&m_pgp_key_map, &m_smime_key_map,
+                      &m_pgp_skey_map, &m_smime_skey_map})
+        {
+          auto &index = bestKeysFor (*map);
+          for (auto it = map->begin (); it != map->end ();)
+            {
+              if (!match (it->second))
+                {
+                  ++it;
+                  continue;
+                }
+              index.erase (it->first);
+              it = map->erase (it);
+            }
+        }
+      keycache_lock.unlock ();
+      TRETURN;
+    }
+
+  /* Called by the keyring watcher when the keyring changed.  The keys
+     are listed again and only the keys which were added, changed or
+     deleted are updated in the cache.  */
+  void refreshChangedKeys ()
+    {
+      TSTART;
+      if (!m_is_populated)
+        {
+          log_debug ("%s:%s: Not yet populated.", SRCNAME, __func__);
+          TRETURN;
+        }
+      ULONGLONG start = GetTickCount64 ();
+      std::vector<GpgME::Key> changed;
+      std::vector<std::string> removed;
+      int n_keys = 0;
+
+      for (const auto proto: {GpgME::OpenPGP, GpgME::CMS})
+        {
+          std::vector<GpgME::Key> keys;
+          bool complete = do_populate_protocol (proto, false, &keys,
+                                                GpgME::KeyListMode::WithSecret);
+          FprTable<bool> listed;
+
+          n_keys += (int) keys.size ();
+          fpr_map_lock.lockShared ();
+          for (const auto &key: keys)
+            {
+              if (!key.primaryFingerprint ())
+                {
+                  continue;
+                }
+              const BinFpr fpr (key.primaryFingerprint ());
+              listed.insert (fpr, true);
+              const auto cached = m_fpr_map.find (fpr);
+              if (!cached || key_digest (*cached) != key_digest (key))
+                {
+                  changed.push_back (key);
+                }
+            }
+          /* Without a complete listing we can't tell what was
+             deleted.  */
+          for (const auto &pair: m_fpr_map)
+            {
+              if (complete && pair.second.protocol () == proto
+                  && !listed.find (pair.first))
+                {
+                  removed.push_back (pair.first.toString ());
+                }
+            }
+          fpr_map_lock.unlockShared ();
+        }
+
+      for (const auto &key: changed)
+        {
+          log_debug ("%s:%s: Updating %s",
+                     SRCNAME, __func__, anonstr (key.primaryFingerprint ()));
+          insertOrUpdateInFprMap (key);
+          patchMboxMaps (key);
+        }
+      for (const auto &fpr: removed)
+        {
+          log_debug ("%s:%s: Removing %s",
+                     SRCNAME, __func__, anonstr (fpr.c_str ()));
+          removeKey (fpr);
+        }
+      log_debug ("%s:%s: Compared %i keys in %u ms. %u changed, %u removed.",
+                 SRCNAME, __func__, n_keys,
+                 (unsigned int) (GetTickCount64 () - start),
+                 (unsigned int) changed.size (),
+                 (unsigned int) removed.size ());
+      TRETURN;
+    }
+
+  void populate ()
+    {
+      TSTART;
+      fpr_map_lock.lock ();
+      m_ultimate_keys.clear ();
+      fpr_map_lock.unlock ();
+      CloseHandle (CreateThread (nullptr, 0, do_populate,
+                                 nullptr, 0,
+                                 nullptr));
+      TRETURN;
+    }
+
+  const std::vector<GpgME::Configuration::Component> get_cached_config () const
+    {
+      /* Quick hack to ensure that the config is loaded. */
+      gpgrt_lock_lock (&config_lock);
       gpgrt_lock_unlock (&config_lock);
       return m_cached_config;
     }
@@ -1286,17 +1771,26 @@ public:
   std::unordered_map<std::string, GpgME::Key> m_smime_key_map;
   std::unordered_map<std::string, GpgME::Key> m_pgp_skey_map;
   std::unordered_map<std::string, GpgME::Key> m_smime_skey_map;
-  std::unordered_map<std::string, GpgME::Key> m_fpr_map;
-  std::unordered_map<std::string, std::string> m_sub_fpr_map;
+  /* The best keys for the mail addresses of the four maps above.  */
+  BestKeyIndex m_pgp_best_keys;
+  BestKeyIndex m_smime_best_keys;
+  BestKeyIndex m_pgp_best_skeys;
+  BestKeyIndex m_smime_best_skeys;
+  FprTable<GpgME::Key> m_fpr_map;
+  FprTable<BinFpr> m_sub_fpr_map;
   std::unordered_map<std::string, std::vector<std::string> >
     m_pgp_overrides;
   std::unordered_map<std::string, std::vector<std::string> >
     m_cms_overrides;
   std::vector<GpgME::Key> m_ultimate_keys;
-  std::set<std::string> m_update_jobs;
-  std::set<std::string> m_pgp_import_jobs;
-  std::set<std::string> m_cms_import_jobs;
+  PendingSet m_update_jobs;
+  PendingSet m_pgp_import_jobs;
+  PendingSet m_cms_import_jobs;
   std::vector<GpgME::Configuration::Component> m_cached_config;
+  KeySnapshot m_snapshot;
+  KeyringWatcher m_watcher;
+  std::string m_snapshot_homedir;
+  std::string m_snapshot_stamp;
   bool m_use_tofu;
   bool m_is_populated;
 };
@@ -1439,34 +1933,12 @@ get_extern_smime_keys (const std::string &addr, bool import)
   TRETURN keys;
 }
 
-static DWORD WINAPI
-do_locate (LPVOID arg)
+/* Locate the S/MIME key for ADDR.  K is the OpenPGP key which was
+   found for ADDR.  */
+static void
+locate_smime (const std::string &addr, const GpgME::Key &k)
 {
   TSTART;
-  if (!arg)
-    {
-      TRETURN 0;
-    }
-
-  auto args = std::unique_ptr<LocateArgs> ((LocateArgs *) arg);
-
-  const auto addr = args->m_mbox;
-
-  log_debug ("%s:%s searching key for addr: \"%s\"",
-             SRCNAME, __func__, anonstr (addr.c_str()));
-
-  const auto k = GpgME::Key::locate (addr.c_str());
-
-  if (!k.isNull ())
-    {
-      log_debug ("%s:%s found key for addr: \"%s\":%s",
-                 SRCNAME, __func__, anonstr (addr.c_str()),
-                 anonstr (k.primaryFingerprint()));
-      KeyCache::instance ()->setPgpKey (addr, k);
-    }
-  log_debug ("%s:%s pgp locate done",
-             SRCNAME, __func__);
-
   if (opt.enable_smime)
     {
       GpgME::Key candidate = get_most_valid_key_simple (
@@ -1477,19 +1949,26 @@ do_locate (LPVOID arg)
                      SRCNAME, __func__, anonstr (addr.c_str()),
                      anonstr (candidate.primaryFingerprint()));
           KeyCache::instance()->setSmimeKey (addr, candidate);
-          TRETURN 0;
+          TRETURN;
         }
       if (!opt.search_smime_servers || (!k.isNull() && !opt.prefer_smime))
         {
           log_debug ("%s:%s Found no S/MIME key locally and external "
                      "search is disabled.", SRCNAME, __func__);
-          TRETURN 0;
+          TRETURN;
+        }
+      if (s_negative_cache.lookup (addr, GpgME::CMS) == NegativeCache::Fresh)
+        {
+          log_debug ("%s:%s: Extern S/MIME search for \"%s\" failed "
+                     "recently.", SRCNAME, __func__, anonstr (addr.c_str ()));
+          TRETURN;
         }
       /* Search for extern keys and import them */
       const auto externs = get_extern_smime_keys (addr, true);
       if (externs.empty())
         {
-          TRETURN 0;
+          s_negative_cache.add (addr, GpgME::CMS);
+          TRETURN;
         }
       /* We found and imported external keys. We need to get them
          locally now to ensure that they are valid etc. */
@@ -1501,15 +1980,178 @@ do_locate (LPVOID arg)
                      SRCNAME, __func__, anonstr (addr.c_str()),
                      anonstr (candidate.primaryFingerprint()));
           KeyCache::instance()->setSmimeKey (addr, candidate);
-          TRETURN 0;
+          TRETURN;
         }
       else
         {
           log_debug ("%s:%s: Found no valid key in extern S/MIME certs",
                      SRCNAME, __func__);
+          s_negative_cache.add (addr, GpgME::CMS);
         }
     }
-  TRETURN 0;
+  TRETURN;
+}
+
+static void
+do_locate (const LocateArgs &args)
+{
+  TSTART;
+  const auto addr = args.m_mbox;
+
+  log_debug ("%s:%s searching key for addr: \"%s\"",
+             SRCNAME, __func__, anonstr (addr.c_str()));
+
+  const auto k = GpgME::Key::locate (addr.c_str());
+
+  if (!k.isNull ())
+    {
+      log_debug ("%s:%s found key for addr: \"%s\":%s",
+                 SRCNAME, __func__, anonstr (addr.c_str()),
+                 anonstr (k.primaryFingerprint()));
+      KeyCache::instance ()->setPgpKey (addr, k);
+    }
+  else
+    {
+      s_negative_cache.add (addr, GpgME::OpenPGP);
+    }
+  log_debug ("%s:%s pgp locate done",
+             SRCNAME, __func__);
+
+  locate_smime (addr, k);
+  TRETURN;
+}
+
+/* Locate the OpenPGP keys for all mail addresses of ARGS with a
+   single gpg --locate-keys.  Like Key::locate the first key gpg
+   returns with a user id for an address is the key for it.  */
+static void
+do_locate_batch (const std::vector<std::shared_ptr<LocateArgs> > &args)
+{
+  TSTART;
+  std::vector<std::string> mboxes;
+  std::unordered_map<std::string, GpgME::Key> found;
+
+  for (const auto &arg: args)
+    {
+      mboxes.push_back (arg->m_mbox);
+      found.insert (std::make_pair (arg->m_mbox, GpgME::Key ()));
+    }
+  log_debug ("%s:%s searching keys for %u addresses",
+             SRCNAME, __func__, (unsigned int) mboxes.size ());
+
+  auto ctx = std::unique_ptr<GpgME::Context> (
+                      GpgME::Context::createForProtocol (GpgME::OpenPGP));
+  if (!ctx)
+    {
+      TRACEPOINT;
+      TRETURN;
+    }
+  /* Local and Extern together are the locate mode.  */
+  ctx->setKeyListMode (GpgME::KeyListMode::Local |
+                       GpgME::KeyListMode::Extern);
+  char **patterns = vector_to_cArray (mboxes);
+  GpgME::Error err = ctx->startKeyListing (
+                                  const_cast<const char **> (patterns));
+  int n_keys = 0;
+  while (!err)
+    {
+      const auto key = ctx->nextKey (err);
+      if (err || key.isNull ())
+        {
+          continue;
+        }
+      n_keys++;
+      for (const auto &uid: key.userIDs ())
+        {
+          const auto it = found.find (uid.addrSpec ());
+          if (it != found.end () && it->second.isNull ())
+            {
+              it->second = key;
+            }
+        }
+    }
+  release_cArray (patterns);
+  if (err && err.code () != GPG_ERR_EOF)
+    {
+      log_debug ("%s:%s keylisting failed: %s",
+                 SRCNAME, __func__, err.asStdString ().c_str ());
+    }
+  log_debug ("%s:%s pgp locate done with %i keys",
+             SRCNAME, __func__, n_keys);
+
+  for (const auto &addr: mboxes)
+    {
+      const auto &k = found[addr];
+      if (!k.isNull ())
+        {
+          log_debug ("%s:%s found key for addr: \"%s\":%s",
+                     SRCNAME, __func__, anonstr (addr.c_str()),
+                     anonstr (k.primaryFingerprint()));
+          KeyCache::instance ()->setPgpKey (addr, k);
+        }
+      else
+        {
+          s_negative_cache.add (addr, GpgME::OpenPGP);
+        }
+      locate_smime (addr, k);
+    }
+  TRETURN;
+}
+
+/* Apply the configured TTL to the negative cache and let its entries
+   expire if the keyring changed.  */
+static void
+update_negative_cache ()
+{
+  s_negative_cache.setTTL (opt.negative_cache_ttl > 0 ?
+                           (unsigned int) opt.negative_cache_ttl : 0);
+  const char *homedir = GpgME::dirInfo ("homedir");
+  if (homedir)
+    {
+      s_negative_cache.checkStamp (KeySnapshot::keyringStamp (homedir));
+    }
+}
+
+/* Check if MBOX was marked as searched in MAP but should be located
+   again because the last locate found nothing and that result
+   expired.  Called with the keycache_lock held.  */
+static bool
+locate_again (const std::unordered_map<std::string, GpgME::Key> &map,
+              const std::string &mbox)
+{
+  const auto it = map.find (mbox);
+
+  return it != map.end () && it->second.isNull ()
+         && s_negative_cache.lookup (mbox, GpgME::OpenPGP)
+            == NegativeCache::Expired;
+}
+
+/* Queue a locate job for the mail addresses of ARGS.  Returns false
+   if the queue is full.  */
+static bool
+submit_locate (const std::vector<std::shared_ptr<LocateArgs> > &args)
+{
+  std::string key = "locate:";
+  std::function<void ()> job;
+
+  for (const auto &arg: args)
+    {
+      if (key.size () > 7)
+        {
+          key += ' ';
+        }
+      key += arg->m_mbox;
+    }
+  if (args.size () == 1)
+    {
+      const auto arg = args[0];
+      job = [arg] () { do_locate (*arg); };
+    }
+  else
+    {
+      job = [args] () { do_locate_batch (args); };
+    }
+  return KeyJobQueue::instance ()->submit (key, job) != KeyJobQueue::Rejected;
 }
 
 static void
@@ -1588,32 +2230,62 @@ locate_secret (const char *addr, GpgME::Protocol proto)
   TRETURN;
 }
 
-static DWORD WINAPI
-do_locate_secret (LPVOID arg)
+static void
+do_locate_secret (const LocateArgs &args)
 {
   TSTART;
-  auto args = std::unique_ptr<LocateArgs> ((LocateArgs *) arg);
-
   log_debug ("%s:%s searching secret key for addr: \"%s\"",
-             SRCNAME, __func__, anonstr (args->m_mbox.c_str ()));
+             SRCNAME, __func__, anonstr (args.m_mbox.c_str ()));
 
-  locate_secret (args->m_mbox.c_str(), GpgME::OpenPGP);
+  locate_secret (args.m_mbox.c_str(), GpgME::OpenPGP);
   if (opt.enable_smime)
     {
-      locate_secret (args->m_mbox.c_str(), GpgME::CMS);
+      locate_secret (args.m_mbox.c_str(), GpgME::CMS);
     }
   log_debug ("%s:%s locator sthread thread done",
              SRCNAME, __func__);
-  TRETURN 0;
+  TRETURN;
 }
 
 void
 KeyCache::startLocate (const std::vector<std::string> &addrs, Mail *mail) const
 {
-  for (const auto &addr: addrs)
+  TSTART;
+  std::vector<std::shared_ptr<LocateArgs> > batch;
+
+  update_negative_cache ();
+  keycache_lock.lock ();
+  for (auto it = addrs.begin (); it != addrs.end (); ++it)
     {
-      startLocate (addr.c_str(), mail);
+      std::string recp = GpgME::UserID::addrSpecFromString (it->c_str ());
+      if (!recp.empty ()
+          && (d->m_pgp_key_map.find (recp) == d->m_pgp_key_map.end ()
+              || locate_again (d->m_pgp_key_map, recp)))
+        {
+          // Mark the key as searched like for a single address.
+          d->m_pgp_key_map.insert (std::pair<std::string, GpgME::Key> (recp, GpgME::Key()));
+          batch.push_back (std::make_shared<LocateArgs> (recp, mail));
+        }
+      if (batch.empty ()
+          || (batch.size () < LOCATE_BATCH_SIZE && it + 1 != addrs.end ()))
+        {
+          continue;
+        }
+      log_debug ("%s:%s Queuing a locator job for %u addresses",
+                 SRCNAME, __func__, (unsigned int) batch.size ());
+      if (!submit_locate (batch))
+        {
+          for (const auto &arg: batch)
+            {
+              d->m_pgp_key_map.erase (arg->m_mbox);
+            }
+        }
+      batch.clear ();
     }
+  keycache_lock.unlock ();
+  KeyJobQueue::instance ()->logStats ();
+  s_negative_cache.logStats ();
+  TRETURN;
 }
 
 void
@@ -1630,21 +2302,23 @@ KeyCache::startLocate (const char *addr, Mail *mail) const
     {
       TRETURN;
     }
-  gpgol_lock (&keycache_lock);
-  if (d->m_pgp_key_map.find (recp) == d->m_pgp_key_map.end ())
+  update_negative_cache ();
+  keycache_lock.lock ();
+  if (d->m_pgp_key_map.find (recp) == d->m_pgp_key_map.end ()
+      || locate_again (d->m_pgp_key_map, recp))
     {
       // It's enough to look at the PGP Key map. We marked
       // searched keys there.
       d->m_pgp_key_map.insert (std::pair<std::string, GpgME::Key> (recp, GpgME::Key()));
-      log_debug ("%s:%s Creating a locator thread",
+      log_debug ("%s:%s Queuing a locator job",
                  SRCNAME, __func__);
-      const auto args = new LocateArgs(recp, mail);
-      HANDLE thread = CreateThread (NULL, 0, do_locate,
-                                    args, 0,
-                                    NULL);
-      CloseHandle (thread);
+      if (!submit_locate ({std::make_shared<LocateArgs> (recp, mail)}))
+        {
+          /* Remove the mark so that the next lookup tries again.  */
+          d->m_pgp_key_map.erase (recp);
+        }
     }
-  gpgol_unlock (&keycache_lock);
+  keycache_lock.unlock ();
   TRETURN;
 }
 
@@ -1662,22 +2336,26 @@ KeyCache::startLocateSecret (const char *addr, Mail *mail) const
     {
       TRETURN;
     }
-  gpgol_lock (&keycache_lock);
+  keycache_lock.lock ();
   if (d->m_pgp_skey_map.find (recp) == d->m_pgp_skey_map.end ())
     {
       // It's enough to look at the PGP Key map. We marked
       // searched keys there.
       d->m_pgp_skey_map.insert (std::pair<std::string, GpgME::Key> (recp, GpgME::Key()));
-      log_debug ("%s:%s Creating a locator thread",
+      log_debug ("%s:%s Queuing a secret key locator job",
                  SRCNAME, __func__);
-      const auto args = new LocateArgs(recp, mail);
-
-      HANDLE thread = CreateThread (NULL, 0, do_locate_secret,
-                                    (LPVOID) args, 0,
-                                    NULL);
-      CloseHandle (thread);
+      const auto args = std::make_shared<LocateArgs> (recp, mail);
+      if (KeyJobQueue::instance ()->submit ("locate-secret:" + recp,
+                                            [args] ()
+                                              {
+                                                do_locate_secret (*args);
+                                              })
+          == KeyJobQueue::Rejected)
+        {
+          d->m_pgp_skey_map.erase (recp);
+        }
     }
-  gpgol_unlock (&keycache_lock);
+  keycache_lock.unlock ();
   TRETURN;
 }
 
@@ -1765,6 +2443,36 @@ KeyCache::onUpdateJobDone (const char *fpr, const GpgME::Key &key)
   return d->onUpdateJobDone (fpr, key);
 }
 
+void
+KeyCache::onPopulateDone (const std::vector<GpgME::Key> &keys)
+{
+  return d->insertKeys (keys);
+}
+
+void
+KeyCache::loadSnapshot (const std::string &homedir, const std::string &stamp)
+{
+  return d->loadSnapshot (homedir, stamp);
+}
+
+void
+KeyCache::saveSnapshot (const std::string &homedir, const std::string &stamp)
+{
+  return d->saveSnapshot (homedir, stamp);
+}
+
+bool
+KeyCache::hasSnapshot () const
+{
+  return d->hasSnapshot ();
+}
+
+void
+KeyCache::startKeyringWatcher (const std::string &homedir)
+{
+  return d->startKeyringWatcher (homedir);
+}
+
 void
 KeyCache::importFromAddrBook (const std::string &mbox, const char *key_data,
                               Mail *mail, GpgME::Protocol proto) const
@@ -1795,9 +2503,9 @@ KeyCache::populate ()
 std::vector<GpgME::Key>
 KeyCache::getUltimateKeys ()
 {
-  gpgrt_lock_lock (&fpr_map_lock);
+  fpr_map_lock.lockShared ();
   const auto ret = d->m_ultimate_keys;
-  gpgrt_lock_unlock (&fpr_map_lock);
+  fpr_map_lock.unlockShared ();
   return ret;
 }
 
@@ -1874,6 +2582,11 @@ KeyCache::import_pgp_key_data (const GpgME::Data &data)
       log_debug ("%s:%s: Import result: %s",
                  SRCNAME, __func__, result.error ().asStdString().c_str());
     }
+  if (result.numImported ())
+    {
+      /* The keys may be for addresses which were not found before.  */
+      s_negative_cache.expireAll ();
+    }
   TRETURN !result.error();
 }
 
@@ -135,6 +135,10 @@ public:
     /* Check if the populate function has finished */
     bool isPopulated ();
 
+    /* Check if lookups can use the snapshot of the keyring from the
+       last run while the populate function is running.  */
+    bool hasSnapshot () const;
+
     /* Get a vector of ultimately trusted keys. */
     std::vector<GpgME::Key> getUltimateKeys ();
 
@@ -158,6 +162,10 @@ public:
     void setSmimeKeySecret(const std::string &mbox, const GpgME::Key &key);
     void setPgpKeySecret(const std::string &mbox, const GpgME::Key &key);
     void onUpdateJobDone(const char *fpr, const GpgME::Key &key);
+    void onPopulateDone(const std::vector<GpgME::Key> &keys);
+    void loadSnapshot(const std::string &homedir, const std::string &stamp);
+    void saveSnapshot(const std::string &homedir, const std::string &stamp);
+    void startKeyringWatcher(const std::string &homedir);
     void onAddrBookImportJobDone (const std::string &fpr,
                                   const std::vector<std::string> &result_fprs,
                                   GpgME::Protocol proto);
@@ -0,0 +1,245 @@
+/* @file keyjobqueue.cpp
+ * @brief Run the key lookups of the KeyCache in a pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "keyjobqueue.h"
+
+#include "common_indep.h"
+#include "workerpool.h"
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# include <time.h>
+#endif
+
+#include <list>
+#include <unordered_set>
+
+namespace
+{
+struct job_s
+{
+  std::string key;
+  std::function<void ()> func;
+  unsigned long long queued;
+};
+}
+
+static KeyJobQueue *singleton = nullptr;
+
+/* A monotonic time in microseconds.  */
+static unsigned long long
+now_usec ()
+{
+#ifdef HAVE_W32_SYSTEM
+  static LARGE_INTEGER freq;
+  LARGE_INTEGER count;
+
+  if (!freq.QuadPart)
+    {
+      QueryPerformanceFrequency (&freq);
+    }
+  QueryPerformanceCounter (&count);
+  return (unsigned long long) (count.QuadPart / freq.QuadPart * 1000000
+                               + count.QuadPart % freq.QuadPart * 1000000
+                                 / freq.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+class KeyJobQueue::Private
+{
+public:
+  Private () :
+    m_pool ("key job", KEYJOB_MAX_WORKERS, [this] () { return take (); }),
+    m_max_queued (KEYJOB_MAX_QUEUED),
+    m_stats ()
+  {
+  }
+
+  /* The workers keep a pointer to us so the queue is never
+     destroyed.  */
+  ~Private () = delete;
+
+  /* Take the next job from the queue.  Called by a worker with the
+     lock held.  */
+  std::function<void ()>
+  take ()
+  {
+    auto job = std::make_shared<job_s> (std::move (m_queue.front ()));
+    m_queue.pop_front ();
+
+    return [this, job] ()
+      {
+        unsigned long long start = now_usec ();
+        job->func ();
+        /* Destroy the job's arguments before it is marked as done.  */
+        job->func = nullptr;
+        unsigned long long end = now_usec ();
+
+        m_pool.lock ();
+        m_keys.erase (job->key);
+        m_stats.done++;
+        m_stats.wait_total += start - job->queued;
+        if (start - job->queued > m_stats.wait_max)
+          {
+            m_stats.wait_max = start - job->queued;
+          }
+        m_stats.run_total += end - start;
+        if (end - start > m_stats.run_max)
+          {
+            m_stats.run_max = end - start;
+          }
+        m_pool.unlock ();
+      };
+  }
+
+  WorkerPool m_pool;
+  std::list<job_s> m_queue;
+  /* The keys of the queued and running jobs.  */
+  std::unordered_set<std::string> m_keys;
+  int m_max_queued;
+  stats_s m_stats;
+};
+
+KeyJobQueue::KeyJobQueue ():
+  d (new Private, [] (Private *) {})
+{
+}
+
+KeyJobQueue *
+KeyJobQueue::instance ()
+{
+  if (!singleton)
+    {
+      singleton = new KeyJobQueue ();
+    }
+  return singleton;
+}
+
+KeyJobQueue::SubmitResult
+KeyJobQueue::submit (const std::string &key,
+                     const std::function<void ()> &job)
+{
+  TSTART;
+  SubmitResult ret = Submitted;
+
+  d->m_pool.lock ();
+  if (d->m_keys.find (key) != d->m_keys.end ())
+    {
+      d->m_stats.duplicates++;
+      ret = Duplicate;
+    }
+  else if ((int) d->m_queue.size () >= d->m_max_queued)
+    {
+      d->m_stats.rejected++;
+      ret = Rejected;
+    }
+  else
+    {
+      d->m_keys.insert (key);
+      d->m_queue.push_back ({key, job, now_usec ()});
+      d->m_stats.submitted++;
+      d->m_pool.queued ();
+    }
+  int queued = (int) d->m_queue.size ();
+  d->m_pool.unlock ();
+
+  if (ret == Duplicate)
+    {
+      log_debug ("%s:%s: Job for %s already queued or running.",
+                 SRCNAME, __func__, anonstr (key.c_str ()));
+    }
+  else if (ret == Rejected)
+    {
+      log_debug ("%s:%s: Queue full with %i jobs. Rejected %s.",
+                 SRCNAME, __func__, queued, anonstr (key.c_str ()));
+    }
+  TRETURN ret;
+}
+
+bool
+KeyJobQueue::contains (const std::string &key) const
+{
+  d->m_pool.lock ();
+  bool ret = d->m_keys.find (key) != d->m_keys.end ();
+  d->m_pool.unlock ();
+  return ret;
+}
+
+void
+KeyJobQueue::waitIdle ()
+{
+  TSTART;
+  d->m_pool.waitIdle ();
+  TRETURN;
+}
+
+void
+KeyJobQueue::setMaxWorkers (int n)
+{
+  d->m_pool.lock ();
+  d->m_pool.setMaxWorkers (n);
+  d->m_pool.unlock ();
+}
+
+void
+KeyJobQueue::setMaxQueued (int n)
+{
+  d->m_pool.lock ();
+  d->m_max_queued = n < 1 ? 1 : n;
+  d->m_pool.unlock ();
+}
+
+KeyJobQueue::stats_s
+KeyJobQueue::stats () const
+{
+  d->m_pool.lock ();
+  stats_s ret = d->m_stats;
+  ret.queued = (int) d->m_queue.size ();
+  ret.running = d->m_pool.runningJobs ();
+  ret.workers = d->m_pool.workers ();
+  d->m_pool.unlock ();
+  return ret;
+}
+
+void
+KeyJobQueue::logStats () const
+{
+  const auto s = stats ();
+
+  log_debug ("%s:%s: %i queued, %i running, %i workers, %lu submitted, "
+             "%lu duplicates, %lu rejected, %lu done",
+             SRCNAME, __func__, s.queued, s.running, s.workers,
+             s.submitted, s.duplicates, s.rejected, s.done);
+  if (s.done)
+    {
+      log_debug ("%s:%s: wait avg %llu max %llu ms, "
+                 "run avg %llu max %llu ms",
+                 SRCNAME, __func__,
+                 s.wait_total / s.done / 1000, s.wait_max / 1000,
+                 s.run_total / s.done / 1000, s.run_max / 1000);
+    }
+}
@@ -0,0 +1,111 @@
+/* @file keyjobqueue.h
+ * @brief Run the key lookups of the KeyCache in a pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYJOBQUEUE_H
+#define KEYJOBQUEUE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <functional>
+#include <memory>
+#include <string>
+
+/* The default number of lookups which run at the same time.  Each
+   of them runs a gpg or gpgsm process and may wait for the network
+   so this is a bit more than the number of cores of a usual machine.  */
+#define KEYJOB_MAX_WORKERS 6
+
+/* The default number of jobs which may wait in the queue.  */
+#define KEYJOB_MAX_QUEUED 500
+
+/* The KeyJobQueue runs the locate, update and import jobs of the
+   KeyCache in a bounded pool of worker threads in the order they
+   were submitted.  Each job has a key, e.g. the kind of the job and
+   the mail address, and a job for a key which is already queued or
+   running is not submitted again.  If the queue is full new jobs are
+   rejected so that the caller does not block.  */
+class KeyJobQueue
+{
+protected:
+  /** Internal ctor */
+  explicit KeyJobQueue ();
+
+public:
+  enum SubmitResult
+    {
+      Submitted = 0,
+      /* A job for the key is already queued or running.  */
+      Duplicate = 1,
+      /* The queue is full.  */
+      Rejected = 2
+    };
+
+  struct stats_s
+  {
+    int queued;
+    int running;
+    int workers;
+    unsigned long submitted;
+    unsigned long duplicates;
+    unsigned long rejected;
+    unsigned long done;
+    /* Time in microseconds the jobs waited in the queue and ran.  */
+    unsigned long long wait_total;
+    unsigned long long wait_max;
+    unsigned long long run_total;
+    unsigned long long run_max;
+  };
+
+  /** Get the KeyJobQueue */
+  static KeyJobQueue *instance ();
+
+  /* Queue JOB for KEY.  If the job is not submitted it is destroyed
+     without being run.  */
+  SubmitResult submit (const std::string &key,
+                       const std::function<void ()> &job);
+
+  /* Check if a job for KEY is queued or running.  */
+  bool contains (const std::string &key) const;
+
+  /* Wait until all queued jobs are done.  */
+  void waitIdle ();
+
+  /* Set the maximum number of worker threads.  Threads which are
+     already running are not stopped.  */
+  void setMaxWorkers (int n);
+
+  /* Set the maximum number of queued jobs.  */
+  void setMaxQueued (int n);
+
+  /* The queue depth and the latency counters.  */
+  stats_s stats () const;
+
+  /* Write the counters to the log.  */
+  void logStats () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif /* KEYJOBQUEUE_H */
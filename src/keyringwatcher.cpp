@@ -0,0 +1,302 @@
+/* @file keyringwatcher.cpp
+ * @brief Notice changes to the keyring files
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "keyringwatcher.h"
+
+#include "common_indep.h"
+#include "keysnapshot.h"
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+# include "w32-gettext.h"
+#else
+# include <pthread.h>
+# include <poll.h>
+# include <unistd.h>
+# include <fcntl.h>
+# include <sys/inotify.h>
+#endif
+
+class KeyringWatcher::Private
+{
+public:
+  Private () :
+    m_delay (KEYRING_WATCH_DELAY),
+    m_running (false)
+  {
+#ifdef HAVE_W32_SYSTEM
+    m_thread = nullptr;
+    m_stop_event = nullptr;
+#else
+    m_stop_pipe[0] = m_stop_pipe[1] = -1;
+#endif
+  }
+
+  /* Report the change if the stamp of the keyring files differs from
+     STAMP.  */
+  void
+  changed (std::string *stamp)
+  {
+    std::string newstamp = KeySnapshot::keyringStamp (m_homedir);
+
+    if (newstamp == *stamp)
+      {
+        return;
+      }
+    log_debug ("%s:%s: Keyring in %s changed.",
+               SRCNAME, __func__, m_homedir.c_str ());
+    *stamp = newstamp;
+    m_callback ();
+  }
+
+#ifdef HAVE_W32_SYSTEM
+  static DWORD WINAPI
+  watcher_thread (LPVOID arg)
+  {
+    static_cast<Private *> (arg)->run ();
+    return 0;
+  }
+
+  void
+  run ()
+  {
+    wchar_t *wdir = utf8_to_wchar (m_homedir.c_str ());
+    HANDLE change = INVALID_HANDLE_VALUE;
+
+    if (wdir)
+      {
+        /* Watch the subtree for private-keys-v1.d  */
+        change = FindFirstChangeNotificationW (wdir, TRUE,
+                                               FILE_NOTIFY_CHANGE_FILE_NAME |
+                                               FILE_NOTIFY_CHANGE_DIR_NAME |
+                                               FILE_NOTIFY_CHANGE_SIZE |
+                                               FILE_NOTIFY_CHANGE_LAST_WRITE);
+      }
+    xfree (wdir);
+    if (change == INVALID_HANDLE_VALUE)
+      {
+        log_error ("%s:%s: Failed to watch %s: %lu",
+                   SRCNAME, __func__, m_homedir.c_str (),
+                   (unsigned long) GetLastError ());
+        return;
+      }
+
+    std::string stamp = KeySnapshot::keyringStamp (m_homedir);
+    HANDLE handles[2] = {m_stop_event, change};
+    bool pending = false;
+    for (;;)
+      {
+        DWORD rc = WaitForMultipleObjects (2, handles, FALSE,
+                                           pending ? m_delay : INFINITE);
+        if (rc == WAIT_OBJECT_0 + 1)
+          {
+            pending = true;
+            if (!FindNextChangeNotification (change))
+              {
+                log_error ("%s:%s: Failed to watch %s: %lu",
+                           SRCNAME, __func__, m_homedir.c_str (),
+                           (unsigned long) GetLastError ());
+                break;
+              }
+          }
+        else if (rc == WAIT_TIMEOUT)
+          {
+            pending = false;
+            changed (&stamp);
+          }
+        else
+          {
+            /* Stopped or failed.  */
+            break;
+          }
+      }
+    FindCloseChangeNotification (change);
+  }
+#else
+  static void *
+  watcher_thread (void *arg)
+  {
+    static_cast<Private *> (arg)->run ();
+    return nullptr;
+  }
+
+  void
+  run ()
+  {
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                          | IN_CREATE | IN_DELETE;
+    const std::string keydir = m_homedir + "/private-keys-v1.d";
+    int fd = inotify_init1 (IN_CLOEXEC | IN_NONBLOCK);
+    int keydir_wd;
+
+    if (fd == -1 || inotify_add_watch (fd, m_homedir.c_str (), mask) == -1)
+      {
+        log_error ("%s:%s: Failed to watch %s",
+                   SRCNAME, __func__, m_homedir.c_str ());
+        if (fd != -1)
+          {
+            close (fd);
+          }
+        return;
+      }
+    keydir_wd = inotify_add_watch (fd, keydir.c_str (), mask);
+
+    std::string stamp = KeySnapshot::keyringStamp (m_homedir);
+    bool pending = false;
+    for (;;)
+      {
+        struct pollfd fds[2] = {{fd, POLLIN, 0},
+                                {m_stop_pipe[0], POLLIN, 0}};
+        int rc = poll (fds, 2, pending ? (int) m_delay : -1);
+
+        if (rc == -1 || (fds[1].revents & (POLLIN | POLLHUP)))
+          {
+            /* Stopped or failed.  */
+            break;
+          }
+        if (!rc)
+          {
+            pending = false;
+            changed (&stamp);
+            continue;
+          }
+        if (fds[0].revents & POLLIN)
+          {
+            char buf[4096];
+            while (read (fd, buf, sizeof buf) > 0)
+              ;
+            pending = true;
+            if (keydir_wd == -1)
+              {
+                /* The directory might have been created.  */
+                keydir_wd = inotify_add_watch (fd, keydir.c_str (), mask);
+              }
+          }
+      }
+    close (fd);
+  }
+#endif
+
+  std::string m_homedir;
+  std::function<void ()> m_callback;
+  unsigned int m_delay;
+  bool m_running;
+#ifdef HAVE_W32_SYSTEM
+  HANDLE m_thread;
+  HANDLE m_stop_event;
+#else
+  pthread_t m_thread;
+  int m_stop_pipe[2];
+#endif
+};
+
+KeyringWatcher::KeyringWatcher () :
+  d (new Private)
+{
+}
+
+KeyringWatcher::~KeyringWatcher ()
+{
+  stop ();
+}
+
+bool
+KeyringWatcher::start (const std::string &homedir,
+                       const std::function<void ()> &callback,
+                       unsigned int delay)
+{
+  TSTART;
+  if (d->m_running || homedir.empty ())
+    {
+      TRETURN false;
+    }
+  d->m_homedir = homedir;
+  d->m_callback = callback;
+  d->m_delay = delay;
+
+#ifdef HAVE_W32_SYSTEM
+  d->m_stop_event = CreateEvent (nullptr, TRUE, FALSE, nullptr);
+  if (!d->m_stop_event)
+    {
+      TRETURN false;
+    }
+  d->m_thread = CreateThread (nullptr, 0, Private::watcher_thread,
+                              d.get (), 0, nullptr);
+  if (!d->m_thread)
+    {
+      log_error ("%s:%s: Failed to create watcher thread.",
+                 SRCNAME, __func__);
+      CloseHandle (d->m_stop_event);
+      d->m_stop_event = nullptr;
+      TRETURN false;
+    }
+#else
+  if (pipe (d->m_stop_pipe))
+    {
+      TRETURN false;
+    }
+  if (pthread_create (&d->m_thread, nullptr, Private::watcher_thread,
+                      d.get ()))
+    {
+      log_error ("%s:%s: Failed to create watcher thread.",
+                 SRCNAME, __func__);
+      close (d->m_stop_pipe[0]);
+      close (d->m_stop_pipe[1]);
+      d->m_stop_pipe[0] = d->m_stop_pipe[1] = -1;
+      TRETURN false;
+    }
+#endif
+  d->m_running = true;
+  log_debug ("%s:%s: Watching %s",
+             SRCNAME, __func__, homedir.c_str ());
+  TRETURN true;
+}
+
+void
+KeyringWatcher::stop ()
+{
+  TSTART;
+  if (!d->m_running)
+    {
+      TRETURN;
+    }
+#ifdef HAVE_W32_SYSTEM
+  SetEvent (d->m_stop_event);
+  WaitForSingleObject (d->m_thread, INFINITE);
+  CloseHandle (d->m_thread);
+  CloseHandle (d->m_stop_event);
+  d->m_thread = nullptr;
+  d->m_stop_event = nullptr;
+#else
+  close (d->m_stop_pipe[1]);
+  pthread_join (d->m_thread, nullptr);
+  close (d->m_stop_pipe[0]);
+  d->m_stop_pipe[0] = d->m_stop_pipe[1] = -1;
+#endif
+  d->m_running = false;
+  TRETURN;
+}
+
+bool
+KeyringWatcher::isRunning () const
+{
+  return d->m_running;
+}
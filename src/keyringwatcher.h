@@ -0,0 +1,68 @@
+/* @file keyringwatcher.h
+ * @brief Notice changes to the keyring files
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYRINGWATCHER_H
+#define KEYRINGWATCHER_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <functional>
+#include <memory>
+#include <string>
+
+/* The default time in milliseconds without further changes after
+   which a change is reported.  An import writes the keyring and the
+   trustdb several times.  */
+#define KEYRING_WATCH_DELAY 1000
+
+/* A KeyringWatcher waits in a thread for changes in a GnuPG home
+   directory.  Changes are detected with inotify or a change
+   notification of Windows and reported only if the stamp of the
+   keyring files, see KeySnapshot::keyringStamp, changed so that e.g.
+   lock files or the random seed are ignored.  */
+class KeyringWatcher
+{
+public:
+  KeyringWatcher ();
+  ~KeyringWatcher ();
+
+  /* Start watching HOMEDIR.  CALLBACK is called in the watcher thread
+     when the keyring files changed and nothing changed for DELAY
+     milliseconds.  Changes during the callback are reported after it
+     returned.  Returns false if the watcher could not be started or
+     is already running.  */
+  bool start (const std::string &homedir,
+              const std::function<void ()> &callback,
+              unsigned int delay = KEYRING_WATCH_DELAY);
+
+  /* Stop the watcher and wait for its thread.  */
+  void stop ();
+
+  bool isRunning () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif /* KEYRINGWATCHER_H */
@@ -0,0 +1,373 @@
+/* @file keysnapshot.cpp
+ * @brief A snapshot of the keyring to answer lookups at startup
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "keysnapshot.h"
+
+#include "common_indep.h"
+#include "cpphelp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+# include "w32-gettext.h"
+#endif
+
+/* The first line of a snapshot file.  */
+#define SNAPSHOT_MAGIC "GpgOL keycache snapshot 1"
+
+/* The files in the GnuPG home directory which change when keys or
+   their validity change.  */
+static const char *keyring_files[] =
+  {
+    "pubring.kbx",
+    "pubring.gpg",
+    "trustdb.gpg",
+    "tofu.db",
+    "trustlist.txt",
+    "private-keys-v1.d",
+    nullptr
+  };
+
+static FILE *
+open_file (const std::string &fname, const char *mode)
+{
+#ifdef HAVE_W32_SYSTEM
+  wchar_t *wname = utf8_to_wchar (fname.c_str ());
+  wchar_t *wmode = utf8_to_wchar (mode);
+  FILE *ret = nullptr;
+
+  if (wname && wmode)
+    {
+      ret = _wfopen (wname, wmode);
+    }
+  xfree (wname);
+  xfree (wmode);
+  return ret;
+#else
+  return fopen (fname.c_str (), mode);
+#endif
+}
+
+static void
+remove_file (const std::string &fname)
+{
+#ifdef HAVE_W32_SYSTEM
+  wchar_t *wname = utf8_to_wchar (fname.c_str ());
+
+  if (wname)
+    {
+      DeleteFileW (wname);
+    }
+  xfree (wname);
+#else
+  remove (fname.c_str ());
+#endif
+}
+
+/* Replace the file FNAME by TMPNAME.  TMPNAME is removed on
+   error.  */
+static bool
+replace_file (const std::string &tmpname, const std::string &fname)
+{
+#ifdef HAVE_W32_SYSTEM
+  wchar_t *wtmp = utf8_to_wchar (tmpname.c_str ());
+  wchar_t *wname = utf8_to_wchar (fname.c_str ());
+  bool ret = wtmp && wname && MoveFileExW (wtmp, wname,
+                                           MOVEFILE_REPLACE_EXISTING);
+
+  xfree (wtmp);
+  xfree (wname);
+#else
+  bool ret = !rename (tmpname.c_str (), fname.c_str ());
+#endif
+  if (!ret)
+    {
+      remove_file (tmpname);
+    }
+  return ret;
+}
+
+/* Append the size and modification time of FNAME to STAMP.  The
+   time has sub-second resolution so that two changes within a second
+   give different stamps.  */
+static void
+stamp_file (const std::string &fname, std::string *stamp)
+{
+  char buf[64];
+  unsigned long long size, mtime;
+#ifdef HAVE_W32_SYSTEM
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  wchar_t *wname = utf8_to_wchar (fname.c_str ());
+  BOOL ok = wname && GetFileAttributesExW (wname, GetFileExInfoStandard,
+                                           &data);
+
+  xfree (wname);
+  if (!ok)
+    {
+      *stamp += "-;";
+      return;
+    }
+  size = ((unsigned long long) data.nFileSizeHigh << 32)
+         | data.nFileSizeLow;
+  mtime = ((unsigned long long) data.ftLastWriteTime.dwHighDateTime << 32)
+          | data.ftLastWriteTime.dwLowDateTime;
+#else
+  struct stat st;
+
+  if (stat (fname.c_str (), &st))
+    {
+      *stamp += "-;";
+      return;
+    }
+  size = (unsigned long long) st.st_size;
+  mtime = (unsigned long long) st.st_mtim.tv_sec * 1000000000
+          + st.st_mtim.tv_nsec;
+#endif
+  snprintf (buf, sizeof buf, "%llu:%llu;", size, mtime);
+  *stamp += buf;
+}
+
+void
+KeySnapshot::add (const std::string &fpr, int protocol, unsigned int flags,
+                  int validity, const std::vector<std::string> &mboxes)
+{
+  if (fpr.empty () || m_by_fpr.find (fpr) != m_by_fpr.end ())
+    {
+      return;
+    }
+  m_by_fpr.insert (std::make_pair (fpr, m_entries.size ()));
+  for (const auto &mbox: mboxes)
+    {
+      m_by_mbox.insert (std::make_pair (mbox, m_entries.size ()));
+    }
+  m_entries.push_back ({fpr, protocol, flags, validity, mboxes});
+}
+
+const KeySnapshot::entry_s *
+KeySnapshot::find (const std::string &fpr) const
+{
+  const auto it = m_by_fpr.find (fpr);
+  if (it == m_by_fpr.end ())
+    {
+      return nullptr;
+    }
+  return &m_entries[it->second];
+}
+
+std::vector<std::string>
+KeySnapshot::secretKeys (const std::string &mbox, int protocol) const
+{
+  std::vector<std::string> ret;
+  const auto range = m_by_mbox.equal_range (mbox);
+
+  for (auto it = range.first; it != range.second; ++it)
+    {
+      const auto &entry = m_entries[it->second];
+      if (entry.protocol == protocol && (entry.flags & FlagSecret))
+        {
+          ret.push_back (entry.fpr);
+        }
+    }
+  return ret;
+}
+
+void
+KeySnapshot::clear ()
+{
+  m_entries.clear ();
+  m_by_fpr.clear ();
+  m_by_mbox.clear ();
+}
+
+/* The file has a line with the magic, a line with the stamp and a
+   line per key:
+
+     <protocol> <flags> <validity> <fpr> [<mbox> ...]
+
+   All numbers are decimal.  A final line "end <count>" shows that the
+   file is complete.  */
+bool
+KeySnapshot::save (const std::string &fname, const std::string &stamp) const
+{
+  const std::string tmpname = fname + ".tmp";
+  FILE *fp = open_file (tmpname, "wb");
+  bool ok;
+
+  if (!fp)
+    {
+      log_debug ("%s:%s: Failed to open %s",
+                 SRCNAME, __func__, tmpname.c_str ());
+      return false;
+    }
+  fprintf (fp, "%s\n%s\n", SNAPSHOT_MAGIC, stamp.c_str ());
+  for (const auto &entry: m_entries)
+    {
+      fprintf (fp, "%i %u %i %s", entry.protocol, entry.flags,
+               entry.validity, entry.fpr.c_str ());
+      for (const auto &mbox: entry.mboxes)
+        {
+          fprintf (fp, " %s", mbox.c_str ());
+        }
+      putc ('\n', fp);
+    }
+  fprintf (fp, "end %lu\n", (unsigned long) m_entries.size ());
+  ok = !ferror (fp);
+  if (fclose (fp))
+    {
+      ok = false;
+    }
+
+  /* Keep the previous snapshot if the new one is incomplete.  */
+  if (ok)
+    {
+      ok = replace_file (tmpname, fname);
+    }
+  else
+    {
+      remove_file (tmpname);
+    }
+  if (!ok)
+    {
+      log_debug ("%s:%s: Failed to write %s",
+                 SRCNAME, __func__, fname.c_str ());
+    }
+  return ok;
+}
+
+bool
+KeySnapshot::load (const std::string &fname, const std::string &stamp)
+{
+  FILE *fp = open_file (fname, "rb");
+  std::string line;
+  bool ok = false;
+  bool header = true;
+  int lineno = 0;
+  int c;
+
+  clear ();
+  if (!fp)
+    {
+      return false;
+    }
+
+  for (;;)
+    {
+      c = getc (fp);
+      if (c != '\n' && c != EOF)
+        {
+          line += (char) c;
+          continue;
+        }
+      if (c == EOF && line.empty ())
+        {
+          break;
+        }
+      lineno++;
+      if (lineno == 1)
+        {
+          if (line != SNAPSHOT_MAGIC)
+            {
+              break;
+            }
+        }
+      else if (lineno == 2)
+        {
+          if (line != stamp)
+            {
+              log_debug ("%s:%s: Keyring changed since the snapshot.",
+                         SRCNAME, __func__);
+              break;
+            }
+          header = false;
+        }
+      else if (!strncmp (line.c_str (), "end ", 4))
+        {
+          ok = strtoul (line.c_str () + 4, nullptr, 10) == m_entries.size ();
+          break;
+        }
+      else
+        {
+          char *fields[4];
+          char *p = &line[0];
+          int i;
+
+          for (i = 0; i < 4 && p; i++)
+            {
+              fields[i] = p;
+              p = strchr (p, ' ');
+              if (p && i < 3)
+                {
+                  *p++ = 0;
+                }
+            }
+          if (i < 4 || !*fields[3])
+            {
+              break;
+            }
+          int protocol = (int) strtol (fields[0], nullptr, 10);
+          unsigned int flags = (unsigned int) strtoul (fields[1], nullptr,
+                                                       10);
+          int validity = (int) strtol (fields[2], nullptr, 10);
+          std::vector<std::string> mboxes;
+
+          if (p)
+            {
+              *p++ = 0;
+              mboxes = gpgol_split (p, ' ');
+            }
+          add (fields[3], protocol, flags, validity, mboxes);
+        }
+      line.clear ();
+      if (c == EOF)
+        {
+          break;
+        }
+    }
+  fclose (fp);
+
+  if (!ok)
+    {
+      if (!header)
+        {
+          log_debug ("%s:%s: Ignoring broken snapshot %s",
+                     SRCNAME, __func__, fname.c_str ());
+        }
+      clear ();
+    }
+  return ok;
+}
+
+std::string
+KeySnapshot::keyringStamp (const std::string &homedir)
+{
+  std::string ret;
+
+  for (int i = 0; keyring_files[i]; i++)
+    {
+      stamp_file (homedir + "/" + keyring_files[i], &ret);
+    }
+  return ret;
+}
@@ -0,0 +1,100 @@
+/* @file keysnapshot.h
+ * @brief A snapshot of the keyring to answer lookups at startup
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KEYSNAPSHOT_H
+#define KEYSNAPSHOT_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/* The name of the snapshot file in the GnuPG home directory.  */
+#define KEYSNAPSHOT_NAME "gpgol-keycache.snapshot"
+
+/* A KeySnapshot records the fingerprints of the keys in the keyring
+   with their flags and validity and, for secret keys, the mail
+   addresses of their user ids.  It is saved after the KeyCache was
+   populated and loaded on the next start if the keyring files have
+   not changed since.  The snapshot only tells which keys to look
+   up.  The keys themselves always come from GnuPG.  */
+class KeySnapshot
+{
+public:
+  enum
+    {
+      FlagSecret = 1,
+      FlagCanEncrypt = 2,
+      FlagCanSign = 4,
+      /* Revoked, expired, disabled or invalid.  */
+      FlagBad = 8
+    };
+
+  struct entry_s
+  {
+    std::string fpr;
+    int protocol;
+    unsigned int flags;
+    int validity;
+    std::vector<std::string> mboxes;
+  };
+
+  /* Add an entry.  PROTOCOL is the GpgME::Protocol of the key and
+     VALIDITY the best validity of its user ids.  */
+  void add (const std::string &fpr, int protocol, unsigned int flags,
+            int validity, const std::vector<std::string> &mboxes);
+
+  /* Return the entry for FPR or nullptr.  */
+  const entry_s *find (const std::string &fpr) const;
+
+  /* Return the fingerprints of the secret keys of PROTOCOL with a
+     user id for MBOX.  */
+  std::vector<std::string> secretKeys (const std::string &mbox,
+                                       int protocol) const;
+
+  size_t size () const { return m_entries.size (); }
+  bool empty () const { return m_entries.empty (); }
+  void clear ();
+
+  /* Write the snapshot with STAMP to the file FNAME.  Returns false
+     on error.  */
+  bool save (const std::string &fname, const std::string &stamp) const;
+
+  /* Read the snapshot from the file FNAME.  If the file was saved with
+     a different stamp than STAMP or is broken the snapshot is empty
+     and false is returned.  */
+  bool load (const std::string &fname, const std::string &stamp);
+
+  /* Return a stamp for the state of the keyring files in the GnuPG
+     home directory HOMEDIR.  It changes whenever a key or the trust
+     database is changed.  */
+  static std::string keyringStamp (const std::string &homedir);
+
+private:
+  std::vector<entry_s> m_entries;
+  std::unordered_map<std::string, size_t> m_by_fpr;
+  std::unordered_multimap<std::string, size_t> m_by_mbox;
+};
+
+#endif /* KEYSNAPSHOT_H */
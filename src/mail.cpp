@@ -35,11 +35,15 @@
 #include "gpgoladdin.h"
 #include "mymapitags.h"
 #include "parsecontroller.h"
+#include "parsescheduler.h"
+#include "jobgroup.h"
+#include "decryptcache.h"
 #include "cryptcontroller.h"
 #include "windowmessages.h"
 #include "mlang-charset.h"
 #include "wks-helper.h"
 #include "keycache.h"
+#include "keyjobqueue.h"
 #include "cpphelp.h"
 #include "addressbook.h"
 #include "recipient.h"
@@ -74,6 +78,7 @@ static std::set<std::string> s_entry_ids_printing;
 
 GPGRT_LOCK_DEFINE (mail_map_lock);
 GPGRT_LOCK_DEFINE (uid_map_lock);
+GPGRT_LOCK_DEFINE (prepared_crypto_lock);
 
 static Mail *s_last_mail;
 
@@ -137,6 +142,7 @@ Mail::Mail (LPDISPATCH mailitem) :
     m_printing(false),
     m_recipients_set(false),
     m_copy_parent(nullptr),
+    m_prepared_serial(0),
     m_attachs_added(false),
     m_BodyVerifyFailed(false)
 {
@@ -196,6 +202,7 @@ Mail::~Mail()
      while parsing. */
   gpgol_lock (&dtor_lock);
   memdbg_dtor ("Mail");
+  ParseScheduler::instance ()->cancel (this);
   log_oom ("%s:%s: dtor: Mail: %p item: %p",
                  SRCNAME, __func__, this, m_mailitem);
   std::map<LPDISPATCH, Mail *>::iterator it;
@@ -886,7 +893,53 @@ Mail::add_attachments_o (std::vector<std::shared_ptr<Attachment> > attachments)
   TRETURN anyError;
 }
 
-GPGRT_LOCK_DEFINE(parser_lock);
+/* Look up MAIL in the DecryptCache.  STREAM has the ciphertext of
+   the mail with the uid UID at START.  This is run by the parse job
+   as the whole ciphertext is hashed for the lookup.  Returns true if
+   the results were restored so that the mail does not need to be
+   parsed.  */
+static bool
+restore_from_cache (Mail *mail, LPSTREAM stream, ULARGE_INTEGER start,
+                    const std::string &uid)
+{
+  TSTART;
+  LARGE_INTEGER pos;
+  std::string hash;
+
+  pos.QuadPart = (LONGLONG) start.QuadPart;
+  if (stream->Seek (pos, STREAM_SEEK_SET, nullptr))
+    {
+      log_error ("%s:%s: Failed to seek to the ciphertext.",
+                 SRCNAME, __func__);
+    }
+  else
+    {
+      hash = DecryptCache::hashStream (stream);
+    }
+  std::shared_ptr<ParseController> cached;
+  if (!hash.empty ())
+    {
+      cached = DecryptCache::instance ()->restore (uid, hash);
+    }
+
+  gpgol_lock (&dtor_lock);
+  if (!Mail::isValidPtr (mail))
+    {
+      log_debug ("%s:%s: canceling lookup for: %p already deleted",
+                 SRCNAME, __func__, mail);
+      gpgol_unlock (&dtor_lock);
+      TRETURN false;
+    }
+  mail->setCacheResult (cached, hash);
+  gpgol_unlock (&dtor_lock);
+
+  if (cached)
+    {
+      log_debug ("%s:%s: Using cached results for %p",
+                 SRCNAME, __func__, mail);
+    }
+  TRETURN !!cached;
+}
 
 static DWORD WINAPI
 do_parsing (LPVOID arg)
@@ -910,13 +963,10 @@ do_parsing (LPVOID arg)
   auto parser = mail->parser ();
   gpgol_unlock (&dtor_lock);
 
-  gpgol_lock (&parser_lock);
-  /* We lock the parser here to avoid too many
-     decryption attempts if there are
-     multiple mailobjects which might have already
-     been deleted (e.g. by quick switches of the mailview.)
-     Let's rather be a bit slower.
-     */
+  /* We are run by the ParseScheduler which limits the number of
+     mails parsed at the same time.  Jobs for mails which are
+     deleted before their job is started (e.g. by quick switches of
+     the mailview) are canceled by the Mail dtor.  */
   log_debug ("%s:%s: preparing the parser for: %p",
              SRCNAME, __func__, arg);
 
@@ -924,7 +974,6 @@ do_parsing (LPVOID arg)
     {
       log_debug ("%s:%s: cancel for: %p already deleted",
                  SRCNAME, __func__, arg);
-      gpgol_unlock (&parser_lock);
       unblockInv();
       TRETURN 0;
     }
@@ -933,7 +982,6 @@ do_parsing (LPVOID arg)
     {
       log_error ("%s:%s: no parser found for mail: %p",
                  SRCNAME, __func__, arg);
-      gpgol_unlock (&parser_lock);
       unblockInv();
       TRETURN -1;
     }
@@ -964,7 +1012,6 @@ do_parsing (LPVOID arg)
             {
               log_debug ("%s:%s: canceling parsing for: %p now deleted",
                          SRCNAME, __func__, arg);
-              gpgol_unlock (&parser_lock);
               unblockInv();
               TRETURN 0;
             }
@@ -987,7 +1034,6 @@ do_parsing (LPVOID arg)
           do_in_ui_thread (PARSING_DONE, arg);
         }
     }
-  gpgol_unlock (&parser_lock);
   unblockInv();
   TRETURN 0;
 }
@@ -1067,20 +1113,36 @@ do_parsing (LPVOID arg)
     CryptFinished
     trigger Send.
 */
-static DWORD WINAPI
-do_crypt (LPVOID arg)
+/* The crypto of one mail.  */
+struct crypt_job_s
+{
+  Mail *mail;
+  std::shared_ptr<CryptController> crypter;
+  int resolve_error;
+  int rc;
+  GpgME::Error err;
+  std::string diag;
+};
+
+/* Take the crypter of the mail of JOB.  Returns false if there is
+   nothing to do.  The return value for do_crypt is then in
+   JOB->rc.  */
+static bool
+crypt_job_start (crypt_job_s *job)
 {
   TSTART;
   gpgol_lock (&dtor_lock);
   /* We lock with mail dtors so we can be sure the mail->parser
      call is valid. */
-  Mail *mail = (Mail *)arg;
+  Mail *mail = job->mail;
+  job->rc = 0;
+  job->resolve_error = 0;
   if (!Mail::isValidPtr (mail))
     {
       log_debug ("%s:%s: canceling crypt for: %p already deleted",
-                 SRCNAME, __func__, arg);
+                 SRCNAME, __func__, mail);
       gpgol_unlock (&dtor_lock);
-      TRETURN 0;
+      TRETURN false;
     }
   if (mail->cryptState () != Mail::DataCollected)
     {
@@ -1088,24 +1150,51 @@ do_crypt (LPVOID arg)
                  SRCNAME, __func__, mail->cryptState ());
       mail->enableWindow ();
       gpgol_unlock (&dtor_lock);
-      TRETURN -1;
+      job->rc = -1;
+      TRETURN false;
     }
 
   /* This takes a shared ptr of crypter. So the crypter is
      still valid when the mail is deleted. */
-  auto crypter = mail->cryper ();
+  job->crypter = mail->cryper ();
   gpgol_unlock (&dtor_lock);
 
-  if (!crypter)
+  if (!job->crypter)
     {
       log_error ("%s:%s: no crypter found for mail: %p",
-                 SRCNAME, __func__, arg);
-      gpgol_unlock (&parser_lock);
+                 SRCNAME, __func__, mail);
       mail->enableWindow ();
-      TRETURN -1;
+      job->rc = -1;
+      TRETURN false;
+    }
+  TRETURN true;
+}
+
+/* Resolve the keys and do the crypto operation of JOB.  This does
+   not touch the mail so the jobs of a split send can run at the same
+   time.  */
+static void
+crypt_job_run (crypt_job_s *job)
+{
+  TSTART;
+  job->rc = 0;
+  job->resolve_error = job->crypter->prepare_crypto ();
+  if (!job->resolve_error)
+    {
+      job->rc = job->crypter->do_crypto (job->err, job->diag, false);
     }
+  TRETURN;
+}
 
-  int resolve_error = crypter->prepare_crypto ();
+/* Handle the result of crypt_job_run.  Errors are shown to the
+   user and the mail is handed on to be sent.  */
+static int
+crypt_job_finish (crypt_job_s *job)
+{
+  TSTART;
+  Mail *mail = job->mail;
+  auto &crypter = job->crypter;
+  int resolve_error = job->resolve_error;
   if (resolve_error) {
       if (resolve_error == -4)
         {
@@ -1123,7 +1212,7 @@ do_crypt (LPVOID arg)
               mail->resetCrypter();
               mail->enableWindow ();
               gpgol_unlock (&dtor_lock);
-              do_in_ui_thread_async (SEND, arg);
+              do_in_ui_thread_async (SEND, mail);
               TRETURN -1;
             }
           else
@@ -1158,15 +1247,15 @@ do_crypt (LPVOID arg)
       TRETURN resolve_error;
   }
 
-  GpgME::Error err;
-  std::string diag;
-  int rc = crypter->do_crypto(err, diag, false);
+  GpgME::Error &err = job->err;
+  std::string &diag = job->diag;
+  int rc = job->rc;
 
   gpgol_lock (&dtor_lock);
   if (!Mail::isValidPtr (mail))
     {
       log_debug ("%s:%s: aborting crypt for: %p already deleted",
-                 SRCNAME, __func__, arg);
+                 SRCNAME, __func__, mail);
       wm_abort_pending_ops ();
       gpgol_unlock (&dtor_lock);
       TRETURN 0;
@@ -1243,7 +1332,7 @@ do_crypt (LPVOID arg)
   if (rc || err.isCanceled())
     {
       log_debug ("%s:%s: crypto failed for: %p with: %i err: %i",
-                 SRCNAME, __func__, arg, rc, err.code());
+                 SRCNAME, __func__, mail, rc, err.code());
       mail->setCryptState (Mail::NotStarted);
       mail->setIsDraftEncrypt (false);
       mail->resetCrypter ();
@@ -1265,9 +1354,9 @@ do_crypt (LPVOID arg)
       mail->setCryptState (Mail::BackendDone);
       gpgol_unlock (&dtor_lock);
       // This deletes the Mail in Outlook 2010
-      do_in_ui_thread (CRYPTO_DONE, arg);
+      do_in_ui_thread (CRYPTO_DONE, mail);
       log_debug ("%s:%s: UI thread finished for %p",
-                 SRCNAME, __func__, arg);
+                 SRCNAME, __func__, mail);
     }
   else if (mail->isDraftEncrypt ())
     {
@@ -1276,7 +1365,7 @@ do_crypt (LPVOID arg)
       mail->setIsDraftEncrypt (false);
       mail->setCryptState (Mail::NotStarted);
       log_debug ("%s:%s: Synchronous draft encrypt finished for %p",
-                 SRCNAME, __func__, arg);
+                 SRCNAME, __func__, mail);
       gpgol_unlock (&dtor_lock);
     }
   else
@@ -1292,7 +1381,7 @@ do_crypt (LPVOID arg)
         {
           // A bug!
           log_debug ("%s:%s: Resetting crypter because of state mismatch. %p",
-                     SRCNAME, __func__, arg);
+                     SRCNAME, __func__, mail);
           mail->resetCrypter ();
         }
       gpgol_unlock (&dtor_lock);
@@ -1305,7 +1394,84 @@ do_crypt (LPVOID arg)
      */
   do_in_ui_thread_async (BRING_TO_FRONT, nullptr, 250);
   log_debug ("%s:%s: crypto thread for %p finished",
-             SRCNAME, __func__, arg);
+             SRCNAME, __func__, mail);
+  TRETURN 0;
+}
+
+static DWORD WINAPI
+do_crypt (LPVOID arg)
+{
+  TSTART;
+  crypt_job_s job;
+  job.mail = (Mail *) arg;
+  if (!crypt_job_start (&job))
+    {
+      TRETURN job.rc;
+    }
+  crypt_job_run (&job);
+  TRETURN crypt_job_finish (&job);
+}
+
+/* Do the crypto of the mails of a split send.  Mixed S/MIME and
+   OpenPGP recipients result in one mail per protocol.  If PARALLEL
+   is set the crypto of the mails runs in the shared pool of the job
+   groups so that the mails do not wait for each other.  Otherwise we
+   are called in the UI thread for sync crypto and the mails are done
+   one after another as the crypto might need to show a message box.
+   All results are collected before the first mail is handed on to be
+   sent.  */
+static void
+split_crypt (const std::vector<Mail *> &mails, bool parallel)
+{
+  TSTART;
+  std::vector<crypt_job_s> jobs;
+
+  for (Mail *mail: mails)
+    {
+      crypt_job_s job;
+      job.mail = mail;
+      if (crypt_job_start (&job))
+        {
+          jobs.push_back (job);
+        }
+    }
+
+  if (parallel)
+    {
+      JobGroup group;
+      for (auto &job: jobs)
+        {
+          crypt_job_s *p = &job;
+          group.add ([p] () { crypt_job_run (p); });
+        }
+      group.wait ();
+    }
+  else
+    {
+      for (auto &job: jobs)
+        {
+          crypt_job_run (&job);
+        }
+    }
+  log_debug ("%s:%s: crypto for %i split mails done",
+             SRCNAME, __func__, (int) jobs.size ());
+
+  for (auto &job: jobs)
+    {
+      crypt_job_finish (&job);
+    }
+  TRETURN;
+}
+
+/* Thread for the async crypto of a split send.  ARG is a vector of
+   mails which is released.  */
+static DWORD WINAPI
+do_split_crypt (LPVOID arg)
+{
+  TSTART;
+  std::unique_ptr<std::vector<Mail *> > mails ((std::vector<Mail *> *) arg);
+
+  split_crypt (*mails, true);
   TRETURN 0;
 }
 
@@ -1584,6 +1750,29 @@ Mail::decryptVerify_o (bool doRevertOnly, bool setUUID)
       TRETURN 0;
     }
 
+  /* Check if we have already decrypted this mail.  The lookup
+     needs a hash of the whole ciphertext so it is done by the parse
+     job and not here in the UI thread.  */
+  std::shared_ptr <IStream> cache_stream;
+  const std::string cache_uid = m_uuid;
+  ULARGE_INTEGER cache_start;
+  LARGE_INTEGER zero;
+  zero.QuadPart = 0;
+  m_cache_hash = std::string ();
+  m_cached_parser = nullptr;
+  /* The parser might read the stream right away so the start of the
+     ciphertext is remembered for the lookup.  */
+  if (opt.decrypt_cache && !m_uuid.empty ()
+      && !cipherstream->Seek (zero, STREAM_SEEK_CUR, &cache_start))
+    {
+      cipherstream->AddRef ();
+      memdbg_addRef (cipherstream);
+      cache_stream = std::shared_ptr <IStream> (cipherstream,
+                                                [] (IStream *stream) {
+                                                  gpgol_release (stream);
+                                                });
+    }
+
   m_parser = std::shared_ptr <ParseController> (new ParseController (cipherstream, m_type));
   m_parser->setSender(GpgME::UserID::addrSpecFromString(getSender_o ().c_str()));
 
@@ -1621,21 +1810,36 @@ Mail::decryptVerify_o (bool doRevertOnly, bool setUUID)
 
   if (!opt.sync_dec && !m_printing)
     {
-      HANDLE parser_thread = CreateThread (NULL, 0, do_parsing, (LPVOID) this, 0,
-                                           NULL);
-
-      if (!parser_thread)
-        {
-          log_error ("%s:%s: Failed to create decrypt / verify thread.",
-                     SRCNAME, __func__);
-        }
-      CloseHandle (parser_thread);
+      /* The explorer marks the mail the user looks at as selected
+         so that it is parsed before the others.  */
+      ParseScheduler::instance ()->submit (this,
+                                           ParseScheduler::PrioNormal,
+                                           [this, cache_stream, cache_start,
+                                            cache_uid] () {
+                                             if (cache_stream
+                                                 && restore_from_cache
+                                                      (this,
+                                                       cache_stream.get (),
+                                                       cache_start,
+                                                       cache_uid))
+                                               {
+                                                 do_in_ui_thread (PARSING_DONE,
+                                                                  this);
+                                                 return;
+                                               }
+                                             do_parsing ((LPVOID) this);
+                                           });
       TRETURN 0;
     }
   else
     {
       /* Parse synchronously */
-      do_parsing ((LPVOID) this);
+      if (!cache_stream
+          || !restore_from_cache (this, cache_stream.get (), cache_start,
+                                  cache_uid))
+        {
+          do_parsing ((LPVOID) this);
+        }
       parsingDone_o ();
       TRETURN 0;
     }
@@ -2032,6 +2236,12 @@ Mail::parsingDone_o (bool is_preview)
 {
   TSTART;
   TRACEPOINT;
+  if (m_cached_parser)
+    {
+      /* The parse job found the results in the DecryptCache.  */
+      m_parser = m_cached_parser;
+      m_cached_parser = nullptr;
+    }
   log_oom ("Mail %p Parsing done for parser num %i: %p",
            this, parsed_count++, m_parser.get());
   if (!m_parser)
@@ -2067,6 +2277,14 @@ Mail::parsingDone_o (bool is_preview)
     {
       m_verify_result = m_parser->verify_result ();
     }
+  /* Only decrypted mails are cached.  Verifying a signed mail is
+     cheap and its result should reflect changes in the keyring.  */
+  if (!is_preview && !m_cache_hash.empty () && !m_decrypt_result.isNull ()
+      && !m_decrypt_result.error ())
+    {
+      DecryptCache::instance ()->store (m_uuid, m_cache_hash, *m_parser);
+      m_cache_hash = std::string ();
+    }
   /* Handle protected headers */
   updateHeaders_o ();
 
@@ -2248,7 +2466,7 @@ Mail::parsingDone_o (bool is_preview)
 }
 
 int
-Mail::encryptSignStart_o ()
+Mail::encryptSignStart_o (bool startCrypt)
 {
   TSTART;
   if (m_crypt_state != DataCollected)
@@ -2324,6 +2542,11 @@ Mail::encryptSignStart_o ()
       TRETURN -1;
     }
 
+  if (!startCrypt)
+    {
+      TRETURN 0;
+    }
+
   if (!m_async_crypt_disabled)
     {
       CloseHandle(CreateThread (NULL, 0, do_crypt,
@@ -2789,6 +3012,7 @@ Mail::revert_o ()
     }
 
   m_disable_att_remove_warning = true;
+  DecryptCache::instance ()->invalidate (m_uuid);
 
   err = gpgol_mailitem_revert (m_mailitem);
   if (err == -1)
@@ -4194,6 +4418,7 @@ Mail::locateKeys_o ()
       TRETURN;
     }
   m_locate_in_progress = true;
+  resetPreparedCrypto ();
 
   Addressbook::check_o (this);
 
@@ -4207,6 +4432,11 @@ Mail::locateKeys_o ()
     }
 
   autosecureCheck ();
+  if (!m_locate_count)
+    {
+      /* After a possible autosecure change of the flags.  */
+      do_in_ui_thread_async (PREPARE_CRYPTO, this);
+    }
 
   m_locate_in_progress = false;
   TRETURN;
@@ -4940,6 +5170,7 @@ Mail::decrementLocateCount ()
   if (!m_locate_count)
     {
       autosecureCheck ();
+      do_in_ui_thread_async (PREPARE_CRYPTO, this);
     }
   TRETURN;
 }
@@ -4967,6 +5198,133 @@ Mail::autosecureCheck ()
   TRETURN;
 }
 
+/* Resolve the keys of MAIL for the recipients with SERIAL.  Runs
+   in the KeyJobQueue.  */
+static void
+prepare_crypto (Mail *mail, bool encrypt, bool sign, int serial)
+{
+  TSTART;
+  /* The controller copies the recipients and the sender from the
+     mail.  The resolution can wait for key imports so it runs
+     without the delete lock.  */
+  Mail::lockDelete ();
+  if (!Mail::isValidPtr (mail) || !mail->isPreparedSerial (serial))
+    {
+      /* The mail is gone or its recipients changed while we were
+         queued.  */
+      Mail::unlockDelete ();
+      TRETURN;
+    }
+  CryptController crypter (mail, encrypt, sign, GpgME::UnknownProtocol);
+  Mail::unlockDelete ();
+
+  const auto prepared = crypter.prewarm ();
+
+  if (prepared)
+    {
+      Mail::lockDelete ();
+      if (Mail::isValidPtr (mail))
+        {
+          mail->setPreparedCrypto (prepared, serial);
+        }
+      Mail::unlockDelete ();
+    }
+  TRETURN;
+}
+
+void
+Mail::prewarmCrypto_o ()
+{
+  TSTART;
+  if (!opt.autoresolve || opt.alwaysShowApproval || m_copy_parent ||
+      m_is_draft_encrypt || m_crypt_state != NotStarted || m_locate_count)
+    {
+      TRETURN;
+    }
+  int flags = needs_crypto_m ();
+  if (!flags)
+    {
+      TRETURN;
+    }
+
+  Mail *mail = this;
+  const bool encrypt = flags & 1;
+  const bool sign = flags & 2;
+  gpgol_lock (&prepared_crypto_lock);
+  const int serial = m_prepared_serial;
+  gpgol_unlock (&prepared_crypto_lock);
+
+  /* A PREPARE_CRYPTO is posted for every change of the recipients so
+     the job is keyed by the mail and the serial of its recipients.
+     Further events for the same recipients are dropped.  */
+  char key[64];
+  snprintf (key, sizeof key, "prepare:%p:%i", this, serial);
+  const auto res = KeyJobQueue::instance ()->submit
+    (key, [mail, encrypt, sign, serial] () {
+        prepare_crypto (mail, encrypt, sign, serial);
+      });
+  if (res != KeyJobQueue::Submitted)
+    {
+      log_debug ("%s:%s: Not preparing %p: %s",
+                 SRCNAME, __func__, this,
+                 res == KeyJobQueue::Duplicate ? "already queued"
+                                               : "queue full");
+    }
+  TRETURN;
+}
+
+bool
+Mail::isPreparedSerial (int serial) const
+{
+  TSTART;
+  gpgol_lock (&prepared_crypto_lock);
+  const bool ret = serial == m_prepared_serial;
+  gpgol_unlock (&prepared_crypto_lock);
+  TRETURN ret;
+}
+
+void
+Mail::setPreparedCrypto (const std::shared_ptr<prepared_crypto_s> &prepared,
+                         int serial)
+{
+  TSTART;
+  gpgol_lock (&prepared_crypto_lock);
+  if (serial == m_prepared_serial)
+    {
+      m_prepared_crypto = prepared;
+    }
+  else
+    {
+      log_debug ("%s:%s: Recipients of %p changed during the preparation.",
+                 SRCNAME, __func__, this);
+    }
+  gpgol_unlock (&prepared_crypto_lock);
+  TRETURN;
+}
+
+std::shared_ptr<prepared_crypto_s>
+Mail::takePreparedCrypto ()
+{
+  TSTART;
+  gpgol_lock (&prepared_crypto_lock);
+  auto ret = m_prepared_crypto;
+  m_prepared_crypto = nullptr;
+  m_prepared_serial++;
+  gpgol_unlock (&prepared_crypto_lock);
+  TRETURN ret;
+}
+
+void
+Mail::resetPreparedCrypto ()
+{
+  TSTART;
+  gpgol_lock (&prepared_crypto_lock);
+  m_prepared_crypto = nullptr;
+  m_prepared_serial++;
+  gpgol_unlock (&prepared_crypto_lock);
+  TRETURN;
+}
+
 void
 Mail::setDoAutosecure_m (bool value)
 {
@@ -5143,6 +5501,9 @@ Mail::decryptPermanently_o()
   /* Remove the existing categories */
   removeCategories_o ();
 
+  /* The mail is stored unencrypted now.  */
+  DecryptCache::instance ()->invalidate (m_uuid);
+
   /* Drop our state variables */
   m_decrypt_result = GpgME::DecryptionResult();
   m_verify_result = GpgME::VerificationResult();
@@ -5366,13 +5727,16 @@ Mail::splitAndSend_o ()
   /* Build the headers to set on the split mails */
   buildProtectedHeaders_o ();
 
+  auto mails = std::unique_ptr<std::vector<Mail *> > (new std::vector<Mail *>);
+  bool sync = false;
+
   for (int i = 0; i < count; i++)
     {
       Mail *copiedMail = copy ();
       if (!copiedMail)
         {
           log_err ("Failed to copy mail. Aboring.");
-          TRETURN;
+          break;
         }
       GpgME::Key sigKey;
       const RecpList recps = mngr.getRecipients (i, sigKey);
@@ -5384,7 +5748,7 @@ Mail::splitAndSend_o ()
         {
           log_err ("Failed to update recipients");
           gpgol_bug (get_active_hwnd(), ERR_SPLIT_RECIPIENTS);
-          TRETURN;
+          break;
         }
       if (!opt.encryptSubject && !mngr.isSplitByProtocol ())
         {
@@ -5410,17 +5774,51 @@ Mail::splitAndSend_o ()
           copiedMail->setProtectedHeaders (m_protected_headers);
         }
 
-      /* Now do the crypto */
+      /* Collect the data, the crypto is done for all mails
+         together below. */
       copiedMail->setCopyParent (this);
       copiedMail->prepareCrypto_o ();
-      copiedMail->encryptSignStart_o ();
+      if (copiedMail->encryptSignStart_o (false) || !copiedMail->cryper ())
+        {
+          continue;
+        }
+      sync = sync || copiedMail->isAsyncCryptDisabled ();
+      mails->push_back (copiedMail);
     }
   /* Reset the protected headers */
   m_protected_headers = std::string ();
 
+  log_dbg ("Starting %s crypto for %i split mails",
+           sync ? "sync" : "async", (int) mails->size ());
+  if (sync)
+    {
+      split_crypt (*mails, false);
+    }
+  else
+    {
+      CloseHandle (CreateThread (NULL, 0, do_split_crypt,
+                                 (LPVOID) mails.release (), 0,
+                                 NULL));
+    }
+
   TRETURN;
 }
 
+void
+Mail::setCacheResult (const std::shared_ptr<ParseController> &parser,
+                      const std::string &hash)
+{
+  if (parser)
+    {
+      m_cached_parser = parser;
+      m_cache_hash = std::string ();
+    }
+  else
+    {
+      m_cache_hash = hash;
+    }
+}
+
 void
 Mail::resetCrypter ()
 {
@@ -34,6 +34,7 @@ class ParseController;
 class CryptController;
 class Attachment;
 class Recipient;
+struct prepared_crypto_s;
 
 /** @brief Data wrapper around a mailitem.
  *
@@ -262,8 +263,12 @@ public:
    * Initiates the crypto operations according to the gpgol
    * draft info flags.
    *
+   * If startCrypt is false only the data is collected and the
+   * caller has to run the crypto.  splitAndSend_o uses this to
+   * run the crypto of all split mails at the same time.
+   *
    * @returns 0 on success. */
-  int encryptSignStart_o ();
+  int encryptSignStart_o (bool startCrypt = true);
 
   /** @brief Necessary crypto operations were completed successfully. */
   bool wasCryptoSuccessful_m () { return m_crypt_successful || !needs_crypto_m (); }
@@ -543,6 +548,13 @@ public:
     on error. */
   void resetCrypter ();
 
+  /** Set the result of the DecryptCache lookup of the parse job.
+    If parser is set it replaces the parser when parsing is done.
+    Otherwise hash is used to store the results after parsing.
+    Called with the dtor lock held. */
+  void setCacheResult (const std::shared_ptr<ParseController> &parser,
+                       const std::string &hash);
+
   /** Set special crypto mime data that should be used as the
     mime structure when sending. */
   void setOverrideMIMEData (const std::string &data) {m_mime_data = data;}
@@ -621,6 +633,27 @@ public:
    */
   void autosecureCheck ();
 
+  /* Resolve the keys for the current recipients and prepare a
+     context in the background so that they are ready when the
+     mail is sent.  See CryptController::prewarm.  */
+  void prewarmCrypto_o ();
+
+  /* Check if the recipients were not changed since the preparation
+     with SERIAL was submitted.  */
+  bool isPreparedSerial (int serial) const;
+
+  /* Store PREPARED unless the recipients were changed since the
+     preparation with SERIAL was started.  */
+  void setPreparedCrypto (const std::shared_ptr<prepared_crypto_s> &prepared,
+                          int serial);
+
+  /* Take the prepared keys and context.  */
+  std::shared_ptr<prepared_crypto_s> takePreparedCrypto ();
+
+  /* Drop the prepared keys and context. To be called when the
+     recipients change.  */
+  void resetPreparedCrypto ();
+
   /* Set if a mail should be secured (encrypted and signed)
    *
    * Only save to call from a place that may access mapi.
@@ -770,6 +803,11 @@ private:
   GpgME::Signature m_sig;
   GpgME::UserID m_uid;
   std::string m_uuid;
+  std::string m_cache_hash; /* Hash of the content to store in the
+                               DecryptCache after parsing.  */
+  std::shared_ptr <ParseController> m_cached_parser; /* Restored from the
+                                                        DecryptCache by the
+                                                        parse job.  */
   std::string m_orig_body;
   bool m_do_inline;
   bool m_is_gsuite; /* Are we on a gsuite account */
@@ -800,6 +838,8 @@ private:
   std::vector<GpgME::Key> m_resolved_signing_keys; /* Prepared / resolved keys for signing. */
   bool m_recipients_set; /* Recipients were explictly set. */
   Mail *m_copy_parent; /* The mail object of which this mail is a copy */
+  std::shared_ptr<prepared_crypto_s> m_prepared_crypto; /* Keys resolved while composing. */
+  int m_prepared_serial; /* Incremented when the prepared keys are dropped. */
   std::string m_protected_headers;
   header_info_s m_header_info; /* Information about the original headers */
   bool m_attachs_added; /* State variable to track if we have added attachments to this mail. */
@@ -22,6 +22,7 @@
 #include <windows.h>
 #include <wincrypt.h>
 #include <ctype.h>
+#include <stdlib.h>
 #include <winnls.h>
 #include <unistd.h>
 
@@ -126,6 +127,17 @@ get_conf_bool (const char *name, int defaultVal)
   return ret;
 }
 
+static int
+get_conf_int (const char *name, int defaultVal)
+{
+  char *val = NULL;
+  int ret;
+  load_extension_value (name, &val);
+  ret = val == NULL || !*val ? defaultVal : atoi (val);
+  xfree (val);
+  return ret;
+}
+
 static int
 dbg_compat (int oldval)
 {
@@ -266,6 +278,7 @@ read_options (void)
   opt.autosecure = get_conf_bool ("autosecure", 1);
   opt.autotrust = get_conf_bool ("autotrust", 0);
   opt.search_smime_servers = get_conf_bool ("searchSmimeServers", 0);
+  opt.negative_cache_ttl = get_conf_int ("negativeCacheTTL", 3600);
   opt.smime_html_warn_shown = get_conf_bool ("smimeHtmlWarnShown", 0);
   opt.smime_insecure_reply_fw_allowed = get_conf_bool ("smimeInsecureReplyAllowed", 0);
   opt.auto_unstrusted = get_conf_bool ("autoencryptUntrusted", 0);
@@ -308,6 +321,8 @@ read_options (void)
       opt.draft_key = NULL;
     }
   opt.alwaysShowApproval = get_conf_bool ("alwaysShowApproval", 0);
+  opt.decrypt_cache = get_conf_bool ("decryptCache", 0);
+  opt.part_cache = get_conf_bool ("partCache", 0);
 
   /* Hidden options  */
   opt.sync_enc = 1; //get_conf_bool ("syncEnc", 0);
@@ -21,6 +21,7 @@
 #include "common_indep.h"
 #include "xmalloc.h"
 #include <string.h>
+#include <errno.h>
 #include <vector>
 #include <sstream>
 
@@ -44,6 +45,11 @@
    our read. -1 */
 #define LINEBUFSIZE (BUFSIZE - 1)
 
+/* In streaming mode crypto data which has been read is kept until
+   this much has accumulated.  Seeking back is possible within that
+   window which is enough for GpgME to detect the data type.  */
+#define STREAM_WINDOW (1024 * 1024)
+
 #include <gpgme++/error.h>
 
 /* To keep track of the MIME message structures we use a linked list
@@ -705,7 +711,16 @@ MimeDataProvider::MimeDataProvider(bool no_headers) :
   m_protected_headers_version(0),
   m_signature(nullptr),
   m_has_html_body(false),
-  m_collect_everything(no_headers)
+  m_collect_everything(no_headers),
+  m_streaming(false),
+#ifdef HAVE_W32_SYSTEM
+  m_stream(nullptr),
+#endif
+  m_file(nullptr),
+  m_source_eof(false),
+  m_first_read(true),
+  m_crypto_pos(0),
+  m_crypto_base(0)
 {
   TSTART;
   memdbg_ctor ("MimeDataProvider");
@@ -716,7 +731,8 @@ MimeDataProvider::MimeDataProvider(bool no_headers) :
 }
 
 #ifdef HAVE_W32_SYSTEM
-MimeDataProvider::MimeDataProvider(LPSTREAM stream, bool no_headers):
+MimeDataProvider::MimeDataProvider(LPSTREAM stream, bool no_headers,
+                                   bool streaming):
   MimeDataProvider(no_headers)
 {
   TSTART;
@@ -730,6 +746,14 @@ MimeDataProvider::MimeDataProvider(LPSTREAM stream, bool no_headers):
       log_error ("%s:%s called without stream ", SRCNAME, __func__);
       TRETURN;
     }
+  if (streaming)
+    {
+      /* Keep the reference until we are done.  */
+      log_debug ("%s:%s Streaming data.", SRCNAME, __func__);
+      m_streaming = true;
+      m_stream = stream;
+      TRETURN;
+    }
   log_data ("%s:%s Collecting data.", SRCNAME, __func__);
   collect_data (stream);
   log_data ("%s:%s Data collected.", SRCNAME, __func__);
@@ -738,10 +762,18 @@ MimeDataProvider::MimeDataProvider(LPSTREAM stream, bool no_headers):
 }
 #endif
 
-MimeDataProvider::MimeDataProvider(FILE *stream, bool no_headers):
+MimeDataProvider::MimeDataProvider(FILE *stream, bool no_headers,
+                                   bool streaming):
   MimeDataProvider(no_headers)
 {
   TSTART;
+  if (streaming)
+    {
+      log_debug ("%s:%s Streaming data from file.", SRCNAME, __func__);
+      m_streaming = true;
+      m_file = stream;
+      TRETURN;
+    }
   log_data ("%s:%s Collecting data from file.", SRCNAME, __func__);
   collect_data (stream);
   log_data ("%s:%s Data collected.", SRCNAME, __func__);
@@ -769,6 +801,12 @@ MimeDataProvider::~MimeDataProvider()
     {
       delete m_signature;
     }
+#ifdef HAVE_W32_SYSTEM
+  if (m_stream)
+    {
+      gpgol_release (m_stream);
+    }
+#endif
   TRETURN;
 }
 
@@ -792,10 +830,14 @@ MimeDataProvider::read(void *buffer, size_t size)
   log_data ("%s:%s: Reading: " SIZE_T_FORMAT "Bytes",
                  SRCNAME, __func__, size);
 #if GPGMEPP_VERSION >= 0x020000
-  gpgme_ssize_t bRead = m_crypto_data.read (buffer, size);
+  gpgme_ssize_t bRead;
 #else
-  ssize_t bRead = m_crypto_data.read (buffer, size);
+  ssize_t bRead;
 #endif
+  if (m_streaming)
+    bRead = stream_read (buffer, size);
+  else
+    bRead = m_crypto_data.read (buffer, size);
   if ((opt.enable_debug & DBG_DATA) && bRead)
     {
       std::string buf ((char *)buffer, bRead);
@@ -815,274 +857,487 @@ MimeDataProvider::read(void *buffer, size_t size)
   return bRead;
 }
 
-/* Split some raw data into lines and handle them accordingly.
-   Returns the amount of bytes not taken from the input buffer.
-*/
-size_t
-MimeDataProvider::collect_input_lines(const char *input, size_t insize)
+/* Add LEN bytes of crypto data at DATA.  */
+void
+MimeDataProvider::crypto_write (const void *data, size_t len)
 {
-  TSTART;
-  char linebuf[LINEBUFSIZE];
-  const char *s = input;
-  size_t pos = 0;
-  size_t nleft = insize;
-  size_t not_taken = nleft;
-  size_t len = 0;
+  if (m_streaming)
+    m_crypto_buf.append ((const char *) data, len);
+  else
+    m_crypto_data.write (data, len);
+}
 
-  /* Split the raw data into lines */
-  for (; nleft; nleft--, s++)
+/* Read and parse data from the source until there are at least WANT
+   bytes of crypto data which have not yet been read or the end of
+   the source is reached.  */
+void
+MimeDataProvider::fill_stream (size_t want)
+{
+  char buf[BUFSIZE];
+  size_t bRead;
+
+  while (!m_source_eof && m_crypto_buf.size () - m_crypto_pos < want)
     {
-      if (pos >= LINEBUFSIZE)
+#ifdef HAVE_W32_SYSTEM
+      if (m_stream)
         {
-          log_error ("%s:%s: rfc822 parser failed: line too long\n",
-                     SRCNAME, __func__);
-          GpgME::Error::setSystemError (GPG_ERR_EIO);
-          TRETURN not_taken;
+          ULONG nread = 0;
+          HRESULT hr = m_stream->Read (buf, BUFSIZE, &nread);
+          if (hr != S_OK && hr != S_FALSE)
+            {
+              log_error ("%s:%s: Read failed: hr=%#lx",
+                         SRCNAME, __func__, hr);
+              nread = 0;
+            }
+          bRead = nread;
         }
-      if (*s != '\n')
-        linebuf[pos++] = *s;
       else
+#endif
+        bRead = m_file ? fread (buf, 1, BUFSIZE, m_file) : 0;
+      if (!bRead)
         {
-          /* Got a complete line.  Remove the last CR.  */
-          not_taken -= pos + 1; /* Pos starts at 0 so + 1 for it */
-          if (pos && linebuf[pos-1] == '\r')
-            {
-              pos--;
-            }
+          log_debug ("%s:%s: Input stream at EOF.", SRCNAME, __func__);
+          m_source_eof = true;
+          break;
+        }
+#ifdef HAVE_W32_SYSTEM
+      if (m_first_read && m_stream)
+        {
+          /* We only stream large data thus the fixup for broken
+             PGP messages done in collect_data is not needed.  */
+          check_first_read (buf, bRead);
+        }
+#endif
+      m_first_read = false;
+
+      if (m_collect_everything)
+        {
+          crypto_write (buf, bRead);
+          continue;
+        }
+      if (!feed_input (buf, bRead))
+        {
+          log_error ("%s:%s: Collect failed to consume the data.",
+                     SRCNAME, __func__);
+          m_source_eof = true;
+        }
+    }
+}
+
+/* The read function in streaming mode.  */
+size_t
+MimeDataProvider::stream_read (void *buffer, size_t size)
+{
+  size_t n;
 
-          log_data ("%s:%s: Parsing line=`%.*s'\n",
-                    SRCNAME, __func__, (int)pos, linebuf);
+  fill_stream (size);
+  n = m_crypto_buf.size () - m_crypto_pos;
+  if (n > size)
+    n = size;
+  memcpy (buffer, m_crypto_buf.data () + m_crypto_pos, n);
+  m_crypto_pos += n;
+
+  /* Drop the data which has been read when the window is full.  */
+  if (m_crypto_pos >= STREAM_WINDOW)
+    {
+      log_data ("%s:%s: Dropping " SIZE_T_FORMAT " bytes at offset %lld",
+                SRCNAME, __func__, m_crypto_pos, (long long) m_crypto_base);
+      m_crypto_buf.erase (0, m_crypto_pos);
+      m_crypto_base += m_crypto_pos;
+      m_crypto_pos = 0;
+    }
+  return n;
+}
+
+/* Handle a single line of LEN bytes at LINEBUF.  The line ending has
+   already been stripped.  Note that the decoders work in place and
+   thus LINEBUF is modified.  Returns 0 on success.  */
+int
+MimeDataProvider::collect_line(char *linebuf, size_t pos)
+{
+  TSTART;
+  size_t len = 0;
+
+  log_data ("%s:%s: Parsing line=`%.*s'\n",
+            SRCNAME, __func__, (int)pos, linebuf);
 
 #if 0 /* This is even too verbose for data debugging */
-          log_dbg ("Parser state:\n"
-                   "checked:      %d\n"
-                   "col_body:     %d\n"
-                   "crypt_data:   %d\n"
-                   "hashing:      %d\n"
-                   "in_data:      %d\n"
-                   "signature:    %d\n"
-                   "prot_headers: %d\n",
-                   m_mime_ctx->pgp_marker_checked,
-                   m_mime_ctx->collect_body,
-                   m_mime_ctx->collect_crypto_data,
-                   m_mime_ctx->start_hashing,
-                   m_mime_ctx->in_data,
-                   m_mime_ctx->collect_signature,
-                   m_mime_ctx->in_protected_headers);
+  log_dbg ("Parser state:\n"
+           "checked:      %d\n"
+           "col_body:     %d\n"
+           "crypt_data:   %d\n"
+           "hashing:      %d\n"
+           "in_data:      %d\n"
+           "signature:    %d\n"
+           "prot_headers: %d\n",
+           m_mime_ctx->pgp_marker_checked,
+           m_mime_ctx->collect_body,
+           m_mime_ctx->collect_crypto_data,
+           m_mime_ctx->start_hashing,
+           m_mime_ctx->in_data,
+           m_mime_ctx->collect_signature,
+           m_mime_ctx->in_protected_headers);
 #endif
-          /* Check the next state if we are not currently parsing
-             an encapsulated mime strucutre. */
-          if (!m_mime_ctx->in_encapsulated_msg &&
+  /* Check the next state if we are not currently parsing
+     an encapsulated mime strucutre. */
+  if (!m_mime_ctx->in_encapsulated_msg &&
+      rfc822parse_insert (m_mime_ctx->msg,
+                          (unsigned char*) linebuf,
+                          pos))
+    {
+      log_error ("%s:%s: rfc822 parser failed: %s\n",
+                 SRCNAME, __func__, strerror (errno));
+      TRETURN -1;
+    }
+  else if (m_mime_ctx->in_encapsulated_msg)
+    {
+      /* In an encapsulated message only break out when we see the next
+       * boundary. */
+      const char *boundary = rfc822parse_query_boundary (m_mime_ctx->msg);
+      if (!boundary)
+        {
+          STRANGEPOINT;
+          TRETURN -1;
+        }
+      std::string bound = std::string ("--") + boundary + std::string ("--");
+      std::string line = std::string (linebuf, pos);
+      log_dbg("comparing: '%s' with '%s'", bound.c_str(),
+              line.c_str());
+
+      if (bound == line)
+        {
+          log_dbg ("Found outer boundary of encapsulated message."
+                   " Continuing with rfc822parse.");
+          m_mime_ctx->in_encapsulated_msg = 0;
+          /* Put an empty line followed by the boundary in the parser */
+
+          if (rfc822parse_insert (m_mime_ctx->msg,
+                                  (unsigned char*) "\r\n",
+                                  2) ||
               rfc822parse_insert (m_mime_ctx->msg,
                                   (unsigned char*) linebuf,
                                   pos))
             {
-              log_error ("%s:%s: rfc822 parser failed: %s\n",
+              log_error ("%s:%s: rfc822 encapsulated parser failed: %s\n",
                          SRCNAME, __func__, strerror (errno));
-              TRETURN not_taken;
+              TRETURN -1;
             }
-          else if (m_mime_ctx->in_encapsulated_msg)
-            {
-              /* In an encapsulated message only break out when we see the next
-               * boundary. */
-              const char *boundary = rfc822parse_query_boundary (m_mime_ctx->msg);
-              if (!boundary)
-                {
-                  STRANGEPOINT;
-                  TRETURN not_taken;
-                }
-              std::string bound = std::string ("--") + boundary + std::string ("--");
-              std::string line = std::string (linebuf, pos);
-              log_dbg("comparing: '%s' with '%s'", bound.c_str(),
-                      line.c_str());
+        }
+    }
 
-              if (bound == line)
-                {
-                  log_dbg ("Found outer boundary of encapsulated message."
-                           " Continuing with rfc822parse.");
-                  m_mime_ctx->in_encapsulated_msg = 0;
-                  /* Put an empty line followed by the boundary in the parser */
-
-                  if (rfc822parse_insert (m_mime_ctx->msg,
-                                          (unsigned char*) "\r\n",
-                                          2) ||
-                      rfc822parse_insert (m_mime_ctx->msg,
-                                          (unsigned char*) linebuf,
-                                          pos))
-                    {
-                      log_error ("%s:%s: rfc822 encapsulated parser failed: %s\n",
-                                 SRCNAME, __func__, strerror (errno));
-                      TRETURN not_taken;
-                    }
-                }
-            }
+  /* Check if the first line of the body is actually
+     a PGP Inline message. If so treat it as crypto data. */
+  if (!m_mime_ctx->pgp_marker_checked && m_mime_ctx->collect_body == 2)
+    {
+      m_mime_ctx->pgp_marker_checked = true;
+      if (pos >= 27 && !strncmp ("-----BEGIN PGP MESSAGE-----", linebuf, 27))
+        {
+          log_debug ("%s:%s: Found PGP Message in body.",
+                     SRCNAME, __func__);
+          m_mime_ctx->collect_body = 0;
+          m_mime_ctx->collect_crypto_data = 1;
+          m_mime_ctx->start_hashing = 1;
+          m_collect_everything = true;
+        }
+    }
 
-          /* Check if the first line of the body is actually
-             a PGP Inline message. If so treat it as crypto data. */
-          if (!m_mime_ctx->pgp_marker_checked && m_mime_ctx->collect_body == 2)
+  /* If we are currently in a collecting state actually
+     collect that line */
+  if (m_mime_ctx->collect_crypto_data && m_mime_ctx->start_hashing)
+    {
+      /* Save the signed data.  Note that we need to delay
+         the CR/LF because the last line ending belongs to the
+         next boundary. */
+      if (m_mime_ctx->collect_crypto_data == 2)
+        {
+          crypto_write ("\r\n", 2);
+        }
+      log_data ("Writing raw crypto data: %.*s",
+                       (int)pos, linebuf);
+      crypto_write (linebuf, pos);
+      m_mime_ctx->collect_crypto_data = 2;
+    }
+  if (m_mime_ctx->in_data && !m_mime_ctx->collect_signature &&
+      !m_mime_ctx->collect_crypto_data)
+    {
+      /* We are inside of a plain part.  Write it out. */
+      if (m_mime_ctx->in_data == 1)  /* Skip the first line. */
+        m_mime_ctx->in_data = 2;
+
+      int slbrk = 0;
+      if (m_mime_ctx->is_qp_encoded)
+        len = qp_decode (linebuf, pos, &slbrk);
+      else if (m_mime_ctx->is_base64_encoded)
+        len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
+      else
+        len = pos;
+
+      if (m_mime_ctx->collect_body)
+        {
+          /* For protected headers to filter out the legacy display part
+             we have to first collect it in its own buffer and then later
+             decide if it should be hidden or not. Depending on the
+             reset of the mime structure. The legacy display part must
+             be either text/plain or text/rfc822-headers so we only
+             have to handle this case and not the HTML case below. */
+          if (m_mime_ctx->collect_body == 2)
             {
-              m_mime_ctx->pgp_marker_checked = true;
-              if (pos >= 27 && !strncmp ("-----BEGIN PGP MESSAGE-----", linebuf, 27))
+              std::string *target_buf =
+                (m_mime_ctx->in_protected_headers ? &m_ph_helpbuf : &m_body);
+              target_buf->append (linebuf, len);
+              log_data ("Collecting as possibly protected header: %.*s",
+                        (int)len, linebuf);
+              if (!m_mime_ctx->is_base64_encoded && !slbrk)
                 {
-                  log_debug ("%s:%s: Found PGP Message in body.",
-                             SRCNAME, __func__);
-                  m_mime_ctx->collect_body = 0;
-                  m_mime_ctx->collect_crypto_data = 1;
-                  m_mime_ctx->start_hashing = 1;
-                  m_collect_everything = true;
+                  *target_buf += "\r\n";
                 }
             }
-
-          /* If we are currently in a collecting state actually
-             collect that line */
-          if (m_mime_ctx->collect_crypto_data && m_mime_ctx->start_hashing)
+          if (m_body_charset.empty())
             {
-              /* Save the signed data.  Note that we need to delay
-                 the CR/LF because the last line ending belongs to the
-                 next boundary. */
-              if (m_mime_ctx->collect_crypto_data == 2)
-                {
-                  m_crypto_data.write ("\r\n", 2);
-                }
-              log_data ("Writing raw crypto data: %.*s",
-                               (int)pos, linebuf);
-              m_crypto_data.write (linebuf, pos);
-              m_mime_ctx->collect_crypto_data = 2;
+              m_body_charset = m_mime_ctx->mimestruct_cur->charset ?
+                               m_mime_ctx->mimestruct_cur->charset : "";
             }
-          if (m_mime_ctx->in_data && !m_mime_ctx->collect_signature &&
-              !m_mime_ctx->collect_crypto_data)
+          m_mime_ctx->collect_body = 2;
+        }
+      else if (m_mime_ctx->collect_html_body)
+        {
+          if (m_mime_ctx->collect_html_body == 2)
             {
-              /* We are inside of a plain part.  Write it out. */
-              if (m_mime_ctx->in_data == 1)  /* Skip the first line. */
-                m_mime_ctx->in_data = 2;
-
-              int slbrk = 0;
-              if (m_mime_ctx->is_qp_encoded)
-                len = qp_decode (linebuf, pos, &slbrk);
-              else if (m_mime_ctx->is_base64_encoded)
-                len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
-              else
-                len = pos;
-
-              if (m_mime_ctx->collect_body)
-                {
-                  /* For protected headers to filter out the legacy display part
-                     we have to first collect it in its own buffer and then later
-                     decide if it should be hidden or not. Depending on the
-                     reset of the mime structure. The legacy display part must
-                     be either text/plain or text/rfc822-headers so we only
-                     have to handle this case and not the HTML case below. */
-                  if (m_mime_ctx->collect_body == 2)
-                    {
-                      std::string *target_buf =
-                        (m_mime_ctx->in_protected_headers ? &m_ph_helpbuf : &m_body);
-                      *target_buf += std::string(linebuf, len);
-                      log_data ("Collecting as possibly protected header: %.*s",
-                                (int)len, linebuf);
-                      if (!m_mime_ctx->is_base64_encoded && !slbrk)
-                        {
-                          *target_buf += "\r\n";
-                        }
-                    }
-                  if (m_body_charset.empty())
-                    {
-                      m_body_charset = m_mime_ctx->mimestruct_cur->charset ?
-                                       m_mime_ctx->mimestruct_cur->charset : "";
-                    }
-                  m_mime_ctx->collect_body = 2;
-                }
-              else if (m_mime_ctx->collect_html_body)
-                {
-                  if (m_mime_ctx->collect_html_body == 2)
-                    {
-                      m_html_body += std::string(linebuf, len);
-                      if (!m_mime_ctx->is_base64_encoded && !slbrk)
-                        {
-                          m_html_body += "\r\n";
-                        }
-                    }
-                  if (m_html_charset.empty())
-                    {
-                      m_html_charset = m_mime_ctx->mimestruct_cur->charset ?
-                                       m_mime_ctx->mimestruct_cur->charset : "";
-                    }
-                  m_mime_ctx->collect_html_body = 2;
-                }
-              else if (m_mime_ctx->current_attachment &&
-                       (len || m_mime_ctx->in_encapsulated_msg))
-                {
-                  /* skip the first empty line */
-                  if (!len && m_mime_ctx->in_encapsulated_msg == 1)
-                    {
-                      m_mime_ctx->in_encapsulated_msg = 2;
-                    }
-                  else
-                    {
-                      m_mime_ctx->current_attachment->get_data().write(linebuf, len);
-                      if (!m_mime_ctx->is_base64_encoded && !slbrk)
-                        {
-                          m_mime_ctx->current_attachment->get_data().write("\r\n", 2);
-                        }
-                    }
-                }
-              else
+              m_html_body.append (linebuf, len);
+              if (!m_mime_ctx->is_base64_encoded && !slbrk)
                 {
-                  log_debug ("%s:%s Collecting finished.",
-                             SRCNAME, __func__);
+                  m_html_body += "\r\n";
                 }
             }
-          else if (m_mime_ctx->in_data && m_mime_ctx->collect_signature)
+          if (m_html_charset.empty())
+            {
+              m_html_charset = m_mime_ctx->mimestruct_cur->charset ?
+                               m_mime_ctx->mimestruct_cur->charset : "";
+            }
+          m_mime_ctx->collect_html_body = 2;
+        }
+      else if (m_mime_ctx->current_attachment &&
+               (len || m_mime_ctx->in_encapsulated_msg))
+        {
+          /* skip the first empty line */
+          if (!len && m_mime_ctx->in_encapsulated_msg == 1)
             {
-              /* We are inside of a signature attachment part.  */
-              if (m_mime_ctx->collect_signature == 1)  /* Skip the first line. */
-                m_mime_ctx->collect_signature = 2;
-              else
+              m_mime_ctx->in_encapsulated_msg = 2;
+            }
+          else
+            {
+              m_mime_ctx->current_attachment->get_data().write(linebuf, len);
+              if (!m_mime_ctx->is_base64_encoded && !slbrk)
                 {
-                  int slbrk = 0;
-
-                  if (m_mime_ctx->is_qp_encoded)
-                    len = qp_decode (linebuf, pos, &slbrk);
-                  else if (m_mime_ctx->is_base64_encoded)
-                    len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
-                  else
-                    len = pos;
-                  if (!m_signature)
-                    {
-                      m_signature = new GpgME::Data();
-                    }
-                  if (len)
-                    m_signature->write(linebuf, len);
-                  if (!m_mime_ctx->is_base64_encoded && !slbrk)
-                    m_signature->write("\r\n", 2);
+                  m_mime_ctx->current_attachment->get_data().write("\r\n", 2);
                 }
             }
-          else if (m_mime_ctx->in_data && !m_mime_ctx->start_hashing)
+        }
+      else
+        {
+          log_debug ("%s:%s Collecting finished.",
+                     SRCNAME, __func__);
+        }
+    }
+  else if (m_mime_ctx->in_data && m_mime_ctx->collect_signature)
+    {
+      /* We are inside of a signature attachment part.  */
+      if (m_mime_ctx->collect_signature == 1)  /* Skip the first line. */
+        m_mime_ctx->collect_signature = 2;
+      else
+        {
+          int slbrk = 0;
+
+          if (m_mime_ctx->is_qp_encoded)
+            len = qp_decode (linebuf, pos, &slbrk);
+          else if (m_mime_ctx->is_base64_encoded)
+            len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
+          else
+            len = pos;
+          if (!m_signature)
             {
-              /* We are inside the data.  That should be the actual
-                 ciphertext in the given encoding. */
-              int slbrk = 0;
-
-              if (m_mime_ctx->is_qp_encoded)
-                len = qp_decode (linebuf, pos, &slbrk);
-              else if (m_mime_ctx->is_base64_encoded)
-                len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
-              else
-                len = pos;
-              log_data ("Writing crypto data: %.*s",
-                         (int)pos, linebuf);
-              if (len)
-                m_crypto_data.write(linebuf, len);
-              if (!m_mime_ctx->is_base64_encoded && !slbrk)
-                m_crypto_data.write("\r\n", 2);
+              m_signature = new GpgME::Data();
             }
-          /* Continue with next line. */
-          pos = 0;
+          if (len)
+            m_signature->write(linebuf, len);
+          if (!m_mime_ctx->is_base64_encoded && !slbrk)
+            m_signature->write("\r\n", 2);
+        }
+    }
+  else if (m_mime_ctx->in_data && !m_mime_ctx->start_hashing)
+    {
+      /* We are inside the data.  That should be the actual
+         ciphertext in the given encoding. */
+      int slbrk = 0;
+
+      if (m_mime_ctx->is_qp_encoded)
+        len = qp_decode (linebuf, pos, &slbrk);
+      else if (m_mime_ctx->is_base64_encoded)
+        len = b64_decode (&m_mime_ctx->base64, linebuf, pos);
+      else
+        len = pos;
+      log_data ("Writing crypto data: %.*s",
+                 (int)pos, linebuf);
+      if (len)
+        crypto_write (linebuf, len);
+      if (!m_mime_ctx->is_base64_encoded && !slbrk)
+        crypto_write ("\r\n", 2);
+    }
+  TRETURN 0;
+}
+
+/* Split some raw data into lines and handle them accordingly.  The
+   lines are not copied but handed to the parser as pointers into
+   INPUT.  The amount of bytes at the end of INPUT which do not form a
+   complete line is stored at R_NOT_TAKEN.  Returns 0 on success.
+*/
+int
+MimeDataProvider::collect_input_lines(char *input, size_t insize,
+                                      size_t *r_not_taken)
+{
+  TSTART;
+  char *s = input;
+  size_t nleft = insize;
+  char *eol;
+
+  *r_not_taken = nleft;
+  while (nleft && (eol = (char *) memchr (s, '\n', nleft)))
+    {
+      size_t pos = eol - s;
+
+      if (pos >= LINEBUFSIZE)
+        {
+          log_error ("%s:%s: rfc822 parser failed: line too long\n",
+                     SRCNAME, __func__);
+          GpgME::Error::setSystemError (GPG_ERR_EIO);
+          TRETURN -1;
+        }
+      /* Got a complete line.  Remove the last CR.  */
+      size_t linelen = pos;
+      if (linelen && s[linelen-1] == '\r')
+        {
+          linelen--;
+        }
+      if (collect_line (s, linelen))
+        {
+          /* As before we skip a line the parser did not accept and
+             continue with the next one.  */
+          log_debug ("%s:%s: Skipping line the parser failed on.",
+                     SRCNAME, __func__);
+        }
+      s = eol + 1;
+      nleft -= pos + 1;
+      *r_not_taken = nleft;
+    }
+  TRETURN 0;
+}
+
+/* Feed SIZE bytes of raw data from BUFFER into the line splitter.
+   Only an incomplete line at the end of the buffer is copied and kept
+   in m_rawbuf until the rest of it arrives with the next call.
+   Returns false if the data could not be processed.  */
+bool
+MimeDataProvider::feed_input(char *buffer, size_t size)
+{
+  TSTART;
+  size_t not_taken;
+
+  if (!m_rawbuf.empty ())
+    {
+      const char *eol = (const char *) memchr (buffer, '\n', size);
+      size_t n = eol ? (size_t)(eol - buffer + 1) : size;
+
+      if (m_rawbuf.size () + n > LINEBUFSIZE)
+        {
+          log_error ("%s:%s: rfc822 parser failed: line too long\n",
+                     SRCNAME, __func__);
+          GpgME::Error::setSystemError (GPG_ERR_EIO);
+          TRETURN false;
+        }
+      m_rawbuf.append (buffer, n);
+      if (!eol)
+        {
+          TRETURN true;
         }
+      /* Process the now complete carried over line.  */
+      if (collect_input_lines (&m_rawbuf[0], m_rawbuf.size (), &not_taken))
+        {
+          TRETURN false;
+        }
+      m_rawbuf.clear ();
+      buffer += n;
+      size -= n;
+    }
+
+  if (collect_input_lines (buffer, size, &not_taken))
+    {
+      TRETURN false;
+    }
+  if (not_taken >= LINEBUFSIZE)
+    {
+      log_error ("%s:%s: rfc822 parser failed: line too long\n",
+                 SRCNAME, __func__);
+      GpgME::Error::setSystemError (GPG_ERR_EIO);
+      TRETURN false;
     }
-  TRETURN not_taken;
+  log_data ("%s:%s: Consumed: " SIZE_T_FORMAT " bytes",
+            SRCNAME, __func__, size - not_taken);
+  m_rawbuf.assign (buffer + size - not_taken, not_taken);
+  TRETURN true;
 }
 
 #ifdef HAVE_W32_SYSTEM
+/* Look at the first BREAD bytes at BUF read from a stream to check
+   whether we have to parse MIME data after all.  Returns true if
+   this looks like a PGP message.  */
+bool
+MimeDataProvider::check_first_read (const char *buf, size_t bRead)
+{
+  TSTART;
+  if (bRead > 12 && strncmp ("MIME-Version", buf, 12) == 0)
+    {
+      /* Fun! In case we have exchange or sent messages created by us
+         we get the mail attachment like it is before the MAPI to MIME
+         conversion. So it has our MIME structure. In that case
+         we have to expect MIME data even if the initial data check
+         suggests that we don't.
+
+         Checking if the content starts with MIME-Version appears
+         to be a robust way to check if we try to parse MIME data. */
+      m_collect_everything = false;
+      log_debug ("%s:%s: Found MIME-Version marker."
+                 "Expecting headers even if type suggested not to.",
+                 SRCNAME, __func__);
+
+    }
+  else if (bRead > 12 && !strncmp ("Content-Type:", buf, 13))
+    {
+      /* Similar as above but we messed with the order of the headers
+         for some s/mime mails. So also check for content type.
+
+         Want some cheese with that hack?
+      */
+      m_collect_everything = false;
+      log_debug ("%s:%s: Found Content-Type header."
+                 "Expecting headers even if type suggested not to.",
+                 SRCNAME, __func__);
+
+    }
+  /* check for the PGP MESSAGE marker to see if we have it. */
+  if (bRead && m_collect_everything)
+    {
+      std::string tmp (buf, bRead);
+      std::size_t found = tmp.find ("-----BEGIN PGP MESSAGE-----");
+      if (found != std::string::npos)
+        {
+          log_debug ("%s:%s: found PGP Message marker,",
+                     SRCNAME, __func__);
+          TRETURN true;
+        }
+    }
+  TRETURN false;
+}
+
 void
 MimeDataProvider::collect_data(LPSTREAM stream)
 {
@@ -1111,47 +1366,7 @@ MimeDataProvider::collect_data(LPSTREAM stream)
       allRead += bRead;
       if (first_read)
         {
-          if (bRead > 12 && strncmp ("MIME-Version", buf, 12) == 0)
-            {
-              /* Fun! In case we have exchange or sent messages created by us
-                 we get the mail attachment like it is before the MAPI to MIME
-                 conversion. So it has our MIME structure. In that case
-                 we have to expect MIME data even if the initial data check
-                 suggests that we don't.
-
-                 Checking if the content starts with MIME-Version appears
-                 to be a robust way to check if we try to parse MIME data. */
-              m_collect_everything = false;
-              log_debug ("%s:%s: Found MIME-Version marker."
-                         "Expecting headers even if type suggested not to.",
-                         SRCNAME, __func__);
-
-            }
-          else if (bRead > 12 && !strncmp ("Content-Type:", buf, 13))
-            {
-              /* Similar as above but we messed with the order of the headers
-                 for some s/mime mails. So also check for content type.
-
-                 Want some cheese with that hack?
-              */
-              m_collect_everything = false;
-              log_debug ("%s:%s: Found Content-Type header."
-                         "Expecting headers even if type suggested not to.",
-                         SRCNAME, __func__);
-
-            }
-          /* check for the PGP MESSAGE marker to see if we have it. */
-          if (bRead && m_collect_everything)
-            {
-              std::string tmp (buf, bRead);
-              std::size_t found = tmp.find ("-----BEGIN PGP MESSAGE-----");
-              if (found != std::string::npos)
-                {
-                  log_debug ("%s:%s: found PGP Message marker,",
-                             SRCNAME, __func__);
-                  is_pgp_message = true;
-                }
-            }
+          is_pgp_message = check_first_read (buf, bRead);
         }
       first_read = false;
 
@@ -1165,20 +1380,12 @@ MimeDataProvider::collect_data(LPSTREAM stream)
           m_crypto_data.write ((void*)buf, (size_t) bRead);
           continue;
         }
-      m_rawbuf += std::string (buf, bRead);
-      size_t not_taken = collect_input_lines (m_rawbuf.c_str(),
-                                              m_rawbuf.size());
-
-      if (not_taken == m_rawbuf.size())
+      if (!feed_input (buf, bRead))
         {
-          log_error ("%s:%s: Collect failed to consume anything.\n"
-                     "Buffer too small?",
+          log_error ("%s:%s: Collect failed to consume the data.",
                      SRCNAME, __func__);
           break;
         }
-      log_debug ("%s:%s: Consumed: " SIZE_T_FORMAT " bytes",
-                 SRCNAME, __func__, m_rawbuf.size() - not_taken);
-      m_rawbuf.erase (0, m_rawbuf.size() - not_taken);
     }
 
 
@@ -1250,20 +1457,12 @@ MimeDataProvider::collect_data(FILE *stream)
           m_crypto_data.write ((void*)buf, bRead);
           continue;
         }
-      m_rawbuf += std::string (buf, bRead);
-      size_t not_taken = collect_input_lines (m_rawbuf.c_str(),
-                                              m_rawbuf.size());
-
-      if (not_taken == m_rawbuf.size())
+      if (!feed_input (buf, bRead))
         {
-          log_error ("%s:%s: Collect failed to consume anything.\n"
-                     "Buffer too small?",
+          log_error ("%s:%s: Collect failed to consume the data.",
                      SRCNAME, __func__);
           TRETURN;
         }
-      log_debug ("%s:%s: Consumed: " SIZE_T_FORMAT " bytes",
-                 SRCNAME, __func__, m_rawbuf.size() - not_taken);
-      m_rawbuf.erase (0, m_rawbuf.size() - not_taken);
     }
   TRETURN;
 }
@@ -1284,20 +1483,15 @@ ssize_t MimeDataProvider::write(const void *buffer, size_t bufSize)
       m_body += std::string ((const char *) buffer, bufSize);
       TRETURN bufSize;
     }
-  m_rawbuf += std::string ((const char*)buffer, bufSize);
-  size_t not_taken = collect_input_lines (m_rawbuf.c_str(),
-                                          m_rawbuf.size());
-
-  if (not_taken == m_rawbuf.size())
+  /* The decoders work in place so we need a writable copy.  The
+     scratch buffer keeps its capacity over calls.  */
+  m_writebuf.assign ((const char*)buffer, bufSize);
+  if (!feed_input (&m_writebuf[0], m_writebuf.size ()))
     {
-      log_error ("%s:%s: Write failed to consume anything.\n"
-                 "Buffer too small? or no newlines in text?",
+      log_error ("%s:%s: Write failed to consume the data.\n"
+                 "Line too long?",
                  SRCNAME, __func__);
-      TRETURN bufSize;
     }
-  log_debug ("%s:%s: Write Consumed: " SIZE_T_FORMAT " bytes",
-                   SRCNAME, __func__, m_rawbuf.size() - not_taken);
-  m_rawbuf.erase (0, m_rawbuf.size() - not_taken);
   TRETURN bufSize;
 }
 
@@ -1309,7 +1503,38 @@ off_t
 MimeDataProvider::seek(off_t offset, int whence)
 #endif
 {
-  return m_crypto_data.seek (offset, whence);
+  if (!m_streaming)
+    return m_crypto_data.seek (offset, whence);
+
+  /* In streaming mode we can only seek within the window.  */
+  gpgme_off_t target;
+  switch (whence)
+    {
+      case SEEK_SET:
+        target = offset;
+        break;
+      case SEEK_CUR:
+        target = m_crypto_base + (gpgme_off_t) m_crypto_pos + offset;
+        break;
+      default:
+        log_error ("%s:%s: Seeking relative to the end is not supported "
+                   "in streaming mode.", SRCNAME, __func__);
+        errno = ESPIPE;
+        return -1;
+    }
+  if (target > m_crypto_base + (gpgme_off_t) m_crypto_buf.size ())
+    fill_stream (target - m_crypto_base - m_crypto_pos);
+  if (target < m_crypto_base
+      || target > m_crypto_base + (gpgme_off_t) m_crypto_buf.size ())
+    {
+      log_error ("%s:%s: Can't seek to %lld outside of the window at %lld.",
+                 SRCNAME, __func__, (long long) target,
+                 (long long) m_crypto_base);
+      errno = EINVAL;
+      return -1;
+    }
+  m_crypto_pos = (size_t) (target - m_crypto_base);
+  return target;
 }
 
 GpgME::Data *
@@ -1407,9 +1632,12 @@ void MimeDataProvider::finalize ()
 
   if (m_rawbuf.size ())
     {
+      size_t not_taken = 0;
       m_rawbuf += "\r\n";
-      size_t not_taken = collect_input_lines (m_rawbuf.c_str(),
-                                              m_rawbuf.size());
+      if (collect_input_lines (&m_rawbuf[0], m_rawbuf.size (), &not_taken))
+        {
+          not_taken = m_rawbuf.size ();
+        }
       m_rawbuf.erase (0, m_rawbuf.size() - not_taken);
       if (m_rawbuf.size ())
         {
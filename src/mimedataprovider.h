@@ -72,11 +72,21 @@ public:
      If no_headers is set to true, assume that there are no
      headers and immediately start collecting crypto data.
      Eg. When decrypting a MOSS Attachment.
+
+     If streaming is set to true the stream is not read in
+     the constructor but only while the crypto data is read
+     from the provider.  Only a window of the crypto data is
+     kept in memory and seeking back is only possible within
+     that window.  A reference to the stream is held until the
+     provider is destroyed.
      */
-  MimeDataProvider(LPSTREAM stream, bool no_headers = false);
+  MimeDataProvider(LPSTREAM stream, bool no_headers = false,
+                   bool streaming = false);
 #endif
-  /* Test instrumentation. */
-  MimeDataProvider(FILE *stream, bool no_headers = false);
+  /* Test instrumentation.  In streaming mode the file must stay
+     open until the provider is destroyed. */
+  MimeDataProvider(FILE *stream, bool no_headers = false,
+                   bool streaming = false);
   ~MimeDataProvider();
 
   /* Dataprovider interface */
@@ -147,15 +157,36 @@ public:
   /* Search for the MIME Header which. Handles line continuation
      and encoding to return an UTF-8 encoded header. */
   std::string get_header (const std::string &which) const;
+
+  /* Returns true if the provider reads its input only on demand. */
+  bool is_streaming () const {return m_streaming;}
 private:
+  friend class DecryptCache;
+
 #ifdef HAVE_W32_SYSTEM
   /* Collect the data from mapi. */
   void collect_data(LPSTREAM stream);
+  /* Check the start of a stream for MIME data. */
+  bool check_first_read(const char *buf, size_t len);
 #endif
   /* Collect data from a file. */
   void collect_data(FILE *stream);
-  /* Collect a single line. */
-  size_t collect_input_lines(const char *input, size_t size);
+  /* Split raw data into lines.  The data in BUFFER is processed in
+     place and may be modified by the decoders.  Returns false if
+     nothing could be consumed. */
+  bool feed_input(char *buffer, size_t size);
+  /* Parse the complete lines in input.  Stores the number of bytes
+     at the end of input that do not form a complete line at
+     r_not_taken.  Returns 0 on success. */
+  int collect_input_lines(char *input, size_t size, size_t *r_not_taken);
+  /* Handle a single line without the line ending. */
+  int collect_line(char *line, size_t len);
+  /* Add data to the crypto data. */
+  void crypto_write(const void *data, size_t len);
+  /* Streaming mode: Parse more input until want bytes are available. */
+  void fill_stream(size_t want);
+  /* Streaming mode: Read from the window. */
+  size_t stream_read(void *buffer, size_t size);
   /* A detached signature found in the input */
   std::string m_sig_data;
   /* The data to be passed to the crypto operation */
@@ -166,8 +197,10 @@ private:
   std::string m_html_body;
   /* A detachted signature found in the mail */
   GpgME::Data *m_signature;
-  /* Internal helper to read line based */
+  /* Carry over buffer for an incomplete line at the end of a read. */
   std::string m_rawbuf;
+  /* Scratch buffer for data passed to write which we can't modify. */
+  std::string m_writebuf;
   /* The mime context */
   mime_context_t m_mime_ctx;
   /* List of attachments. */
@@ -186,5 +219,23 @@ private:
   std::string m_ph_helpbuf;
   /* Main content type */
   std::string m_content_type;
+  /* Read the input only on demand */
+  bool m_streaming;
+#ifdef HAVE_W32_SYSTEM
+  /* The input stream in streaming mode */
+  LPSTREAM m_stream;
+#endif
+  /* The input file in streaming mode */
+  FILE *m_file;
+  /* The end of the input has been reached */
+  bool m_source_eof;
+  /* Nothing has been read from the input yet */
+  bool m_first_read;
+  /* Streaming mode: The window of crypto data */
+  std::string m_crypto_buf;
+  /* Streaming mode: The read position in the window */
+  size_t m_crypto_pos;
+  /* Streaming mode: The offset of the window in the crypto data */
+  gpgme_off_t m_crypto_base;
 };
 #endif // MIMEDATAPROVIDER_H
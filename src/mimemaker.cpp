@@ -44,6 +44,7 @@
 #include "mail.h"
 #include "attachment.h"
 #include "cpphelp.h"
+#include "partcache.h"
 
 #undef _
 #define _(a) utf8_gettext (a)
@@ -51,12 +52,6 @@
 static const unsigned char oid_mimetag[] =
     {0x2A, 0x86, 0x48, 0x86, 0xf7, 0x14, 0x03, 0x0a, 0x04};
 
-/* The base-64 list used for base64 encoding. */
-static unsigned char bintoasc[64+1] = ("ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-                                       "abcdefghijklmnopqrstuvwxyz"
-                                       "0123456789+/");
-
-
 /* Object used to collect data in a memory buffer.  */
 struct databuf_s
 {
@@ -147,6 +142,8 @@ create_mapi_attachment (LPMESSAGE message, sink_t sink,
 
   sink->cb_data = NULL;
   sink->writefnc = NULL;
+  sink->buffer = NULL;
+  sink->buflen = sink->bufsize = 0;
   hr = message->CreateAttach(NULL, 0, &pos, &att);
   memdbg_addRef (att);
   if (hr)
@@ -230,6 +227,8 @@ create_mapi_attachment (LPMESSAGE message, sink_t sink,
     }
   sink->cb_data = (LPSTREAM)punk;
   sink->writefnc = sink_std_write;
+  /* Each write to the stream is a COM call.  */
+  sink_set_buffer (sink, SINK_BUFFER_SIZE);
   return att;
 
  failure:
@@ -238,39 +237,6 @@ create_mapi_attachment (LPMESSAGE message, sink_t sink,
 }
 
 
-/* Write data to a sink_t.  */
-int
-write_buffer (sink_t sink, const void *data, size_t datalen)
-{
-  if (!sink || !sink->writefnc)
-    {
-      log_error ("%s:%s: sink not properly setup", SRCNAME, __func__);
-      return -1;
-    }
-  return sink->writefnc (sink, data, datalen);
-}
-
-/* Same as above but used for passing as callback function.  This
-   fucntion does not return an error code but the number of bytes
-   written.  */
-int
-write_buffer_for_cb (void *opaque, const void *data, size_t datalen)
-{
-  sink_t sink = (sink_t) opaque;
-  sink->enc_counter += datalen;
-  return write_buffer (sink, data, datalen) ? -1 : datalen;
-}
-
-
-/* Write the string TEXT to the IStream STREAM.  Returns 0 on sucsess,
-   prints an error message and returns -1 on error.  */
-int
-write_string (sink_t sink, const char *text)
-{
-  return write_buffer (sink, text, strlen (text));
-}
-
-
 /* Write the string TEXT1 and all folloing arguments of type (const
    char*) to the SINK.  The list of argumens needs to be terminated
    with a NULL.  Returns 0 on sucsess, prints an error message and
@@ -279,15 +245,27 @@ static int
 write_multistring (sink_t sink, const char *text1, ...)
 {
   va_list arg_ptr;
-  int rc;
+  int rc = 0;
   const char *s;
+  sink_iov_t iov[8];
+  size_t iovcnt = 0;
 
   va_start (arg_ptr, text1);
   s = text1;
   do
-    rc = write_string (sink, s);
+    {
+      if (iovcnt == DIM (iov))
+        {
+          rc = write_bufferv (sink, iov, iovcnt);
+          iovcnt = 0;
+        }
+      iov[iovcnt].data = s;
+      iov[iovcnt++].datalen = strlen (s);
+    }
   while (!rc && (s=va_arg (arg_ptr, const char *)));
   va_end (arg_ptr);
+  if (!rc)
+    rc = write_bufferv (sink, iov, iovcnt);
   return rc;
 }
 
@@ -298,99 +276,15 @@ write_multistring (sink_t sink, const char *text1, ...)
 int
 write_boundary (sink_t sink, const char *boundary, int lastone)
 {
-  int rc = write_string (sink, "\r\n--");
-  if (!rc)
-    rc = write_string (sink, boundary);
-  if (!rc)
-    rc = write_string (sink, lastone? "--\r\n":"\r\n");
-  return rc;
-}
-
-
-/* Write DATALEN bytes of DATA to SINK in base64 encoding.  This
-   creates a complete Base64 chunk including the trailing fillers.  */
-int
-write_b64 (sink_t sink, const void *data, size_t datalen)
-{
-  int rc;
-  const unsigned char *p;
-  unsigned char inbuf[4];
-  int idx, quads;
-  char outbuf[2048];
-  size_t outlen;
-
-  log_debug ("  writing base64 of length %d\n", (int)datalen);
-  idx = quads = 0;
-  outlen = 0;
-  for (p = (const unsigned char*)data; datalen; p++, datalen--)
-    {
-      inbuf[idx++] = *p;
-      if (idx > 2)
-        {
-          /* We need space for a quad and a possible CR,LF.  */
-          if (outlen+4+2 >= sizeof outbuf)
-            {
-              if ((rc = write_buffer (sink, outbuf, outlen)))
-                return rc;
-              outlen = 0;
-            }
-          outbuf[outlen++] = bintoasc[(*inbuf>>2)&077];
-          outbuf[outlen++] = bintoasc[(((*inbuf<<4)&060)
-                                       |((inbuf[1] >> 4)&017))&077];
-          outbuf[outlen++] = bintoasc[(((inbuf[1]<<2)&074)
-                                       |((inbuf[2]>>6)&03))&077];
-          outbuf[outlen++] = bintoasc[inbuf[2]&077];
-          idx = 0;
-          if (++quads >= (64/4))
-            {
-              quads = 0;
-              outbuf[outlen++] = '\r';
-              outbuf[outlen++] = '\n';
-            }
-        }
-    }
+  const char *end = lastone? "--\r\n":"\r\n";
+  sink_iov_t iov[3] = {{"\r\n--", 4},
+                       {boundary, strlen (boundary)},
+                       {end, strlen (end)}};
 
-  /* We need space for a quad and a final CR,LF.  */
-  if (outlen+4+2 >= sizeof outbuf)
-    {
-      if ((rc = write_buffer (sink, outbuf, outlen)))
-        return rc;
-      outlen = 0;
-    }
-  if (idx)
-    {
-      outbuf[outlen++] = bintoasc[(*inbuf>>2)&077];
-      if (idx == 1)
-        {
-          outbuf[outlen++] = bintoasc[((*inbuf<<4)&060)&077];
-          outbuf[outlen++] = '=';
-          outbuf[outlen++] = '=';
-        }
-      else
-        {
-          outbuf[outlen++] = bintoasc[(((*inbuf<<4)&060)
-                                    |((inbuf[1]>>4)&017))&077];
-          outbuf[outlen++] = bintoasc[((inbuf[1]<<2)&074)&077];
-          outbuf[outlen++] = '=';
-        }
-      ++quads;
-    }
-
-  if (quads)
-    {
-      outbuf[outlen++] = '\r';
-      outbuf[outlen++] = '\n';
-    }
-
-  if (outlen)
-    {
-      if ((rc = write_buffer (sink, outbuf, outlen)))
-        return rc;
-    }
-
-  return 0;
+  return write_bufferv (sink, iov, DIM (iov));
 }
 
+
 /* Write DATALEN bytes of DATA to SINK in quoted-prinable encoding. */
 static int
 write_qp (sink_t sink, const void *data, size_t datalen)
@@ -1010,6 +904,51 @@ count_usable_attachments (mapi_attach_item_t *table)
   return count;
 }
 
+/* Write the attachment DATA as a MIME part like write_part.  If the
+   partCache option is set large attachments are looked up in the
+   PartCache first so that an attachment which is sent again is not
+   analyzed and encoded again.  */
+static int
+write_attachment (sink_t sink, const std::string &data,
+                  const char *boundary, const std::string &name,
+                  const std::string &cid)
+{
+  int rc;
+
+  if (!opt.part_cache || data.size () < PART_CACHE_MIN_SIZE)
+    return write_part (sink, data.c_str (), data.size (), boundary,
+                       name.c_str (), 0, cid.size () ? cid.c_str () : nullptr);
+
+  auto cache = PartCache::instance ();
+  auto part = cache->find (data, name, cid);
+  if (!part)
+    {
+      std::string encoded;
+      struct sink_s sinkmem;
+      sink_t partsink = &sinkmem;
+
+      memset (partsink, 0, sizeof *partsink);
+      partsink->writefnc = sink_string_append;
+      partsink->cb_data = &encoded;
+      if ((rc = write_part (partsink, data.c_str (), data.size (), NULL,
+                            name.c_str (), 0,
+                            cid.size () ? cid.c_str () : nullptr)))
+        return rc;
+      cache->store (data, name, cid, encoded);
+      if (boundary)
+        if ((rc = write_boundary (sink, boundary, 0)))
+          return rc;
+      rc = write_buffer (sink, encoded.data (), encoded.size ());
+      wipememory (&encoded[0], encoded.size ());
+      return rc;
+    }
+
+  if (boundary)
+    if ((rc = write_boundary (sink, boundary, 0)))
+      return rc;
+  return write_buffer (sink, part->data (), part->size ());
+}
+
 /* Write out all attachments from TABLE separated by BOUNDARY to SINK.
    This function needs to be syncronized with count_usable_attachments.
    If only_related is 1 only include attachments for multipart/related they
@@ -1062,8 +1001,7 @@ write_attachments (sink_t sink,
               TRETURN -1;
             }
         }
-      rc = write_part (sink, buf.c_str (), buf.size (), boundary,
-                       name.c_str (), 0, cid.size () ? cid.c_str () : nullptr);
+      rc = write_attachment (sink, buf, boundary, name, cid);
       if (rc)
         {
           log_error ("Write part returned err: %i", rc);
@@ -1113,6 +1051,9 @@ close_mapi_attachment (LPATTACH *attach, sink_t sink)
       log_error ("%s:%s: sink not setup", SRCNAME, __func__);
       return -1;
     }
+  if (sink_flush (sink))
+    return -1;
+  sink_release_buffer (sink);
   hr = stream->Commit (0);
   if (hr)
     {
@@ -1144,6 +1085,7 @@ cancel_mapi_attachment (LPATTACH *attach, sink_t sink)
 {
   LPSTREAM stream = sink ? (LPSTREAM) sink->cb_data : NULL;
 
+  sink_release_buffer (sink);
   if (stream)
     {
       stream->Revert();
@@ -1689,6 +1631,7 @@ restore_msg_from_moss (LPMESSAGE message, LPDISPATCH moss_att,
 
   err = 0;
 done:
+  sink_release_buffer (sink);
   xfree (orig);
   return err;
 }
@@ -23,6 +23,7 @@
 #define MIMEMAKER_H
 
 #include "mapihelp.h"
+#include "sink.h"
 
 class Mail;
 #ifdef __cplusplus
@@ -37,29 +38,9 @@ extern "C" {
 #define OPENPGP_SIG_NAME "openpgp-digital-signature.asc"
 #define SMIME_SIG_NAME "smime.p7s"
 
-/* The object we use instead of IStream.  It allows us to have a
-   callback method for output and thus for processing stuff
-   recursively.  */
-struct sink_s;
-typedef struct sink_s *sink_t;
-struct sink_s
-{
-  void *cb_data;
-  sink_t extrasink;
-  int (*writefnc)(sink_t sink, const void *data, size_t datalen);
-  unsigned long enc_counter; /* Used by write_buffer_for_cb.  */
-/*   struct { */
-/*     int idx; */
-/*     unsigned char inbuf[4]; */
-/*     int quads; */
-/*   } b64; */
-};
-
 int sink_std_write (sink_t sink, const void *data, size_t datalen);
 int sink_file_write (sink_t sink, const void *data, size_t datalen);
 int sink_encryption_write (sink_t encsink, const void *data, size_t datalen);
-int write_buffer_for_cb (void *opaque, const void *data, size_t datalen);
-int write_buffer (sink_t sink, const void *data, size_t datalen);
 
 /** @brief Try to restore a message from the moss attachment.
   *
@@ -90,8 +71,6 @@ int finalize_message (LPMESSAGE message, mapi_attach_item_t *att_table,
 void cancel_mapi_attachment (LPATTACH *attach, sink_t sink);
 void create_top_signing_header (char *buffer, size_t buflen, protocol_t protocol,
                            int first, const char *boundary, const char *micalg);
-int write_string (sink_t sink, const char *text);
-int write_b64 (sink_t sink, const void *data, size_t datalen);
 
 /* Encode an input string according to rfc2047
    caller needs to free result. */
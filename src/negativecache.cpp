@@ -0,0 +1,221 @@
+/* @file negativecache.cpp
+ * @brief Remember key lookups which found nothing
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "negativecache.h"
+
+#include "common_indep.h"
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <time.h>
+#endif
+
+#include <unordered_map>
+
+/* A monotonic time in milliseconds.  */
+static unsigned long long
+now_msec ()
+{
+#ifdef HAVE_W32_SYSTEM
+  return GetTickCount64 ();
+#else
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+static std::string
+make_key (const std::string &mbox, int protocol)
+{
+  return std::to_string (protocol) + ":" + mbox;
+}
+
+class NegativeCache::Private
+{
+public:
+  Private () :
+    m_ttl (NEGATIVE_CACHE_TTL),
+    m_stats ()
+  {
+#ifdef HAVE_W32_SYSTEM
+    InitializeCriticalSection (&m_lock);
+#else
+    pthread_mutex_init (&m_lock, nullptr);
+#endif
+  }
+
+  ~Private ()
+  {
+#ifdef HAVE_W32_SYSTEM
+    DeleteCriticalSection (&m_lock);
+#else
+    pthread_mutex_destroy (&m_lock);
+#endif
+  }
+
+#ifdef HAVE_W32_SYSTEM
+  void lock () { EnterCriticalSection (&m_lock); }
+  void unlock () { LeaveCriticalSection (&m_lock); }
+#else
+  void lock () { pthread_mutex_lock (&m_lock); }
+  void unlock () { pthread_mutex_unlock (&m_lock); }
+#endif
+
+  /* Let all entries expire.  Called with the lock held.  */
+  void
+  expireAll ()
+  {
+    for (auto &pair: m_expires)
+      {
+        pair.second = 0;
+      }
+    m_stats.invalidations++;
+  }
+
+  /* The key and the time the entry expires.  */
+  std::unordered_map<std::string, unsigned long long> m_expires;
+  std::string m_stamp;
+  unsigned int m_ttl;
+  stats_s m_stats;
+#ifdef HAVE_W32_SYSTEM
+  CRITICAL_SECTION m_lock;
+#else
+  pthread_mutex_t m_lock;
+#endif
+};
+
+NegativeCache::NegativeCache () :
+  d (new Private)
+{
+}
+
+void
+NegativeCache::setTTL (unsigned int seconds)
+{
+  d->lock ();
+  d->m_ttl = seconds;
+  d->unlock ();
+}
+
+void
+NegativeCache::add (const std::string &mbox, int protocol)
+{
+  d->lock ();
+  if (d->m_ttl && !mbox.empty ())
+    {
+      d->m_expires[make_key (mbox, protocol)] = now_msec ()
+                                                + d->m_ttl * 1000ULL;
+    }
+  d->unlock ();
+}
+
+NegativeCache::State
+NegativeCache::lookup (const std::string &mbox, int protocol)
+{
+  State ret = Unknown;
+
+  d->lock ();
+  const auto it = d->m_expires.find (make_key (mbox, protocol));
+  if (it != d->m_expires.end ())
+    {
+      if (d->m_ttl && it->second > now_msec ())
+        {
+          ret = Fresh;
+        }
+      else
+        {
+          ret = Expired;
+          d->m_expires.erase (it);
+        }
+    }
+  if (ret == Fresh)
+    {
+      d->m_stats.hits++;
+    }
+  else
+    {
+      d->m_stats.misses++;
+    }
+  d->unlock ();
+  return ret;
+}
+
+void
+NegativeCache::expire (const std::string &mbox, int protocol)
+{
+  d->lock ();
+  const auto it = d->m_expires.find (make_key (mbox, protocol));
+  if (it != d->m_expires.end ())
+    {
+      it->second = 0;
+    }
+  d->unlock ();
+}
+
+void
+NegativeCache::expireAll ()
+{
+  d->lock ();
+  d->expireAll ();
+  d->unlock ();
+}
+
+void
+NegativeCache::checkStamp (const std::string &stamp)
+{
+  d->lock ();
+  if (stamp != d->m_stamp)
+    {
+      if (!d->m_stamp.empty ())
+        {
+          log_debug ("%s:%s: Keyring changed. Expiring %u entries.",
+                     SRCNAME, __func__, (unsigned int) d->m_expires.size ());
+          d->expireAll ();
+        }
+      d->m_stamp = stamp;
+    }
+  d->unlock ();
+}
+
+NegativeCache::stats_s
+NegativeCache::stats () const
+{
+  d->lock ();
+  stats_s ret = d->m_stats;
+  ret.entries = (unsigned long) d->m_expires.size ();
+  d->unlock ();
+  return ret;
+}
+
+void
+NegativeCache::logStats () const
+{
+  const auto s = stats ();
+
+  log_debug ("%s:%s: %lu entries, %lu hits, %lu misses, "
+             "%lu invalidations",
+             SRCNAME, __func__, s.entries, s.hits, s.misses,
+             s.invalidations);
+}
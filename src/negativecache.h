@@ -0,0 +1,99 @@
+/* @file negativecache.h
+ * @brief Remember key lookups which found nothing
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NEGATIVECACHE_H
+#define NEGATIVECACHE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <memory>
+#include <string>
+
+/* The default time in seconds for which a failed lookup is not
+   repeated.  */
+#define NEGATIVE_CACHE_TTL 3600
+
+/* A NegativeCache records the mail addresses for which a key lookup
+   of a protocol found nothing so that the lookup, which may go to
+   WKD, a keyserver or an LDAP server, is not repeated for every mail.
+   An entry expires after the TTL or when it is invalidated because a
+   key was imported or the keyring changed.  An expired entry is kept
+   until it is looked up so that the caller knows that the lookup has
+   to be done again.  */
+class NegativeCache
+{
+public:
+  enum State
+    {
+      /* No lookup for the address failed.  */
+      Unknown = 0,
+      /* The last lookup found nothing.  */
+      Fresh = 1,
+      /* The last lookup found nothing but that is no longer valid.  */
+      Expired = 2
+    };
+
+  struct stats_s
+  {
+    unsigned long entries;
+    /* Lookups answered by a fresh entry.  */
+    unsigned long hits;
+    /* Lookups without a fresh entry.  */
+    unsigned long misses;
+    /* Number of times all entries were invalidated.  */
+    unsigned long invalidations;
+  };
+
+  NegativeCache ();
+
+  /* Set the TTL in seconds.  A TTL of 0 disables the cache.  */
+  void setTTL (unsigned int seconds);
+
+  /* Record that the lookup of MBOX for PROTOCOL found nothing.  */
+  void add (const std::string &mbox, int protocol);
+
+  /* Return the state of MBOX for PROTOCOL.  An expired entry is
+     removed.  */
+  State lookup (const std::string &mbox, int protocol);
+
+  /* Let the entry for MBOX and PROTOCOL expire.  */
+  void expire (const std::string &mbox, int protocol);
+
+  /* Let all entries expire.  */
+  void expireAll ();
+
+  /* Let all entries expire if STAMP, which describes the state of the
+     keyring, differs from the last call.  */
+  void checkStamp (const std::string &stamp);
+
+  stats_s stats () const;
+
+  /* Write the counters to the log.  */
+  void logStats () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif /* NEGATIVECACHE_H */
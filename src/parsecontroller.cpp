@@ -61,6 +61,10 @@ const char decrypt_template_html[] = {
 
 const char decrypt_template[] = {"%s %s\n\n%s"};
 
+/* Encrypted mails larger than this are decrypted while they are
+   parsed.  */
+#define STREAMING_THRESHOLD (8 * 1024 * 1024)
+
 using namespace GpgME;
 
 static bool
@@ -111,37 +115,134 @@ get_and_print_key_test (const char *fingerprint, GpgME::Protocol proto)
 }
 #endif
 
+/* Whether TYPE is a message which only needs to be decrypted.  The
+   input of such messages can be streamed.  */
+static bool
+is_decrypt_only (msgtype_t type)
+{
+  TSTART;
+  TRETURN type == MSGTYPE_GPGOL_MULTIPART_ENCRYPTED ||
+         type == MSGTYPE_GPGOL_PGP_MESSAGE ||
+         type == MSGTYPE_GPGOL_OPAQUE_ENCRYPTED;
+}
+
 #ifdef HAVE_W32_SYSTEM
+/* Check if we want to decrypt the data in INSTREAM while it is still
+   parsed instead of collecting all crypto data first.  This is done
+   for large encrypted mails to avoid having the ciphertext in
+   memory.  */
+static bool
+use_streaming (LPSTREAM instream, msgtype_t type)
+{
+  TSTART;
+  STATSTG statInfo;
+  HRESULT hr;
+
+  if (!instream || !is_decrypt_only (type))
+    {
+      TRETURN false;
+    }
+  hr = instream->Stat (&statInfo, STATFLAG_NONAME);
+  if (hr)
+    {
+      log_debug ("%s:%s: Stat failed: hr=%#lx", SRCNAME, __func__, hr);
+      TRETURN false;
+    }
+  TRETURN statInfo.cbSize.QuadPart >= STREAMING_THRESHOLD;
+}
+
 ParseController::ParseController(LPSTREAM instream, msgtype_t type):
-    m_inputprovider  (new MimeDataProvider(instream,
-                          expect_no_headers(type))),
+    m_inputprovider  (nullptr),
     m_outputprovider (new MimeDataProvider(expect_no_mime(type))),
     m_type (type),
     m_block_html (false),
-    m_second_pass (false)
+    m_second_pass (false),
+    m_instream (nullptr),
+    m_infile (nullptr),
+    m_instart (0)
 {
   TSTART;
   memdbg_ctor ("ParseController");
+  bool streaming = use_streaming (instream, type);
+  if (streaming)
+    {
+      ULARGE_INTEGER pos;
+      LARGE_INTEGER zero;
+
+      zero.QuadPart = 0;
+      if (instream->Seek (zero, STREAM_SEEK_CUR, &pos))
+        {
+          log_error ("%s:%s: Failed to get the stream position.",
+                     SRCNAME, __func__);
+          streaming = false;
+        }
+      else
+        {
+          /* Keep a reference for a second pass.  */
+          instream->AddRef ();
+          memdbg_addRef (instream);
+          m_instream = instream;
+          m_instart = (long long) pos.QuadPart;
+        }
+    }
+  m_inputprovider = new MimeDataProvider (instream, expect_no_headers (type),
+                                          streaming);
   log_data ("%s:%s: Creating parser for stream: %p of type %i"
-                   " expect no headers: %i expect no mime: %i",
+                   " expect no headers: %i expect no mime: %i streaming: %i",
                    SRCNAME, __func__, instream, type,
-                   expect_no_headers (type), expect_no_mime (type));
+                   expect_no_headers (type), expect_no_mime (type),
+                   streaming);
   TRETURN;
 }
 #endif
 
-ParseController::ParseController(FILE *instream, msgtype_t type):
-    m_inputprovider  (new MimeDataProvider(instream,
-                          expect_no_headers(type))),
+ParseController::ParseController(FILE *instream, msgtype_t type,
+                                 bool streaming):
+    m_inputprovider  (nullptr),
     m_outputprovider (new MimeDataProvider(expect_no_mime(type))),
     m_type (type),
     m_block_html (false),
-    m_second_pass (false)
+    m_second_pass (false),
+#ifdef HAVE_W32_SYSTEM
+    m_instream (nullptr),
+#endif
+    m_infile (nullptr),
+    m_instart (0)
+{
+  TSTART;
+  memdbg_ctor ("ParseController");
+  if (streaming && !is_decrypt_only (type))
+    {
+      log_debug ("%s:%s: Not streaming data of type %i",
+                 SRCNAME, __func__, type);
+      streaming = false;
+    }
+  if (streaming)
+    {
+      m_infile = instream;
+      m_instart = ftello (instream);
+    }
+  m_inputprovider = new MimeDataProvider (instream, expect_no_headers (type),
+                                          streaming);
+  log_data ("%s:%s: Creating parser for stream: %p of type %i streaming: %i",
+                   SRCNAME, __func__, instream, type, streaming);
+  TRETURN;
+}
+
+ParseController::ParseController(msgtype_t type):
+    m_inputprovider  (nullptr),
+    m_outputprovider (new MimeDataProvider(expect_no_mime(type))),
+    m_type (type),
+    m_block_html (false),
+    m_second_pass (true),
+#ifdef HAVE_W32_SYSTEM
+    m_instream (nullptr),
+#endif
+    m_infile (nullptr),
+    m_instart (0)
 {
   TSTART;
   memdbg_ctor ("ParseController");
-  log_data ("%s:%s: Creating parser for stream: %p of type %i",
-                   SRCNAME, __func__, instream, type);
   TRETURN;
 }
 
@@ -152,6 +253,54 @@ ParseController::~ParseController()
   memdbg_dtor ("ParseController");
   delete m_inputprovider;
   delete m_outputprovider;
+#ifdef HAVE_W32_SYSTEM
+  if (m_instream)
+    {
+      gpgol_release (m_instream);
+    }
+#endif
+  TRETURN;
+}
+
+/* Create a new streaming input provider reading the input again
+   from the start.  */
+void
+ParseController::restart_input ()
+{
+  TSTART;
+  MimeDataProvider *provider = nullptr;
+#ifdef HAVE_W32_SYSTEM
+  if (m_instream)
+    {
+      LARGE_INTEGER start;
+
+      start.QuadPart = m_instart;
+      if (m_instream->Seek (start, STREAM_SEEK_SET, nullptr))
+        {
+          log_error ("%s:%s: Failed to rewind the stream.",
+                     SRCNAME, __func__);
+          TRETURN;
+        }
+      provider = new MimeDataProvider (m_instream,
+                                       expect_no_headers (m_type), true);
+    }
+#endif
+  if (m_infile)
+    {
+      if (fseeko (m_infile, m_instart, SEEK_SET))
+        {
+          log_error ("%s:%s: Failed to rewind the file.",
+                     SRCNAME, __func__);
+          TRETURN;
+        }
+      provider = new MimeDataProvider (m_infile,
+                                       expect_no_headers (m_type), true);
+    }
+  if (provider)
+    {
+      delete m_inputprovider;
+      m_inputprovider = provider;
+    }
   TRETURN;
 }
 
@@ -356,6 +505,19 @@ ParseController::parse(bool offline)
   Protocol protocol;
   bool decrypt, verify;
 
+  if (!m_inputprovider)
+    {
+      log_debug ("%s:%s: Nothing to parse. Restored from cache.",
+                 SRCNAME, __func__);
+      TRETURN;
+    }
+
+  if (m_second_pass && m_inputprovider->is_streaming ())
+    {
+      /* The first pass has consumed the input.  */
+      restart_input ();
+    }
+
   Data input (m_inputprovider);
 
   auto inputType = input.type ();
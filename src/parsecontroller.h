@@ -58,7 +58,13 @@ public:
     destruction. */
   ParseController(LPSTREAM instream, msgtype_t type);
 #endif
-  ParseController(FILE *instream, msgtype_t type);
+  /** Construct a new ParseController for the file instream.
+    If streaming is true and the message only needs to be decrypted
+    the file is read while decrypting and must stay open until the
+    controller is destroyed. Otherwise it is read in the
+    constructor.  Large streams are always handled this way by the
+    LPSTREAM variant. */
+  ParseController(FILE *instream, msgtype_t type, bool streaming = false);
 
   ~ParseController();
 
@@ -106,6 +112,15 @@ public:
   std::string get_content_type () const;
 
 private:
+  friend class DecryptCache;
+
+  /* Construct an empty controller to be filled by the
+     DecryptCache. */
+  explicit ParseController(msgtype_t type);
+
+  /* Recreate a streaming input provider for a second pass. */
+  void restart_input ();
+
   /* State variables */
   MimeDataProvider *m_inputprovider;
   MimeDataProvider *m_outputprovider;
@@ -117,6 +132,11 @@ private:
   bool m_block_html;
   autocrypt_s m_autocrypt_info; /* Autocrypt info about the mail */
   bool m_second_pass; /* Second pass parsing with the same controller. */
+#ifdef HAVE_W32_SYSTEM
+  LPSTREAM m_instream; /* The input stream if it is streamed. */
+#endif
+  FILE *m_infile; /* The input file if it is streamed. */
+  long long m_instart; /* Start offset of the streamed input. */
 };
 
 #endif /* PARSECONTROLLER_H */
@@ -0,0 +1,226 @@
+/* @file parsescheduler.cpp
+ * @brief Run the parsing of mails in a pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "parsescheduler.h"
+
+#include "common_indep.h"
+#include "workerpool.h"
+
+#include <list>
+
+namespace
+{
+struct job_s
+{
+  const void *key;
+  int prio;
+  std::function<void ()> func;
+};
+}
+
+static ParseScheduler *singleton = nullptr;
+
+class ParseScheduler::Private
+{
+public:
+  Private () :
+    m_pool ("parse", PARSE_MAX_WORKERS, [this] () { return take (); }),
+    m_selected (nullptr)
+  {
+  }
+
+  /* The workers keep a pointer to us so the scheduler is never
+     destroyed.  */
+  ~Private () = delete;
+
+  /* Remove the queued job for KEY.  Called with the lock held.  */
+  bool
+  dropJob (const void *key)
+  {
+    for (auto it = m_queue.begin (); it != m_queue.end (); ++it)
+      {
+        if (it->key == key)
+          {
+            m_queue.erase (it);
+            m_pool.dropped ();
+            return true;
+          }
+      }
+    return false;
+  }
+
+  /* Lower the priority of the selected jobs.  Called with the lock
+     held.  */
+  void
+  unselect ()
+  {
+    for (auto &job: m_queue)
+      {
+        if (job.prio >= PrioSelected)
+          {
+            job.prio = PrioNormal;
+          }
+      }
+  }
+
+  /* Take the next job from the queue.  Called by a worker with the
+     lock held.  */
+  std::function<void ()>
+  take ()
+  {
+    auto best = m_queue.begin ();
+    for (auto it = m_queue.begin (); it != m_queue.end (); ++it)
+      {
+        if (it->prio > best->prio)
+          {
+            best = it;
+          }
+      }
+    const void *key = best->key;
+    int prio = best->prio;
+    auto func = std::move (best->func);
+    m_queue.erase (best);
+
+    return [key, prio, func] ()
+      {
+        log_debug ("%s:%s: Parsing for %p with priority %i",
+                   SRCNAME, __func__, key, prio);
+        func ();
+      };
+  }
+
+  WorkerPool m_pool;
+  std::list<job_s> m_queue;
+  /* The key the user selected last.  */
+  const void *m_selected;
+};
+
+ParseScheduler::ParseScheduler ():
+  d (new Private, [] (Private *) {})
+{
+}
+
+ParseScheduler *
+ParseScheduler::instance ()
+{
+  if (!singleton)
+    {
+      singleton = new ParseScheduler ();
+    }
+  return singleton;
+}
+
+void
+ParseScheduler::submit (const void *key, int prio,
+                        const std::function<void ()> &job)
+{
+  TSTART;
+  d->m_pool.lock ();
+  if (d->dropJob (key))
+    {
+      log_debug ("%s:%s: Dropped stale job for %p",
+                 SRCNAME, __func__, key);
+    }
+  if (key == d->m_selected && prio < PrioSelected)
+    {
+      prio = PrioSelected;
+    }
+  if (prio >= PrioSelected)
+    {
+      d->unselect ();
+    }
+  d->m_queue.push_back ({key, prio, job});
+  d->m_pool.queued ();
+  d->m_pool.unlock ();
+  TRETURN;
+}
+
+bool
+ParseScheduler::cancel (const void *key)
+{
+  TSTART;
+  d->m_pool.lock ();
+  bool ret = d->dropJob (key);
+  if (key == d->m_selected)
+    {
+      d->m_selected = nullptr;
+    }
+  d->m_pool.unlock ();
+  if (ret)
+    {
+      log_debug ("%s:%s: Canceled job for %p",
+                 SRCNAME, __func__, key);
+    }
+  TRETURN ret;
+}
+
+void
+ParseScheduler::setSelected (const void *key)
+{
+  TSTART;
+  d->m_pool.lock ();
+  d->m_selected = key;
+  for (auto &job: d->m_queue)
+    {
+      if (job.key == key)
+        {
+          d->unselect ();
+          job.prio = PrioSelected;
+          break;
+        }
+    }
+  d->m_pool.unlock ();
+  TRETURN;
+}
+
+void
+ParseScheduler::waitIdle ()
+{
+  TSTART;
+  d->m_pool.waitIdle ();
+  TRETURN;
+}
+
+void
+ParseScheduler::setMaxWorkers (int n)
+{
+  d->m_pool.lock ();
+  d->m_pool.setMaxWorkers (n);
+  d->m_pool.unlock ();
+}
+
+int
+ParseScheduler::maxWorkers () const
+{
+  d->m_pool.lock ();
+  int ret = d->m_pool.maxWorkers ();
+  d->m_pool.unlock ();
+  return ret;
+}
+
+int
+ParseScheduler::pending () const
+{
+  d->m_pool.lock ();
+  int ret = d->m_pool.queuedJobs () + d->m_pool.runningJobs ();
+  d->m_pool.unlock ();
+  return ret;
+}
@@ -0,0 +1,89 @@
+/* @file parsescheduler.h
+ * @brief Run the parsing of mails in a pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARSESCHEDULER_H
+#define PARSESCHEDULER_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <functional>
+#include <memory>
+
+/* The default number of mails which are parsed at the same time.  */
+#define PARSE_MAX_WORKERS 4
+
+/* The ParseScheduler runs parse jobs in a bounded pool of worker
+   threads.  Each job belongs to a key, usually the Mail object it
+   parses, so that stale jobs can be dropped.  Of the queued jobs the
+   one with the highest priority is started first and jobs of the same
+   priority are started in the order they were submitted.  */
+class ParseScheduler
+{
+protected:
+  /** Internal ctor */
+  explicit ParseScheduler ();
+
+public:
+  enum Priority
+    {
+      PrioBackground = 0,
+      PrioNormal = 1,
+      /* The mail the user is looking at.  Only the most recently
+         submitted or selected job has this priority.  */
+      PrioSelected = 2
+    };
+
+  /** Get the ParseScheduler */
+  static ParseScheduler *instance ();
+
+  /* Queue JOB for KEY with priority PRIO.  A job for KEY which has
+     not yet been started is dropped as it is stale now.  If KEY is
+     the selected key the job gets the selected priority.  */
+  void submit (const void *key, int prio, const std::function<void ()> &job);
+
+  /* Drop the job for KEY if it has not yet been started and forget
+     KEY if it is selected.  Returns true if a job was dropped.  */
+  bool cancel (const void *key);
+
+  /* Give the queued job for KEY the selected priority and lower the
+     priority of the previously selected job.  A job for KEY which is
+     submitted later also gets the selected priority.  */
+  void setSelected (const void *key);
+
+  /* Wait until all queued jobs are done.  */
+  void waitIdle ();
+
+  /* Set the maximum number of worker threads.  Threads which are
+     already running are not stopped.  */
+  void setMaxWorkers (int n);
+  int maxWorkers () const;
+
+  /* Number of jobs that are queued or running.  */
+  int pending () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif
@@ -0,0 +1,248 @@
+/* @file partcache.cpp
+ * @brief Cache for the MIME parts of attachments
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "partcache.h"
+
+#include "cachecrypt.h"
+#include "common_indep.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+
+#include <gpg-error.h>
+
+GPGRT_LOCK_DEFINE (part_cache_lock);
+
+static PartCache *singleton = nullptr;
+
+namespace
+{
+struct entry_s
+{
+  /* The SHA-256 of the attachment data, name and content id.  */
+  std::string key;
+  /* The MIME part without the boundary.  Encrypted with
+     protect_data.  */
+  std::string blob;
+  size_t part_len;
+};
+}
+
+/* Return the SHA-256 of the attachment or an empty string on
+   error.  */
+static std::string
+make_key (const std::string &data, const std::string &name,
+          const std::string &cid)
+{
+  Sha256 ctx;
+
+  ctx.writeString (data);
+  ctx.writeString (name);
+  ctx.writeString (cid);
+  return ctx.final ();
+}
+
+class PartCache::Private
+{
+public:
+  Private () :
+    m_max_size (PART_CACHE_MAX_SIZE),
+    m_size (0)
+  {
+  }
+
+  /* Remove the entry at IT.  Called with the lock held.  */
+  void
+  remove (std::list<entry_s>::iterator it)
+  {
+    m_size -= it->part_len;
+    m_map.erase (it->key);
+    m_entries.erase (it);
+  }
+
+  /* Remove the least recently used entries until the cache fits
+     into the size limit.  Called with the lock held.  */
+  void
+  shrink ()
+  {
+    while (m_size > m_max_size && !m_entries.empty ())
+      {
+        log_debug ("%s:%s: Evicting part of %lu bytes",
+                   SRCNAME, __func__,
+                   (unsigned long) m_entries.back ().part_len);
+        remove (std::prev (m_entries.end ()));
+      }
+  }
+
+  /* Most recently used first.  */
+  std::list<entry_s> m_entries;
+  std::unordered_map<std::string, std::list<entry_s>::iterator> m_map;
+  size_t m_max_size;
+  size_t m_size;
+};
+
+PartCache::PartCache ():
+  d (new Private)
+{
+}
+
+PartCache *
+PartCache::instance ()
+{
+  if (!singleton)
+    {
+      singleton = new PartCache ();
+    }
+  return singleton;
+}
+
+std::shared_ptr<const std::string>
+PartCache::find (const std::string &data, const std::string &name,
+                 const std::string &cid)
+{
+  TSTART;
+  if (data.size () < PART_CACHE_MIN_SIZE)
+    {
+      TRETURN nullptr;
+    }
+
+  const auto key = make_key (data, name, cid);
+  if (key.empty ())
+    {
+      TRETURN nullptr;
+    }
+
+  gpgol_lock (&part_cache_lock);
+  const auto it = d->m_map.find (key);
+  if (it == d->m_map.end ())
+    {
+      gpgol_unlock (&part_cache_lock);
+      TRETURN nullptr;
+    }
+  auto part = std::shared_ptr<std::string> (new std::string
+                                            (it->second->blob),
+                                            delete_wiped);
+  const size_t part_len = it->second->part_len;
+  /* Move it to the front.  */
+  d->m_entries.splice (d->m_entries.begin (), d->m_entries, it->second);
+  gpgol_unlock (&part_cache_lock);
+
+  if (!unprotect_data (*part, part_len))
+    {
+      TRETURN nullptr;
+    }
+  log_debug ("%s:%s: Found part of %lu bytes",
+             SRCNAME, __func__, (unsigned long) part->size ());
+  TRETURN part;
+}
+
+void
+PartCache::store (const std::string &data, const std::string &name,
+                  const std::string &cid, const std::string &part)
+{
+  TSTART;
+  if (data.size () < PART_CACHE_MIN_SIZE)
+    {
+      TRETURN;
+    }
+
+  gpgol_lock (&part_cache_lock);
+  if (part.size () > d->m_max_size / 4)
+    {
+      log_debug ("%s:%s: Not caching %lu bytes",
+                 SRCNAME, __func__, (unsigned long) part.size ());
+      gpgol_unlock (&part_cache_lock);
+      TRETURN;
+    }
+  gpgol_unlock (&part_cache_lock);
+
+  entry_s entry;
+  entry.key = make_key (data, name, cid);
+  if (entry.key.empty ())
+    {
+      TRETURN;
+    }
+  entry.blob = part;
+  entry.part_len = part.size ();
+  protect_data (entry.blob);
+  if (entry.blob.empty ())
+    {
+      TRETURN;
+    }
+
+  gpgol_lock (&part_cache_lock);
+  const auto it = d->m_map.find (entry.key);
+  if (it != d->m_map.end ())
+    {
+      d->remove (it->second);
+    }
+  d->m_size += entry.part_len;
+  d->m_entries.push_front (std::move (entry));
+  d->m_map[d->m_entries.front ().key] = d->m_entries.begin ();
+  d->shrink ();
+  log_debug ("%s:%s: Cached part of %lu bytes. %lu entries with %lu bytes",
+             SRCNAME, __func__, (unsigned long) part.size (),
+             (unsigned long) d->m_entries.size (), (unsigned long) d->m_size);
+  gpgol_unlock (&part_cache_lock);
+  TRETURN;
+}
+
+void
+PartCache::clear ()
+{
+  TSTART;
+  gpgol_lock (&part_cache_lock);
+  while (!d->m_entries.empty ())
+    {
+      d->remove (d->m_entries.begin ());
+    }
+  gpgol_unlock (&part_cache_lock);
+  TRETURN;
+}
+
+void
+PartCache::setMaxSize (size_t size)
+{
+  gpgol_lock (&part_cache_lock);
+  d->m_max_size = size;
+  d->shrink ();
+  gpgol_unlock (&part_cache_lock);
+}
+
+size_t
+PartCache::count () const
+{
+  gpgol_lock (&part_cache_lock);
+  size_t ret = d->m_entries.size ();
+  gpgol_unlock (&part_cache_lock);
+  return ret;
+}
+
+size_t
+PartCache::size () const
+{
+  gpgol_lock (&part_cache_lock);
+  size_t ret = d->m_size;
+  gpgol_unlock (&part_cache_lock);
+  return ret;
+}
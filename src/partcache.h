@@ -0,0 +1,85 @@
+/* @file partcache.h
+ * @brief Cache for the MIME parts of attachments
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARTCACHE_H
+#define PARTCACHE_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <memory>
+#include <string>
+
+/* The default size limit of the cache.  */
+#define PART_CACHE_MAX_SIZE (64 * 1024 * 1024)
+
+/* Attachments smaller than this are not worth caching.  */
+#define PART_CACHE_MIN_SIZE (64 * 1024)
+
+/* The PartCache keeps the MIME parts of large attachments, i.e. the
+   part headers and the encoded content, so that an attachment which
+   is sent again, e.g. when a mail is forwarded, does not need to be
+   encoded again.  Entries are looked up by the SHA-256 of the
+   attachment data and its file name and content id.  The data itself
+   is not kept and the parts are encrypted in memory like the entries
+   of the DecryptCache.  If the cache grows beyond its size limit the
+   least recently used entries are removed.  The cache is only used
+   if the partCache option is set.  */
+class PartCache
+{
+protected:
+  /** Internal ctor */
+  explicit PartCache ();
+
+public:
+  /** Get the PartCache */
+  static PartCache *instance ();
+
+  /* Return a copy of the part stored for an attachment with DATA,
+     NAME and CID or nullptr.  The copy is wiped when it is
+     released.  */
+  std::shared_ptr<const std::string> find (const std::string &data,
+                                           const std::string &name,
+                                           const std::string &cid);
+
+  /* Store PART as the MIME part of the attachment with DATA, NAME
+     and CID.  Attachments smaller than PART_CACHE_MIN_SIZE or too
+     large for the size limit are not stored.  */
+  void store (const std::string &data, const std::string &name,
+              const std::string &cid, const std::string &part);
+
+  /* Remove all entries.  */
+  void clear ();
+
+  /* Set the maximum size of all entries.  */
+  void setMaxSize (size_t size);
+
+  /* The number of the entries and the size of their parts.  */
+  size_t count () const;
+  size_t size () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif
@@ -0,0 +1,220 @@
+/* @file pendingset.cpp
+ * @brief A set of jobs in progress which can be waited for
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pendingset.h"
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <time.h>
+# include <errno.h>
+#endif
+
+#include <unordered_map>
+
+namespace
+{
+/* The event for one pending key.  Waiters keep a reference so that
+   it stays valid after the key has been removed.  */
+struct event_s
+{
+  event_s () : done (false)
+  {
+#ifdef HAVE_W32_SYSTEM
+    InitializeConditionVariable (&cond);
+#else
+    pthread_condattr_t attr;
+
+    pthread_condattr_init (&attr);
+    pthread_condattr_setclock (&attr, CLOCK_MONOTONIC);
+    pthread_cond_init (&cond, &attr);
+    pthread_condattr_destroy (&attr);
+#endif
+  }
+
+  ~event_s ()
+  {
+#ifndef HAVE_W32_SYSTEM
+    pthread_cond_destroy (&cond);
+#endif
+  }
+
+  bool done;
+#ifdef HAVE_W32_SYSTEM
+  CONDITION_VARIABLE cond;
+#else
+  pthread_cond_t cond;
+#endif
+};
+}
+
+class PendingSet::Private
+{
+public:
+  Private ()
+  {
+#ifdef HAVE_W32_SYSTEM
+    InitializeCriticalSection (&m_lock);
+#else
+    pthread_mutex_init (&m_lock, nullptr);
+#endif
+  }
+
+  ~Private ()
+  {
+#ifdef HAVE_W32_SYSTEM
+    DeleteCriticalSection (&m_lock);
+#else
+    pthread_mutex_destroy (&m_lock);
+#endif
+  }
+
+  /* waitFor waits with the lock held until EV is done but not longer
+     than TIMEOUT milliseconds.  It returns false on timeout.  */
+#ifdef HAVE_W32_SYSTEM
+  void lock () { EnterCriticalSection (&m_lock); }
+  void unlock () { LeaveCriticalSection (&m_lock); }
+  void broadcast (event_s *ev) { WakeAllConditionVariable (&ev->cond); }
+
+  bool
+  waitFor (event_s *ev, unsigned int timeout)
+  {
+    ULONGLONG deadline = GetTickCount64 () + timeout;
+
+    while (!ev->done)
+      {
+        ULONGLONG now = GetTickCount64 ();
+        if (now >= deadline)
+          {
+            return false;
+          }
+        SleepConditionVariableCS (&ev->cond, &m_lock,
+                                  (DWORD) (deadline - now));
+      }
+    return true;
+  }
+#else
+  void lock () { pthread_mutex_lock (&m_lock); }
+  void unlock () { pthread_mutex_unlock (&m_lock); }
+  void broadcast (event_s *ev) { pthread_cond_broadcast (&ev->cond); }
+
+  bool
+  waitFor (event_s *ev, unsigned int timeout)
+  {
+    struct timespec deadline;
+
+    clock_gettime (CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout / 1000;
+    deadline.tv_nsec += (long) (timeout % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000)
+      {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+    while (!ev->done)
+      {
+        if (pthread_cond_timedwait (&ev->cond, &m_lock,
+                                    &deadline) == ETIMEDOUT)
+          {
+            return ev->done;
+          }
+      }
+    return true;
+  }
+#endif
+
+  std::unordered_map<std::string, std::shared_ptr<event_s> > m_events;
+#ifdef HAVE_W32_SYSTEM
+  CRITICAL_SECTION m_lock;
+#else
+  pthread_mutex_t m_lock;
+#endif
+};
+
+PendingSet::PendingSet () :
+  d (new Private)
+{
+}
+
+bool
+PendingSet::add (const std::string &key)
+{
+  d->lock ();
+  bool ret = d->m_events.find (key) == d->m_events.end ();
+  if (ret)
+    {
+      d->m_events.insert (std::make_pair (key,
+                                          std::make_shared<event_s> ()));
+    }
+  d->unlock ();
+  return ret;
+}
+
+bool
+PendingSet::remove (const std::string &key)
+{
+  d->lock ();
+  const auto it = d->m_events.find (key);
+  bool ret = it != d->m_events.end ();
+  if (ret)
+    {
+      it->second->done = true;
+      d->broadcast (it->second.get ());
+      d->m_events.erase (it);
+    }
+  d->unlock ();
+  return ret;
+}
+
+bool
+PendingSet::contains (const std::string &key) const
+{
+  d->lock ();
+  bool ret = d->m_events.find (key) != d->m_events.end ();
+  d->unlock ();
+  return ret;
+}
+
+bool
+PendingSet::wait (const std::string &key, unsigned int timeout) const
+{
+  d->lock ();
+  const auto it = d->m_events.find (key);
+  if (it == d->m_events.end ())
+    {
+      d->unlock ();
+      return true;
+    }
+  auto ev = it->second;
+  bool ret = d->waitFor (ev.get (), timeout);
+  d->unlock ();
+  return ret;
+}
+
+size_t
+PendingSet::size () const
+{
+  d->lock ();
+  size_t ret = d->m_events.size ();
+  d->unlock ();
+  return ret;
+}
@@ -0,0 +1,63 @@
+/* @file pendingset.h
+ * @brief A set of jobs in progress which can be waited for
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PENDINGSET_H
+#define PENDINGSET_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <memory>
+#include <string>
+
+/* A PendingSet holds the keys, e.g. fingerprints or mail addresses,
+   of the jobs which are in progress.  A thread can wait until the job
+   for a key is done.  Each key has its own event so that a waiter is
+   only woken up when its own job is done.  */
+class PendingSet
+{
+public:
+  PendingSet ();
+
+  /* Add KEY.  Returns false if KEY is already pending.  */
+  bool add (const std::string &key);
+
+  /* Remove KEY and wake up the threads waiting for it.  Returns false
+     if KEY was not pending.  */
+  bool remove (const std::string &key);
+
+  /* Check if KEY is pending.  */
+  bool contains (const std::string &key) const;
+
+  /* Wait until KEY is no longer pending but not longer than
+     TIMEOUT milliseconds.  Returns false on timeout.  */
+  bool wait (const std::string &key, unsigned int timeout) const;
+
+  /* The number of pending keys.  */
+  size_t size () const;
+
+private:
+  class Private;
+  std::shared_ptr<Private> d;
+};
+
+#endif /* PENDINGSET_H */
@@ -61,13 +61,15 @@ struct rfc822parse_field_context
     unsigned int cont:1;
     unsigned int lowered:1;
   } flags;
-  /*TOKEN owner_pantry; */
+  rfc822parse_t owner;  /* Only set in the first token of a field.  */
   char data[1];
 };
 
 struct hdr_line
 {
   struct hdr_line *next;
+  struct hdr_line *next_same; /* Next line with the same name.  */
+  size_t namelen; /* Length of the name or 0 for a continuation.  */
   int cont;     /* This is a continuation of the previous line. */
   unsigned char line[1];
 };
@@ -75,16 +77,51 @@ struct hdr_line
 typedef struct hdr_line *HDR_LINE;
 
 
+/* An open addressing hash table to find the header lines of a part
+   by name.  It is created once all header lines of the part have
+   been read.  */
+struct hdr_index_entry
+{
+  HDR_LINE first;       /* First line with that name or NULL.  */
+  HDR_LINE last;        /* Last line with that name.  */
+  size_t namelen;       /* Length of the name.  */
+  unsigned int hash;    /* Hash value of the lowercased name.  */
+};
+
+struct hdr_index
+{
+  size_t size;          /* Number of entries; a power of 2.  */
+  struct hdr_index_entry entries[1];
+};
+
+
 struct part
 {
   struct part *right;     /* The next part. */
   struct part *down;      /* A contained part. */
   HDR_LINE hdr_lines;       /* Header lines os that part. */
   HDR_LINE *hdr_lines_tail; /* Helper for adding lines. */
+  struct hdr_index *hdr_index; /* Index of the header lines or NULL. */
   char *boundary;           /* Only used in the first part. */
 };
 typedef struct part *part_t;
 
+
+/* The parts and header lines of a message are allocated from an
+   arena of larger chunks which is released at once when the message
+   is closed.  The tokens of the parsed fields use a second arena
+   which is reset as soon as no field is in use anymore.  */
+#define ARENA_CHUNK_SIZE 8192
+#define ARENA_ALIGN (2 * sizeof (void *))
+#define ARENA_ROUND(n) (((n) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_chunk
+{
+  struct arena_chunk *next;
+  size_t size;          /* Allocated size of the chunk.  */
+  size_t used;          /* Used bytes including this header.  */
+};
+
 struct rfc822parse_context
 {
   rfc822parse_cb_t callback;
@@ -95,6 +132,9 @@ struct rfc822parse_context
   part_t parts;         /* The tree of parts. */
   part_t current_part;  /* Whom we are processing (points into parts). */
   const char *boundary; /* Current boundary. */
+  struct arena_chunk *arena; /* The current chunk is the first.  */
+  struct arena_chunk *token_arena; /* Ditto for the tokens.  */
+  int live_fields;      /* Number of not yet released fields.  */
 };
 
 static HDR_LINE find_header (rfc822parse_t msg, const char *name,
@@ -155,6 +195,172 @@ capitalize_header_name (unsigned char *name)
 }
 
 
+/* Return N bytes of memory from ARENA.  */
+static void *
+arena_alloc (struct arena_chunk **arena, size_t n)
+{
+  struct arena_chunk *chunk = *arena;
+  size_t size;
+  void *p;
+
+  n = ARENA_ROUND (n);
+  if (!chunk || chunk->size - chunk->used < n)
+    {
+      size = ARENA_ROUND (sizeof *chunk) + n;
+      if (size < ARENA_CHUNK_SIZE)
+        size = ARENA_CHUNK_SIZE;
+      chunk = xmalloc (size);
+      if (!chunk)
+        return NULL;
+      chunk->size = size;
+      chunk->used = ARENA_ROUND (sizeof *chunk);
+      if (*arena && size > ARENA_CHUNK_SIZE)
+        {
+          /* Keep allocating from the current chunk if this one is
+             used up by this request.  */
+          chunk->next = (*arena)->next;
+          (*arena)->next = chunk;
+        }
+      else
+        {
+          chunk->next = *arena;
+          *arena = chunk;
+        }
+    }
+  p = (char *)chunk + chunk->used;
+  chunk->used += n;
+  return p;
+}
+
+
+static void *
+arena_calloc (struct arena_chunk **arena, size_t n)
+{
+  void *p = arena_alloc (arena, n);
+
+  if (p)
+    memset (p, 0, n);
+  return p;
+}
+
+
+/* Release all memory of ARENA.  If KEEP is set the current chunk is
+   kept for reuse.  */
+static void
+arena_release (struct arena_chunk **arena, int keep)
+{
+  struct arena_chunk *chunk, *next;
+
+  chunk = *arena;
+  if (keep && chunk)
+    {
+      chunk->used = ARENA_ROUND (sizeof *chunk);
+      next = chunk->next;
+      chunk->next = NULL;
+      chunk = next;
+    }
+  else
+    *arena = NULL;
+  for (; chunk; chunk = next)
+    {
+      next = chunk->next;
+      xfree (chunk);
+    }
+}
+
+
+/* Return a hash value for the header name NAME of length LEN.  The
+   name is hashed case insensitive.  */
+static unsigned int
+hash_header_name (const unsigned char *name, size_t len)
+{
+  unsigned int hash = 2166136261u;
+  unsigned int c;
+
+  /* FNV-1a.  */
+  for (; len; len--, name++)
+    {
+      c = *name;
+      if (c >= 'A' && c <= 'Z')
+        c = c - 'A' + 'a';
+      hash = (hash ^ c) * 16777619u;
+    }
+  return hash;
+}
+
+
+/* Return the entry for NAME of length NAMELEN with HASH in INDEX.
+   This is either the entry with that name or the empty entry where
+   it would be stored.  */
+static struct hdr_index_entry *
+find_index_entry (struct hdr_index *index, const unsigned char *name,
+                  size_t namelen, unsigned int hash)
+{
+  struct hdr_index_entry *e;
+  size_t i;
+
+  for (i = hash & (index->size - 1); ; i = (i + 1) & (index->size - 1))
+    {
+      e = index->entries + i;
+      if (!e->first
+          || (e->hash == hash && e->namelen == namelen
+              && !memcmp (e->first->line, name, namelen)))
+        return e;
+    }
+}
+
+
+/* Build the index for the header lines of PART of MSG.  On a memory
+   failure the part is left without index and the lookups fall back
+   to a linear search.  */
+static void
+index_headers (rfc822parse_t msg, part_t part)
+{
+  struct hdr_index *index;
+  struct hdr_index_entry *e;
+  HDR_LINE hdr;
+  size_t count, size, n;
+  unsigned int hash;
+
+  if (part->hdr_index)
+    return;
+
+  for (count = 0, hdr = part->hdr_lines; hdr; hdr = hdr->next)
+    if (!hdr->cont)
+      count++;
+
+  /* Keep the table at most half full so that there is always an
+     empty entry to end the probing.  */
+  for (size = 8; size < 2 * count; size *= 2)
+    ;
+  index = arena_calloc (&msg->arena, sizeof *index
+                        + (size - 1) * sizeof *index->entries);
+  if (!index)
+    return;
+  index->size = size;
+
+  for (hdr = part->hdr_lines; hdr; hdr = hdr->next)
+    {
+      hdr->next_same = NULL;
+      if (!(n = hdr->namelen))
+        continue;
+      hash = hash_header_name (hdr->line, n);
+      e = find_index_entry (index, hdr->line, n, hash);
+      if (!e->first)
+        {
+          e->first = hdr;
+          e->namelen = n;
+          e->hash = hash;
+        }
+      else
+        e->last->next_same = hdr;
+      e->last = hdr;
+    }
+
+  part->hdr_index = index;
+}
+
+
 static char *
 my_stpcpy (char *a,const char *b)
 {
@@ -181,11 +387,11 @@ do_callback (rfc822parse_t msg, rfc822parse_event_t event)
 }
 
 static part_t
-new_part (void)
+new_part (rfc822parse_t msg)
 {
   part_t part;
 
-  part = xcalloc (1, sizeof *part);
+  part = arena_calloc (&msg->arena, sizeof *part);
   if (part)
     {
       part->hdr_lines_tail = &part->hdr_lines;
@@ -194,32 +400,12 @@ new_part (void)
 }
 
 
-static void
-release_part (part_t part)
-{
-  part_t tmp;
-  HDR_LINE hdr, hdr2;
-
-  for (; part; part = tmp)
-    {
-      tmp = part->right;
-      if (part->down)
-        release_part (part->down);
-      for (hdr = part->hdr_lines; hdr; hdr = hdr2)
-        {
-          hdr2 = hdr->next;
-          xfree (hdr);
-        }
-      xfree (part->boundary);
-      xfree (part);
-    }
-}
-
-
 static void
 release_handle_data (rfc822parse_t msg)
 {
-  release_part (msg->parts);
+  arena_release (&msg->arena, 0);
+  arena_release (&msg->token_arena, 0);
+  msg->live_fields = 0;
   msg->parts = NULL;
   msg->current_part = NULL;
   msg->boundary = NULL;
@@ -235,7 +421,7 @@ rfc822parse_open (rfc822parse_cb_t cb, void *cb_value)
   rfc822parse_t msg = xcalloc (1, sizeof *msg);
   if (msg)
     {
-      msg->parts = msg->current_part = new_part ();
+      msg->parts = msg->current_part = new_part (msg);
       if (!msg->parts)
         {
           xfree (msg);
@@ -339,6 +525,9 @@ transition_to_body (rfc822parse_t msg)
   rfc822parse_field_t ctx;
   int rc;
 
+  /* All headers of the part are known now.  */
+  index_headers (msg, msg->current_part);
+
   rc = do_callback (msg, RFC822PARSE_T2BODY);
   if (!rc)
     {
@@ -355,14 +544,15 @@ transition_to_body (rfc822parse_t msg)
               if (s)
                 {
                   assert (!msg->current_part->boundary);
-                  msg->current_part->boundary = xmalloc (strlen (s) + 1);
+                  msg->current_part->boundary = arena_alloc (&msg->arena,
+                                                             strlen (s) + 1);
                   if (msg->current_part->boundary)
                     {
                       part_t part;
 
                       strcpy (msg->current_part->boundary, s);
                       msg->boundary = msg->current_part->boundary;
-                      part = new_part ();
+                      part = new_part (msg);
                       if (!part)
                         {
                           int save_errno = errno;
@@ -395,7 +585,7 @@ transition_to_header (rfc822parse_t msg)
   assert (msg->current_part);
   assert (!msg->current_part->right);
 
-  part = new_part ();
+  part = new_part (msg);
   if (!part)
     return -1;
 
@@ -409,6 +599,7 @@ static int
 insert_header (rfc822parse_t msg, const unsigned char *line, size_t length)
 {
   HDR_LINE hdr;
+  const char *p;
 
   assert (msg->current_part);
   if (!length)
@@ -421,24 +612,26 @@ insert_header (rfc822parse_t msg, const unsigned char *line, size_t length)
     do_callback (msg, RFC822PARSE_BEGIN_HEADER);
 
   length = length_sans_trailing_ws (line, length);
-  hdr = xmalloc (sizeof (*hdr) + length);
+  hdr = arena_alloc (&msg->arena, sizeof (*hdr) + length);
   if (!hdr)
     return -1;
   hdr->next = NULL;
+  hdr->next_same = NULL;
+  hdr->namelen = 0;
   hdr->cont = (*line == ' ' || *line == '\t');
   memcpy (hdr->line, line, length);
   hdr->line[length] = 0; /* Make it a string. */
 
   /* Transform a field name into canonical format. */
-  if (!hdr->cont && strchr (line, ':'))
+  if (!hdr->cont && (p = strchr ((char *)hdr->line, ':')))
     {
+     hdr->namelen = p - (const char *)hdr->line;
      capitalize_header_name (hdr->line);
     }
   else if (!hdr->cont)
     {
       /* Neither continuation nor a header name. Must be invalid. */
       log_dbg ("Invalid header data: %s", anonstr (hdr->line));
-      xfree(hdr);
       return -1;
     }
   *msg->current_part->hdr_lines_tail = hdr;
@@ -631,7 +824,6 @@ static HDR_LINE
 find_header (rfc822parse_t msg, const char *name, int which, HDR_LINE *rprev)
 {
   HDR_LINE hdr, prev = NULL, mark = NULL;
-  unsigned char *p;
   size_t namelen, n;
   int found = 0;
   int glob = 0;
@@ -646,6 +838,24 @@ find_header (rfc822parse_t msg, const char *name, int which, HDR_LINE *rprev)
       glob = 1;
     }
 
+  if (!glob && !rprev && msg->current_part->hdr_index)
+    {
+      /* Use the index.  */
+      struct hdr_index_entry *e;
+
+      if (!namelen || which == 0 || which < -1)
+        return NULL;
+      e = find_index_entry (msg->current_part->hdr_index,
+                            (const unsigned char *)name, namelen,
+                            hash_header_name ((const unsigned char *)name,
+                                              namelen));
+      if (!e->first || which == -1)
+        return e->first ? e->last : NULL;
+      for (hdr = e->first; hdr && --which; hdr = hdr->next_same)
+        ;
+      return hdr;
+    }
+
   hdr = msg->current_part->hdr_lines;
   if (rprev && *rprev)
     {
@@ -660,11 +870,9 @@ find_header (rfc822parse_t msg, const char *name, int which, HDR_LINE *rprev)
     {
       if (hdr->cont)
 	continue;
-      if (!(p = strchr (hdr->line, ':')))
-	continue;		/* invalid header, just skip it. */
-      n = p - hdr->line;
+      n = hdr->namelen;
       if (!n)
-	continue;		/* invalid name */
+	continue;		/* invalid header, just skip it. */
       if ((glob ? (namelen <= n) : (namelen == n))
 	  && !memcmp (hdr->line, name, namelen))
 	{
@@ -695,33 +903,19 @@ skip_ws (const char *s)
 }
 
 
-static void
-release_token_list (TOKEN t)
-{
-  while (t)
-    {
-      TOKEN t2 = t->next;
-      /* fixme: If we have owner_pantry, put the token back to
-       * this pantry so that it can be reused later */
-      xfree (t);
-      t = t2;
-    }
-}
-
-
 static TOKEN
-new_token (enum token_type type, const char *buf, size_t length)
+new_token (rfc822parse_t msg, enum token_type type, const char *buf,
+           size_t length)
 {
   TOKEN t;
 
-  /* fixme: look through our pantries to find a suitable
-   * token for reuse */
-  t = xmalloc (sizeof *t + length);
+  t = arena_alloc (&msg->token_arena, sizeof *t + length);
   if (t)
     {
       t->next = NULL;
       t->type = type;
       memset (&t->flags, 0, sizeof (t->flags));
+      t->owner = NULL;
       t->data[0] = 0;
       if (buf)
         {
@@ -734,23 +928,25 @@ new_token (enum token_type type, const char *buf, size_t length)
   return t;
 }
 
+/* Return a copy of the token OLD with BUF of LENGTH appended.  The
+   memory of OLD is not reused.  */
 static TOKEN
-append_to_token (TOKEN old, const char *buf, size_t length)
+append_to_token (rfc822parse_t msg, TOKEN old, const char *buf,
+                 size_t length)
 {
   size_t n = strlen (old->data);
   TOKEN t;
 
-  t = xmalloc (sizeof *t + n + length);
+  t = arena_alloc (&msg->token_arena, sizeof *t + n + length);
   if (t)
     {
       t->next = old->next;
       t->type = old->type;
       t->flags = old->flags;
+      t->owner = NULL;
       memcpy (t->data, old->data, n);
       memcpy (t->data + n, buf, length);
       t->data[n + length] = 0;
-      old->next = NULL;
-      release_token_list (old);
     }
   return t;
 }
@@ -761,7 +957,7 @@ append_to_token (TOKEN old, const char *buf, size_t length)
    Parse a field into tokens as defined by rfc822.
  */
 static TOKEN
-parse_field (HDR_LINE hdr)
+parse_field (rfc822parse_t msg, HDR_LINE hdr)
 {
   static const char specials[] = "<>@.,;:\\[]\"()";
   static const char specials2[] = "<>@.,;:";
@@ -819,7 +1015,14 @@ parse_field (HDR_LINE hdr)
       while (!*s)
 	{
 	  if (!hdr->next || !hdr->next->cont)
-	    return tok; /* Ready.  */
+	    {
+              if (tok)
+                {
+                  tok->owner = msg;
+                  msg->live_fields++;
+                }
+	      return tok; /* Ready.  */
+	    }
           /* Next item is a header continuation line.  */
 	  hdr = hdr->next;
 	  s = hdr->line;
@@ -884,8 +1087,9 @@ parse_field (HDR_LINE hdr)
 		}
 
 	      t = (t
-                   ? append_to_token (t, s, s2 - s)
-                   : new_token (term == '\"'? tQUOTED : tDOMAINLIT, s, s2 - s));
+                   ? append_to_token (msg, t, s, s2 - s)
+                   : new_token (msg, term == '\"'? tQUOTED : tDOMAINLIT,
+                                s, s2 - s));
               if (!t)
                 goto failure;
 
@@ -904,7 +1108,7 @@ parse_field (HDR_LINE hdr)
       else if ((s2 = strchr (delimiters2, *s)))
 	{ /* Special characters which are not handled above. */
 	  invalid = 0;
-	  t = new_token (tSPECIAL, s, 1);
+	  t = new_token (msg, tSPECIAL, s, 1);
           if (!t)
             goto failure;
 	  *tok_tail = t;
@@ -922,7 +1126,7 @@ parse_field (HDR_LINE hdr)
 	  for (s2 = s + 1; *s2 > 0x20
 	       && !(*s2 & 128) && !strchr (delimiters, *s2); s2++)
 	    ;
-	  t = new_token (tATOM, s, s2 - s);
+	  t = new_token (msg, tATOM, s, s2 - s);
           if (!t)
             goto failure;
 	  *tok_tail = t;
@@ -933,7 +1137,7 @@ parse_field (HDR_LINE hdr)
 	{ /* Invalid character. */
 	  if (!invalid)
 	    { /* For parsing we assume only one space. */
-	      t = new_token (tSPACE, NULL, 0);
+	      t = new_token (msg, tSPACE, NULL, 0);
               if (!t)
                 goto failure;
 	      *tok_tail = t;
@@ -946,11 +1150,8 @@ parse_field (HDR_LINE hdr)
   /*NOTREACHED*/
 
  failure:
-  {
-    int save = errno;
-    release_token_list (tok);
-    errno = save;
-  }
+  if (!msg->live_fields)
+    arena_release (&msg->token_arena, 1);
   return NULL;
 }
 
@@ -978,14 +1179,22 @@ rfc822parse_parse_field (rfc822parse_t msg, const char *name, int which)
   hdr = find_header (msg, name, which, NULL);
   if (!hdr)
     return NULL;
-  return parse_field (hdr);
+  return parse_field (msg, hdr);
 }
 
+/* The tokens of CTX are taken from the token arena of the message
+   which is reused once no field is in use anymore.  CTX may thus not
+   be used after the message has been closed.  */
 void
 rfc822parse_release_field (rfc822parse_field_t ctx)
 {
-  if (ctx)
-    release_token_list (ctx);
+  rfc822parse_t msg;
+
+  if (!ctx)
+    return;
+  msg = ctx->owner;
+  if (!--msg->live_fields)
+    arena_release (&msg->token_arena, 1);
 }
 
 
@@ -0,0 +1,85 @@
+/* @file rwlock.h
+ * @brief A lock for data which is read much more often than written
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RWLOCK_H
+#define RWLOCK_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+/* A reader-writer lock.  Any number of readers can hold the lock at
+   the same time while a writer holds it alone.  The lock is not
+   recursive: a thread which holds the lock in any mode must not try
+   to take it again.  Unlike the gpgrt locks it needs no
+   initialization call, so it can be used for static objects.  */
+class RWLock
+{
+public:
+#ifdef HAVE_W32_SYSTEM
+  RWLock () { InitializeSRWLock (&m_lock); }
+  ~RWLock () {}
+
+  void lock () { AcquireSRWLockExclusive (&m_lock); }
+  void unlock () { ReleaseSRWLockExclusive (&m_lock); }
+  void lockShared () { AcquireSRWLockShared (&m_lock); }
+  void unlockShared () { ReleaseSRWLockShared (&m_lock); }
+#else
+  RWLock ()
+  {
+    pthread_rwlockattr_t attr;
+
+    pthread_rwlockattr_init (&attr);
+#ifdef __GLIBC__
+    /* By default glibc lets new readers in while a writer waits so
+       that a steady stream of readers starves the writer.  */
+    pthread_rwlockattr_setkind_np
+      (&attr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init (&m_lock, &attr);
+    pthread_rwlockattr_destroy (&attr);
+  }
+  ~RWLock () { pthread_rwlock_destroy (&m_lock); }
+
+  void lock () { pthread_rwlock_wrlock (&m_lock); }
+  void unlock () { pthread_rwlock_unlock (&m_lock); }
+  void lockShared () { pthread_rwlock_rdlock (&m_lock); }
+  void unlockShared () { pthread_rwlock_unlock (&m_lock); }
+#endif
+
+private:
+  RWLock (const RWLock &) = delete;
+  RWLock &operator= (const RWLock &) = delete;
+
+#ifdef HAVE_W32_SYSTEM
+  SRWLOCK m_lock;
+#else
+  pthread_rwlock_t m_lock;
+#endif
+};
+
+#endif /* RWLOCK_H */
@@ -0,0 +1,142 @@
+/* signeddataprovider.cpp - GpgME dataprovider for multipart/signed data
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include "common_indep.h"
+#include <string.h>
+#include <errno.h>
+
+#include "signeddataprovider.h"
+
+SignedDataProvider::SignedDataProvider (const std::string &head,
+                                        GpgME::Data &signedData,
+                                        const std::string &tail):
+  m_head (head),
+  m_signed_data (signedData),
+  m_tail (tail),
+  m_state (StateHead),
+  m_pos (0),
+  m_offset (0)
+{
+  m_signed_data.seek (0, SEEK_SET);
+}
+
+bool
+SignedDataProvider::isSupported (GpgME::DataProvider::Operation op) const
+{
+  return op == GpgME::DataProvider::Read ||
+         op == GpgME::DataProvider::Seek ||
+         op == GpgME::DataProvider::Release;
+}
+
+/* Fill BUFFER from the head, the signed data and the tail in turn.
+   The signed data is read directly into BUFFER.  */
+#if GPGMEPP_VERSION >= 0x020000
+gpgme_ssize_t
+SignedDataProvider::read (void *buffer, size_t size)
+#else
+ssize_t
+SignedDataProvider::read (void *buffer, size_t size)
+#endif
+{
+  char *p = (char *) buffer;
+  size_t nread = 0;
+
+  while (nread < size && m_state != StateDone)
+    {
+      if (m_state == StateBody)
+        {
+          const auto n = m_signed_data.read (p + nread, size - nread);
+          if (n < 0)
+            {
+              log_error ("%s:%s: Failed to read the signed data.",
+                         SRCNAME, __func__);
+              errno = EIO;
+              return -1;
+            }
+          if (!n)
+            {
+              m_state = StateTail;
+              m_pos = 0;
+              continue;
+            }
+          nread += n;
+          /* Don't wait for more data which might not be available
+             right now.  */
+          break;
+        }
+
+      const std::string &str = m_state == StateHead ? m_head : m_tail;
+      size_t n = str.size () - m_pos;
+      if (n > size - nread)
+        {
+          n = size - nread;
+        }
+      memcpy (p + nread, str.data () + m_pos, n);
+      m_pos += n;
+      nread += n;
+      if (m_pos == str.size ())
+        {
+          m_state = m_state == StateHead ? StateBody : StateDone;
+          m_pos = 0;
+        }
+    }
+  m_offset += nread;
+  return nread;
+}
+
+#if GPGMEPP_VERSION >= 0x020000
+gpgme_ssize_t
+SignedDataProvider::write (const void *, size_t)
+#else
+ssize_t
+SignedDataProvider::write (const void *, size_t)
+#endif
+{
+  log_error ("%s:%s: Write not supported.",
+             SRCNAME, __func__);
+  errno = EBADF;
+  return -1;
+}
+
+#if GPGMEPP_VERSION >= 0x020000
+gpgme_off_t
+SignedDataProvider::seek (gpgme_off_t offset, int whence)
+#else
+off_t
+SignedDataProvider::seek (off_t offset, int whence)
+#endif
+{
+  if (whence == SEEK_CUR && !offset)
+    {
+      return m_offset;
+    }
+  if ((whence == SEEK_SET && !offset)
+      || (whence == SEEK_CUR && offset == -m_offset))
+    {
+      m_signed_data.seek (0, SEEK_SET);
+      m_state = StateHead;
+      m_pos = 0;
+      m_offset = 0;
+      return 0;
+    }
+  log_debug ("%s:%s: Unsupported seek %li whence %i.",
+             SRCNAME, __func__, (long) offset, whence);
+  errno = EINVAL;
+  return -1;
+}
@@ -0,0 +1,94 @@
+/* signeddataprovider.h - GpgME dataprovider for multipart/signed data
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SIGNEDDATAPROVIDER_H
+#define SIGNEDDATAPROVIDER_H
+
+#include "config.h"
+
+#include <gpgme++/interfaces/dataprovider.h>
+#include <gpgme++/data.h>
+#include <gpgme++/gpgmepp_version.h>
+
+#include <string>
+
+/** Provides a multipart/signed MIME structure without building it
+  in memory.
+
+  For PGP/MIME sign and encrypt the multipart/signed structure is the
+  plaintext of the encryption.  It consists of the top header and the
+  first boundary, the signed data, and the signature part with the
+  final boundary.  The header and the signature part are small and
+  kept as strings.  The signed data is read from its GpgME::Data
+  object only when the engine reads from this provider, so apart from
+  the signed data nothing of the size of the message is held in
+  memory.
+
+  The signed data must stay valid for the lifetime of the provider.
+  Seeking is only possible back to the start.  */
+class SignedDataProvider : public GpgME::DataProvider
+{
+public:
+  SignedDataProvider (const std::string &head, GpgME::Data &signedData,
+                      const std::string &tail);
+  ~SignedDataProvider () {}
+
+  /* Dataprovider interface */
+  bool isSupported (Operation) const;
+
+#if GPGMEPP_VERSION >= 0x020000
+  gpgme_ssize_t read (void *buffer, size_t bufSize);
+
+  gpgme_ssize_t write (const void *buffer, size_t bufSize);
+
+  /* Only a seek to the start or to the current position is
+     possible.  */
+  gpgme_off_t seek (gpgme_off_t offset, int whence);
+#else
+  ssize_t read (void *buffer, size_t bufSize);
+
+  ssize_t write (const void *buffer, size_t bufSize);
+
+  /* Only a seek to the start or to the current position is
+     possible.  */
+  off_t seek (off_t offset, int whence);
+#endif
+
+  /* Noop */
+  void release () {}
+
+private:
+  enum state_t
+    {
+      StateHead,
+      StateBody,
+      StateTail,
+      StateDone
+    };
+
+  std::string m_head;
+  GpgME::Data m_signed_data;
+  std::string m_tail;
+  state_t m_state;
+  /* The position in m_head or m_tail.  */
+  size_t m_pos;
+  /* The number of bytes read so far.  */
+  gpgme_off_t m_offset;
+};
+
+#endif // SIGNEDDATAPROVIDER_H
@@ -0,0 +1,191 @@
+/* sink.cpp - Output objects for the MIME construction
+ * Copyright (C) 2007, 2008 g10 Code GmbH
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+#include <string>
+
+#include "sink.h"
+#include "common_indep.h"
+
+/* Pieces of up to this size given to write_bufferv for an unbuffered
+   sink are collected on the stack and written at once.  */
+#define SINK_GATHER_SIZE 512
+
+
+void
+sink_set_buffer (sink_t sink, size_t bufsize)
+{
+  sink_release_buffer (sink);
+  if (!bufsize)
+    return;
+  sink->buffer = (char *) xmalloc (bufsize);
+  sink->bufsize = bufsize;
+}
+
+
+int
+sink_flush (sink_t sink)
+{
+  int rc;
+
+  if (!sink || !sink->buffer || !sink->buflen)
+    return 0;
+  rc = sink->writefnc (sink, sink->buffer, sink->buflen);
+  sink->buflen = 0;
+  return rc;
+}
+
+
+void
+sink_release_buffer (sink_t sink)
+{
+  if (!sink)
+    return;
+  xfree (sink->buffer);
+  sink->buffer = NULL;
+  sink->buflen = 0;
+  sink->bufsize = 0;
+}
+
+
+int
+sink_string_append (sink_t sink, const void *data, size_t datalen)
+{
+  std::string *str = static_cast<std::string *> (sink->cb_data);
+
+  if (data)
+    str->append (static_cast<const char *> (data), datalen);
+  return 0;
+}
+
+
+/* Write data to a sink_t.  */
+int
+write_buffer (sink_t sink, const void *data, size_t datalen)
+{
+  int rc;
+
+  if (!sink || !sink->writefnc)
+    {
+      log_error ("%s:%s: sink not properly setup", SRCNAME, __func__);
+      return -1;
+    }
+  if (!sink->buffer)
+    return sink->writefnc (sink, data, datalen);
+
+  if (!data)
+    {
+      /* Flush.  */
+      if ((rc = sink_flush (sink)))
+        return rc;
+      return sink->writefnc (sink, data, datalen);
+    }
+  if (sink->buflen + datalen > sink->bufsize)
+    {
+      if ((rc = sink_flush (sink)))
+        return rc;
+      if (datalen >= sink->bufsize)
+        return sink->writefnc (sink, data, datalen);
+    }
+  memcpy (sink->buffer + sink->buflen, data, datalen);
+  sink->buflen += datalen;
+  return 0;
+}
+
+
+int
+write_bufferv (sink_t sink, const sink_iov_t *iov, size_t iovcnt)
+{
+  char gather[SINK_GATHER_SIZE];
+  size_t total = 0;
+  size_t i;
+  int rc;
+
+  if (sink && !sink->buffer)
+    {
+      for (i = 0; i < iovcnt; i++)
+        total += iov[i].datalen;
+      if (total <= sizeof gather)
+        {
+          total = 0;
+          for (i = 0; i < iovcnt; i++)
+            {
+              memcpy (gather + total, iov[i].data, iov[i].datalen);
+              total += iov[i].datalen;
+            }
+          return write_buffer (sink, gather, total);
+        }
+    }
+  for (i = 0; i < iovcnt; i++)
+    if ((rc = write_buffer (sink, iov[i].data, iov[i].datalen)))
+      return rc;
+  return 0;
+}
+
+
+/* Same as above but used for passing as callback function.  This
+   fucntion does not return an error code but the number of bytes
+   written.  */
+int
+write_buffer_for_cb (void *opaque, const void *data, size_t datalen)
+{
+  sink_t sink = (sink_t) opaque;
+  sink->enc_counter += datalen;
+  return write_buffer (sink, data, datalen) ? -1 : datalen;
+}
+
+
+/* Write the string TEXT to the IStream STREAM.  Returns 0 on sucsess,
+   prints an error message and returns -1 on error.  */
+int
+write_string (sink_t sink, const char *text)
+{
+  return write_buffer (sink, text, strlen (text));
+}
+
+
+/* Write DATALEN bytes of DATA to SINK in base64 encoding.  This
+   creates a complete Base64 chunk including the trailing fillers.  */
+int
+write_b64 (sink_t sink, const void *data, size_t datalen)
+{
+  int rc;
+  const char *p = (const char *)data;
+  /* Encode 128 lines at once.  */
+  char outbuf[B64_MIME_ENCODED_LEN (128 * B64_MIME_LINE_INPUT)];
+  size_t n, outlen;
+
+  log_debug ("  writing base64 of length %d\n", (int)datalen);
+  for (; datalen; p += n, datalen -= n)
+    {
+      n = datalen;
+      if (n > 128 * B64_MIME_LINE_INPUT)
+        n = 128 * B64_MIME_LINE_INPUT;
+      outlen = b64_encode_mime (outbuf, p, n);
+      if ((rc = write_buffer (sink, outbuf, outlen)))
+        return rc;
+    }
+
+  return 0;
+}
@@ -0,0 +1,77 @@
+/* sink.h - Output objects for the MIME construction
+ * Copyright (C) 2007, 2008 g10 Code GmbH
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SINK_H
+#define SINK_H
+
+#include <stddef.h>
+
+/* The default size of the buffer of a buffered sink.  */
+#define SINK_BUFFER_SIZE 16384
+
+/* The object we use instead of IStream.  It allows us to have a
+   callback method for output and thus for processing stuff
+   recursively.  */
+struct sink_s;
+typedef struct sink_s *sink_t;
+struct sink_s
+{
+  void *cb_data;
+  sink_t extrasink;
+  int (*writefnc)(sink_t sink, const void *data, size_t datalen);
+  unsigned long enc_counter; /* Used by write_buffer_for_cb.  */
+  /* If BUFFER is set writes are collected there and passed on to
+     WRITEFNC in blocks of up to BUFSIZE bytes.  See sink_set_buffer.  */
+  char *buffer;
+  size_t buflen;
+  size_t bufsize;
+};
+
+/* One piece of data for write_bufferv.  */
+struct sink_iov_s
+{
+  const void *data;
+  size_t datalen;
+};
+typedef struct sink_iov_s sink_iov_t;
+
+/* Let SINK collect the data in a buffer of BUFSIZE bytes.  Data
+   which does not fit into an empty buffer is passed on directly.
+   The caller needs to call sink_flush before the output is used and
+   sink_release_buffer when done.  */
+void sink_set_buffer (sink_t sink, size_t bufsize);
+/* Pass the buffered data of SINK on to its write function.  */
+int sink_flush (sink_t sink);
+/* Release the buffer of SINK without writing it.  */
+void sink_release_buffer (sink_t sink);
+
+/* A write function which appends the data to the std::string in
+   the cb_data of the sink.  */
+int sink_string_append (sink_t sink, const void *data, size_t datalen);
+
+int write_buffer_for_cb (void *opaque, const void *data, size_t datalen);
+int write_buffer (sink_t sink, const void *data, size_t datalen);
+/* Write the IOVCNT pieces of data in IOV to SINK.  Small pieces are
+   passed to the write function of an unbuffered sink at once.  */
+int write_bufferv (sink_t sink, const sink_iov_t *iov, size_t iovcnt);
+int write_string (sink_t sink, const char *text);
+int write_b64 (sink_t sink, const void *data, size_t datalen);
+
+#endif /*SINK_H*/
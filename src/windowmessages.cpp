@@ -352,6 +352,18 @@ gpgol_window_proc (HWND hWnd, UINT message, WPARAM wParam, LPARAM lParam)
               mail->setDoAutosecure_m (false);
               TBREAK;
             }
+          case (PREPARE_CRYPTO):
+            {
+              auto mail = (Mail*) ctx->data;
+              if (!Mail::isValidPtr (mail))
+                {
+                  log_debug ("%s:%s: PREPARE_CRYPTO for mail which is gone.",
+                             SRCNAME, __func__);
+                  TBREAK;
+                }
+              mail->prewarmCrypto_o ();
+              TBREAK;
+            }
           case (CONFIG_KEY_DONE):
             {
               log_debug ("%s:%s: Key configuration done.",
@@ -65,6 +65,8 @@ typedef enum _gpgol_wmsg_type
   SEND,
   SHOW_PREVIEW, /* Show mail contents before a verify is done */
   SELECT_MAIL,
+  PREPARE_CRYPTO, /* Resolve the keys of a mail in the composer ahead
+                     of the send. Data should be ptr to mail */
   /* External API, keep it stable! */
   EXT_API_CLOSE = 1301,
   EXT_API_CLOSE_ALL = 1302,
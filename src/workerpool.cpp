@@ -0,0 +1,230 @@
+/* @file workerpool.cpp
+ * @brief A bounded pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "workerpool.h"
+
+#include "common_indep.h"
+
+WorkerPool::WorkerPool (const char *name, int max_workers,
+                        const std::function<std::function<void ()> ()> &take):
+  m_name (name),
+  m_take (take),
+  m_max_workers (max_workers < 1 ? 1 : max_workers),
+  m_workers (0),
+  m_idle (0),
+  m_wakeups (0),
+  m_queued (0),
+  m_running (0)
+{
+#ifdef HAVE_W32_SYSTEM
+  InitializeCriticalSection (&m_lock);
+  InitializeConditionVariable (&m_work_cond);
+  InitializeConditionVariable (&m_done_cond);
+#else
+  pthread_mutex_init (&m_lock, nullptr);
+  pthread_cond_init (&m_work_cond, nullptr);
+  pthread_cond_init (&m_done_cond, nullptr);
+#endif
+}
+
+#ifdef HAVE_W32_SYSTEM
+void
+WorkerPool::lock ()
+{
+  EnterCriticalSection (&m_lock);
+}
+
+void
+WorkerPool::unlock ()
+{
+  LeaveCriticalSection (&m_lock);
+}
+
+DWORD WINAPI
+WorkerPool::worker_thread (LPVOID arg)
+{
+  static_cast<WorkerPool *> (arg)->work ();
+  return 0;
+}
+#else
+void
+WorkerPool::lock ()
+{
+  pthread_mutex_lock (&m_lock);
+}
+
+void
+WorkerPool::unlock ()
+{
+  pthread_mutex_unlock (&m_lock);
+}
+
+void *
+WorkerPool::worker_thread (void *arg)
+{
+  static_cast<WorkerPool *> (arg)->work ();
+  return nullptr;
+}
+#endif
+
+/* Start a new worker thread.  Called with the lock held.  */
+void
+WorkerPool::startWorker ()
+{
+#ifdef HAVE_W32_SYSTEM
+  HANDLE thread = CreateThread (nullptr, 0, worker_thread, this, 0,
+                                nullptr);
+  if (!thread)
+    {
+      log_error ("%s:%s: Failed to create %s worker thread.",
+                 SRCNAME, __func__, m_name);
+      return;
+    }
+  CloseHandle (thread);
+#else
+  pthread_t thread;
+  if (pthread_create (&thread, nullptr, worker_thread, this))
+    {
+      log_error ("%s:%s: Failed to create %s worker thread.",
+                 SRCNAME, __func__, m_name);
+      return;
+    }
+  pthread_detach (thread);
+#endif
+  m_workers++;
+  log_debug ("%s:%s: Started %s worker %i of %i",
+             SRCNAME, __func__, m_name, m_workers, m_max_workers);
+}
+
+void
+WorkerPool::queued (int n)
+{
+  m_queued += n;
+  for (; n > 0; n--)
+    {
+      if (m_idle > m_wakeups)
+        {
+          m_wakeups++;
+#ifdef HAVE_W32_SYSTEM
+          WakeConditionVariable (&m_work_cond);
+#else
+          pthread_cond_signal (&m_work_cond);
+#endif
+        }
+      else if (m_workers < m_max_workers)
+        {
+          /* A new worker takes a job before it waits.  */
+          startWorker ();
+        }
+    }
+}
+
+void
+WorkerPool::dropped (int n)
+{
+  m_queued -= n;
+  if (!m_queued && !m_running)
+    {
+#ifdef HAVE_W32_SYSTEM
+      WakeAllConditionVariable (&m_done_cond);
+#else
+      pthread_cond_broadcast (&m_done_cond);
+#endif
+    }
+}
+
+void
+WorkerPool::work ()
+{
+  lock ();
+  for (;;)
+    {
+      while (!m_queued)
+        {
+          m_idle++;
+#ifdef HAVE_W32_SYSTEM
+          SleepConditionVariableCS (&m_work_cond, &m_lock, INFINITE);
+#else
+          pthread_cond_wait (&m_work_cond, &m_lock);
+#endif
+          m_idle--;
+          if (m_wakeups)
+            {
+              m_wakeups--;
+            }
+        }
+      auto job = m_take ();
+      m_queued--;
+      m_running++;
+      unlock ();
+
+      if (job)
+        {
+          job ();
+        }
+      /* Destroy the job's arguments before it is marked as done.  */
+      job = nullptr;
+
+      lock ();
+      m_running--;
+#ifdef HAVE_W32_SYSTEM
+      WakeAllConditionVariable (&m_done_cond);
+#else
+      pthread_cond_broadcast (&m_done_cond);
+#endif
+    }
+}
+
+void
+WorkerPool::wait (const std::function<bool ()> &done)
+{
+  lock ();
+  while (!done ())
+    {
+#ifdef HAVE_W32_SYSTEM
+      SleepConditionVariableCS (&m_done_cond, &m_lock, INFINITE);
+#else
+      pthread_cond_wait (&m_done_cond, &m_lock);
+#endif
+    }
+  unlock ();
+}
+
+void
+WorkerPool::waitIdle ()
+{
+  wait ([this] () { return !m_queued && !m_running; });
+}
+
+void
+WorkerPool::setMaxWorkers (int n)
+{
+  int waiting;
+
+  m_max_workers = n < 1 ? 1 : n;
+  /* Start workers for the queued jobs which no woken up worker is
+     going to take.  */
+  for (waiting = m_queued - m_wakeups;
+       waiting > 0 && m_workers < m_max_workers; waiting--)
+    {
+      startWorker ();
+    }
+}
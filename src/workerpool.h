@@ -0,0 +1,120 @@
+/* @file workerpool.h
+ * @brief A bounded pool of worker threads
+ *
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef HAVE_W32_SYSTEM
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
+#include <functional>
+
+/* The WorkerPool runs the jobs of a queue in up to a maximum number
+   of worker threads.  The queue itself and the order of its jobs
+   belong to the user of the pool, e.g. the KeyJobQueue or the
+   ParseScheduler, which tells the pool how many jobs it queued or
+   dropped.  A worker calls the take function to get the next job.
+   All of this is done with the lock of the pool held, which the
+   user also uses to protect its queue.  A user that needs to wait
+   for some of its jobs, like a JobGroup, checks its own state with
+   wait.
+
+   A new worker is started whenever the queued jobs outnumber the
+   idle workers which have not yet been woken up for a job, so a
+   burst of jobs does not wait for a worker that was woken up but
+   did not yet run.  Workers are never stopped and keep a pointer to
+   the pool so it must never be destroyed.  */
+class WorkerPool
+{
+public:
+  /* NAME is used for the log.  TAKE is called by a worker with the
+     lock held and returns the next queued job.  */
+  WorkerPool (const char *name, int max_workers,
+              const std::function<std::function<void ()> ()> &take);
+
+  void lock ();
+  void unlock ();
+
+  /* N jobs were queued.  Called with the lock held.  */
+  void queued (int n = 1);
+
+  /* N queued jobs were dropped without being taken.  Called with
+     the lock held.  */
+  void dropped (int n = 1);
+
+  /* Wait until DONE returns true.  DONE is called with the lock
+     held, first and then whenever a job is done.  Called without the
+     lock.  */
+  void wait (const std::function<bool ()> &done);
+
+  /* Wait until no job is queued or running.  Called without the
+     lock.  */
+  void waitIdle ();
+
+  /* Set the maximum number of worker threads.  Threads which are
+     already running are not stopped.  Called with the lock held.  */
+  void setMaxWorkers (int n);
+  int maxWorkers () const { return m_max_workers; }
+
+  /* The counters.  Called with the lock held.  */
+  int queuedJobs () const { return m_queued; }
+  int runningJobs () const { return m_running; }
+  int workers () const { return m_workers; }
+
+private:
+  void startWorker ();
+  void work ();
+#ifdef HAVE_W32_SYSTEM
+  static DWORD WINAPI worker_thread (LPVOID arg);
+#else
+  static void *worker_thread (void *arg);
+#endif
+
+  const char *m_name;
+  std::function<std::function<void ()> ()> m_take;
+  int m_max_workers;
+  int m_workers;
+  /* Workers waiting for a job.  */
+  int m_idle;
+  /* Idle workers which were woken up for a job but did not yet
+     return from the wait.  */
+  int m_wakeups;
+  int m_queued;
+  int m_running;
+#ifdef HAVE_W32_SYSTEM
+  CRITICAL_SECTION m_lock;
+  CONDITION_VARIABLE m_work_cond;
+  CONDITION_VARIABLE m_done_cond;
+#else
+  pthread_mutex_t m_lock;
+  pthread_cond_t m_work_cond;
+  pthread_cond_t m_done_cond;
+#endif
+};
+
+#endif /* WORKERPOOL_H */
@@ -0,0 +1,718 @@
+/* run-bench.cpp - Throughput benchmark for the ParseController.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This runs the ParseController over all mails in tests/data and
+   over generated mails from 1 KiB up to 200 MiB which are signed and
+   encrypted with the test key.  The generated mails cover deep
+   nesting, many attachments and quoted-printable and base64 heavy
+   parts.  For each mail the throughput, the number of heap
+   allocations and the peak RSS are reported, summed up per message
+   type and optionally written as JSON to track regressions.
+
+   The allocations are counted by wrapping malloc, which only works
+   with the GNU C library.  The peak RSS is reset before each mail on
+   Linux and is otherwise the peak of the whole process.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gpgme.h>
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/encryptionresult.h>
+#include <gpgme++/signingresult.h>
+
+#include "parsecontroller.h"
+#include "attachment.h"
+
+/* Same as used by the ParseController for Outlook streams.  */
+#define STREAMING_THRESHOLD (8 * 1024 * 1024)
+
+/* Mails larger than this are only parsed once.  */
+#define SINGLE_RUN_SIZE (64 * 1024 * 1024)
+
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc (size_t);
+extern "C" void *__libc_calloc (size_t, size_t);
+extern "C" void *__libc_realloc (void *, size_t);
+
+static std::atomic<unsigned long> alloc_count;
+
+extern "C" void *
+malloc (size_t n) __THROW
+{
+  alloc_count.fetch_add (1, std::memory_order_relaxed);
+  return __libc_malloc (n);
+}
+
+extern "C" void *
+calloc (size_t m, size_t n) __THROW
+{
+  alloc_count.fetch_add (1, std::memory_order_relaxed);
+  return __libc_calloc (m, n);
+}
+
+extern "C" void *
+realloc (void *p, size_t n) __THROW
+{
+  alloc_count.fetch_add (1, std::memory_order_relaxed);
+  return __libc_realloc (p, n);
+}
+
+# define HAVE_ALLOC_COUNT 1
+static unsigned long
+get_alloc_count ()
+{
+  return alloc_count.load (std::memory_order_relaxed);
+}
+#else
+static unsigned long
+get_alloc_count ()
+{
+  return 0;
+}
+#endif
+
+
+/* Reset the peak RSS of the process if possible.  */
+static void
+reset_peak_rss ()
+{
+  FILE *fp = fopen ("/proc/self/clear_refs", "w");
+
+  if (fp)
+    {
+      fputs ("5", fp);
+      fclose (fp);
+    }
+}
+
+
+/* Return the peak RSS of the process in KiB.  */
+static long
+get_peak_rss ()
+{
+  struct rusage usage;
+  char line[256];
+  long ret = -1;
+  FILE *fp;
+
+  fp = fopen ("/proc/self/status", "r");
+  if (fp)
+    {
+      while (fgets (line, sizeof line, fp))
+        if (!strncmp (line, "VmHWM:", 6))
+          {
+            ret = atol (line + 6);
+            break;
+          }
+      fclose (fp);
+    }
+  if (ret < 0 && !getrusage (RUSAGE_SELF, &usage))
+    ret = usage.ru_maxrss;
+  return ret;
+}
+
+
+static const char *
+type_name (msgtype_t type)
+{
+  switch (type)
+    {
+    case MSGTYPE_GPGOL_MULTIPART_SIGNED: return "multipart-signed";
+    case MSGTYPE_GPGOL_MULTIPART_ENCRYPTED: return "multipart-encrypted";
+    case MSGTYPE_GPGOL_OPAQUE_SIGNED: return "opaque-signed";
+    case MSGTYPE_GPGOL_OPAQUE_ENCRYPTED: return "opaque-encrypted";
+    case MSGTYPE_GPGOL_CLEAR_SIGNED: return "clear-signed";
+    case MSGTYPE_GPGOL_PGP_MESSAGE: return "pgp-message";
+    default: return "unknown";
+    }
+}
+
+
+/* Return the message type for a mail in tests/data by its name.  */
+static msgtype_t
+type_for_file (const char *name)
+{
+  static const struct
+  {
+    const char *prefix;
+    msgtype_t type;
+  } table[] = {
+    { "inlinepgp", MSGTYPE_GPGOL_PGP_MESSAGE },
+    { "openpgp-encrypted", MSGTYPE_GPGOL_MULTIPART_ENCRYPTED },
+    { "openpgp-signed", MSGTYPE_GPGOL_MULTIPART_SIGNED },
+    { "smime-opaque-sign.", MSGTYPE_GPGOL_OPAQUE_SIGNED },
+    { "smime-", MSGTYPE_GPGOL_OPAQUE_ENCRYPTED },
+    { NULL, MSGTYPE_UNKNOWN }
+  };
+  int i;
+
+  for (i = 0; table[i].prefix; i++)
+    if (!strncmp (name, table[i].prefix, strlen (table[i].prefix)))
+      break;
+  return table[i].type;
+}
+
+
+/* The kinds of generated mails.  */
+enum gen_kind
+  {
+    GEN_SMALL,
+    GEN_BASE64,
+    GEN_QP,
+    GEN_NESTED,
+    GEN_ATTACHMENTS
+  };
+
+
+static void
+write_base64 (FILE *fp, size_t size)
+{
+  static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  char line[78];
+  size_t written;
+  int i;
+
+  line[76] = '\r';
+  line[77] = '\n';
+  for (written = 0; written < size; written += sizeof line)
+    {
+      for (i = 0; i < 76; i++)
+        line[i] = b64chars[rand () % 64];
+      fwrite (line, 1, sizeof line, fp);
+    }
+}
+
+
+static void
+write_qp (FILE *fp, size_t size, bool html)
+{
+  size_t written = 0;
+
+  while (written < size)
+    written += fprintf (fp, html
+                        ? "<p style=3D\"color: red\">Gr=C3=BC=C3=9Fe aus dem"
+                          " Benchmark, Zeile %lu</p>=\r\n"
+                        : "Gr=C3=BC=C3=9Fe aus dem Benchmark, Zeile %lu,"
+                          " =E2=82=AC=\r\n",
+                        (unsigned long) written);
+  fputs ("\r\n", fp);
+}
+
+
+/* Write a MIME entity of KIND with about SIZE bytes to FP.  */
+static void
+write_entity (FILE *fp, gen_kind kind, size_t size)
+{
+  int i;
+
+  switch (kind)
+    {
+    case GEN_SMALL:
+      fputs ("Content-Type: multipart/alternative; boundary=\"=-=alt=-=\"\r\n"
+             "\r\n"
+             "--=-=alt=-=\r\n"
+             "Content-Type: text/plain; charset=utf-8\r\n"
+             "Content-Transfer-Encoding: quoted-printable\r\n"
+             "\r\n", fp);
+      write_qp (fp, size / 3, false);
+      fputs ("--=-=alt=-=\r\n"
+             "Content-Type: text/html; charset=utf-8\r\n"
+             "Content-Transfer-Encoding: quoted-printable\r\n"
+             "\r\n", fp);
+      write_qp (fp, size / 3, true);
+      fputs ("--=-=alt=-=--\r\n", fp);
+      break;
+
+    case GEN_BASE64:
+      fputs ("Content-Type: multipart/mixed; boundary=\"=-=mixed=-=\"\r\n"
+             "\r\n"
+             "--=-=mixed=-=\r\n"
+             "Content-Type: text/plain; charset=us-ascii\r\n"
+             "\r\n"
+             "See the attachment.\r\n"
+             "--=-=mixed=-=\r\n"
+             "Content-Type: application/octet-stream\r\n"
+             "Content-Disposition: attachment; filename=\"data.bin\"\r\n"
+             "Content-Transfer-Encoding: base64\r\n"
+             "\r\n", fp);
+      write_base64 (fp, size);
+      fputs ("--=-=mixed=-=--\r\n", fp);
+      break;
+
+    case GEN_QP:
+      fputs ("Content-Type: multipart/alternative; boundary=\"=-=alt=-=\"\r\n"
+             "\r\n"
+             "--=-=alt=-=\r\n"
+             "Content-Type: text/plain; charset=utf-8\r\n"
+             "Content-Transfer-Encoding: quoted-printable\r\n"
+             "\r\n", fp);
+      write_qp (fp, size / 2, false);
+      fputs ("--=-=alt=-=\r\n"
+             "Content-Type: text/html; charset=utf-8\r\n"
+             "Content-Transfer-Encoding: quoted-printable\r\n"
+             "\r\n", fp);
+      write_qp (fp, size / 2, true);
+      fputs ("--=-=alt=-=--\r\n", fp);
+      break;
+
+    case GEN_NESTED:
+      for (i = 0; i < (int) size; i++)
+        fprintf (fp, "Content-Type: multipart/mixed; boundary=\"=-=%d=-=\"\r\n"
+                 "\r\n"
+                 "--=-=%d=-=\r\n"
+                 "Content-Type: text/plain; charset=us-ascii\r\n"
+                 "\r\n"
+                 "Level %d\r\n"
+                 "--=-=%d=-=\r\n", i, i, i, i);
+      fputs ("Content-Type: text/plain; charset=us-ascii\r\n"
+             "\r\n"
+             "The innermost part.\r\n", fp);
+      for (i = (int) size - 1; i >= 0; i--)
+        fprintf (fp, "--=-=%d=-=--\r\n", i);
+      break;
+
+    case GEN_ATTACHMENTS:
+      fputs ("Content-Type: multipart/mixed; boundary=\"=-=mixed=-=\"\r\n"
+             "\r\n"
+             "--=-=mixed=-=\r\n"
+             "Content-Type: text/plain; charset=us-ascii\r\n"
+             "\r\n"
+             "See the attachments.\r\n", fp);
+      for (i = 0; i < (int) size; i++)
+        {
+          fprintf (fp, "--=-=mixed=-=\r\n"
+                   "Content-Type: application/octet-stream;"
+                   " name=\"file%d.bin\"\r\n"
+                   "Content-Disposition: attachment;"
+                   " filename=\"file%d.bin\"\r\n"
+                   "Content-Transfer-Encoding: base64\r\n"
+                   "\r\n", i, i);
+          write_base64 (fp, 2048);
+        }
+      fputs ("--=-=mixed=-=--\r\n", fp);
+      break;
+    }
+}
+
+
+static FILE *
+make_tmpfile ()
+{
+  FILE *fp = tmpfile ();
+
+  if (!fp)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+  return fp;
+}
+
+
+/* Return a multipart/signed or multipart/encrypted mail with the
+   ENTITY using CTX and KEY.  */
+static FILE *
+wrap_entity (GpgME::Context *ctx, const GpgME::Key &key, FILE *entity,
+             msgtype_t type)
+{
+  FILE *fp = make_tmpfile ();
+  char buf[4096];
+  size_t n;
+
+  fputs ("From: test@example.com\r\n"
+         "To: test@example.com\r\n"
+         "Subject: Benchmark\r\n"
+         "MIME-Version: 1.0\r\n", fp);
+  if (type == MSGTYPE_GPGOL_MULTIPART_ENCRYPTED)
+    fputs ("Content-Type: multipart/encrypted;"
+           " protocol=\"application/pgp-encrypted\"; boundary=\"outer\"\r\n"
+           "\r\n"
+           "--outer\r\n"
+           "Content-Type: application/pgp-encrypted\r\n"
+           "\r\n"
+           "Version: 1\r\n"
+           "\r\n"
+           "--outer\r\n"
+           "Content-Type: application/octet-stream\r\n"
+           "\r\n", fp);
+  else
+    {
+      fputs ("Content-Type: multipart/signed; micalg=pgp-sha256;"
+             " protocol=\"application/pgp-signature\"; boundary=\"outer\"\r\n"
+             "\r\n"
+             "--outer\r\n", fp);
+      rewind (entity);
+      while ((n = fread (buf, 1, sizeof buf, entity)))
+        fwrite (buf, 1, n, fp);
+      fputs ("\r\n--outer\r\n"
+             "Content-Type: application/pgp-signature\r\n"
+             "\r\n", fp);
+    }
+  fflush (fp);
+  rewind (entity);
+
+  {
+    GpgME::Data plain (entity);
+    GpgME::Data out (fp);
+    GpgME::Error err;
+
+    if (type == MSGTYPE_GPGOL_MULTIPART_ENCRYPTED)
+      err = ctx->encrypt ({key}, plain, out,
+                          GpgME::Context::AlwaysTrust).error ();
+    else
+      err = ctx->sign (plain, out, GpgME::Detached).error ();
+    if (err)
+      {
+        std::cerr << "Failed to create the mail: " << err.asString ()
+                  << std::endl;
+        exit (1);
+      }
+  }
+  fseeko (fp, 0, SEEK_END);
+  fputs ("\r\n--outer--\r\n", fp);
+  fflush (fp);
+  return fp;
+}
+
+
+struct result_s
+{
+  std::string name;
+  msgtype_t type = MSGTYPE_UNKNOWN;
+  long long size = 0;
+  int runs = 0;
+  double best = 0;          /* Best time in seconds.  */
+  double total = 0;         /* Total time of all runs.  */
+  unsigned long allocs = 0; /* Allocations of the last run.  */
+  long peak_rss = 0;        /* Peak RSS in KiB.  */
+};
+
+
+/* Parse FP as mail of TYPE REPEATS times.  */
+static result_s
+run_mail (const std::string &name, FILE *fp, msgtype_t type, int repeats)
+{
+  result_s res;
+  unsigned long allocs;
+  int i;
+
+  fseeko (fp, 0, SEEK_END);
+  res.name = name;
+  res.type = type;
+  res.size = ftello (fp);
+  if (res.size >= SINGLE_RUN_SIZE)
+    repeats = 1;
+  res.runs = repeats;
+
+  reset_peak_rss ();
+  for (i = 0; i < repeats; i++)
+    {
+      rewind (fp);
+      allocs = get_alloc_count ();
+      const auto start = std::chrono::steady_clock::now ();
+      {
+        ParseController parser (fp, type, res.size >= STREAMING_THRESHOLD);
+        parser.setSender ("test@example.com");
+        parser.parse (true);
+        if (parser.decrypt_result ().error ()
+            || parser.verify_result ().error ())
+          {
+            std::cerr << name << ": Decrypt or verify error:\n"
+                      << parser.decrypt_result ()
+                      << parser.verify_result ();
+            exit (1);
+          }
+      }
+      const auto stop = std::chrono::steady_clock::now ();
+      double secs = std::chrono::duration<double> (stop - start).count ();
+
+      res.allocs = get_alloc_count () - allocs;
+      res.total += secs;
+      if (!i || secs < res.best)
+        res.best = secs;
+    }
+  res.peak_rss = get_peak_rss ();
+
+  printf ("%-40s %-20s %10.2f KiB %9.2f MB/s %9lu allocs %8ld KiB RSS\n",
+          res.name.c_str (), type_name (type), res.size / 1024.0,
+          res.size / res.best / 1e6, res.allocs, res.peak_rss);
+  fflush (stdout);
+  return res;
+}
+
+
+static void
+write_json (const char *fname, const std::vector<result_s> &results)
+{
+  std::map<std::string, result_s> types;
+  FILE *fp;
+  size_t i;
+
+  fp = fopen (fname, "w");
+  if (!fp)
+    {
+      perror (fname);
+      exit (1);
+    }
+
+  fputs ("{\n", fp);
+#ifdef PACKAGE_VERSION
+  fprintf (fp, "  \"version\": \"%s\",\n", PACKAGE_VERSION);
+#endif
+  fprintf (fp, "  \"allocations_counted\": %s,\n",
+#ifdef HAVE_ALLOC_COUNT
+           "true"
+#else
+           "false"
+#endif
+           );
+  fputs ("  \"results\": [\n", fp);
+  for (i = 0; i < results.size (); i++)
+    {
+      const auto &r = results[i];
+      auto &t = types[type_name (r.type)];
+
+      fprintf (fp, "    { \"name\": \"%s\", \"type\": \"%s\", \"bytes\": %lld,"
+               " \"runs\": %d, \"best_seconds\": %.6f, \"mean_seconds\": %.6f,"
+               " \"mb_per_s\": %.3f, \"allocations\": %lu,"
+               " \"peak_rss_kb\": %ld }%s\n",
+               r.name.c_str (), type_name (r.type), r.size, r.runs,
+               r.best, r.total / r.runs, r.size / r.best / 1e6, r.allocs,
+               r.peak_rss, i + 1 < results.size () ? "," : "");
+
+      t.size += r.size;
+      t.best += r.best;
+      t.allocs += r.allocs;
+      if (r.peak_rss > t.peak_rss)
+        t.peak_rss = r.peak_rss;
+    }
+  fputs ("  ],\n"
+         "  \"types\": {\n", fp);
+  for (auto it = types.begin (); it != types.end (); it++)
+    fprintf (fp, "    \"%s\": { \"bytes\": %lld, \"seconds\": %.6f,"
+             " \"mb_per_s\": %.3f, \"allocations\": %lu,"
+             " \"peak_rss_kb\": %ld }%s\n",
+             it->first.c_str (), it->second.size, it->second.best,
+             it->second.size / it->second.best / 1e6, it->second.allocs,
+             it->second.peak_rss,
+             std::next (it) != types.end () ? "," : "");
+  fputs ("  }\n"
+         "}\n", fp);
+  fclose (fp);
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-bench [options] [DIR]\n\n"
+         "Runs the parser over the mbox files in DIR (default: tests/data)\n"
+         "and over generated mails.\n\n"
+         "Options:\n"
+         "  --verbose             run in verbose mode\n"
+         "  --repeat N            parse each mail N times (default: 3)\n"
+         "  --max-size N          largest generated mail in MiB (default: 200)\n"
+         "  --no-generated        only use the files in DIR\n"
+         "  --json FILE           write the results as JSON to FILE\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int repeats = 3;
+  size_t max_size = 200;
+  bool generated = true;
+  const char *json = NULL;
+  const char *datadir = DATADIR;
+  std::vector<result_s> results;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--verbose"))
+        {
+          opt.enable_debug |= 1;
+          set_log_file ("stderr");
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeats = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--max-size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          max_size = (size_t) atol (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--no-generated"))
+        {
+          generated = false;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--json"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          json = *argv;
+          argc--; argv++;
+        }
+    }
+  if (argc > 1 || repeats < 1)
+    show_usage (1);
+  if (argc)
+    datadir = *argv;
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  /* The mails in the data directory.  */
+  DIR *dir = opendir (datadir);
+  if (!dir)
+    {
+      perror (datadir);
+      exit (1);
+    }
+  std::vector<std::string> names;
+  struct dirent *dent;
+  while ((dent = readdir (dir)))
+    {
+      size_t len = strlen (dent->d_name);
+      if (len > 5 && !strcmp (dent->d_name + len - 5, ".mbox")
+          && type_for_file (dent->d_name) != MSGTYPE_UNKNOWN)
+        names.push_back (dent->d_name);
+    }
+  closedir (dir);
+  std::sort (names.begin (), names.end ());
+  for (const auto &name: names)
+    {
+      FILE *fp = fopen ((std::string (datadir) + "/" + name).c_str (), "rb");
+      if (!fp)
+        {
+          perror (name.c_str ());
+          exit (1);
+        }
+      results.push_back (run_mail (name, fp, type_for_file (name.c_str ()),
+                                   repeats));
+      fclose (fp);
+    }
+
+  if (generated)
+    {
+      static const struct
+      {
+        const char *name;
+        gen_kind kind;
+        size_t size;   /* Bytes or the number of levels or parts.  */
+      } corpora[] = {
+        { "small-1k", GEN_SMALL, 1024 },
+        { "base64-64k", GEN_BASE64, 64 * 1024 },
+        { "base64-1m", GEN_BASE64, 1024 * 1024 },
+        { "base64-16m", GEN_BASE64, 16 * 1024 * 1024 },
+        { "base64-200m", GEN_BASE64, 200 * 1024 * 1024 },
+        { "qp-1m", GEN_QP, 1024 * 1024 },
+        { "qp-16m", GEN_QP, 16 * 1024 * 1024 },
+        { "nested-64", GEN_NESTED, 64 },
+        { "attachments-1000", GEN_ATTACHMENTS, 1000 },
+        { NULL, GEN_SMALL, 0 }
+      };
+      static const msgtype_t types[] = {
+        MSGTYPE_GPGOL_MULTIPART_SIGNED,
+        MSGTYPE_GPGOL_MULTIPART_ENCRYPTED
+      };
+
+      auto ctx = std::unique_ptr<GpgME::Context>
+        (GpgME::Context::createForProtocol (GpgME::OpenPGP));
+      if (!ctx)
+        {
+          fprintf (stderr, "Failed to create context\n");
+          exit (1);
+        }
+      ctx->setArmor (true);
+      GpgME::Error err = ctx->startKeyListing ((const char *) nullptr, true);
+      const auto key = ctx->nextKey (err);
+      ctx->endKeyListing ();
+      if (key.isNull ())
+        {
+          fprintf (stderr, "No secret key found\n");
+          exit (1);
+        }
+      ctx->addSigningKey (key);
+
+      srand (42);
+      for (int i = 0; corpora[i].name; i++)
+        {
+          if ((corpora[i].kind == GEN_BASE64 || corpora[i].kind == GEN_QP)
+              && corpora[i].size > max_size * 1024 * 1024)
+            continue;
+
+          FILE *entity = make_tmpfile ();
+          write_entity (entity, corpora[i].kind, corpora[i].size);
+          fflush (entity);
+          for (const auto type: types)
+            {
+              FILE *fp = wrap_entity (ctx.get (), key, entity, type);
+              results.push_back (run_mail (corpora[i].name, fp, type,
+                                           repeats));
+              fclose (fp);
+            }
+          fclose (entity);
+        }
+    }
+
+  if (json)
+    write_json (json, results);
+  return 0;
+}
@@ -0,0 +1,239 @@
+/* run-codec-bench.cpp - Micro benchmark for the transfer encodings.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This measures the decoders in the way the MimeDataProvider uses
+   them, that is line by line on the data of a MIME part, and the
+   encoders in the way mimemaker uses them.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <gpgme.h>
+
+#include "common_indep.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-codec-bench [options]\n\n"
+         "Options:\n"
+         "  --size N              size of the test data in KiB\n"
+         "  --repeat N            repeat N times\n"
+         , stderr);
+  exit (ex);
+}
+
+
+/* Return a base64 encoded text of SIZE bytes split into lines of the
+   usual length.  */
+static std::string
+make_b64 (size_t size)
+{
+  static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  std::string ret;
+  size_t i;
+
+  ret.reserve (size + size / 38);
+  srand (42);
+  for (i = 0; i < size; i++)
+    {
+      ret += b64chars[rand () % 64];
+      if (!((i + 1) % 76))
+        ret += "\r\n";
+    }
+  return ret;
+}
+
+
+/* Return a quoted-printable encoded HTML like text of SIZE bytes
+   split into lines of the usual length with soft line breaks.  */
+static std::string
+make_qp (size_t size)
+{
+  static const char *words[] = {"<p>", "</p>", "the", "newsletter",
+                                "=3D", "=C3=A4", "style=3D\"color:", "#fff",
+                                "<a href=3D\"https://example.org/\">",
+                                "and", "some", "more", "text"};
+  std::string ret, line;
+
+  ret.reserve (size + size / 36);
+  srand (42);
+  while (ret.size () < size)
+    {
+      const char *w = words[rand () % (sizeof words / sizeof *words)];
+      if (line.size () + strlen (w) + 1 > 75)
+        {
+          ret += line + "=\r\n";
+          line.clear ();
+        }
+      line += w;
+      line += ' ';
+    }
+  return ret;
+}
+
+
+/* Run FUNC on a fresh copy of the lines in DATA REPEATS times and
+   print the best result.  */
+template <typename F> static void
+run_lines (const char *name, const std::string &data, int repeats, F func)
+{
+  std::vector<std::string> lines;
+  size_t pos = 0, end, total = 0;
+  double best = 0;
+  int i;
+
+  while (pos < data.size ())
+    {
+      end = data.find ('\n', pos);
+      if (end == std::string::npos)
+        end = data.size ();
+      /* The parser strips the line ending.  */
+      lines.push_back (data.substr (pos, end - pos - (end > pos
+                                                      && data[end-1] == '\r')));
+      pos = end + 1;
+    }
+
+  for (i = 0; i < repeats; i++)
+    {
+      std::vector<std::string> copy = lines;
+      const auto start = std::chrono::steady_clock::now ();
+      total = func (copy);
+      const auto stop = std::chrono::steady_clock::now ();
+      double secs = std::chrono::duration<double> (stop - start).count ();
+      if (!i || secs < best)
+        best = secs;
+    }
+
+  double mb = (double) data.size () / (1024 * 1024);
+  printf ("%-12s %8.2f MiB in, %8.2f MiB out, %8.2f MiB/s\n",
+          name, mb, (double) total / (1024 * 1024), mb / best);
+}
+
+
+/* Run FUNC on DATA REPEATS times and print the best result.  */
+template <typename F> static void
+run_buffer (const char *name, const std::string &data, int repeats, F func)
+{
+  size_t total = 0;
+  double best = 0;
+  int i;
+
+  for (i = 0; i < repeats; i++)
+    {
+      const auto start = std::chrono::steady_clock::now ();
+      total = func (data);
+      const auto stop = std::chrono::steady_clock::now ();
+      double secs = std::chrono::duration<double> (stop - start).count ();
+      if (!i || secs < best)
+        best = secs;
+    }
+
+  double mb = (double) data.size () / (1024 * 1024);
+  printf ("%-12s %8.2f MiB in, %8.2f MiB out, %8.2f MiB/s\n",
+          name, mb, (double) total / (1024 * 1024), mb / best);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  size_t size = 32 * 1024 * 1024;
+  int repeats = 5;
+
+  gpgme_check_version (NULL);
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          size = (size_t) atol (*argv) * 1024;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeats = atoi (*argv);
+          argc--; argv++;
+        }
+    }
+  if (argc || repeats < 1)
+    show_usage (1);
+
+  std::string b64 = make_b64 (size);
+  run_lines ("b64_decode", b64, repeats,
+             [] (std::vector<std::string> &lines) {
+               b64_state_t state;
+               size_t total = 0;
+
+               b64_init (&state);
+               for (auto &line: lines)
+                 total += b64_decode (&state, &line[0], line.size ());
+               return total;
+             });
+
+  std::string qp = make_qp (size);
+  run_lines ("qp_decode", qp, repeats,
+             [] (std::vector<std::string> &lines) {
+               size_t total = 0;
+               int slbrk;
+
+               for (auto &line: lines)
+                 total += qp_decode (&line[0], line.size (), &slbrk);
+               return total;
+             });
+
+  std::string bin (size, 0);
+  for (auto &c: bin)
+    c = rand () % 256;
+  run_buffer ("b64_encode", bin, repeats,
+              [] (const std::string &data) {
+                char outbuf[B64_MIME_ENCODED_LEN (128 * B64_MIME_LINE_INPUT)];
+                size_t n, off, total = 0;
+
+                /* Same chunking as write_b64.  */
+                for (off = 0; off < data.size (); off += n)
+                  {
+                    n = data.size () - off;
+                    if (n > 128 * B64_MIME_LINE_INPUT)
+                      n = 128 * B64_MIME_LINE_INPUT;
+                    total += b64_encode_mime (outbuf, data.data () + off, n);
+                  }
+                return total;
+              });
+
+  return 0;
+}
@@ -0,0 +1,245 @@
+/* run-fprtable-bench.cpp - Measure the fingerprint maps of the key cache.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The KeyCache maps the fingerprint of every key to the key and the
+   fingerprint of every subkey to the primary fingerprint.  This
+   benchmark fills these two maps for a large keyring once with hex
+   strings in std::unordered_maps, as the cache did before, and once
+   with binary fingerprints in FprTables.  It prints the heap memory
+   used by the maps and the time to look up a key by the fingerprint
+   of a subkey.  A key is a refcounted pointer like a GpgME::Key.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "fprtable.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-fprtable-bench [options]\n\n"
+         "Options:\n"
+         "  --keys N              number of keys in the keyring\n"
+         "  --subkeys N           number of subkeys per key\n"
+         "  --lookups N           number of lookups\n"
+         , stderr);
+  exit (ex);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+typedef std::shared_ptr<int> stand_in_key_t;
+
+struct fprs_s
+{
+  std::string fpr;
+  std::vector<std::string> sub_fprs;
+};
+
+
+static size_t
+heap_used ()
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+  const auto mi = mallinfo2 ();
+  return mi.uordblks + mi.hblkhd;
+#else
+  const auto mi = mallinfo ();
+  return (size_t) mi.uordblks + (size_t) mi.hblkhd;
+#endif
+}
+
+
+struct string_maps_s
+{
+  std::unordered_map<std::string, stand_in_key_t> fpr_map;
+  std::unordered_map<std::string, std::string> sub_fpr_map;
+
+  void
+  insert (const fprs_s &fprs, const stand_in_key_t &key)
+  {
+    for (const auto &sub: fprs.sub_fprs)
+      sub_fpr_map.insert (std::make_pair (sub, fprs.fpr));
+    fpr_map.insert (std::make_pair (fprs.fpr, key));
+  }
+
+  stand_in_key_t
+  get (const char *fpr) const
+  {
+    std::string primary;
+    const auto it = sub_fpr_map.find (fpr);
+    primary = it == sub_fpr_map.end () ? fpr : it->second;
+    const auto kit = fpr_map.find (primary);
+    return kit == fpr_map.end () ? stand_in_key_t () : kit->second;
+  }
+};
+
+
+struct bin_maps_s
+{
+  FprTable<stand_in_key_t> fpr_map;
+  FprTable<BinFpr> sub_fpr_map;
+
+  void
+  insert (const fprs_s &fprs, const stand_in_key_t &key)
+  {
+    const BinFpr primary (fprs.fpr);
+
+    for (const auto &sub: fprs.sub_fprs)
+      sub_fpr_map.insert (BinFpr (sub), primary);
+    fpr_map.insert (primary, key);
+  }
+
+  stand_in_key_t
+  get (const char *fpr) const
+  {
+    BinFpr primary (fpr);
+    const auto sub = sub_fpr_map.find (primary);
+    if (sub)
+      primary = *sub;
+    const auto key = fpr_map.find (primary);
+    return key ? *key : stand_in_key_t ();
+  }
+};
+
+
+static std::string
+random_fpr ()
+{
+  char buf[48];
+
+  snprintf (buf, sizeof buf, "%08X%08X%08X%08X%08X",
+            rand (), rand (), rand (), rand (), rand ());
+  return buf;
+}
+
+
+template <class Maps>
+static void
+run (const char *name, const std::vector<fprs_s> &keyring,
+     const std::vector<stand_in_key_t> &keys, int n_lookups)
+{
+  const size_t before = heap_used ();
+  auto maps = std::unique_ptr<Maps> (new Maps);
+  size_t i;
+
+  auto start = bench_clock::now ();
+  for (i = 0; i < keyring.size (); i++)
+    maps->insert (keyring[i], keys[i]);
+  std::chrono::duration<double> fill = bench_clock::now () - start;
+  const size_t used = heap_used () - before;
+
+  unsigned int seed = 42;
+  unsigned long found = 0;
+  start = bench_clock::now ();
+  for (i = 0; i < (size_t) n_lookups; i++)
+    {
+      const auto &fprs = keyring[rand_r (&seed) % keyring.size ()];
+      const auto &sub = fprs.sub_fprs[rand_r (&seed) % fprs.sub_fprs.size ()];
+      if (maps->get (sub.c_str ()))
+        found++;
+    }
+  std::chrono::duration<double> lookup = bench_clock::now () - start;
+  if (found != (unsigned long) n_lookups)
+    {
+      fprintf (stderr, "run-fprtable-bench: %s: key not found\n", name);
+      exit (1);
+    }
+
+  printf ("%-8s memory %8.2f MiB (%5.1f bytes/key)  fill %8.3f ms  "
+          "lookup %6.1f ns\n",
+          name, used / 1048576.0, (double) used / keyring.size (),
+          fill.count () * 1000, lookup.count () * 1e9 / n_lookups);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int n_keys = 100000;
+  int n_subkeys = 3;
+  int n_lookups = 1000000;
+  std::vector<fprs_s> keyring;
+  std::vector<stand_in_key_t> keys;
+  int i, j;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--keys"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_keys = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--subkeys"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_subkeys = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--lookups"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_lookups = atoi (*argv);
+          argc--; argv++;
+        }
+    }
+  if (argc || n_keys < 1 || n_subkeys < 1 || n_lookups < 1)
+    show_usage (1);
+
+  /* Like in GnuPG the first subkey is the primary key.  */
+  srand (42);
+  for (i = 0; i < n_keys; i++)
+    {
+      fprs_s fprs;
+      fprs.fpr = random_fpr ();
+      fprs.sub_fprs.push_back (fprs.fpr);
+      for (j = 1; j < n_subkeys; j++)
+        fprs.sub_fprs.push_back (random_fpr ());
+      keyring.push_back (fprs);
+      keys.push_back (std::make_shared<int> (i));
+    }
+
+  printf ("%i keys with %i subkeys, %i lookups\n",
+          n_keys, n_subkeys, n_lookups);
+  run<string_maps_s> ("string", keyring, keys, n_lookups);
+  run<bin_maps_s> ("binary", keyring, keys, n_lookups);
+
+  return 0;
+}
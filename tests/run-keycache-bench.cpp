@@ -0,0 +1,279 @@
+/* run-keycache-bench.cpp - Measure lock contention in the key cache.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The KeyCache itself needs Outlook.  This benchmark uses a stand-in
+   keyring with the same maps and the same locking pattern: a writer
+   inserts the keys one by one like the keylisting does on startup
+   while readers look up fingerprints and mail addresses like the
+   recipient resolution does.  It is run once with the plain gpgrt
+   lock the cache used before and once with the RWLock.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <gpg-error.h>
+
+#include "rwlock.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-keycache-bench [options]\n\n"
+         "Options:\n"
+         "  --keys N              number of keys in the keyring\n"
+         "  --readers N           number of reader threads\n"
+         , stderr);
+  exit (ex);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+/* A key is refcounted like a GpgME::Key.  */
+struct stand_in_key_s
+{
+  std::string fpr;
+  std::string sub_fpr;
+  std::string mbox;
+};
+typedef std::shared_ptr<stand_in_key_s> stand_in_key_t;
+
+
+/* The lock used before.  */
+class MutexLock
+{
+public:
+  MutexLock () { gpgrt_lock_init (&m_lock); }
+  ~MutexLock () { gpgrt_lock_destroy (&m_lock); }
+  void lock () { gpgrt_lock_lock (&m_lock); }
+  void unlock () { gpgrt_lock_unlock (&m_lock); }
+  void lockShared () { gpgrt_lock_lock (&m_lock); }
+  void unlockShared () { gpgrt_lock_unlock (&m_lock); }
+
+private:
+  gpgrt_lock_t m_lock;
+};
+
+
+template <class Lock>
+struct keyring_s
+{
+  Lock keycache_lock;
+  Lock fpr_map_lock;
+  std::unordered_map<std::string, stand_in_key_t> key_map;
+  std::unordered_map<std::string, stand_in_key_t> fpr_map;
+  std::unordered_map<std::string, std::string> sub_fpr_map;
+
+  void
+  insert (const stand_in_key_t &key)
+  {
+    fpr_map_lock.lock ();
+    sub_fpr_map[key->sub_fpr] = key->fpr;
+    fpr_map[key->fpr] = key;
+    fpr_map_lock.unlock ();
+    keycache_lock.lock ();
+    key_map[key->mbox] = key;
+    keycache_lock.unlock ();
+  }
+
+  stand_in_key_t
+  getByFpr (const std::string &fpr)
+  {
+    stand_in_key_t ret;
+
+    fpr_map_lock.lockShared ();
+    const auto it = sub_fpr_map.find (fpr);
+    const auto kit = fpr_map.find (it == sub_fpr_map.end ()? fpr : it->second);
+    if (kit != fpr_map.end ())
+      ret = kit->second;
+    fpr_map_lock.unlockShared ();
+    return ret;
+  }
+
+  stand_in_key_t
+  getKey (const std::string &mbox)
+  {
+    stand_in_key_t ret;
+
+    keycache_lock.lockShared ();
+    const auto it = key_map.find (mbox);
+    if (it != key_map.end ())
+      ret = it->second;
+    keycache_lock.unlockShared ();
+    return ret;
+  }
+};
+
+
+struct result_s
+{
+  double populate_time = 0;
+  unsigned long lookups = 0;
+  double max_wait = 0;
+};
+
+
+static std::vector<stand_in_key_t>
+make_keys (int n)
+{
+  std::vector<stand_in_key_t> ret;
+  char buf[64];
+  int i;
+
+  srand (42);
+  for (i = 0; i < n; i++)
+    {
+      auto key = std::make_shared<stand_in_key_s> ();
+      snprintf (buf, sizeof buf, "%08X%08X%08X%08X%08X",
+                rand (), rand (), rand (), rand (), i);
+      key->fpr = buf;
+      snprintf (buf, sizeof buf, "%08X%08X%08X%08X%08X",
+                rand (), rand (), rand (), rand (), i);
+      key->sub_fpr = buf;
+      snprintf (buf, sizeof buf, "user%i@example.org", i);
+      key->mbox = buf;
+      ret.push_back (key);
+    }
+  return ret;
+}
+
+
+template <class Lock>
+static result_s
+run (const std::vector<stand_in_key_t> &keys, int n_readers)
+{
+  keyring_s<Lock> ring;
+  std::vector<pthread_t> threads (n_readers);
+  std::vector<unsigned long> lookups (n_readers);
+  std::vector<double> max_wait (n_readers);
+  volatile bool done = false;
+  result_s result;
+  int i;
+
+  struct reader_arg_s
+  {
+    keyring_s<Lock> *ring;
+    const std::vector<stand_in_key_t> *keys;
+    volatile bool *done;
+    unsigned long *lookups;
+    double *max_wait;
+    unsigned int seed;
+  };
+  std::vector<reader_arg_s> args (n_readers);
+
+  auto reader = [] (void *opaque) -> void * {
+    auto arg = static_cast<reader_arg_s *> (opaque);
+
+    while (!*arg->done)
+      {
+        const auto &key = (*arg->keys)[rand_r (&arg->seed)
+                                       % arg->keys->size ()];
+        auto start = bench_clock::now ();
+        arg->ring->getByFpr (key->sub_fpr);
+        arg->ring->getKey (key->mbox);
+        std::chrono::duration<double> wait = bench_clock::now () - start;
+        if (wait.count () > *arg->max_wait)
+          *arg->max_wait = wait.count ();
+        (*arg->lookups)++;
+      }
+    return nullptr;
+  };
+
+  for (i = 0; i < n_readers; i++)
+    {
+      args[i] = {&ring, &keys, &done, &lookups[i], &max_wait[i],
+                 (unsigned int) i};
+      pthread_create (&threads[i], nullptr, reader, &args[i]);
+    }
+
+  auto start = bench_clock::now ();
+  for (const auto &key: keys)
+    ring.insert (key);
+  std::chrono::duration<double> elapsed = bench_clock::now () - start;
+  result.populate_time = elapsed.count ();
+
+  done = true;
+  for (i = 0; i < n_readers; i++)
+    {
+      pthread_join (threads[i], nullptr);
+      result.lookups += lookups[i];
+      if (max_wait[i] > result.max_wait)
+        result.max_wait = max_wait[i];
+    }
+  return result;
+}
+
+
+static void
+print_result (const char *name, const result_s &r)
+{
+  printf ("%-8s populate %8.3f ms  lookups %10.0f/s  max wait %8.1f us\n",
+          name, r.populate_time * 1000, r.lookups / r.populate_time,
+          r.max_wait * 1e6);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int n_keys = 50000;
+  int n_readers = 4;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--keys"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_keys = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--readers"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_readers = atoi (*argv);
+          argc--; argv++;
+        }
+    }
+  if (argc || n_keys < 1 || n_readers < 1)
+    show_usage (1);
+
+  const auto keys = make_keys (n_keys);
+
+  printf ("%i keys, %i readers\n", n_keys, n_readers);
+  print_result ("mutex", run<MutexLock> (keys, n_readers));
+  print_result ("rwlock", run<RWLock> (keys, n_readers));
+
+  return 0;
+}
@@ -0,0 +1,260 @@
+/* run-parser-bench.cpp - Benchmark for GpgOL's MIME parser.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This generates a multipart/mixed mail with a text body, a quoted
+   printable HTML body and a base64 encoded attachment and runs it
+   through the MimeDataProvider.  The cost of the line splitting and
+   decoding is reported per MB of input.  No crypto is involved.
+
+   With --received a small mail with many Received header lines, as
+   they are seen on mails which passed through many relays, is parsed
+   instead and the number of mails per second is reported.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <gpgme.h>
+
+#include "common_indep.h"
+#include "mimedataprovider.h"
+#include "attachment.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-parser-bench [options]\n\n"
+         "Options:\n"
+         "  --size N              size of the generated mail in KiB\n"
+         "  --repeat N            repeat N times\n"
+         "  --received N          parse a small mail with N Received lines\n"
+         , stderr);
+  exit (ex);
+}
+
+/* Write a test mail with about SIZE bytes to FP.  */
+static void
+write_mail (FILE *fp, size_t size)
+{
+  static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  size_t written = 0;
+
+  fputs ("From: bench@example.com\r\n"
+         "To: bench@example.com\r\n"
+         "Subject: Parser benchmark\r\n"
+         "MIME-Version: 1.0\r\n"
+         "Content-Type: multipart/mixed; boundary=\"=-=bench=-=\"\r\n"
+         "\r\n"
+         "--=-=bench=-=\r\n"
+         "Content-Type: text/plain; charset=us-ascii\r\n"
+         "\r\n"
+         "Hello, this is the body.\r\n"
+         "--=-=bench=-=\r\n"
+         "Content-Type: text/html; charset=utf-8\r\n"
+         "Content-Transfer-Encoding: quoted-printable\r\n"
+         "\r\n", fp);
+
+  /* A quarter of the mail is qp encoded HTML.  */
+  while (written < size / 4)
+    {
+      written += fprintf (fp, "<p style=3D\"color: red\">Gr=C3=BC=C3=9Fe aus"
+                          " dem Benchmark, Zeile %lu</p>=\r\n",
+                          (unsigned long) written);
+    }
+  fputs ("\r\n--=-=bench=-=\r\n"
+         "Content-Type: application/octet-stream\r\n"
+         "Content-Disposition: attachment; filename=\"bench.bin\"\r\n"
+         "Content-Transfer-Encoding: base64\r\n"
+         "\r\n", fp);
+
+  /* The rest is a base64 attachment with the usual line length.  */
+  srand (42);
+  while (written < size)
+    {
+      char line[78];
+      int i;
+
+      for (i = 0; i < 76; i++)
+        line[i] = b64chars[rand () % 64];
+      line[76] = '\r';
+      line[77] = '\n';
+      fwrite (line, 1, sizeof line, fp);
+      written += sizeof line;
+    }
+  fputs ("--=-=bench=-=--\r\n", fp);
+}
+
+/* Write a small mail with RECEIVED Received header lines to FP.  */
+static void
+write_received_mail (FILE *fp, int received)
+{
+  int i;
+
+  for (i = 0; i < received; i++)
+    fprintf (fp, "Received: from relay%d.example.org (relay%d.example.org"
+             " [192.0.2.%d])\r\n"
+             "\tby relay%d.example.net with ESMTPS id %08X\r\n"
+             "\tfor <bench@example.com>; Mon, 2 Mar 2026 10:%02d:00 +0100\r\n",
+             i, i, i % 256, i + 1, i * 2654435761u, i % 60);
+  fputs ("From: bench@example.com\r\n"
+         "To: bench@example.com\r\n"
+         "Subject: Parser benchmark\r\n"
+         "MIME-Version: 1.0\r\n"
+         "Content-Type: multipart/mixed; boundary=\"=-=bench=-=\"\r\n"
+         "\r\n"
+         "--=-=bench=-=\r\n"
+         "Content-Type: text/plain; charset=us-ascii\r\n"
+         "\r\n"
+         "Hello, this is the body.\r\n"
+         "--=-=bench=-=\r\n"
+         "Content-Type: application/octet-stream\r\n"
+         "Content-Disposition: attachment; filename=\"bench.bin\"\r\n"
+         "Content-Transfer-Encoding: base64\r\n"
+         "\r\n"
+         "SGVsbG8gV29ybGQK\r\n"
+         "--=-=bench=-=--\r\n", fp);
+}
+
+
+/* Parse the mail in FP COUNT times per run and print the number of
+   mails per second.  */
+static void
+run_received (FILE *fp, int received, int repeats)
+{
+  const int count = 200;
+  double best = 0;
+
+  for (int i = 0; i < repeats; i++)
+    {
+      const auto start = std::chrono::steady_clock::now ();
+      for (int j = 0; j < count; j++)
+        {
+          rewind (fp);
+          MimeDataProvider provider (fp, false);
+          provider.finalize ();
+          if (provider.get_attachments ().size () != 1)
+            {
+              fprintf (stderr, "Unexpected parse result\n");
+              exit (1);
+            }
+        }
+      const auto end = std::chrono::steady_clock::now ();
+      double secs = std::chrono::duration<double> (end - start).count ();
+
+      if (!i || secs < best)
+        best = secs;
+      printf ("Run %d: %.3f s\n", i, secs);
+    }
+
+  printf ("Received lines: %d, best: %.3f s, %.1f mails/s, %.3f ms/mail\n",
+          received, best, count / best, best * 1000 / count);
+}
+
+
+int main(int argc, char **argv)
+{
+  int last_argc = -1;
+  size_t size = 16 * 1024 * 1024;
+  int repeats = 5;
+  int received = 0;
+
+  gpgme_check_version (NULL);
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          size = (size_t) atol (*argv) * 1024;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeats = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--received"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          received = atoi (*argv);
+          argc--; argv++;
+        }
+    }
+  if (argc)
+    show_usage (1);
+
+  FILE *fp = tmpfile ();
+  if (!fp)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+  if (received > 0)
+    {
+      write_received_mail (fp, received);
+      run_received (fp, received, repeats);
+      fclose (fp);
+      return 0;
+    }
+  write_mail (fp, size);
+  long total = ftell (fp);
+  double mb = (double) total / (1024 * 1024);
+
+  double best = 0;
+  for (int i = 0; i < repeats; i++)
+    {
+      rewind (fp);
+      const auto start = std::chrono::steady_clock::now ();
+      MimeDataProvider provider (fp, false);
+      provider.finalize ();
+      const auto end = std::chrono::steady_clock::now ();
+      double secs = std::chrono::duration<double> (end - start).count ();
+
+      if (provider.get_attachments ().size () != 1
+          || provider.get_html_body ().empty ())
+        {
+          fprintf (stderr, "Unexpected parse result\n");
+          exit (1);
+        }
+      if (!i || secs < best)
+        best = secs;
+      printf ("Run %d: %.3f s\n", i, secs);
+    }
+
+  printf ("Input: %.2f MiB, best: %.3f s, %.2f MiB/s, %.2f ms/MiB\n",
+          mb, best, mb / best, best * 1000 / mb);
+  fclose (fp);
+  return 0;
+}
@@ -0,0 +1,320 @@
+/* run-populate-bench.cpp - Measure the population of the key cache.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The KeyCache is populated on startup from a public and a secret
+   keylisting.  This benchmark generates a GNUPGHOME with many keys
+   and compares the old way, listing one after another and inserting
+   each key under the lock, with listing at the same time and
+   swapping in maps which were built without the lock.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <gpgme.h>
+
+#include "rwlock.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-populate-bench [options]\n\n"
+         "Options:\n"
+         "  --homedir DIR         use the keys in DIR\n"
+         "  --keys N              number of keys to generate if DIR\n"
+         "                        is empty\n"
+         "  --gpg PROGRAM         the gpg to generate the keys\n"
+         , stderr);
+  exit (ex);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+static const char *homedir;
+
+struct maps_s
+{
+  std::unordered_map<std::string, gpgme_key_t> fpr_map;
+  std::unordered_map<std::string, std::string> sub_fpr_map;
+
+  ~maps_s ()
+  {
+    for (const auto &pair: fpr_map)
+      gpgme_key_unref (pair.second);
+  }
+
+  void
+  insert (gpgme_key_t key)
+  {
+    gpgme_subkey_t sub;
+
+    for (sub = key->subkeys; sub; sub = sub->next)
+      if (sub->fpr)
+        sub_fpr_map.insert (std::make_pair (sub->fpr, key->fpr));
+    auto it = fpr_map.find (key->fpr);
+    gpgme_key_ref (key);
+    if (it == fpr_map.end ())
+      fpr_map.insert (std::make_pair (key->fpr, key));
+    else
+      {
+        gpgme_key_unref (it->second);
+        it->second = key;
+      }
+  }
+};
+
+
+struct listing_s
+{
+  int secret;
+  std::vector<gpgme_key_t> keys;
+  /* For the old way the keys are inserted right away.  */
+  maps_s *maps;
+  RWLock *lock;
+};
+
+
+static void *
+do_listing (void *arg)
+{
+  auto listing = static_cast<listing_s *> (arg);
+  gpgme_ctx_t ctx;
+  gpgme_key_t key;
+  gpgme_error_t err;
+
+  err = gpgme_new (&ctx);
+  if (!err)
+    err = gpgme_ctx_set_engine_info (ctx, GPGME_PROTOCOL_OpenPGP, NULL,
+                                     homedir);
+  if (err)
+    {
+      fprintf (stderr, "failed to create context: %s\n", gpgme_strerror (err));
+      exit (1);
+    }
+  gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL
+                          | GPGME_KEYLIST_MODE_VALIDATE);
+  gpgme_set_offline (ctx, 1);
+
+  err = gpgme_op_keylist_start (ctx, NULL, listing->secret);
+  while (!err && !(err = gpgme_op_keylist_next (ctx, &key)))
+    {
+      if (listing->maps)
+        {
+          listing->lock->lock ();
+          listing->maps->insert (key);
+          listing->lock->unlock ();
+          gpgme_key_unref (key);
+        }
+      else
+        listing->keys.push_back (key);
+    }
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    {
+      fprintf (stderr, "keylisting failed: %s\n", gpgme_strerror (err));
+      exit (1);
+    }
+  gpgme_release (ctx);
+  return nullptr;
+}
+
+
+static size_t
+count_keys ()
+{
+  listing_s listing = {0, {}, nullptr, nullptr};
+  size_t ret;
+
+  do_listing (&listing);
+  ret = listing.keys.size ();
+  for (auto key: listing.keys)
+    gpgme_key_unref (key);
+  return ret;
+}
+
+
+/* Generate N keys in HOMEDIR with a single gpg process.  */
+static void
+generate_keys (const char *gpg, int n)
+{
+  std::string cmd = std::string (gpg) + " --homedir '" + homedir
+                    + "' --batch --quiet --gen-key";
+  FILE *fp;
+  int i;
+
+  printf ("generating %i keys in %s\n", n, homedir);
+  fflush (stdout);
+  fp = popen (cmd.c_str (), "w");
+  if (!fp)
+    {
+      perror (gpg);
+      exit (1);
+    }
+  for (i = 0; i < n; i++)
+    fprintf (fp,
+             "%%no-protection\n"
+             "Key-Type: eddsa\n"
+             "Key-Curve: ed25519\n"
+             "Subkey-Type: ecdh\n"
+             "Subkey-Curve: cv25519\n"
+             "Name-Email: user%i@example.org\n"
+             "Expire-Date: 0\n"
+             "%%commit\n", i);
+  if (pclose (fp))
+    {
+      fprintf (stderr, "key generation failed\n");
+      exit (1);
+    }
+}
+
+
+/* List the public and then the secret keys and insert each key under
+   the lock.  */
+static double
+run_sequential (size_t *r_count)
+{
+  maps_s maps;
+  RWLock lock;
+  listing_s pub = {0, {}, &maps, &lock};
+  listing_s sec = {1, {}, &maps, &lock};
+  auto start = bench_clock::now ();
+
+  do_listing (&pub);
+  do_listing (&sec);
+  std::chrono::duration<double> elapsed = bench_clock::now () - start;
+  *r_count = maps.fpr_map.size ();
+  return elapsed.count ();
+}
+
+
+/* List the public and the secret keys at the same time, build the
+   maps without the lock and swap them in.  */
+static double
+run_batched (size_t *r_count)
+{
+  maps_s maps;
+  RWLock lock;
+  listing_s pub = {0, {}, nullptr, nullptr};
+  listing_s sec = {1, {}, nullptr, nullptr};
+  pthread_t thread;
+  auto start = bench_clock::now ();
+
+  pthread_create (&thread, nullptr, do_listing, &pub);
+  do_listing (&sec);
+  pthread_join (thread, nullptr);
+
+  {
+    maps_s local;
+
+    local.fpr_map.reserve (pub.keys.size ());
+    local.sub_fpr_map.reserve (pub.keys.size () * 2);
+    for (auto key: pub.keys)
+      local.insert (key);
+    for (auto key: sec.keys)
+      local.insert (key);
+
+    lock.lock ();
+    std::swap (maps.fpr_map, local.fpr_map);
+    std::swap (maps.sub_fpr_map, local.sub_fpr_map);
+    lock.unlock ();
+  }
+  std::chrono::duration<double> elapsed = bench_clock::now () - start;
+
+  for (auto key: pub.keys)
+    gpgme_key_unref (key);
+  for (auto key: sec.keys)
+    gpgme_key_unref (key);
+  *r_count = maps.fpr_map.size ();
+  return elapsed.count ();
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int n_keys = 20000;
+  const char *gpg = "gpg";
+  char tmpdir[] = "/tmp/gpgol-bench-XXXXXX";
+  size_t count;
+  double t;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--homedir"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          homedir = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--keys"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_keys = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--gpg"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          gpg = *argv;
+          argc--; argv++;
+        }
+    }
+  if (argc || n_keys < 1)
+    show_usage (1);
+
+  gpgme_check_version (NULL);
+
+  if (!homedir)
+    {
+      if (!mkdtemp (tmpdir))
+        {
+          perror (tmpdir);
+          return 1;
+        }
+      homedir = tmpdir;
+      printf ("keeping the keys in %s for the next run (--homedir)\n",
+              homedir);
+    }
+  if (!count_keys ())
+    generate_keys (gpg, n_keys);
+
+  t = run_sequential (&count);
+  printf ("sequential  %6lu keys  %8.3f s\n", (unsigned long) count, t);
+  t = run_batched (&count);
+  printf ("batched     %6lu keys  %8.3f s\n", (unsigned long) count, t);
+
+  return 0;
+}
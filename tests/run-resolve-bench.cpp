@@ -0,0 +1,316 @@
+/* run-resolve-bench.cpp - Measure the resolution of recipients.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* KeyCache::isMailResolvable is called for every recipient whenever
+   the ribbon is invalidated.  The KeyCache itself needs Outlook so
+   this benchmark seeds a key map and the BestKeyIndex of the KeyCache
+   with the keys of the test keyring and resolves a mail like
+   getSigningKey and getEncryptionKeys do.  It compares computing the
+   flags of each key on every lookup with looking up the flags which
+   the index computed when the key was stored.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <gpgme.h>
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+
+#include "bestkeyindex.h"
+#include "rwlock.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-resolve-bench [options]\n\n"
+         "Options:\n"
+         "  --recipients N        number of recipients of the mail\n"
+         "  --keys N              number of mail addresses in the cache\n"
+         "  --iterations N        number of resolutions\n"
+         , stderr);
+  exit (ex);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+/* Like with opt.auto_unstrusted the test keys with unknown
+   validity may be used.  */
+static const bool de_vs_mode = false;
+static const bool auto_untrusted = true;
+
+
+/* The key maps of the KeyCache with its lock and the index of the
+   best keys.  */
+struct keyring_s
+{
+  RWLock keycache_lock;
+  std::unordered_map<std::string, GpgME::Key> key_map;
+  std::unordered_map<std::string, GpgME::Key> skey_map;
+  BestKeyIndex best_keys;
+  BestKeyIndex best_skeys;
+
+  void
+  insert (const std::string &mbox, const GpgME::Key &key, bool secret)
+  {
+    keycache_lock.lock ();
+    (secret ? skey_map : key_map)[mbox] = key;
+    (secret ? best_skeys : best_keys).set (mbox, key, secret);
+    keycache_lock.unlock ();
+  }
+
+  GpgME::Key
+  getKey (const std::string &mbox, bool secret)
+  {
+    const auto &map = secret ? skey_map : key_map;
+    GpgME::Key ret;
+
+    keycache_lock.lockShared ();
+    const auto it = map.find (mbox);
+    if (it != map.end ())
+      ret = it->second;
+    keycache_lock.unlockShared ();
+    return ret;
+  }
+
+  /* Like KeyCache::getBestKey.  */
+  bool
+  getBestKey (const std::string &mbox, bool secret, best_key_s *r_best)
+  {
+    const auto &index = secret ? best_skeys : best_keys;
+
+    keycache_lock.lockShared ();
+    const bool ret = index.find (mbox, r_best);
+    keycache_lock.unlockShared ();
+    return ret;
+  }
+
+  /* Look up the key for MBOX and compute its flags.  */
+  bool
+  checked (const std::string &mbox, bool secret)
+  {
+    best_key_s best;
+
+    best.key = getKey (mbox, secret);
+    if (best.key.isNull ())
+      return false;
+    best.flags = best_key_flags (best.key, mbox, secret);
+    return check_best_key (best, secret, de_vs_mode,
+                           auto_untrusted) <= BestKeyOkUnknown;
+  }
+
+  /* Look up the key for MBOX and its flags in the index.  */
+  bool
+  indexed (const std::string &mbox, bool secret)
+  {
+    best_key_s best;
+
+    if (!getBestKey (mbox, secret, &best))
+      return false;
+    return check_best_key (best, secret, de_vs_mode,
+                           auto_untrusted) <= BestKeyOkUnknown;
+  }
+};
+
+
+/* Resolve the mail from SENDER to RECPS with LOOKUP and return the
+   number of resolvable recipients or -1 if there is no signing key.  */
+template <class Fn>
+static int
+resolve (const std::string &sender, const std::vector<std::string> &recps,
+         Fn lookup)
+{
+  int n = 0;
+
+  if (!lookup (sender, true))
+    return -1;
+  for (const auto &recp: recps)
+    if (lookup (recp, false))
+      n++;
+  return n;
+}
+
+
+template <class Fn>
+static double
+measure (int iterations, int *r_result, Fn fn)
+{
+  auto start = bench_clock::now ();
+  int i;
+
+  for (i = 0; i < iterations; i++)
+    *r_result = fn ();
+  std::chrono::duration<double> elapsed = bench_clock::now () - start;
+  return elapsed.count ();
+}
+
+
+/* Return the keys of the test keyring.  */
+static std::vector<GpgME::Key>
+list_keys (bool secret)
+{
+  std::vector<GpgME::Key> ret;
+  auto ctx = std::unique_ptr<GpgME::Context>
+    (GpgME::Context::createForProtocol (GpgME::OpenPGP));
+
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context\n");
+      exit (1);
+    }
+  GpgME::Error err = ctx->startKeyListing ((const char *) nullptr, secret);
+  while (!err)
+    {
+      const auto key = ctx->nextKey (err);
+      if (err || key.isNull ())
+        break;
+      ret.push_back (key);
+    }
+  ctx->endKeyListing ();
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int n_recps = 500;
+  int n_keys = 5000;
+  int iterations = 1000;
+  keyring_s ring;
+  std::vector<std::string> mboxes;
+  std::vector<std::string> recps;
+  std::string sender;
+  char buf[64];
+  int i;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--recipients"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_recps = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--keys"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_keys = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--iterations"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          iterations = atoi (*argv);
+          argc--; argv++;
+        }
+    }
+  if (argc || n_recps < 1 || n_keys < 0 || iterations < 1)
+    show_usage (1);
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  /* Seed the maps like KeyCache::setPgpKey does.  */
+  const auto keys = list_keys (false);
+  for (const auto &key: keys)
+    for (const auto &uid: key.userIDs ())
+      {
+        const auto mbox = uid.addrSpec ();
+        if (mbox.empty () || ring.key_map.count (mbox))
+          continue;
+        ring.insert (mbox, key, false);
+        mboxes.push_back (mbox);
+      }
+  for (const auto &key: list_keys (true))
+    for (const auto &uid: key.userIDs ())
+      {
+        const auto mbox = uid.addrSpec ();
+        if (mbox.empty ())
+          continue;
+        ring.insert (mbox, key, true);
+        if (sender.empty ())
+          sender = mbox;
+      }
+  if (mboxes.empty () || sender.empty ())
+    {
+      fprintf (stderr, "run-resolve-bench: no keys in " GPGHOMEDIR "\n");
+      exit (1);
+    }
+
+  /* More mail addresses for a cache of realistic size.  Their user
+     ids do not match so they are never valid.  */
+  for (i = (int) ring.key_map.size (); i < n_keys; i++)
+    {
+      snprintf (buf, sizeof buf, "filler%i@example.org", i);
+      ring.insert (buf, keys[i % keys.size ()], false);
+    }
+
+  for (i = 0; i < n_recps; i++)
+    recps.push_back (mboxes[i % mboxes.size ()]);
+
+  printf ("%i recipients, %i mail addresses, %i iterations\n",
+          n_recps, (int) ring.key_map.size (), iterations);
+  int checked_result;
+  int indexed_result;
+  const double checked = measure (iterations, &checked_result, [&] () {
+      return resolve (sender, recps, [&] (const std::string &mbox,
+                                          bool secret) {
+          return ring.checked (mbox, secret);
+        });
+    });
+  const double indexed = measure (iterations, &indexed_result, [&] () {
+      return resolve (sender, recps, [&] (const std::string &mbox,
+                                          bool secret) {
+          return ring.indexed (mbox, secret);
+        });
+    });
+  if (checked_result != indexed_result)
+    {
+      fprintf (stderr, "run-resolve-bench: index resolved %i instead of %i"
+               " recipients\n", indexed_result, checked_result);
+      exit (1);
+    }
+  printf ("%i of %i recipients resolvable\n", checked_result, n_recps);
+  printf ("checked  %8.2f us per mail\n", checked * 1e6 / iterations);
+  printf ("indexed  %8.2f us per mail\n", indexed * 1e6 / iterations);
+
+  return 0;
+}
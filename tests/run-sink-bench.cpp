@@ -0,0 +1,264 @@
+/* run-sink-bench.cpp - Measure the buffering of MIME output.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* mimemaker needs MAPI.  This benchmark writes a MIME message with
+   the same pattern of writes as add_body_and_attachments: header
+   lines in pieces, a quoted-printable body line by line and base64
+   attachments.  The sink writes to a file descriptor, which like the
+   IStream of an attachment costs a call for every write.  The
+   message is built with one write per piece as before, with the
+   pieces of a header line gathered and with a buffer.  The outputs
+   are compared.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+
+#include "common_indep.h"
+#include "sink.h"
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-sink-bench [options]\n\n"
+         "Options:\n"
+         "  --attachments N       number of attachments\n"
+         "  --size N              size of an attachment in bytes\n"
+         "  --bufsize N           size of the sink buffer\n"
+         "  --output FILE         write to FILE instead of /dev/null\n"
+         , stderr);
+  exit (ex);
+}
+
+typedef std::chrono::steady_clock bench_clock;
+
+/* Write the pieces of a line one by one.  */
+static int per_piece;
+
+struct target_s
+{
+  int fd;
+  unsigned long calls;
+  std::string data;
+};
+
+
+static int
+sink_fd_write (sink_t sink, const void *data, size_t datalen)
+{
+  auto target = static_cast<target_s *> (sink->cb_data);
+
+  if (!data)
+    return 0;
+  target->calls++;
+  target->data.append ((const char *) data, datalen);
+  if (write (target->fd, data, datalen) != (ssize_t) datalen)
+    {
+      perror ("write");
+      return -1;
+    }
+  return 0;
+}
+
+
+/* Like write_multistring in mimemaker.  */
+static int
+write_strings (sink_t sink, const char *s1, const char *s2 = "",
+               const char *s3 = "")
+{
+  sink_iov_t iov[3] = {{s1, strlen (s1)}, {s2, strlen (s2)},
+                       {s3, strlen (s3)}};
+  int i;
+
+  if (!per_piece)
+    return write_bufferv (sink, iov, 3);
+  for (i = 0; i < 3; i++)
+    if (iov[i].datalen && write_buffer (sink, iov[i].data, iov[i].datalen))
+      return -1;
+  return 0;
+}
+
+
+static int
+write_boundary (sink_t sink, const char *boundary, int lastone)
+{
+  return write_strings (sink, "\r\n--", boundary, lastone? "--\r\n":"\r\n");
+}
+
+
+static int
+build_message (sink_t sink, const std::string &attachment, int n_attach)
+{
+  const char *boundary = "=-=SINK-BENCH-BOUNDARY=-=";
+  char name[64];
+  int i;
+
+  if (write_strings (sink, "MIME-Version: 1.0\r\n"
+                     "Content-Type: multipart/mixed;\r\n\tboundary=\"",
+                     boundary, "\"\r\n"))
+    return -1;
+
+  /* The body as quoted-printable, one write per line.  */
+  if (write_boundary (sink, boundary, 0)
+      || write_strings (sink, "Content-Type: ", "text/plain", ";\r\n")
+      || write_strings (sink, "\tcharset=\"", "utf-8", "\"\r\n")
+      || write_strings (sink, "Content-Transfer-Encoding: ",
+                        "quoted-printable\r\n")
+      || write_string (sink, "\r\n"))
+    return -1;
+  for (i = 0; i < 200; i++)
+    if (write_string (sink, "Lorem ipsum dolor sit amet, consectetur "
+                      "adipiscing elit, sed do eiusmod tempor=\r\n"))
+      return -1;
+
+  for (i = 0; i < n_attach; i++)
+    {
+      snprintf (name, sizeof name, "attachment-%i.bin", i);
+      if (write_boundary (sink, boundary, 0)
+          || write_strings (sink, "Content-Type: ",
+                            "application/octet-stream", ";\r\n")
+          || write_strings (sink, "\tname=\"", name, "\"\r\n")
+          || write_strings (sink, "Content-Transfer-Encoding: ",
+                            "base64\r\n")
+          || write_strings (sink, "Content-Disposition: attachment;\r\n"
+                            "\tfilename=\"", name, "\"\r\n")
+          || write_string (sink, "\r\n")
+          || write_b64 (sink, attachment.data (), attachment.size ()))
+        return -1;
+    }
+  return write_boundary (sink, boundary, 1);
+}
+
+
+static void
+run (const char *name, const char *output, size_t bufsize,
+     const std::string &attachment, int n_attach, std::string *r_data)
+{
+  struct sink_s sinkmem;
+  sink_t sink = &sinkmem;
+  target_s target;
+
+  target.fd = open (output, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (target.fd == -1)
+    {
+      perror (output);
+      exit (1);
+    }
+  target.calls = 0;
+  memset (sink, 0, sizeof *sink);
+  sink->cb_data = &target;
+  sink->writefnc = sink_fd_write;
+  sink_set_buffer (sink, bufsize);
+
+  auto start = bench_clock::now ();
+  if (build_message (sink, attachment, n_attach) || sink_flush (sink))
+    {
+      fprintf (stderr, "run-sink-bench: %s: write failed\n", name);
+      exit (1);
+    }
+  std::chrono::duration<double> elapsed = bench_clock::now () - start;
+  sink_release_buffer (sink);
+  close (target.fd);
+
+  printf ("%-10s %8lu writes  %8.3f ms\n",
+          name, target.calls, elapsed.count () * 1000);
+  r_data->swap (target.data);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int n_attach = 50;
+  int size = 64 * 1024;
+  int bufsize = SINK_BUFFER_SIZE;
+  const char *output = "/dev/null";
+  std::string attachment;
+  std::string pieces, plain, buffered;
+  int i;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--attachments"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          n_attach = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          size = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--bufsize"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          bufsize = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--output"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          output = *argv;
+          argc--; argv++;
+        }
+    }
+  if (argc || n_attach < 0 || size < 0 || bufsize < 1)
+    show_usage (1);
+
+  srand (42);
+  for (i = 0; i < size; i++)
+    attachment += (char) rand ();
+
+  printf ("%i attachments of %i bytes, buffer %i bytes\n",
+          n_attach, size, bufsize);
+  per_piece = 1;
+  run ("pieces", output, 0, attachment, n_attach, &pieces);
+  per_piece = 0;
+  run ("gathered", output, 0, attachment, n_attach, &plain);
+  run ("buffered", output, bufsize, attachment, n_attach, &buffered);
+  if (pieces != plain || plain != buffered)
+    {
+      fprintf (stderr, "run-sink-bench: output differs\n");
+      return 1;
+    }
+  printf ("%u bytes\n", (unsigned int) plain.size ());
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+/* t-cachecrypt.cpp - Test for the helpers of the plaintext caches.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The SHA-256 is checked with the known answers of FIPS 180-4 for
+   data which is written at once and in pieces.  The length prefix of
+   writeString must keep strings from being shifted into each other.
+   Then protected data must be restored to its original length.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#include "cachecrypt.h"
+#include "t-support.h"
+
+
+static std::string
+hash_string (const char *str)
+{
+  Sha256 ctx;
+
+  ctx.write (str, strlen (str));
+  return ctx.final ();
+}
+
+
+static void
+check_sha256 ()
+{
+  static const struct
+  {
+    const char *data;
+    const char *digest;
+  } vectors[] = {
+    { "",
+      "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+    { "abc",
+      "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+      "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+    { NULL, NULL }
+  };
+  int i;
+
+  for (i = 0; vectors[i].data; i++)
+    if (hash_string (vectors[i].data) != vectors[i].digest)
+      fail ("wrong digest");
+
+  /* A million times "a" in pieces which do not fit the blocks.  */
+  const std::string piece (999, 'a');
+  Sha256 ctx;
+  for (i = 0; i < 1000000 / 999; i++)
+    ctx.write (piece.data (), piece.size ());
+  ctx.write (piece.data (), 1000000 % 999);
+  if (ctx.final ()
+      != "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0")
+    fail ("wrong digest for pieces");
+  if (!ctx.final ().empty ())
+    fail ("digest read twice");
+
+  Sha256 a;
+  a.writeString ("abc");
+  a.writeString ("");
+  a.writeString ("de");
+  Sha256 b;
+  b.writeString ("ab");
+  b.writeString ("c");
+  b.writeString ("de");
+  if (a.final ()
+      != "06c41d6027f0be1083045ec646a2330b57b6abaac1ce8934b1d25ff46492e6a0"
+      || b.final ()
+      != "8605353b93ce80929dea4f8c39450e806accd4bc0339aa55b692b2c8dc6d993a")
+    fail ("wrong digest for strings");
+}
+
+
+static void
+check_protect ()
+{
+  const std::string plain = "Some secret plaintext";
+  std::string buf = plain;
+
+  protect_data (buf);
+  if (buf.size () < plain.size ())
+    fail ("protected data too short");
+  if (!unprotect_data (buf, plain.size ()) || buf != plain)
+    fail ("protected data not restored");
+  if (unprotect_data (buf, plain.size () + 1))
+    fail ("restored data longer than the buffer");
+
+  wipe_string (buf);
+  if (!buf.empty ())
+    fail ("wiped string not cleared");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  (void) argc;
+  (void) argv;
+
+  check_sha256 ();
+  check_protect ();
+
+  return !!failures;
+}
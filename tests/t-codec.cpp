@@ -0,0 +1,431 @@
+/* t-codec.cpp - Tests for GpgOL's transfer encoding routines.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The optimized encoders and decoders are compared with
+   straightforward reference implementations on random input.  The
+   quoted-printable decoder is also checked with input split into
+   random chunks.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <gpgme.h>
+
+#include "common_indep.h"
+#include "t-support.h"
+
+/* The byte wise base64 decoder as it was used before the block
+   decoder was added.  */
+static size_t
+ref_b64_decode (b64_state_t *state, char *buffer, size_t length)
+{
+  static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  int idx = state->idx;
+  unsigned char val = state->val;
+  int c;
+  char *d, *s;
+  const char *p;
+
+  if (state->stop_seen)
+    return 0;
+
+  for (s=d=buffer; length; length--, s++)
+    {
+      if (*s == '\n' || *s == ' ' || *s == '\r' || *s == '\t')
+        continue;
+      if (*s == '=')
+        {
+          if (idx == 1)
+            *d++ = val;
+          state->stop_seen = 1;
+          break;
+        }
+
+      if (!*s || !(p = strchr (b64chars, *s)))
+        {
+          state->invalid_encoding = 1;
+          continue;
+        }
+      c = p - b64chars;
+
+      switch (idx)
+        {
+        case 0:
+          val = c << 2;
+          break;
+        case 1:
+          val |= (c>>4)&3;
+          *d++ = val;
+          val = (c<<4)&0xf0;
+          break;
+        case 2:
+          val |= (c>>2)&15;
+          *d++ = val;
+          val = (c<<6)&0xc0;
+          break;
+        case 3:
+          val |= c&0x3f;
+          *d++ = val;
+          break;
+        }
+      idx = (idx+1) % 4;
+    }
+
+  state->idx = idx;
+  state->val = val;
+  return d - buffer;
+}
+
+
+/* The base64 encoder as used by write_b64 before b64_encode_mime was
+   added.  */
+static std::string
+ref_write_b64 (const void *data, size_t datalen)
+{
+  static const char bintoasc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  const unsigned char *p;
+  unsigned char inbuf[4];
+  int idx, quads;
+  std::string out;
+
+  idx = quads = 0;
+  for (p = (const unsigned char*)data; datalen; p++, datalen--)
+    {
+      inbuf[idx++] = *p;
+      if (idx > 2)
+        {
+          out += bintoasc[(*inbuf>>2)&077];
+          out += bintoasc[(((*inbuf<<4)&060)|((inbuf[1] >> 4)&017))&077];
+          out += bintoasc[(((inbuf[1]<<2)&074)|((inbuf[2]>>6)&03))&077];
+          out += bintoasc[inbuf[2]&077];
+          idx = 0;
+          if (++quads >= (64/4))
+            {
+              quads = 0;
+              out += "\r\n";
+            }
+        }
+    }
+
+  if (idx)
+    {
+      out += bintoasc[(*inbuf>>2)&077];
+      if (idx == 1)
+        {
+          out += bintoasc[((*inbuf<<4)&060)&077];
+          out += "==";
+        }
+      else
+        {
+          out += bintoasc[(((*inbuf<<4)&060)|((inbuf[1]>>4)&017))&077];
+          out += bintoasc[((inbuf[1]<<2)&074)&077];
+          out += '=';
+        }
+      ++quads;
+    }
+  if (quads)
+    out += "\r\n";
+
+  return out;
+}
+
+
+static void
+test_b64_encode (int iterations)
+{
+  std::string input, expected, out;
+  size_t len, off, n, chunk;
+  int i;
+
+  for (i = 0; i < iterations; i++)
+    {
+      len = i < 200 ? i : rand () % 5000;
+      input.resize (len);
+      for (off = 0; off < len; off++)
+        input[off] = rand () % 256;
+      expected = ref_write_b64 (input.data (), len);
+
+      out.resize (B64_MIME_ENCODED_LEN (len));
+      n = b64_encode_mime (&out[0], input.data (), len);
+      if (n != expected.size () || out.compare (0, n, expected))
+        fail ("b64_encode_mime output differs");
+
+      /* The same in chunks as done by write_b64.  */
+      out.clear ();
+      chunk = B64_MIME_LINE_INPUT * (rand () % 4 + 1);
+      for (off = 0; off < len; off += n)
+        {
+          char buf[B64_MIME_ENCODED_LEN (4 * B64_MIME_LINE_INPUT)];
+
+          n = len - off > chunk ? chunk : len - off;
+          out.append (buf, b64_encode_mime (buf, input.data () + off, n));
+        }
+      if (out != expected)
+        fail ("b64_encode_mime output differs in chunks");
+    }
+  if (verbose)
+    printf ("b64_encode_mime: %d random inputs checked\n", iterations);
+}
+
+
+/* Return a random base64 text of about LENGTH characters.  With
+   NOISE set white space, padding and garbage is sprinkled in.  */
+static std::string
+random_b64 (size_t length, int noise)
+{
+  static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+                                 "abcdefghijklmnopqrstuvwxyz"
+                                 "0123456789+/";
+  static const char extra[] = " \t\r\n=*-\x80\xff";
+  std::string ret;
+
+  while (ret.size () < length)
+    {
+      if (noise && !(rand () % 50))
+        ret += extra[rand () % (sizeof extra - 1)];
+      else if (noise && !(rand () % 500))
+        ret += (char) (rand () % 256);
+      else
+        ret += b64chars[rand () % 64];
+    }
+  return ret;
+}
+
+
+static void
+compare_b64 (const std::string &input)
+{
+  b64_state_t st1, st2;
+  size_t off, n, len1, len2;
+  std::string out1, out2;
+
+  b64_init (&st1);
+  b64_init (&st2);
+
+  /* Feed both decoders with the same random chunks as the parser
+     would do with lines.  */
+  for (off = 0; off < input.size (); off += n)
+    {
+      n = rand () % 100 + 1;
+      if (n > input.size () - off)
+        n = input.size () - off;
+
+      std::string buf1 = input.substr (off, n);
+      std::string buf2 = buf1;
+      len1 = b64_decode (&st1, &buf1[0], n);
+      len2 = ref_b64_decode (&st2, &buf2[0], n);
+      out1.append (buf1, 0, len1);
+      out2.append (buf2, 0, len2);
+    }
+
+  if (out1 != out2)
+    fail ("b64_decode output differs");
+  if (st1.idx != st2.idx || st1.val != st2.val
+      || st1.stop_seen != st2.stop_seen
+      || st1.invalid_encoding != st2.invalid_encoding)
+    fail ("b64_decode state differs");
+}
+
+
+static void
+test_b64_decode (int iterations)
+{
+  int i;
+
+  compare_b64 ("");
+  compare_b64 ("QUJD");
+  compare_b64 ("QUJDRA==");
+  compare_b64 ("QUJDREU=");
+  compare_b64 ("QUJDREVGR0hJSktMTU5PUFFSU1RVVldYWVo=");
+
+  for (i = 0; i < iterations; i++)
+    {
+      compare_b64 (random_b64 (rand () % 2000, 0));
+      compare_b64 (random_b64 (rand () % 2000, 1));
+    }
+  if (verbose)
+    printf ("b64_decode: %d random inputs checked\n", 2 * iterations);
+}
+
+
+/* The line wise quoted-printable decoder as it was used before the
+   buffer decoder was added.  */
+static size_t
+ref_qp_decode (char *buffer, size_t length, int *r_slbrk)
+{
+  char *d, *s;
+
+  if (r_slbrk)
+    *r_slbrk = 0;
+
+  for (s=d=buffer; length; length--)
+    if (*s == '=')
+      {
+        if (length > 2 && hexdigitp (s+1) && hexdigitp (s+2))
+          {
+            s++;
+            *(unsigned char*)d++ = xtoi_2 (s);
+            s += 2;
+            length -= 2;
+          }
+        else if (length > 2 && s[1] == '\r' && s[2] == '\n')
+          {
+            s += 3;
+            length -= 2;
+            if (r_slbrk && length == 1)
+              *r_slbrk = 1;
+          }
+        else if (length > 1 && s[1] == '\n')
+          {
+            s += 2;
+            length -= 1;
+            if (r_slbrk && length == 1)
+              *r_slbrk = 1;
+          }
+        else if (length == 1)
+          {
+            s += 1;
+            if (r_slbrk)
+              *r_slbrk = 1;
+          }
+        else
+          *d++ = *s++;
+      }
+    else
+      *d++ = *s++;
+
+  return d - buffer;
+}
+
+
+/* Return a random quoted-printable text of about LENGTH characters.
+   Escape sequences, soft line breaks and broken sequences are
+   sprinkled in.  */
+static std::string
+random_qp (size_t length)
+{
+  static const char *pieces[] = {"=", "=\r\n", "=\n", "=3D", "=c3=a4",
+                                 "=E2=82=AC", "=4", "=G1", "==41", "=\r",
+                                 "\r\n", "\n", " ", "\t", "\x80", "-"};
+  std::string ret;
+  int run;
+
+  while (ret.size () < length)
+    {
+      if (rand () % 4)
+        {
+          /* A run of literal text of varying length.  */
+          for (run = rand () % 40; run; run--)
+            ret += (char) ('a' + rand () % 26);
+        }
+      else
+        ret += pieces[rand () % (sizeof pieces / sizeof *pieces)];
+    }
+  return ret;
+}
+
+
+static void
+compare_qp (const std::string &input)
+{
+  std::string buf1 = input;
+  std::string buf2 = input;
+  std::string whole, chunked, carry;
+  size_t len1, len2, off, n, not_taken;
+  int slbrk1, slbrk2;
+
+  /* A complete line as passed by the parser.  */
+  len1 = qp_decode (&buf1[0], buf1.size (), &slbrk1);
+  len2 = ref_qp_decode (&buf2[0], buf2.size (), &slbrk2);
+  if (len1 != len2 || buf1.compare (0, len1, buf2, 0, len2))
+    fail ("qp_decode output differs");
+  if (slbrk1 != slbrk2)
+    fail ("qp_decode soft line break differs");
+
+  /* The same data split into random chunks.  */
+  whole = input;
+  whole.resize (qp_decode_buffer (&whole[0], whole.size (), NULL, NULL));
+  for (off = 0; off < input.size (); off += n)
+    {
+      n = rand () % 50 + 1;
+      if (n > input.size () - off)
+        n = input.size () - off;
+      carry += input.substr (off, n);
+      if (off + n == input.size ())
+        {
+          chunked.append (carry, 0, qp_decode_buffer (&carry[0], carry.size (),
+                                                      NULL, NULL));
+          break;
+        }
+      len1 = qp_decode_buffer (&carry[0], carry.size (), &not_taken, NULL);
+      if (not_taken > 2)
+        fail ("qp_decode_buffer kept too much");
+      chunked.append (carry, 0, len1);
+      carry.erase (0, carry.size () - not_taken);
+    }
+  if (whole != chunked)
+    fail ("qp_decode_buffer output differs for chunks");
+}
+
+
+static void
+test_qp_decode (int iterations)
+{
+  int i;
+
+  compare_qp ("");
+  compare_qp ("=");
+  compare_qp ("=\r\n");
+  compare_qp ("=4");
+  compare_qp ("=41");
+  compare_qp ("foo=3Dbar=");
+  compare_qp ("=\r\nfoo=\r\n");
+
+  for (i = 0; i < iterations; i++)
+    compare_qp (random_qp (rand () % 2000));
+  if (verbose)
+    printf ("qp_decode: %d random inputs checked\n", iterations);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int iterations = 1000;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    {
+      verbose = 1;
+      argc--; argv++;
+    }
+  if (argc > 1)
+    iterations = atoi (argv[1]);
+
+  srand (42);
+  test_b64_decode (iterations);
+  test_b64_encode (iterations);
+  test_qp_decode (iterations);
+
+  return !!failures;
+}
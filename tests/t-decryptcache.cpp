@@ -0,0 +1,183 @@
+/* t-decryptcache.cpp - Test for the cache of decrypted mails.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The encrypted mails in tests/data are parsed and stored in the
+   DecryptCache.  A ParseController restored from the cache must
+   return the same results.  Then the eviction and invalidation of
+   entries is checked.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <string>
+#include <vector>
+#include <gpgme.h>
+
+#include "parsecontroller.h"
+#include "decryptcache.h"
+#include "attachment.h"
+#include "t-support.h"
+
+
+static std::string
+attachments_string (const ParseController &parser)
+{
+  std::string ret;
+
+  for (const auto &att: parser.get_attachments ())
+    {
+      ret += att->get_display_name () + ";" + att->get_content_type () + ";"
+             + att->get_content_id () + ";" + att->get_data ().toString ()
+             + "\n";
+    }
+  return ret;
+}
+
+
+static void
+compare (const char *name, const ParseController &a,
+         const ParseController &b)
+{
+  static const char *headers[] = {"Subject", "From", "To", "Cc",
+                                  "Reply-To", "Followup-To", nullptr};
+
+  if (a.get_body () != b.get_body ()
+      || a.get_html_body () != b.get_html_body ()
+      || a.get_body_charset () != b.get_body_charset ()
+      || a.get_html_charset () != b.get_html_charset ()
+      || a.get_content_type () != b.get_content_type ()
+      || a.get_formatted_error () != b.get_formatted_error ()
+      || a.shouldBlockHtml () != b.shouldBlockHtml ()
+      || attachments_string (a) != attachments_string (b))
+    {
+      fprintf (stderr, "Mismatch for %s\n", name);
+      fail ("restored content differs");
+    }
+  for (int i = 0; headers[i]; i++)
+    if (a.get_protected_header (headers[i])
+        != b.get_protected_header (headers[i]))
+      fail ("restored protected header differs");
+  if (a.decrypt_result ().error ().code ()
+      != b.decrypt_result ().error ().code ()
+      || a.verify_result ().numSignatures ()
+      != b.verify_result ().numSignatures ())
+    fail ("restored result differs");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  auto cache = DecryptCache::instance ();
+  std::vector<std::string> uids;
+  std::vector<std::string> hashes;
+  DIR *dir;
+  struct dirent *dent;
+  size_t len;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  dir = opendir (DATADIR);
+  if (!dir)
+    {
+      perror (DATADIR);
+      exit (1);
+    }
+  while ((dent = readdir (dir)))
+    {
+      len = strlen (dent->d_name);
+      if (len < 5 || strcmp (dent->d_name + len - 5, ".mbox")
+          || strncmp (dent->d_name, "openpgp-encrypted", 17))
+        continue;
+
+      std::string fname = std::string (DATADIR "/") + dent->d_name;
+      FILE *fp = fopen (fname.c_str (), "rb");
+      if (!fp)
+        {
+          perror (fname.c_str ());
+          exit (1);
+        }
+      const std::string hash = DecryptCache::hashFile (fp);
+      ParseController parser (fp, MSGTYPE_GPGOL_MULTIPART_ENCRYPTED);
+      fclose (fp);
+      parser.parse (true);
+
+      cache->store (dent->d_name, hash, parser);
+      auto restored = cache->restore (dent->d_name, hash);
+      if (!restored)
+        {
+          fail ("entry not found");
+          continue;
+        }
+      compare (dent->d_name, parser, *restored);
+      /* Parsing a restored controller does nothing.  */
+      restored->parse (true);
+      compare (dent->d_name, parser, *restored);
+
+      if (cache->restore (dent->d_name, hash + "x"))
+        fail ("entry found for a different hash");
+      if (cache->restore (dent->d_name, hash))
+        fail ("entry not removed for a different hash");
+      cache->store (dent->d_name, hash, parser);
+      uids.push_back (dent->d_name);
+      hashes.push_back (hash);
+    }
+  closedir (dir);
+
+  if (uids.size () < 3)
+    {
+      fail ("not enough test mails");
+      return 1;
+    }
+  if (verbose)
+    printf ("%lu entries with %lu bytes\n", (unsigned long) cache->count (),
+            (unsigned long) cache->size ());
+  if (cache->count () != uids.size ())
+    fail ("wrong number of entries");
+
+  /* Invalidate one entry.  */
+  cache->invalidate (uids[0]);
+  if (cache->restore (uids[0], hashes[0])
+      || cache->count () != uids.size () - 1)
+    fail ("entry not invalidated");
+
+  /* Use the oldest remaining entry so that it is the most recently
+     used one.  Shrinking the cache then evicts the second oldest.  */
+  if (!cache->restore (uids[1], hashes[1]))
+    fail ("entry not found");
+  cache->setMaxSize (cache->size () - 1);
+  if (cache->count () != uids.size () - 2)
+    fail ("wrong number of entries after shrinking");
+  if (!cache->restore (uids[1], hashes[1]))
+    fail ("recently used entry evicted");
+  if (cache->restore (uids[2], hashes[2]))
+    fail ("least recently used entry not evicted");
+  cache->setMaxSize (DECRYPT_CACHE_MAX_SIZE);
+
+  cache->clear ();
+  if (cache->count () || cache->size ())
+    fail ("cache not cleared");
+
+  return !!failures;
+}
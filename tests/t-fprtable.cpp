@@ -0,0 +1,154 @@
+/* t-fprtable.cpp - Test for the fingerprint hash table.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The table is compared with a std::unordered_map after random
+   inserts and removals.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+
+#include "fprtable.h"
+#include "t-support.h"
+
+
+static void
+check_binfpr ()
+{
+  const char *v4 = "AB6D3A8E61A2E27BC4B6A3DB2EB5C6A4D44D6E2F";
+  const char *v5 = "19347BC9872464025F99DF3EC2E0000ED9884892E1F7B3EA4C94009159569B54";
+
+  if (BinFpr (v4).toString () != v4 || BinFpr (v5).toString () != v5)
+    fail ("hex form changed");
+  if (BinFpr ("ab6d3a8e61a2e27bc4b6a3db2eb5c6a4d44d6e2f") != BinFpr (v4))
+    fail ("lower case differs");
+  if (BinFpr (v4) == BinFpr (v5))
+    fail ("different fingerprints are equal");
+  if (!BinFpr ("").isNull () || !BinFpr ((const char *) nullptr).isNull ()
+      || !BinFpr ("ABC").isNull () || !BinFpr ("XY").isNull ()
+      || !BinFpr (std::string (66, 'A')).isNull ())
+    fail ("invalid fingerprint accepted");
+  /* A key id is shorter but valid.  */
+  if (BinFpr ("2EB5C6A4D44D6E2F").isNull ())
+    fail ("key id not accepted");
+}
+
+
+static std::string
+random_fpr (int len)
+{
+  static const char digits[] = "0123456789ABCDEF";
+  std::string ret;
+  int i;
+
+  for (i = 0; i < len; i++)
+    ret += digits[rand () % 16];
+  return ret;
+}
+
+
+static void
+check_table ()
+{
+  FprTable<int> table;
+  std::unordered_map<std::string, int> ref;
+  std::vector<std::string> fprs;
+  int i;
+
+  srand (1);
+  for (i = 0; i < 3000; i++)
+    fprs.push_back (random_fpr (i % 3 ? 40 : 64));
+
+  for (i = 0; i < 20000; i++)
+    {
+      const auto &fpr = fprs[rand () % fprs.size ()];
+      switch (rand () % 3)
+        {
+        case 0:
+          table.set (BinFpr (fpr), i);
+          ref[fpr] = i;
+          break;
+        case 1:
+          if (table.insert (BinFpr (fpr), i).second
+              != ref.insert (std::make_pair (fpr, i)).second)
+            fail ("insert differs");
+          break;
+        default:
+          if (table.erase (BinFpr (fpr)) != (ref.erase (fpr) == 1))
+            fail ("erase differs");
+          break;
+        }
+    }
+
+  if (table.size () != ref.size ())
+    fail ("size differs");
+  for (const auto &fpr: fprs)
+    {
+      const int *val = table.find (BinFpr (fpr));
+      const auto it = ref.find (fpr);
+      if (!val != (it == ref.end ()) || (val && *val != it->second))
+        {
+          fail ("lookup differs");
+          break;
+        }
+    }
+  size_t n = 0;
+  for (const auto &pair: table)
+    {
+      const auto it = ref.find (pair.first.toString ());
+      if (it == ref.end () || it->second != pair.second)
+        fail ("iteration differs");
+      n++;
+    }
+  if (n != ref.size ())
+    fail ("iteration missed entries");
+
+  const size_t removed = table.eraseIf ([] (const BinFpr &, int val) {
+      return val % 2;
+    });
+  for (const auto &pair: table)
+    if (pair.second % 2)
+      fail ("eraseIf kept an entry");
+  if (verbose)
+    printf ("%u entries, %u removed, %u bytes\n",
+            (unsigned int) ref.size (), (unsigned int) removed,
+            (unsigned int) table.memoryUsage ());
+
+  FprTable<int> other;
+  other.swap (table);
+  if (!table.empty () || other.size () != ref.size () - removed)
+    fail ("swap failed");
+  if (table.find (BinFpr (fprs[0])))
+    fail ("found in empty table");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  check_binfpr ();
+  check_table ();
+
+  return !!failures;
+}
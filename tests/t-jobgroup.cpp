@@ -0,0 +1,101 @@
+/* t-jobgroup.cpp - Test for groups of jobs in the shared pool.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The jobs of a group must run at the same time, and waiting for a
+   group must not wait for the jobs of another group which share the
+   pool.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "jobgroup.h"
+#include "t-support.h"
+
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_closed = true;
+static int running;
+static int done;
+
+
+/* Wait until all jobs of a group run at once.  */
+static void
+meet_job (int n)
+{
+  pthread_mutex_lock (&gate_lock);
+  running++;
+  pthread_cond_broadcast (&gate_cond);
+  while (running < n)
+    pthread_cond_wait (&gate_cond, &gate_lock);
+  done++;
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+static void
+blocked_job ()
+{
+  pthread_mutex_lock (&gate_lock);
+  while (gate_closed)
+    pthread_cond_wait (&gate_cond, &gate_lock);
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+static void
+open_gate ()
+{
+  pthread_mutex_lock (&gate_lock);
+  gate_closed = false;
+  pthread_cond_broadcast (&gate_cond);
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  const int n = JOBGROUP_MAX_WORKERS - 1;
+  int i;
+
+  (void) argc;
+  (void) argv;
+
+  /* This one blocks a worker until the end.  */
+  JobGroup other;
+  other.add (blocked_job);
+
+  JobGroup group;
+  for (i = 0; i < n; i++)
+    group.add ([n] () { meet_job (n); });
+  if (group.size () != n)
+    fail ("wrong group size");
+  /* Deadlocks unless the jobs run at the same time and the other
+     group is not waited for.  */
+  group.wait ();
+  if (done != n || group.size ())
+    fail ("group not done");
+
+  open_gate ();
+  other.wait ();
+
+  return !!failures;
+}
@@ -0,0 +1,202 @@
+/* t-keyjobqueue.cpp - Test for the key job queue.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The KeyCache queues a locate job per recipient.  A fake locate
+   backend which sleeps a bit stands in for gpg.  A distribution list
+   with many recipients must not run more lookups at the same time
+   than there are workers, each address must be looked up only once
+   while its lookup is in flight and a full queue must reject new
+   jobs instead of blocking.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+
+#include "keyjobqueue.h"
+#include "t-support.h"
+
+#define N_WORKERS 3
+#define N_RECIPIENTS 200
+#define N_ADDRESSES 40
+
+static pthread_mutex_t backend_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_closed;
+static int backend_running;
+static int backend_max_running;
+static std::map<std::string, int> backend_calls;
+
+
+/* The fake locate backend.  */
+static void
+fake_locate (const std::string &mbox, unsigned int usec)
+{
+  pthread_mutex_lock (&backend_lock);
+  backend_calls[mbox]++;
+  if (++backend_running > backend_max_running)
+    backend_max_running = backend_running;
+  while (gate_closed)
+    pthread_cond_wait (&gate_cond, &backend_lock);
+  pthread_mutex_unlock (&backend_lock);
+
+  usleep (usec);
+
+  pthread_mutex_lock (&backend_lock);
+  backend_running--;
+  pthread_mutex_unlock (&backend_lock);
+}
+
+
+static void
+set_gate (bool closed)
+{
+  pthread_mutex_lock (&backend_lock);
+  gate_closed = closed;
+  pthread_cond_broadcast (&gate_cond);
+  pthread_mutex_unlock (&backend_lock);
+}
+
+
+static KeyJobQueue::SubmitResult
+submit (const std::string &mbox, unsigned int usec = 2000)
+{
+  return KeyJobQueue::instance ()->submit ("locate:" + mbox,
+                                           [mbox, usec] ()
+                                             {
+                                               fake_locate (mbox, usec);
+                                             });
+}
+
+
+/* Paste a distribution list where each address shows up several
+   times.  */
+static void
+check_distribution_list ()
+{
+  auto queue = KeyJobQueue::instance ();
+  int results[3] = {0, 0, 0};
+  int calls = 0;
+  int i;
+
+  for (i = 0; i < N_RECIPIENTS; i++)
+    {
+      std::string mbox = "user" + std::to_string (i % N_ADDRESSES)
+                         + "@example.org";
+      results[submit (mbox)]++;
+    }
+  queue->waitIdle ();
+
+  const auto s = queue->stats ();
+  for (const auto &pair: backend_calls)
+    calls += pair.second;
+
+  if (verbose)
+    {
+      printf ("%i submitted, %i duplicates, %i rejected, "
+              "max %i lookups at once\n",
+              results[0], results[1], results[2], backend_max_running);
+      printf ("wait avg %.1f ms max %.1f ms, run avg %.1f ms max %.1f ms\n",
+              s.wait_total / 1000.0 / s.done, s.wait_max / 1000.0,
+              s.run_total / 1000.0 / s.done, s.run_max / 1000.0);
+    }
+
+  if (results[0] + results[1] != N_RECIPIENTS || results[2])
+    fail ("wrong submit results");
+  if ((int) backend_calls.size () != N_ADDRESSES)
+    fail ("not every address was looked up");
+  if (calls != results[0])
+    fail ("wrong number of lookups");
+  if (backend_max_running > N_WORKERS)
+    fail ("too many lookups at once");
+  if (s.queued || s.running || s.workers > N_WORKERS)
+    fail ("queue not idle");
+  if ((int) s.submitted != results[0] || (int) s.duplicates != results[1]
+      || s.done != s.submitted)
+    fail ("wrong counters");
+  if (s.run_total < s.done * 2000 || s.run_max < 2000)
+    fail ("wrong run time");
+}
+
+
+/* Block the workers and fill the queue.  */
+static void
+check_backpressure ()
+{
+  auto queue = KeyJobQueue::instance ();
+  const auto before = queue->stats ();
+  int i;
+
+  queue->setMaxQueued (10);
+  set_gate (true);
+  for (i = 0; i < N_WORKERS; i++)
+    if (submit ("busy" + std::to_string (i)) != KeyJobQueue::Submitted)
+      fail ("submit failed");
+  /* Wait until the workers took the jobs.  */
+  while (queue->stats ().queued)
+    usleep (1000);
+
+  for (i = 0; i < 10; i++)
+    if (submit ("queued" + std::to_string (i)) != KeyJobQueue::Submitted)
+      fail ("submit failed");
+  if (submit ("queued0") != KeyJobQueue::Duplicate)
+    fail ("queued job submitted twice");
+  if (submit ("busy0") != KeyJobQueue::Duplicate)
+    fail ("running job submitted twice");
+  if (!queue->contains ("locate:busy0") || queue->contains ("locate:none"))
+    fail ("wrong contains");
+  if (submit ("toomuch") != KeyJobQueue::Rejected)
+    fail ("full queue accepted a job");
+
+  const auto s = queue->stats ();
+  if (s.queued != 10 || s.running != N_WORKERS
+      || s.rejected != before.rejected + 1
+      || s.duplicates != before.duplicates + 2)
+    fail ("wrong counters for a full queue");
+
+  set_gate (false);
+  queue->waitIdle ();
+  if (queue->contains ("locate:busy0"))
+    fail ("done job still contained");
+  if (submit ("busy0") != KeyJobQueue::Submitted)
+    fail ("done job not submitted again");
+  if (submit ("toomuch") != KeyJobQueue::Submitted)
+    fail ("rejected job not submitted again");
+  queue->waitIdle ();
+  if (queue->stats ().done != before.done + N_WORKERS + 12)
+    fail ("wrong number of done jobs");
+  queue->setMaxQueued (KEYJOB_MAX_QUEUED);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  KeyJobQueue::instance ()->setMaxWorkers (N_WORKERS);
+  check_distribution_list ();
+  check_backpressure ();
+
+  return !!failures;
+}
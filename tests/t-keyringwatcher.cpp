@@ -0,0 +1,179 @@
+/* t-keyringwatcher.cpp - Test for noticing keyring changes.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The watcher is started on a temporary GNUPGHOME with a copy of the
+   keyring from tests/gnupg_home.  Other files must not be reported,
+   a burst of changes must be reported once and an import with gpg,
+   if it is installed, must be noticed.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <string>
+
+#include "keyringwatcher.h"
+#include "t-support.h"
+
+/* A short delay for the test.  */
+#define DELAY 100
+
+static pthread_mutex_t count_lock = PTHREAD_MUTEX_INITIALIZER;
+static int count;
+static std::string homedir;
+
+
+static void
+on_change ()
+{
+  pthread_mutex_lock (&count_lock);
+  count++;
+  pthread_mutex_unlock (&count_lock);
+}
+
+
+/* Return the number of changes since the last call after waiting long
+   enough for a pending change to be reported.  */
+static int
+take_count ()
+{
+  int ret;
+
+  usleep (DELAY * 1000 * 4);
+  pthread_mutex_lock (&count_lock);
+  ret = count;
+  count = 0;
+  pthread_mutex_unlock (&count_lock);
+  return ret;
+}
+
+
+static void
+write_file (const char *name, const char *data, const char *mode)
+{
+  std::string fname = homedir + "/" + name;
+  FILE *fp = fopen (fname.c_str (), mode);
+
+  if (!fp)
+    {
+      perror (fname.c_str ());
+      exit (1);
+    }
+  fputs (data, fp);
+  fclose (fp);
+}
+
+
+static int
+run (const std::string &cmd)
+{
+  if (verbose)
+    printf ("%s\n", cmd.c_str ());
+  return system (cmd.c_str ());
+}
+
+
+int
+main (int argc, char **argv)
+{
+  char tmpdir[] = "/tmp/t-keyringwatcher-XXXXXX";
+  KeyringWatcher watcher;
+  int i;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  if (!mkdtemp (tmpdir))
+    {
+      perror (tmpdir);
+      return 1;
+    }
+  homedir = tmpdir;
+  run ("cp " GPGHOMEDIR "/pubring.kbx " GPGHOMEDIR "/trustdb.gpg "
+       + homedir);
+
+  if (!watcher.start (homedir, on_change, DELAY))
+    fail ("start failed");
+  if (watcher.start (homedir, on_change, DELAY))
+    fail ("started twice");
+
+  /* Other files are ignored.  */
+  write_file ("random_seed", "seed", "wb");
+  write_file ("pubring.kbx.lock", "1234", "wb");
+  unlink ((homedir + "/pubring.kbx.lock").c_str ());
+  if (take_count ())
+    fail ("change of other files reported");
+
+  /* A burst of changes is reported once.  */
+  for (i = 0; i < 5; i++)
+    {
+      write_file ("pubring.kbx", "x", "ab");
+      usleep (DELAY * 1000 / 4);
+    }
+  if ((i = take_count ()) != 1)
+    {
+      fprintf (stderr, "%i changes reported\n", i);
+      fail ("burst not reported once");
+    }
+
+  /* Replacing the trustdb the way gpg does.  */
+  write_file ("trustdb.gpg.tmp", "trust", "wb");
+  rename ((homedir + "/trustdb.gpg.tmp").c_str (),
+          (homedir + "/trustdb.gpg").c_str ());
+  if (take_count () != 1)
+    fail ("replaced trustdb not reported");
+
+  /* A new secret key.  */
+  mkdir ((homedir + "/private-keys-v1.d").c_str (), 0700);
+  if (take_count () != 1)
+    fail ("new private key directory not reported");
+  write_file ("private-keys-v1.d/0123.key", "key", "wb");
+  if (take_count () != 1)
+    fail ("new private key not reported");
+
+  /* An import with gpg.  */
+  if (!run ("gpg --version >/dev/null 2>&1"))
+    {
+      run ("cp " GPGHOMEDIR "/pubring.kbx " GPGHOMEDIR "/trustdb.gpg "
+           + homedir);
+      take_count ();
+      if (run ("gpg --homedir " + homedir + " --batch --quiet --import "
+               DATADIR "/../testkey-hagelin.asc 2>/dev/null"))
+        fail ("gpg --import failed");
+      /* The import may take longer than the delay.  */
+      if (take_count () < 1)
+        fail ("import not reported");
+    }
+  else if (verbose)
+    printf ("gpg not found.  Skipping the import.\n");
+
+  watcher.stop ();
+  if (watcher.isRunning ())
+    fail ("still running");
+  write_file ("pubring.kbx", "x", "ab");
+  if (take_count ())
+    fail ("change reported after stop");
+
+  run ("gpgconf --homedir " + homedir + " --kill all >/dev/null 2>&1");
+  run ("rm -rf " + homedir);
+
+  return !!failures;
+}
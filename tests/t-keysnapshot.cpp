@@ -0,0 +1,172 @@
+/* t-keysnapshot.cpp - Test for the keyring snapshot.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A snapshot is saved for a fake GnuPG home directory and loaded
+   again.  It must be rejected after a keyring file was changed and if
+   the file is broken.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "keysnapshot.h"
+#include "t-support.h"
+
+
+static void
+write_file (const std::string &fname, const char *data, const char *mode)
+{
+  FILE *fp = fopen (fname.c_str (), mode);
+
+  if (!fp)
+    {
+      perror (fname.c_str ());
+      exit (1);
+    }
+  fputs (data, fp);
+  fclose (fp);
+}
+
+
+static std::string
+read_file (const std::string &fname)
+{
+  std::string ret;
+  FILE *fp = fopen (fname.c_str (), "rb");
+  int c;
+
+  if (!fp)
+    {
+      perror (fname.c_str ());
+      exit (1);
+    }
+  while ((c = getc (fp)) != EOF)
+    ret += (char) c;
+  fclose (fp);
+  return ret;
+}
+
+
+static void
+fill (KeySnapshot *snap, int n)
+{
+  char fpr[41];
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      std::vector<std::string> mboxes;
+
+      snprintf (fpr, sizeof fpr, "%040X", i);
+      if (i % 10 == 0)
+        {
+          mboxes.push_back ("user" + std::to_string (i) + "@example.org");
+          mboxes.push_back ("all@example.org");
+        }
+      snap->add (fpr, i % 2, (i % 10 == 0 ? KeySnapshot::FlagSecret : 0)
+                 | KeySnapshot::FlagCanEncrypt, i % 6, mboxes);
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+  char tmpdir[] = "/tmp/t-keysnapshot-XXXXXX";
+  KeySnapshot snap, loaded;
+  std::string homedir, fname, stamp;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  if (!mkdtemp (tmpdir))
+    {
+      perror (tmpdir);
+      return 1;
+    }
+  homedir = tmpdir;
+  fname = homedir + "/" + KEYSNAPSHOT_NAME;
+  write_file (homedir + "/pubring.kbx", "keys", "wb");
+
+  stamp = KeySnapshot::keyringStamp (homedir);
+  if (verbose)
+    printf ("stamp: %s\n", stamp.c_str ());
+  if (stamp != KeySnapshot::keyringStamp (homedir))
+    fail ("stamp not stable");
+
+  fill (&snap, 1000);
+  /* Duplicates are ignored.  */
+  snap.add (std::string (40, '0'), 1, 0, 0, {});
+  if (snap.size () != 1000)
+    fail ("wrong size");
+  if (!snap.save (fname, stamp))
+    fail ("save failed");
+
+  if (!loaded.load (fname, stamp) || loaded.size () != snap.size ())
+    fail ("load failed");
+  else
+    {
+      const auto *entry = loaded.find (std::string (38, '0') + "14");
+      if (!entry || entry->protocol != 0 || entry->validity != 2
+          || entry->flags != (KeySnapshot::FlagSecret
+                              | KeySnapshot::FlagCanEncrypt)
+          || entry->mboxes.size () != 2)
+        fail ("wrong entry");
+      if (loaded.find ("nothere"))
+        fail ("found missing entry");
+      if (loaded.secretKeys ("all@example.org", 0).size () != 100)
+        fail ("wrong secret keys for all@");
+      if (loaded.secretKeys ("all@example.org", 1).size ())
+        fail ("wrong secret keys for the other protocol");
+      if (loaded.secretKeys ("user20@example.org", 0).size () != 1
+          || loaded.secretKeys ("user21@example.org", 1).size ())
+        fail ("wrong secret keys for user");
+    }
+
+  /* A changed keyring invalidates the snapshot.  */
+  write_file (homedir + "/pubring.kbx", "more", "ab");
+  if (loaded.load (fname, KeySnapshot::keyringStamp (homedir))
+      || !loaded.empty ())
+    fail ("snapshot of a changed keyring loaded");
+  write_file (homedir + "/trustdb.gpg", "trust", "wb");
+  if (KeySnapshot::keyringStamp (homedir) == stamp)
+    fail ("new trustdb does not change the stamp");
+
+  /* A truncated file is rejected.  */
+  std::string data = read_file (fname);
+  write_file (fname, data.substr (0, data.size () / 2).c_str (), "wb");
+  if (loaded.load (fname, stamp) || !loaded.empty ())
+    fail ("truncated snapshot loaded");
+  write_file (fname, data.substr (0, data.rfind ("end")).c_str (), "wb");
+  if (loaded.load (fname, stamp))
+    fail ("snapshot without end loaded");
+  write_file (fname, ("x" + data).c_str (), "wb");
+  if (loaded.load (fname, stamp))
+    fail ("snapshot with a wrong magic loaded");
+
+  unlink (fname.c_str ());
+  unlink ((homedir + "/pubring.kbx").c_str ());
+  unlink ((homedir + "/trustdb.gpg").c_str ());
+  rmdir (tmpdir);
+
+  return !!failures;
+}
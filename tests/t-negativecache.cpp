@@ -0,0 +1,129 @@
+/* t-negativecache.cpp - Test for the cache of failed key lookups.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A failed lookup is remembered per address and protocol until the
+   TTL has passed, the keyring changed or a key was imported.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "negativecache.h"
+#include "t-support.h"
+
+#define PGP 0
+#define CMS 1
+
+
+static void
+check_lookup ()
+{
+  NegativeCache cache;
+
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Unknown)
+    fail ("empty cache has an entry");
+  cache.add ("a@example.org", PGP);
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Fresh
+      || cache.lookup ("a@example.org", PGP) != NegativeCache::Fresh)
+    fail ("entry not found");
+  if (cache.lookup ("a@example.org", CMS) != NegativeCache::Unknown)
+    fail ("entry found for the other protocol");
+
+  cache.expire ("a@example.org", PGP);
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Expired)
+    fail ("entry not expired");
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Unknown)
+    fail ("expired entry not removed");
+
+  const auto s = cache.stats ();
+  if (s.hits != 2 || s.misses != 4 || s.entries)
+    fail ("wrong counters");
+}
+
+
+static void
+check_ttl ()
+{
+  NegativeCache cache;
+
+  cache.setTTL (1);
+  cache.add ("a@example.org", PGP);
+  cache.add ("b@example.org", CMS);
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Fresh)
+    fail ("entry not found");
+  usleep (1100000);
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Expired
+      || cache.lookup ("b@example.org", CMS) != NegativeCache::Expired)
+    fail ("entry not expired after the TTL");
+
+  /* A TTL of 0 disables the cache.  */
+  cache.add ("c@example.org", PGP);
+  cache.setTTL (0);
+  cache.add ("d@example.org", PGP);
+  if (cache.lookup ("c@example.org", PGP) != NegativeCache::Expired
+      || cache.lookup ("d@example.org", PGP) != NegativeCache::Unknown)
+    fail ("disabled cache has fresh entries");
+}
+
+
+static void
+check_invalidation ()
+{
+  NegativeCache cache;
+
+  cache.checkStamp ("1;");
+  cache.add ("a@example.org", PGP);
+  cache.add ("b@example.org", PGP);
+  cache.checkStamp ("1;");
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Fresh)
+    fail ("entry expired without a keyring change");
+  cache.checkStamp ("2;");
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Expired
+      || cache.lookup ("b@example.org", PGP) != NegativeCache::Expired)
+    fail ("entry not expired after a keyring change");
+
+  cache.add ("a@example.org", PGP);
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Fresh)
+    fail ("entry not added again");
+  cache.expireAll ();
+  if (cache.lookup ("a@example.org", PGP) != NegativeCache::Expired)
+    fail ("entry not expired after an import");
+
+  const auto s = cache.stats ();
+  if (verbose)
+    printf ("%lu entries, %lu hits, %lu misses, %lu invalidations\n",
+            s.entries, s.hits, s.misses, s.invalidations);
+  if (s.invalidations != 2 || s.hits != 2 || s.misses != 3)
+    fail ("wrong counters");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  check_lookup ();
+  check_ttl ();
+  check_invalidation ();
+
+  return !!failures;
+}
@@ -0,0 +1,336 @@
+/* t-parallel-parser.cpp - Test for parsing mails in parallel.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The mails in tests/data are parsed one after another and then
+   several copies of each are parsed at the same time by the
+   ParseScheduler.  The results must be the same.  A second test
+   checks the order in which queued jobs are started and that
+   canceled jobs are not run.  A third test selects mails before and
+   after their jobs are queued.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include <gpgme.h>
+
+#include "parsecontroller.h"
+#include "parsescheduler.h"
+#include "attachment.h"
+#include "t-support.h"
+
+/* What we compare between the sequential and the parallel run.  */
+struct result_s
+{
+  std::string body;
+  std::string html;
+  std::string charset;
+  std::string attachments;
+  int decrypt_error = 0;
+  int signatures = 0;
+};
+
+
+/* Return the message type for a mail in tests/data by its name.  */
+static msgtype_t
+type_for_file (const char *name)
+{
+  static const struct
+  {
+    const char *prefix;
+    msgtype_t type;
+  } table[] = {
+    { "inlinepgp", MSGTYPE_GPGOL_PGP_MESSAGE },
+    { "openpgp-encrypted", MSGTYPE_GPGOL_MULTIPART_ENCRYPTED },
+    { "openpgp-signed", MSGTYPE_GPGOL_MULTIPART_SIGNED },
+    { "smime-opaque-sign.", MSGTYPE_GPGOL_OPAQUE_SIGNED },
+    { "smime-", MSGTYPE_GPGOL_OPAQUE_ENCRYPTED },
+    { NULL, MSGTYPE_UNKNOWN }
+  };
+  int i;
+
+  for (i = 0; table[i].prefix; i++)
+    if (!strncmp (name, table[i].prefix, strlen (table[i].prefix)))
+      break;
+  return table[i].type;
+}
+
+
+static void
+parse_mail (const std::string &fname, msgtype_t type, result_s *result)
+{
+  FILE *fp = fopen (fname.c_str (), "rb");
+
+  if (!fp)
+    {
+      perror (fname.c_str ());
+      exit (1);
+    }
+  {
+    ParseController parser (fp, type);
+    parser.parse (true);
+
+    result->body = parser.get_body ();
+    result->html = parser.get_html_body ();
+    result->charset = parser.get_body_charset ();
+    for (const auto &att: parser.get_attachments ())
+      result->attachments += att->get_display_name () + "\n";
+    result->decrypt_error = parser.decrypt_result ().error ().code ();
+    result->signatures = parser.verify_result ().numSignatures ();
+  }
+  fclose (fp);
+}
+
+
+static double
+now ()
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Parse COPIES copies of each mail in the data directory with the
+   ParseScheduler and compare the results with sequential parsing.  */
+static void
+check_parallel (int copies, int workers)
+{
+  std::vector<std::string> files;
+  std::vector<msgtype_t> types;
+  std::vector<result_s> expected;
+  std::vector<result_s> results;
+  DIR *dir;
+  struct dirent *dent;
+  double start, seq_time, par_time;
+  size_t i;
+  int j;
+
+  dir = opendir (DATADIR);
+  if (!dir)
+    {
+      perror (DATADIR);
+      exit (1);
+    }
+  while ((dent = readdir (dir)))
+    {
+      size_t len = strlen (dent->d_name);
+      msgtype_t type = type_for_file (dent->d_name);
+
+      if (len > 5 && !strcmp (dent->d_name + len - 5, ".mbox")
+          && type != MSGTYPE_UNKNOWN)
+        {
+          files.push_back (std::string (DATADIR "/") + dent->d_name);
+          types.push_back (type);
+        }
+    }
+  closedir (dir);
+
+  expected.resize (files.size ());
+  start = now ();
+  for (j = 0; j < copies; j++)
+    for (i = 0; i < files.size (); i++)
+      parse_mail (files[i], types[i], &expected[i]);
+  seq_time = now () - start;
+
+  auto sched = ParseScheduler::instance ();
+  sched->setMaxWorkers (workers);
+  results.resize (files.size () * copies);
+  start = now ();
+  for (i = 0; i < results.size (); i++)
+    {
+      size_t idx = i % files.size ();
+      result_s *result = &results[i];
+
+      sched->submit (result, ParseScheduler::PrioNormal,
+                     [&files, &types, idx, result] () {
+                       parse_mail (files[idx], types[idx], result);
+                     });
+    }
+  sched->waitIdle ();
+  par_time = now () - start;
+
+  for (i = 0; i < results.size (); i++)
+    {
+      const result_s &a = expected[i % files.size ()];
+      const result_s &b = results[i];
+
+      if (a.body != b.body || a.html != b.html || a.charset != b.charset
+          || a.attachments != b.attachments
+          || a.decrypt_error != b.decrypt_error
+          || a.signatures != b.signatures)
+        {
+          fprintf (stderr, "Mismatch for %s\n",
+                   files[i % files.size ()].c_str ());
+          fail ("parallel result differs");
+        }
+    }
+
+  if (verbose)
+    printf ("%lu mails: sequential %.3fs, %d workers %.3fs\n",
+            (unsigned long) results.size (), seq_time, workers, par_time);
+}
+
+
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static int gate_state;
+
+static void
+set_gate (int state)
+{
+  pthread_mutex_lock (&gate_lock);
+  gate_state = state;
+  pthread_cond_broadcast (&gate_cond);
+  pthread_mutex_unlock (&gate_lock);
+}
+
+static void
+wait_gate (int state)
+{
+  pthread_mutex_lock (&gate_lock);
+  while (gate_state != state)
+    pthread_cond_wait (&gate_cond, &gate_lock);
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+/* With a single worker which is busy queue some jobs and check the
+   order in which they are run.  */
+static void
+check_order ()
+{
+  auto sched = ParseScheduler::instance ();
+  std::string order;
+  int keys[5];
+
+  /* This must run before any other worker has been started.  */
+  sched->setMaxWorkers (1);
+  sched->submit (&keys[0], ParseScheduler::PrioNormal, [] () {
+                   set_gate (1);
+                   wait_gate (2);
+                 });
+  wait_gate (1);
+  /* keys[0] is running now.  */
+  sched->submit (&keys[1], ParseScheduler::PrioNormal,
+                 [&order] () { order += "A"; });
+  sched->submit (&keys[2], ParseScheduler::PrioNormal,
+                 [&order] () { order += "B"; });
+  sched->submit (&keys[3], ParseScheduler::PrioSelected,
+                 [&order] () { order += "C"; });
+  sched->submit (&keys[4], ParseScheduler::PrioBackground,
+                 [&order] () { order += "D"; });
+  /* A newer job for the same key replaces the queued one.  */
+  sched->submit (&keys[1], ParseScheduler::PrioNormal,
+                 [&order] () { order += "a"; });
+  if (!sched->cancel (&keys[2]))
+    fail ("queued job not canceled");
+  if (sched->cancel (&keys[0]))
+    fail ("running job canceled");
+  set_gate (2);
+  sched->waitIdle ();
+
+  if (verbose)
+    printf ("order: %s\n", order.c_str ());
+  if (order != "CaD")
+    fail ("jobs run in the wrong order");
+}
+
+
+/* Occupy the single worker until the gate is opened.  */
+static void
+block_worker (const void *key)
+{
+  auto sched = ParseScheduler::instance ();
+
+  set_gate (0);
+  sched->submit (key, ParseScheduler::PrioNormal, [] () {
+                   set_gate (1);
+                   wait_gate (2);
+                 });
+  wait_gate (1);
+}
+
+
+/* Select mails with a single worker which is busy.  */
+static void
+check_selected ()
+{
+  auto sched = ParseScheduler::instance ();
+  std::string order;
+  int keys[4];
+
+  /* A mail which is selected before its job is queued.  */
+  block_worker (&keys[0]);
+  sched->setSelected (&keys[2]);
+  sched->submit (&keys[1], ParseScheduler::PrioNormal,
+                 [&order] () { order += "A"; });
+  sched->submit (&keys[2], ParseScheduler::PrioNormal,
+                 [&order] () { order += "B"; });
+  set_gate (2);
+  sched->waitIdle ();
+
+  /* Selecting another mail lowers the priority of the previous one.  */
+  block_worker (&keys[0]);
+  sched->submit (&keys[1], ParseScheduler::PrioNormal,
+                 [&order] () { order += "a"; });
+  sched->submit (&keys[2], ParseScheduler::PrioNormal,
+                 [&order] () { order += "b"; });
+  sched->submit (&keys[3], ParseScheduler::PrioNormal,
+                 [&order] () { order += "c"; });
+  sched->setSelected (&keys[3]);
+  set_gate (2);
+  sched->waitIdle ();
+  sched->cancel (&keys[3]);
+
+  if (verbose)
+    printf ("selected order: %s\n", order.c_str ());
+  if (order != "BAcab")
+    fail ("selected jobs run in the wrong order");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int copies = 8;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    {
+      verbose = 1;
+      argc--;
+      argv++;
+    }
+  if (argc > 1)
+    copies = atoi (argv[1]);
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  check_order ();
+  check_selected ();
+  check_parallel (copies, PARSE_MAX_WORKERS);
+
+  return !!failures;
+}
@@ -0,0 +1,138 @@
+/* t-partcache.cpp - Test for the cache of attachment parts.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Parts of generated attachments are stored in the PartCache and
+   looked up with the same and with changed data, names and content
+   ids.  Then the size limit and the eviction of the least recently
+   used entries are checked.  Only the parts count for the size as the
+   attachment data is not kept.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+#include "partcache.h"
+#include "t-support.h"
+
+
+static std::string
+generate_data (size_t size, unsigned int seed)
+{
+  std::string ret (size, '\0');
+
+  for (size_t i = 0; i < size; i++)
+    {
+      seed = seed * 1103515245 + 12345;
+      ret[i] = (char) (seed >> 16);
+    }
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  auto cache = PartCache::instance ();
+  const size_t size = 256 * 1024;
+  const std::string data = generate_data (size, 1);
+  const std::string part = "Content-Type: application/octet-stream\r\n"
+                           "\r\n" + generate_data (size, 2);
+
+  (void) argc;
+  (void) argv;
+
+  if (cache->find (data, "a.bin", ""))
+    fail ("found part in empty cache");
+
+  /* Small attachments are not cached.  */
+  cache->store ("small", "small.txt", "", "part");
+  if (cache->count () || cache->find ("small", "small.txt", ""))
+    fail ("small attachment cached");
+
+  cache->store (data, "a.bin", "", part);
+  if (cache->count () != 1 || cache->size () != part.size ())
+    fail ("part not stored");
+  auto found = cache->find (data, "a.bin", "");
+  if (!found || *found != part)
+    fail ("stored part not found");
+  auto again = cache->find (data, "a.bin", "");
+  if (!again || *again != part || again == found)
+    fail ("found part is not a copy");
+  again = nullptr;
+  if (cache->find (data, "b.bin", ""))
+    fail ("found part for another name");
+  if (cache->find (data, "a.bin", "cid@example"))
+    fail ("found part for another content id");
+
+  std::string changed = data;
+  changed[size / 2] ^= 1;
+  if (cache->find (changed, "a.bin", ""))
+    fail ("found part for changed data");
+  if (cache->find (data.substr (0, size - 1), "a.bin", ""))
+    fail ("found part for truncated data");
+  /* The fields of the key can't be shifted into each other.  */
+  if (cache->find (data + "a", ".bin", ""))
+    fail ("found part for shifted name");
+
+  /* Storing the same attachment again replaces the entry.  */
+  cache->store (data, "a.bin", "", part);
+  if (cache->count () != 1)
+    fail ("entry not replaced");
+
+  /* The part stays valid after the entry is gone.  */
+  cache->clear ();
+  if (cache->count () || cache->size () || cache->find (data, "a.bin", ""))
+    fail ("cache not cleared");
+  if (*found != part)
+    fail ("found part changed by clear");
+  found = nullptr;
+
+  /* Entries larger than a quarter of the limit are not cached.  */
+  cache->setMaxSize (4 * part.size () - 1);
+  cache->store (data, "a.bin", "", part);
+  if (cache->count ())
+    fail ("too large part cached");
+
+  /* With room for four entries the least recently used one is
+     evicted by the fifth.  */
+  cache->setMaxSize (4 * part.size ());
+  const std::string names[] = {"1.bin", "2.bin", "3.bin", "4.bin", "5.bin"};
+  for (int i = 0; i < 4; i++)
+    cache->store (data, names[i], "", part);
+  if (cache->count () != 4)
+    fail ("entries not stored");
+  if (!cache->find (data, names[0], ""))
+    fail ("first entry not found");
+  cache->store (data, names[4], "", part);
+  if (cache->count () != 4)
+    fail ("entry not evicted");
+  if (!cache->find (data, names[0], "")
+      || cache->find (data, names[1], "")
+      || !cache->find (data, names[2], "")
+      || !cache->find (data, names[3], "")
+      || !cache->find (data, names[4], ""))
+    fail ("wrong entry evicted");
+
+  cache->setMaxSize (0);
+  if (cache->count () || cache->size ())
+    fail ("entries not evicted by the size limit");
+  cache->setMaxSize (PART_CACHE_MAX_SIZE);
+
+  return !!failures;
+}
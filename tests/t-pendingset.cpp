@@ -0,0 +1,151 @@
+/* t-pendingset.cpp - Test for waiting on pending jobs.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The KeyCache waits on a PendingSet for updates and imports.  This
+   checks that a waiter is woken up when its own key is removed and
+   not before, and measures how long that takes.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "pendingset.h"
+#include "t-support.h"
+
+typedef std::chrono::steady_clock test_clock;
+
+/* The wake-up latency is a few microseconds.  Polling took up to 10
+   milliseconds.  Only fail if something is badly wrong.  */
+#define MAX_LATENCY 0.5
+
+#define N_WAITERS 8
+
+
+struct waiter_s
+{
+  PendingSet *set;
+  std::string key;
+  bool ret;
+  test_clock::time_point woken;
+};
+
+
+static void *
+waiter_thread (void *arg)
+{
+  auto w = static_cast<waiter_s *> (arg);
+
+  w->ret = w->set->wait (w->key, 10000);
+  w->woken = test_clock::now ();
+  return nullptr;
+}
+
+
+static void
+check_basic ()
+{
+  PendingSet set;
+
+  if (!set.add ("a") || !set.add ("b"))
+    fail ("add failed");
+  if (set.add ("a"))
+    fail ("key added twice");
+  if (!set.contains ("a") || set.contains ("c") || set.size () != 2)
+    fail ("wrong keys");
+  if (!set.wait ("c", 0))
+    fail ("wait for a key which is not pending failed");
+  if (!set.remove ("a") || set.remove ("a") || set.contains ("a"))
+    fail ("remove failed");
+
+  auto start = test_clock::now ();
+  if (set.wait ("b", 50))
+    fail ("wait did not time out");
+  std::chrono::duration<double> elapsed = test_clock::now () - start;
+  if (elapsed.count () < 0.045)
+    fail ("wait returned too early");
+}
+
+
+/* Start a waiter for each key and remove the keys one after another.
+   Each waiter must be woken up after its key was removed.  */
+static void
+check_latency ()
+{
+  PendingSet set;
+  waiter_s waiters[N_WAITERS];
+  pthread_t threads[N_WAITERS];
+  test_clock::time_point removed[N_WAITERS];
+  double max = 0, sum = 0;
+  int i;
+
+  for (i = 0; i < N_WAITERS; i++)
+    {
+      waiters[i].set = &set;
+      waiters[i].key = "fpr" + std::to_string (i);
+      waiters[i].ret = false;
+      set.add (waiters[i].key);
+      pthread_create (&threads[i], nullptr, waiter_thread, &waiters[i]);
+    }
+  /* Give the waiters time to block.  */
+  usleep (50000);
+
+  for (i = 0; i < N_WAITERS; i++)
+    {
+      removed[i] = test_clock::now ();
+      set.remove (waiters[i].key);
+      usleep (10000);
+    }
+
+  for (i = 0; i < N_WAITERS; i++)
+    {
+      pthread_join (threads[i], nullptr);
+      if (!waiters[i].ret)
+        fail ("waiter timed out");
+      if (waiters[i].woken < removed[i])
+        fail ("waiter woken up before its key was removed");
+      std::chrono::duration<double> latency = waiters[i].woken - removed[i];
+      sum += latency.count ();
+      if (latency.count () > max)
+        max = latency.count ();
+    }
+
+  if (verbose)
+    printf ("wake-up latency: avg %.1f us, max %.1f us\n",
+            sum / N_WAITERS * 1e6, max * 1e6);
+  if (max > MAX_LATENCY)
+    fail ("wake-up latency too high");
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  check_basic ();
+  check_latency ();
+
+  return !!failures;
+}
@@ -0,0 +1,224 @@
+/* t-rfc822parse.cpp - Allocation test for the rfc822 parser.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The mails in tests/data and a generated deeply nested mail with
+   many attachments are fed into rfc822parse.  The number of heap
+   allocations done by the parser must not grow with the number of
+   parts, header lines and tokens and everything must be released by
+   rfc822parse_close.
+
+   The allocations are counted by replacing the memory debugging
+   hooks which the xmalloc macros call with DBG_MEMORY enabled.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <string>
+#include <set>
+#include <gpgme.h>
+
+#include "common_indep.h"
+#include "rfc822parse.h"
+#include "t-support.h"
+
+/* Allocations done by rfc822parse.c which are not yet freed.  */
+static std::set<void *> live;
+static size_t alloc_count;
+
+extern "C" void
+_memdbg_alloc (void *ptr, const char *srcname, const char *, int)
+{
+  if (ptr && !strcmp (srcname, "rfc822parse.c"))
+    {
+      live.insert (ptr);
+      alloc_count++;
+    }
+}
+
+extern "C" int
+memdbg_free (void *ptr)
+{
+  live.erase (ptr);
+  return 1;
+}
+
+
+/* Query the fields of each part like the MimeDataProvider does.  */
+static int
+message_cb (void *, rfc822parse_event_t event, rfc822parse_t msg)
+{
+  rfc822parse_field_t field;
+  const char *s;
+
+  if (event != RFC822PARSE_T2BODY)
+    return 0;
+
+  field = rfc822parse_parse_field (msg, "Content-Disposition", -1);
+  if (field)
+    {
+      rfc822parse_query_parameter (field, "filename", 0);
+      rfc822parse_release_field (field);
+    }
+  field = rfc822parse_parse_field (msg, "Content-Type", -1);
+  if (field)
+    {
+      s = rfc822parse_query_media_type (field, NULL);
+      if (s && !strcmp (s, "text"))
+        rfc822parse_query_parameter (field, "charset", 0);
+      rfc822parse_query_parameter (field, "name", 0);
+      rfc822parse_release_field (field);
+    }
+  return 0;
+}
+
+
+/* Parse the mail in DATA and check the allocations.  */
+static void
+check_mail (const char *name, const std::string &data)
+{
+  rfc822parse_t msg;
+  size_t pos, end, lines = 0;
+
+  alloc_count = 0;
+  msg = rfc822parse_open (message_cb, NULL);
+  if (!msg)
+    {
+      fail ("rfc822parse_open failed");
+      return;
+    }
+  for (pos = 0; pos < data.size (); pos = end + 1)
+    {
+      end = data.find ('\n', pos);
+      if (end == std::string::npos)
+        end = data.size ();
+      if (rfc822parse_insert (msg, (const unsigned char *)data.data () + pos,
+                              end - pos - (end > pos && data[end-1] == '\r')))
+        break;
+      lines++;
+    }
+  rfc822parse_close (msg);
+
+  if (verbose)
+    printf ("%s: %lu bytes, %lu lines, %lu allocations\n", name,
+            (unsigned long) data.size (), (unsigned long) lines,
+            (unsigned long) alloc_count);
+
+  if (!live.empty ())
+    {
+      fail ("memory not released by rfc822parse_close");
+      live.clear ();
+    }
+  /* The context and a chunk for every few KiB of header data.  Without
+     the arena there was an allocation for each line and token.  */
+  if (alloc_count > 4 + data.size () / 2048)
+    fail ("too many allocations");
+}
+
+
+static std::string
+read_file (const std::string &fname)
+{
+  std::string ret;
+  char buf[4096];
+  size_t n;
+  FILE *fp;
+
+  fp = fopen (fname.c_str (), "rb");
+  if (!fp)
+    {
+      perror (fname.c_str ());
+      exit (1);
+    }
+  while ((n = fread (buf, 1, sizeof buf, fp)))
+    ret.append (buf, n);
+  fclose (fp);
+  return ret;
+}
+
+
+/* Return a mail with DEPTH nested multipart/mixed parts each having
+   ATTACHMENTS small attachments.  */
+static std::string
+make_nested_mail (int depth, int attachments)
+{
+  std::string ret = "From: test@example.com\r\n"
+                    "Subject: Nested\r\n"
+                    "MIME-Version: 1.0\r\n";
+  int i, j;
+
+  for (i = 0; i < depth; i++)
+    {
+      std::string boundary = "=-=level" + std::to_string (i) + "=-=";
+
+      ret += "Content-Type: multipart/mixed; boundary=\"" + boundary
+             + "\"\r\n\r\n";
+      for (j = 0; j < attachments; j++)
+        {
+          ret += "--" + boundary + "\r\n"
+                 "Content-Type: application/octet-stream;"
+                 " name=\"file" + std::to_string (j) + ".bin\"\r\n"
+                 "Content-Disposition: attachment;\r\n"
+                 "\tfilename=\"file" + std::to_string (j) + ".bin\"\r\n"
+                 "Content-Transfer-Encoding: base64\r\n"
+                 "\r\n"
+                 "SGVsbG8gV29ybGQK\r\n";
+        }
+      ret += "--" + boundary + "\r\n";
+    }
+  ret += "Content-Type: text/plain; charset=us-ascii\r\n"
+         "\r\n"
+         "The innermost body.\r\n";
+  for (i = depth - 1; i >= 0; i--)
+    ret += "--=-=level" + std::to_string (i) + "=-=--\r\n";
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  DIR *dir;
+  struct dirent *dent;
+  size_t len;
+
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  opt.enable_debug = DBG_MEMORY;
+
+  dir = opendir (DATADIR);
+  if (!dir)
+    {
+      perror (DATADIR);
+      exit (1);
+    }
+  while ((dent = readdir (dir)))
+    {
+      len = strlen (dent->d_name);
+      if (len > 5 && !strcmp (dent->d_name + len - 5, ".mbox"))
+        check_mail (dent->d_name,
+                    read_file (std::string (DATADIR "/") + dent->d_name));
+    }
+  closedir (dir);
+
+  check_mail ("nested", make_nested_mail (10, 50));
+
+  return !!failures;
+}
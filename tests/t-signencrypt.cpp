@@ -0,0 +1,214 @@
+/* t-signencrypt.cpp - Test for streaming sign and encrypt.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This signs a large generated mail with the test key like the
+   CryptController does for PGP/MIME sign and encrypt and then
+   encrypts the multipart/signed structure from a SignedDataProvider.
+   The mail and the ciphertext are files so that the peak memory
+   measured during the encryption is only what the multipart/signed
+   construction needs.  It must stay far below the size of the mail.
+   The decrypted data must be the complete multipart/signed.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <gpgme.h>
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/signingresult.h>
+#include <gpgme++/encryptionresult.h>
+#include <gpgme++/decryptionresult.h>
+
+#include "common_indep.h"
+#include "signeddataprovider.h"
+
+#define BOUNDARY "=-=signencrypt=-="
+
+static long
+peak_rss_kb ()
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage))
+    {
+      perror ("getrusage");
+      exit (1);
+    }
+  return usage.ru_maxrss;
+}
+
+
+/* Write a mail with an attachment of SIZE pseudo random bytes to FP
+   in base64.  */
+static void
+write_mail (FILE *fp, size_t size)
+{
+  unsigned char bin[48 * 64];
+  char b64[B64_MIME_ENCODED_LEN (sizeof bin)];
+  unsigned int seed = 42;
+  size_t n, i;
+
+  fputs ("Content-Type: multipart/mixed; boundary=\"inner\"\r\n"
+         "\r\n"
+         "--inner\r\n"
+         "Content-Type: text/plain; charset=us-ascii\r\n"
+         "\r\n"
+         "See the attachment.\r\n"
+         "--inner\r\n"
+         "Content-Type: application/octet-stream\r\n"
+         "Content-Disposition: attachment; filename=\"data.bin\"\r\n"
+         "Content-Transfer-Encoding: base64\r\n"
+         "\r\n", fp);
+  while (size)
+    {
+      n = size < sizeof bin ? size : sizeof bin;
+      for (i = 0; i < n; i++)
+        {
+          seed = seed * 1103515245 + 12345;
+          bin[i] = seed >> 16;
+        }
+      fwrite (b64, 1, b64_encode_mime (b64, bin, n), fp);
+      size -= n;
+    }
+  fputs ("--inner--\r\n", fp);
+  fflush (fp);
+}
+
+
+static std::string
+read_all (FILE *fp)
+{
+  std::string ret;
+  char buf[65536];
+  size_t n;
+
+  rewind (fp);
+  while ((n = fread (buf, 1, sizeof buf, fp)) > 0)
+    ret.append (buf, n);
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  size_t size = 24 * 1024 * 1024;
+  GpgME::Error err;
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  if (argc > 1)
+    size = (size_t) atol (argv[1]) * 1024;
+
+  auto ctx = std::unique_ptr<GpgME::Context> (GpgME::Context::createForProtocol
+                                              (GpgME::OpenPGP));
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context\n");
+      exit (1);
+    }
+  ctx->setArmor (true);
+  ctx->setTextMode (true);
+  err = ctx->startKeyListing ((const char *) nullptr, true);
+  const auto key = ctx->nextKey (err);
+  ctx->endKeyListing ();
+  if (key.isNull ())
+    {
+      fprintf (stderr, "No secret key found\n");
+      exit (1);
+    }
+  ctx->addSigningKey (key);
+
+  FILE *mail_fp = tmpfile ();
+  FILE *cipher_fp = tmpfile ();
+  if (!mail_fp || !cipher_fp)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+  write_mail (mail_fp, size);
+  long mail_kb = ftello (mail_fp) / 1024;
+  rewind (mail_fp);
+
+  GpgME::Data input (mail_fp);
+  GpgME::Data signature;
+  const auto sigResult = ctx->sign (input, signature, GpgME::Detached);
+  if (sigResult.error ())
+    {
+      std::cerr << "Signing failed:\n" << sigResult;
+      exit (1);
+    }
+
+  const std::string head =
+    "Content-Type: multipart/signed; protocol=\"application/pgp-signature\";"
+    "\r\n\tmicalg=pgp-sha256; boundary=\"" BOUNDARY "\"\r\n"
+    "\r\n--" BOUNDARY "\r\n";
+  const std::string tail =
+    "\r\n--" BOUNDARY "\r\n"
+    "Content-Type: application/pgp-signature\r\n"
+    "\r\n" + signature.toString () + "\r\n--" BOUNDARY "--\r\n";
+
+  long before = peak_rss_kb ();
+  long used;
+  {
+    SignedDataProvider provider (head, input, tail);
+    GpgME::Data multipart (&provider);
+    GpgME::Data cipher (cipher_fp);
+
+    const auto result = ctx->encrypt ({key}, multipart, cipher,
+                                      GpgME::Context::AlwaysTrust);
+    used = peak_rss_kb () - before;
+    if (result.error ())
+      {
+        std::cerr << "Encryption failed:\n" << result;
+        exit (1);
+      }
+  }
+
+  /* Check the plaintext.  */
+  const std::string expected = head + read_all (mail_fp) + tail;
+  rewind (cipher_fp);
+  GpgME::Data cipher (cipher_fp);
+  GpgME::Data plain;
+  const auto decResult = ctx->decrypt (cipher, plain);
+  if (decResult.error ())
+    {
+      std::cerr << "Decryption failed:\n" << decResult;
+      exit (1);
+    }
+  if (plain.toString () != expected)
+    {
+      fprintf (stderr, "Plaintext mismatch\n");
+      exit (1);
+    }
+  fclose (mail_fp);
+  fclose (cipher_fp);
+
+  fprintf (stderr, "Mail: %ld KiB, peak RSS growth: %ld KiB\n",
+           mail_kb, used);
+  if (used >= mail_kb / 4)
+    {
+      fprintf (stderr, "Peak RSS growth is not independent of the mail\n");
+      exit (1);
+    }
+  exit (0);
+}
@@ -0,0 +1,238 @@
+/* t-splitcrypt.cpp - Test for the parallel crypto of a split send.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* With S/MIME and OpenPGP recipients a mail is split into one mail
+   per protocol.  The CryptController needs Outlook, so this test does
+   what its do_crypto does for sign and encrypt for one OpenPGP and
+   one S/MIME group of the test keys: a detached signature and the
+   encryption of the multipart/signed from a SignedDataProvider.  The
+   two groups are run one after another and at the same time in a
+   JobGroup, each with its own context.  The results of the parallel
+   run are decrypted and compared.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <gpgme.h>
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/signingresult.h>
+#include <gpgme++/encryptionresult.h>
+#include <gpgme++/decryptionresult.h>
+
+#include "common_indep.h"
+#include "jobgroup.h"
+#include "signeddataprovider.h"
+
+#define BOUNDARY "=-=splitcrypt=-="
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct group_s
+{
+  GpgME::Protocol proto;
+  GpgME::Key key;
+  std::string plain;
+  std::string expected;
+  std::string cipher;
+  GpgME::Error err;
+};
+
+
+static std::unique_ptr<GpgME::Context>
+create_context (GpgME::Protocol proto)
+{
+  auto ctx = std::unique_ptr<GpgME::Context> (GpgME::Context::createForProtocol
+                                              (proto));
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context\n");
+      exit (1);
+    }
+  ctx->setTextMode (proto == GpgME::OpenPGP);
+  ctx->setArmor (proto == GpgME::OpenPGP);
+  return ctx;
+}
+
+
+static GpgME::Key
+secret_key (GpgME::Protocol proto)
+{
+  GpgME::Error err;
+  auto ctx = create_context (proto);
+
+  err = ctx->startKeyListing ((const char *) nullptr, true);
+  const auto key = ctx->nextKey (err);
+  ctx->endKeyListing ();
+  if (key.isNull ())
+    {
+      fprintf (stderr, "No secret %s key found\n",
+               proto == GpgME::CMS ? "S/MIME" : "OpenPGP");
+      exit (1);
+    }
+  return key;
+}
+
+
+/* Sign and encrypt like CryptController::do_crypto.  */
+static void
+crypt_group (group_s *group)
+{
+  auto ctx = create_context (group->proto);
+  GpgME::Data input (group->plain.data (), group->plain.size (), false);
+  GpgME::Data signature;
+  GpgME::Data output;
+
+  ctx->addSigningKey (group->key);
+  const auto sigResult = ctx->sign (input, signature, GpgME::Detached);
+  if ((group->err = sigResult.error ()))
+    return;
+
+  const std::string head =
+    "Content-Type: multipart/signed;\r\n"
+    "\tboundary=\"" BOUNDARY "\"\r\n"
+    "\r\n--" BOUNDARY "\r\n";
+  const std::string tail =
+    "\r\n--" BOUNDARY "\r\n"
+    "Content-Type: application/octet-stream\r\n"
+    "\r\n" + signature.toString () + "\r\n--" BOUNDARY "--\r\n";
+  group->expected = head + group->plain + tail;
+
+  SignedDataProvider provider (head, input, tail);
+  GpgME::Data multipart (&provider);
+  const auto encResult = ctx->encrypt ({group->key}, multipart, output,
+                                       GpgME::Context::AlwaysTrust);
+  if ((group->err = encResult.error ()))
+    return;
+  group->cipher = output.toString ();
+}
+
+
+static void
+check_group (group_s *group)
+{
+  const char *name = group->proto == GpgME::CMS ? "S/MIME" : "OpenPGP";
+
+  if (group->err)
+    {
+      fprintf (stderr, "%s crypto failed: %s\n", name,
+               group->err.asString ());
+      exit (1);
+    }
+
+  auto ctx = create_context (group->proto);
+  GpgME::Data cipher (group->cipher.data (), group->cipher.size (), false);
+  GpgME::Data plain;
+  const auto result = ctx->decrypt (cipher, plain);
+  if (result.error ())
+    {
+      std::cerr << name << " decryption failed:\n" << result;
+      exit (1);
+    }
+  if (plain.toString () != group->expected)
+    {
+      fprintf (stderr, "%s plaintext mismatch\n", name);
+      exit (1);
+    }
+}
+
+
+static std::string
+generate_mail (size_t size)
+{
+  std::string ret = "Content-Type: application/octet-stream\r\n"
+                    "Content-Transfer-Encoding: base64\r\n"
+                    "\r\n";
+  unsigned char bin[48 * 64];
+  char b64[B64_MIME_ENCODED_LEN (sizeof bin)];
+  unsigned int seed = 42;
+  size_t n, i;
+
+  while (size)
+    {
+      n = size < sizeof bin ? size : sizeof bin;
+      for (i = 0; i < n; i++)
+        {
+          seed = seed * 1103515245 + 12345;
+          bin[i] = seed >> 16;
+        }
+      ret.append (b64, b64_encode_mime (b64, bin, n));
+      size -= n;
+    }
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  size_t size = 4 * 1024 * 1024;
+  std::vector<group_s> groups (2);
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  if (argc > 1)
+    size = (size_t) atol (argv[1]) * 1024;
+
+  const std::string mail = generate_mail (size);
+  groups[0].proto = GpgME::OpenPGP;
+  groups[1].proto = GpgME::CMS;
+  for (auto &group: groups)
+    {
+      group.key = secret_key (group.proto);
+      group.plain = mail;
+    }
+
+  auto start = bench_clock::now ();
+  for (auto &group: groups)
+    crypt_group (&group);
+  std::chrono::duration<double> serial = bench_clock::now () - start;
+  for (auto &group: groups)
+    check_group (&group);
+
+  for (auto &group: groups)
+    {
+      group.cipher.clear ();
+      group.expected.clear ();
+    }
+  start = bench_clock::now ();
+  {
+    JobGroup jobs;
+    for (auto &group: groups)
+      {
+        group_s *p = &group;
+        jobs.add ([p] () { crypt_group (p); });
+      }
+    jobs.wait ();
+  }
+  std::chrono::duration<double> parallel = bench_clock::now () - start;
+  for (auto &group: groups)
+    check_group (&group);
+
+  fprintf (stderr, "Mail: %lu KiB, one after another: %.1f ms,"
+           " in parallel: %.1f ms\n", (unsigned long) mail.size () / 1024,
+           serial.count () * 1000, parallel.count () * 1000);
+  exit (0);
+}
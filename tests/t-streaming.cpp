@@ -0,0 +1,235 @@
+/* t-streaming.cpp - Test for streaming decryption in the parser.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This encrypts a large generated mail to the test key and decrypts
+   it with a streaming ParseController.  The peak memory used by the
+   parser must stay below the size of the ciphertext as only the
+   decrypted attachment needs to be kept in memory.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <iostream>
+#include <gpgme.h>
+#include <gpgme++/context.h>
+#include <gpgme++/key.h>
+#include <gpgme++/encryptionresult.h>
+#include <gpgme++/interfaces/dataprovider.h>
+
+#include "parsecontroller.h"
+#include "attachment.h"
+
+#define BOUNDARY "=-=streaming=-="
+
+/* A data provider which generates a mail with an attachment of SIZE
+   pseudo random bytes without keeping it in memory.  */
+class MailGenerator : public GpgME::DataProvider
+{
+public:
+  MailGenerator (size_t size): m_left (size), m_pos (0), m_seed (42)
+  {
+    m_buf = "MIME-Version: 1.0\r\n"
+            "Content-Type: multipart/mixed; boundary=\"" BOUNDARY "\"\r\n"
+            "\r\n"
+            "--" BOUNDARY "\r\n"
+            "Content-Type: text/plain; charset=us-ascii\r\n"
+            "\r\n"
+            "See the attachment.\r\n"
+            "--" BOUNDARY "\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Content-Disposition: attachment; filename=\"data.bin\"\r\n"
+            "Content-Transfer-Encoding: base64\r\n"
+            "\r\n";
+    m_done = false;
+  }
+
+  bool isSupported (Operation op) const
+  { return op == Read; }
+
+  gpgme_ssize_t read (void *buffer, size_t size)
+  {
+    if (m_pos == m_buf.size ())
+      {
+        if (m_done)
+          return 0;
+        next_chunk ();
+      }
+    if (size > m_buf.size () - m_pos)
+      size = m_buf.size () - m_pos;
+    memcpy (buffer, m_buf.data () + m_pos, size);
+    m_pos += size;
+    return size;
+  }
+
+  gpgme_ssize_t write (const void *, size_t)
+  { return -1; }
+
+  gpgme_off_t seek (gpgme_off_t, int)
+  { return -1; }
+
+  void release () {}
+
+private:
+  void next_chunk ()
+  {
+    unsigned char bin[48 * 64];
+    size_t n = sizeof bin, i;
+
+    if (n > m_left)
+      n = m_left;
+    for (i = 0; i < n; i++)
+      {
+        m_seed = m_seed * 1103515245 + 12345;
+        bin[i] = m_seed >> 16;
+      }
+    m_left -= n;
+    m_buf.resize (B64_MIME_ENCODED_LEN (n));
+    m_buf.resize (b64_encode_mime (&m_buf[0], bin, n));
+    if (!m_left)
+      {
+        m_buf += "--" BOUNDARY "--\r\n";
+        m_done = true;
+      }
+    m_pos = 0;
+  }
+
+  std::string m_buf;
+  size_t m_left;
+  size_t m_pos;
+  unsigned int m_seed;
+  bool m_done;
+};
+
+
+static long
+peak_rss_kb ()
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage))
+    {
+      perror ("getrusage");
+      exit (1);
+    }
+  return usage.ru_maxrss;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  size_t size = 24 * 1024 * 1024;
+  GpgME::Error err;
+
+  putenv ((char*) "GNUPGHOME=" GPGHOMEDIR);
+  gpgme_check_version (NULL);
+
+  if (argc > 1)
+    size = (size_t) atol (argv[1]) * 1024;
+
+  /* Encrypt the generated mail into a temporary mbox file.  */
+  auto ctx = std::unique_ptr<GpgME::Context> (GpgME::Context::createForProtocol
+                                              (GpgME::OpenPGP));
+  if (!ctx)
+    {
+      fprintf (stderr, "Failed to create context\n");
+      exit (1);
+    }
+  ctx->setArmor (true);
+  err = ctx->startKeyListing ((const char *) nullptr, true);
+  const auto key = ctx->nextKey (err);
+  ctx->endKeyListing ();
+  if (key.isNull ())
+    {
+      fprintf (stderr, "No secret key found\n");
+      exit (1);
+    }
+
+  FILE *fp = tmpfile ();
+  if (!fp)
+    {
+      perror ("tmpfile");
+      exit (1);
+    }
+  fputs ("From: test@example.com\r\n"
+         "MIME-Version: 1.0\r\n"
+         "Content-Type: multipart/encrypted;"
+         " protocol=\"application/pgp-encrypted\"; boundary=\"outer\"\r\n"
+         "\r\n"
+         "--outer\r\n"
+         "Content-Type: application/pgp-encrypted\r\n"
+         "\r\n"
+         "Version: 1\r\n"
+         "\r\n"
+         "--outer\r\n"
+         "Content-Type: application/octet-stream\r\n"
+         "\r\n", fp);
+  fflush (fp);
+  {
+    MailGenerator generator (size);
+    GpgME::Data plain (&generator);
+    GpgME::Data cipher (fp);
+
+    const auto result = ctx->encrypt ({key}, plain, cipher,
+                                      GpgME::Context::AlwaysTrust);
+    if (result.error ())
+      {
+        std::cerr << "Encryption failed:\n" << result;
+        exit (1);
+      }
+  }
+  fseeko (fp, 0, SEEK_END);
+  fputs ("\r\n--outer--\r\n", fp);
+  fflush (fp);
+  long cipher_kb = ftello (fp) / 1024;
+  rewind (fp);
+
+  long before = peak_rss_kb ();
+  long used;
+  {
+    ParseController parser (fp, MSGTYPE_GPGOL_MULTIPART_ENCRYPTED, true);
+    parser.parse (true);
+    used = peak_rss_kb () - before;
+
+    if (parser.decrypt_result ().error ())
+      {
+        std::cerr << "Decryption failed:\n" << parser.decrypt_result ();
+        exit (1);
+      }
+    const auto atts = parser.get_attachments ();
+    if (atts.size () != 1
+        || atts[0]->get_data ().seek (0, SEEK_END) != (gpgme_off_t) size)
+      {
+        fprintf (stderr, "Attachment mismatch\n");
+        exit (1);
+      }
+  }
+  fclose (fp);
+
+  fprintf (stderr, "Ciphertext: %ld KiB, attachment: %lu KiB,"
+           " peak RSS growth: %ld KiB\n",
+           cipher_kb, (unsigned long) size / 1024, used);
+  if (used >= cipher_kb)
+    {
+      fprintf (stderr, "Peak RSS growth exceeds the ciphertext size\n");
+      exit (1);
+    }
+  exit (0);
+}
@@ -0,0 +1,40 @@
+/* t-support.h - Helper for the tests.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef T_SUPPORT_H
+#define T_SUPPORT_H
+
+#include <stdio.h>
+
+/* Not every test has a --verbose option.  */
+#if __GNUC__ >= 3
+static int verbose __attribute__ ((unused));
+#else
+static int verbose;
+#endif
+
+/* The number of failed checks.  main returns !!failures.  */
+static int failures;
+
+#define fail(a)  do { fprintf (stderr, "%s:%d: test failed: %s\n", \
+                               __FILE__, __LINE__, (a));           \
+                      failures++;                                  \
+                    } while (0)
+
+#endif /* T_SUPPORT_H */
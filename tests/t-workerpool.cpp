@@ -0,0 +1,162 @@
+/* t-workerpool.cpp - Test for the pool of worker threads.
+ * Copyright (C) 2026 g10 Code GmbH
+ *
+ * This file is part of GpgOL.
+ *
+ * GpgOL is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GpgOL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* A burst of jobs is queued at once while one worker is idle.  The
+   idle worker is woken up for only one of the jobs so the others must
+   start new workers until the maximum is reached.  Then the dropping
+   of queued jobs and waiting for an idle pool are checked.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <list>
+
+#include "workerpool.h"
+#include "t-support.h"
+
+#define N_WORKERS 4
+
+static std::list<int> queue;
+static WorkerPool *pool;
+
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_closed;
+static int running;
+static int max_running;
+static int done;
+
+
+static void
+run_job ()
+{
+  pthread_mutex_lock (&gate_lock);
+  if (++running > max_running)
+    max_running = running;
+  while (gate_closed)
+    pthread_cond_wait (&gate_cond, &gate_lock);
+  running--;
+  done++;
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+static std::function<void ()>
+take ()
+{
+  queue.pop_front ();
+  return run_job;
+}
+
+
+static void
+set_gate (bool closed)
+{
+  pthread_mutex_lock (&gate_lock);
+  gate_closed = closed;
+  pthread_cond_broadcast (&gate_cond);
+  pthread_mutex_unlock (&gate_lock);
+}
+
+
+/* Queue N jobs under one lock.  */
+static void
+queue_jobs (int n)
+{
+  pool->lock ();
+  for (int i = 0; i < n; i++)
+    queue.push_back (i);
+  pool->queued (n);
+  pool->unlock ();
+}
+
+
+static int
+get_running ()
+{
+  pthread_mutex_lock (&gate_lock);
+  int ret = running;
+  pthread_mutex_unlock (&gate_lock);
+  return ret;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int i;
+
+  (void) argc;
+  (void) argv;
+
+  pool = new WorkerPool ("test", 1, take);
+
+  /* Leave one idle worker.  */
+  queue_jobs (1);
+  pool->waitIdle ();
+  pool->lock ();
+  if (pool->workers () != 1 || pool->queuedJobs () || pool->runningJobs ())
+    fail ("pool not idle");
+  pool->setMaxWorkers (N_WORKERS);
+  pool->unlock ();
+
+  set_gate (true);
+  queue_jobs (2 * N_WORKERS);
+  /* Wait up to five seconds for all workers to run a job.  */
+  for (i = 0; i < 5000 && get_running () < N_WORKERS; i++)
+    usleep (1000);
+  if (get_running () != N_WORKERS)
+    fail ("burst did not start all workers");
+
+  pool->lock ();
+  if (pool->workers () != N_WORKERS || pool->runningJobs () != N_WORKERS
+      || pool->queuedJobs () != N_WORKERS)
+    fail ("wrong counters for a burst");
+  /* Drop the jobs which did not start.  */
+  pool->dropped ((int) queue.size ());
+  queue.clear ();
+  pool->unlock ();
+
+  set_gate (false);
+  pool->waitIdle ();
+  if (done != 1 + N_WORKERS || max_running != N_WORKERS)
+    fail ("wrong number of jobs run");
+
+  /* A larger pool starts workers for jobs which are already queued.  */
+  pool->lock ();
+  pool->setMaxWorkers (1);
+  pool->unlock ();
+  set_gate (true);
+  queue_jobs (2 * N_WORKERS);
+  pool->lock ();
+  pool->setMaxWorkers (N_WORKERS + 1);
+  pool->unlock ();
+  for (i = 0; i < 5000 && get_running () < N_WORKERS + 1; i++)
+    usleep (1000);
+  if (get_running () != N_WORKERS + 1)
+    fail ("new maximum did not start a worker");
+  set_gate (false);
+  pool->waitIdle ();
+  if (done != 1 + 3 * N_WORKERS)
+    fail ("queued jobs not run");
+
+  return !!failures;
+}